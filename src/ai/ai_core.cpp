@@ -21,6 +21,7 @@
 #include "ai_config.hpp"
 #include "ai_info.hpp"
 #include "ai.hpp"
+#include "../framerate_type.h"
 
 #include "../safeguards.h"
 
@@ -79,6 +80,7 @@
 	const Company *c;
 	FOR_ALL_COMPANIES(c) {
 		if (c->is_ai) {
+			PerformanceMeasurer framerate((PerformanceElement)(PFE_AI0 + c->index));
 			cur_company.Change(c->index);
 			c->ai_instance->GameLoop();
 		}
@@ -38,6 +38,7 @@
 #include "infrastructure_func.h"
 #include "zoom_func.h"
 #include "disaster_vehicle.h"
+#include "framerate_type.h"
 
 #include "table/strings.h"
 
@@ -2113,6 +2114,8 @@ bool Aircraft::Tick()
 {
 	if (!this->IsNormalAircraft()) return true;
 
+	PerformanceAccumulator framerate(PFE_GL_AIRCRAFT);
+
 	this->tick_counter++;
 
 	if (!(this->vehstatus & VS_STOPPED)) this->running_ticks++;
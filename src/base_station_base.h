@@ -88,6 +88,8 @@ struct BaseStation : StationPool::PoolItem<&_station_pool> {
 
 	virtual ~BaseStation();
 
+	static void PreCleanPool();
+
 	/**
 	 * Check whether a specific tile belongs to this station.
 	 * @param tile the tile to check
@@ -0,0 +1,259 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file benchmark.cpp Headless benchmark of the game loop: load a game, run a fixed number of ticks as fast as possible and report the timings. */
+
+#include "stdafx.h"
+#include "benchmark.h"
+#include "framerate_type.h"
+#include "openttd.h"
+#include "saveload/saveload.h"
+#include "genworld.h"
+#include "settings_type.h"
+#include "date_func.h"
+#include "map_func.h"
+#include "vehicle_base.h"
+#include "company_base.h"
+#include "station_base.h"
+#include "string_func.h"
+#include "thread/thread.h"
+#include "core/random_func.hpp"
+#include "3rdparty/md5/md5.h"
+#include "rev.h"
+
+#include "safeguards.h"
+
+BenchmarkSettings _benchmark; ///< Settings of the requested benchmark run.
+
+extern void StateGameLoop();
+
+static const uint MAX_BENCHMARK_STALLED_TICKS = 60000; ///< Number of ticks waiting for a link graph job, about a minute, after which the benchmark gives up.
+
+/**
+ * Parse the argument of the benchmark command line option.
+ * @param opt Argument in the form "ticks[:report_file]".
+ * @return True if the argument is valid.
+ */
+bool ParseBenchmarkOption(const char *opt)
+{
+	/* strtoul happily negates a number with a sign. */
+	if (*opt < '0' || *opt > '9') return false;
+
+	char *end;
+	unsigned long ticks = strtoul(opt, &end, 10);
+	if (end == opt || ticks == 0 || ticks > UINT_MAX) return false;
+	if (*end != '\0' && (*end != ':' || StrEmpty(end + 1))) return false;
+
+	_benchmark.ticks = (uint)ticks;
+	free(_benchmark.report_file);
+	_benchmark.report_file = (*end == ':') ? stredup(end + 1) : NULL;
+	return true;
+}
+
+/**
+ * Calculate a hash of the game state, so that a change of the game state by a performance change is noticed.
+ * This covers the map, the random state, the date, and the state of the vehicles, companies and stations.
+ * @param digest Buffer to store the hash in.
+ */
+static void CalculateGameStateHash(uint8 digest[16])
+{
+	Md5 checksum;
+	checksum.Append(_m, sizeof(Tile) * MapSize());
+	checksum.Append(_me, sizeof(TileExtended) * MapSize());
+	checksum.Append(&_random.state, sizeof(_random.state));
+	checksum.Append(&_date, sizeof(_date));
+	checksum.Append(&_date_fract, sizeof(_date_fract));
+	checksum.Append(&_tick_counter, sizeof(_tick_counter));
+
+	const Vehicle *v;
+	FOR_ALL_VEHICLES(v) {
+		const uint32 data[] = {
+			v->index, (uint32)v->x_pos, (uint32)v->y_pos, (uint32)v->z_pos, v->tile, v->cur_speed, v->progress, v->vehstatus,
+			v->cargo.StoredCount(), (uint32)(int64)v->profit_this_year, (uint32)((int64)v->profit_this_year >> 32),
+		};
+		checksum.Append(data, sizeof(data));
+	}
+
+	const Company *c;
+	FOR_ALL_COMPANIES(c) {
+		const int64 data[] = { c->index, (int64)c->money };
+		checksum.Append(data, sizeof(data));
+	}
+
+	const Station *st;
+	FOR_ALL_STATIONS(st) {
+		for (CargoID i = 0; i < NUM_CARGO; i++) {
+			const uint32 data[] = { st->index, i, st->goods[i].cargo.TotalCount(), st->goods[i].rating };
+			checksum.Append(data, sizeof(data));
+		}
+	}
+
+	checksum.Finish(digest);
+}
+
+/**
+ * Write a string to a JSON report, quoting and escaping it.
+ * @param f File to write to.
+ * @param str String to write.
+ */
+static void WriteJSONString(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for (; *str != '\0'; str++) {
+		if (*str == '"' || *str == '\\') fputc('\\', f);
+		if ((byte)*str < 0x20) {
+			fprintf(f, "\\u%04x", (byte)*str);
+		} else {
+			fputc(*str, f);
+		}
+	}
+	fputc('"', f);
+}
+
+/**
+ * Write the machine readable report of a benchmark run.
+ * The format is CSV when the file name ends with ".csv", and JSON otherwise.
+ * @param filename File to write to.
+ * @param ticks Number of ticks which were run.
+ * @param wall_time Wall time of the run, in microseconds.
+ * @param hash Hash of the game state at the end of the run.
+ * @return True if the report was written.
+ */
+static bool WriteBenchmarkReport(const char *filename, uint ticks, TimingMeasurement wall_time, const char *hash)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == NULL) return false;
+
+	const char *ext = strrchr(filename, '.');
+	bool csv = ext != NULL && strcasecmp(ext, ".csv") == 0;
+	double ticks_per_second = wall_time > 0 ? ticks * 1000000.0 / wall_time : 0;
+
+	if (csv) {
+		fprintf(f, "# revision,%s\n", _openttd_revision);
+		fprintf(f, "# savegame,%s\n", _file_to_saveload.name);
+		fprintf(f, "# ticks,%u\n", ticks);
+		fprintf(f, "# wall_time_ms,%.3f\n", wall_time / 1000.0);
+		fprintf(f, "# ticks_per_second,%.3f\n", ticks_per_second);
+		fprintf(f, "# state_hash,%s\n", hash);
+		fprintf(f, "element,samples,total_ms,average_ms,peak_ms\n");
+	} else {
+		fprintf(f, "{\n\t\"revision\": ");
+		WriteJSONString(f, _openttd_revision);
+		fprintf(f, ",\n\t\"savegame\": ");
+		WriteJSONString(f, _file_to_saveload.name);
+		fprintf(f, ",\n\t\"ticks\": %u,\n\t\"wall_time_ms\": %.3f,\n\t\"ticks_per_second\": %.3f,\n\t\"state_hash\": \"%s\",\n\t\"elements\": [",
+				ticks, wall_time / 1000.0, ticks_per_second, hash);
+	}
+
+	bool first = true;
+	for (PerformanceElement e = PFE_FIRST; e < PFE_MAX; e++) {
+		PerformanceTotals totals = GetPerformanceTotals(e);
+		if (totals.samples == 0) continue;
+
+		char name[64];
+		GetPerformanceElementName(e, name, lastof(name));
+		double average = totals.total_duration / 1000.0 / totals.samples;
+		if (csv) {
+			fprintf(f, "%s," OTTD_PRINTF64U ",%.3f,%.3f,%.3f\n", name, totals.samples, totals.total_duration / 1000.0, average, totals.peak_duration / 1000.0);
+		} else {
+			fprintf(f, "%s\n\t\t{ \"element\": ", first ? "" : ",");
+			WriteJSONString(f, name);
+			fprintf(f, ", \"samples\": " OTTD_PRINTF64U ", \"total_ms\": %.3f, \"average_ms\": %.3f, \"peak_ms\": %.3f }",
+					totals.samples, totals.total_duration / 1000.0, average, totals.peak_duration / 1000.0);
+		}
+		first = false;
+	}
+
+	if (!csv) fprintf(f, "\n\t]\n}\n");
+
+	bool ok = ferror(f) == 0;
+	if (fclose(f) != 0) ok = false;
+	return ok;
+}
+
+/**
+ * Run the benchmark requested on the command line.
+ * The game given with -g is loaded (or a new game is generated), the game loop
+ * is run for the requested number of ticks without any real-time pacing, and
+ * the timings are written to stdout and optionally to a report file.
+ * Ticks during which the game is paused waiting for a link graph job are not counted.
+ * The benchmark is aborted when the game is paused for any other reason, or when
+ * it waits for a link graph job for too long.
+ */
+void RunBenchmark()
+{
+	if (_switch_mode == SM_LOAD_GAME) {
+		_switch_mode = SM_NONE;
+		SwitchToMode(SM_LOAD_GAME);
+	} else {
+		StartNewGameWithoutGUI(_settings_newgame.game_creation.generation_seed);
+		SwitchToMode(_switch_mode);
+		_switch_mode = SM_NONE;
+	}
+
+	if (_game_mode != GM_NORMAL) {
+		fprintf(stderr, "Benchmark: loading the game failed, aborting\n");
+		return;
+	}
+
+	_pause_mode = PM_UNPAUSED;
+	ResetPerformanceData();
+
+	TimingMeasurement start = GetPerformanceTimer();
+	uint ticks_done = 0;
+	uint ticks_stalled = 0;
+	while (ticks_done < _benchmark.ticks) {
+		if ((_pause_mode & ~PM_PAUSED_LINK_GRAPH) != PM_UNPAUSED) {
+			fprintf(stderr, "Benchmark: the game got paused after %u ticks, aborting\n", ticks_done);
+			return;
+		}
+
+		bool paused = _pause_mode != PM_UNPAUSED;
+		StateGameLoop();
+		if (paused) {
+			if (++ticks_stalled == MAX_BENCHMARK_STALLED_TICKS) {
+				fprintf(stderr, "Benchmark: waited too long for a link graph job after %u ticks, aborting\n", ticks_done);
+				return;
+			}
+			/* Give the link graph job the game is waiting for some time to finish. */
+			CSleep(1);
+		} else {
+			ticks_stalled = 0;
+			ticks_done++;
+		}
+	}
+	TimingMeasurement wall_time = GetPerformanceTimer() - start;
+
+	uint8 digest[16];
+	char hash[33];
+	CalculateGameStateHash(digest);
+	md5sumToString(hash, lastof(hash), digest);
+
+	double ticks_per_second = wall_time > 0 ? ticks_done * 1000000.0 / wall_time : 0;
+	fprintf(stdout, "Benchmark: %s\n", StrEmpty(_file_to_saveload.name) ? "(new game)" : _file_to_saveload.name);
+	fprintf(stdout, "  Ticks:      %u\n", ticks_done);
+	fprintf(stdout, "  Wall time:  %.3f ms\n", wall_time / 1000.0);
+	fprintf(stdout, "  Ticks/s:    %.2f\n", ticks_per_second);
+	fprintf(stdout, "  State hash: %s\n", hash);
+	fprintf(stdout, "  %-24s %10s %14s %12s %12s\n", "Element", "Samples", "Total", "Average", "Peak");
+	for (PerformanceElement e = PFE_FIRST; e < PFE_MAX; e++) {
+		PerformanceTotals totals = GetPerformanceTotals(e);
+		if (totals.samples == 0) continue;
+
+		char name[64];
+		GetPerformanceElementName(e, name, lastof(name));
+		fprintf(stdout, "  %-24s %10u %11.2f ms %9.4f ms %9.3f ms\n", name, (uint)totals.samples,
+				totals.total_duration / 1000.0, totals.total_duration / 1000.0 / totals.samples, totals.peak_duration / 1000.0);
+	}
+	fflush(stdout);
+
+	if (_benchmark.report_file != NULL && !WriteBenchmarkReport(_benchmark.report_file, ticks_done, wall_time, hash)) {
+		fprintf(stderr, "Benchmark: writing the report to '%s' failed\n", _benchmark.report_file);
+	}
+}
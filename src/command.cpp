@@ -29,6 +29,7 @@
 #include "newgrf_text.h"
 #include "string_func.h"
 #include "scope_info.h"
+#include "newgrf_callback_cache.h"
 #include <array>
 
 #include "table/strings.h"
@@ -654,6 +655,9 @@ CommandCost DoCommand(TileIndex tile, uint32 p1, uint32 p2, DoCommandFlag flags,
 	/* Do not even think about executing out-of-bounds tile-commands */
 	if (tile != 0 && (tile >= MapSize() || (!IsValidTile(tile) && (flags & DC_ALL_TILES) == 0))) return CMD_ERROR;
 
+	/* The command may change anything, so do not memoise callback results while it runs, e.g. within the vehicle ticks. */
+	NewGRFCallbackCacheScope cb_cache(0);
+
 	/* Chop of any CMD_MSG or other flags; we don't need those here */
 	CommandProc *proc = _command_proc_table[cmd & CMD_ID_MASK].proc;
 
@@ -43,6 +43,7 @@
 #include "airport.h"
 #include "station_base.h"
 #include "economy_func.h"
+#include "framerate_type.h"
 
 #include "safeguards.h"
 
@@ -665,7 +666,7 @@ DEF_CONSOLE_CMD(ConRcon)
 DEF_CONSOLE_CMD(ConStatus)
 {
 	if (argc == 0) {
-		IConsoleHelp("List the status of all clients connected to the server. Usage 'status'");
+		IConsoleHelp("List the status and traffic of all clients connected to the server. Usage 'status'");
 		return true;
 	}
 
@@ -1990,6 +1991,44 @@ DEF_CONSOLE_CMD(ConDumpCpdpStats)
 	return true;
 }
 
+DEF_CONSOLE_CMD(ConDumpVehicleTileHashStats)
+{
+	if (argc == 0) {
+		IConsoleHelp("Dump vehicle tile hash occupancy stats.");
+		return true;
+	}
+
+	extern void DumpVehicleTileHashStats(char *buffer, const char *last);
+	char buffer[1024];
+	DumpVehicleTileHashStats(buffer, lastof(buffer));
+	PrintLineByLine(buffer);
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConDumpTraceRestrictStats)
+{
+	if (argc == 0) {
+		IConsoleHelp("Dump the most often executed signal routing restriction programs, and reset the counters. Usage: 'dump_tracerestrict_stats [profile on|off]'");
+		IConsoleHelp("With profiling on, the time spent executing each program is measured as well.");
+		return true;
+	}
+
+	extern bool _tracerestrict_profile;
+	extern void DumpTraceRestrictProgramStats(char *buffer, const char *last);
+
+	if (argc == 3 && strcmp(argv[1], "profile") == 0) {
+		_tracerestrict_profile = (strcmp(argv[2], "on") == 0);
+		IConsolePrintF(CC_DEFAULT, "Trace restrict profiling is %s", _tracerestrict_profile ? "on" : "off");
+		return true;
+	}
+	if (argc != 1) return false;
+
+	char buffer[8192];
+	DumpTraceRestrictProgramStats(buffer, lastof(buffer));
+	PrintLineByLine(buffer);
+	return true;
+}
+
 DEF_CONSOLE_CMD(ConCheckCaches)
 {
 	if (argc == 0) {
@@ -2010,6 +2049,34 @@ DEF_CONSOLE_CMD(ConCheckCaches)
 	return true;
 }
 
+DEF_CONSOLE_CMD(ConFramerate)
+{
+	if (argc == 0) {
+		IConsoleHelp("Show the time spent in each element of the game loop.");
+		return true;
+	}
+
+	extern void ConPrintFramerate();
+	ConPrintFramerate();
+	return true;
+}
+
+DEF_CONSOLE_CMD(ConFramerateWindow)
+{
+	if (argc == 0) {
+		IConsoleHelp("Open the frame rate window.");
+		return true;
+	}
+
+	if (_network_dedicated) {
+		IConsoleError("Can not open frame rate window on a dedicated server");
+		return false;
+	}
+
+	ShowFramerateWindow();
+	return true;
+}
+
 #ifdef _DEBUG
 /******************
  *  debug commands
@@ -2157,7 +2224,11 @@ void IConsoleStdLibRegister()
 	IConsoleCmdRegister("dump_command_log", ConDumpCommandLog, nullptr, true);
 	IConsoleCmdRegister("dump_inflation", ConDumpInflation, nullptr, true);
 	IConsoleCmdRegister("dump_cpdp_stats", ConDumpCpdpStats, nullptr, true);
+	IConsoleCmdRegister("dump_veh_hash_stats", ConDumpVehicleTileHashStats, nullptr, true);
+	IConsoleCmdRegister("dump_tracerestrict_stats", ConDumpTraceRestrictStats, nullptr, true);
 	IConsoleCmdRegister("check_caches", ConCheckCaches, nullptr, true);
+	IConsoleCmdRegister("fps", ConFramerate);
+	IConsoleCmdRegister("fps_wnd", ConFramerateWindow);
 
 	/* NewGRF development stuff */
 	IConsoleCmdRegister("reload_newgrfs",  ConNewGRFReload, ConHookNewGRFDeveloperTool);
@@ -22,6 +22,7 @@
 #include "saveload/saveload.h"
 #include "console_func.h"
 #include "debug.h"
+#include "newgrf_callback_cache.h"
 
 #include "safeguards.h"
 
@@ -52,6 +53,7 @@ void SetDate(Date date, DateFract fract)
 	_cur_year = ymd.year;
 	_cur_month = ymd.month;
 	SetScaledTickVariables();
+	InvalidateNewGRFCallbackCache();
 }
 
 void SetScaledTickVariables()
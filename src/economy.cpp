@@ -53,6 +53,8 @@
 #include "linkgraph/refresh.h"
 #include "tracerestrict.h"
 #include "tbtr_template_vehicle.h"
+#include "pathfinder/yapf/yapf_cache.h"
+#include "newgrf_callback_cache.h"
 
 #include "table/strings.h"
 #include "table/pricebase.h"
@@ -542,6 +544,10 @@ void ChangeOwnershipOfCompanyItems(Owner old_owner, Owner new_owner)
 		}
 		/* Update any signals in the buffer */
 		UpdateSignalsInBuffer();
+
+		/* Following tracks depends on their owner. */
+		YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
+		YapfNotifyRoadLayoutChange(INVALID_TILE);
 	}
 
 	/* Add airport infrastructure count of the old company to the new one. */
@@ -1313,7 +1319,7 @@ static OrderUnloadFlags GetUnloadType(const Vehicle *v)
 void PrepareUnload(Vehicle *front_v)
 {
 	Station *curr_station = Station::Get(front_v->last_station_visited);
-	curr_station->loading_vehicles.push_back(front_v);
+	curr_station->AddLoadingVehicle(front_v);
 
 	/* At this moment loading cannot be finished */
 	ClrBit(front_v->vehicle_flags, VF_LOADING_FINISHED);
@@ -1777,6 +1783,8 @@ static void LoadUnloadVehicle(Vehicle *front)
 			amount_unloaded = v->cargo.Unload(amount_unloaded, &ge->cargo, payment);
 			remaining = v->cargo.UnloadCount() > 0;
 			if (amount_unloaded > 0) {
+				/* The vehicle callbacks can read the amount of cargo. */
+				InvalidateNewGRFCallbackCache();
 				dirty_vehicle = true;
 				anything_unloaded = true;
 				new_load_unload_ticks += amount_unloaded;
@@ -1861,6 +1869,7 @@ static void LoadUnloadVehicle(Vehicle *front)
 			 * completely_emptied assignment can then be safely
 			 * removed; that's how TTDPatch behaves too. --pasky */
 			if (loaded > 0) {
+				InvalidateNewGRFCallbackCache();
 				completely_emptied = false;
 				anything_loaded = true;
 
@@ -2028,6 +2037,21 @@ void LoadUnloadStation(Station *st)
 	_cargo_delivery_destinations.Clear();
 }
 
+/**
+ * Load/unload the vehicles in all stations with loading vehicles, in the order of the station index.
+ * Stations without loading vehicles are not visited at all.
+ */
+void LoadUnloadStations()
+{
+	std::set<StationID>::iterator it = _loading_stations.begin();
+	while (it != _loading_stations.end()) {
+		StationID index = *it;
+		LoadUnloadStation(Station::Get(index));
+		/* Loading may have added or removed stations, so look the next one up again. */
+		it = _loading_stations.upper_bound(index);
+	}
+}
+
 /**
  * Monthly update of the economic data (of the companies as well as economic fluctuations).
  */
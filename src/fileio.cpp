@@ -15,8 +15,10 @@
 #include "fios.h"
 #include "string_func.h"
 #include "tar_type.h"
+#include "thread/thread.h"
 #ifdef WIN32
 #include <windows.h>
+#include <io.h>
 # define access _taccess
 #elif defined(__HAIKU__)
 #include <Path.h>
@@ -25,6 +27,10 @@
 #include <unistd.h>
 #include <pwd.h>
 #endif
+#if defined(UNIX) && !defined(__OS2__) && !defined(__MORPHOS__) && !defined(__AMIGA__)
+#include <sys/mman.h>
+#define WITH_MMAP
+#endif
 #include <sys/stat.h>
 #include <algorithm>
 
@@ -37,6 +43,19 @@
 /** Size of the #Fio data buffer. */
 #define FIO_BUFFER_SIZE 512
 
+/** Maximum total size of the files mapped into memory; small on 32 bit builds to leave enough address space. */
+static const size_t FIO_MAX_MAPPED_SIZE = (size_t)1 << (sizeof(size_t) > 4 ? 34 : 28);
+
+/** Mapping of a slotted file into memory, for reading it by #FioAcquireFileView. */
+struct FioMapping {
+	void *address;     ///< Start of the mapped memory, or \c NULL if the file is not mapped.
+	size_t length;     ///< Length of the mapped memory.
+	const byte *data;  ///< The data of the file in the mapped memory.
+	uint users;        ///< Number of acquired views on the mapping; it is not unmapped while there are any.
+	uint64 last_use;   ///< Value of #Fio::mapping_uses when a view on the mapping was acquired last.
+	bool failed;       ///< Whether mapping the file failed, so it is not tried again until the file is reopened.
+};
+
 /** Structure for keeping several open files with just one data buffer. */
 struct Fio {
 	byte *buffer, *buffer_end;             ///< position pointer in local buffer and last valid byte of buffer
@@ -47,6 +66,11 @@ struct Fio {
 	byte buffer_start[FIO_BUFFER_SIZE];    ///< local buffer when read from file
 	const char *filenames[MAX_FILE_SLOTS]; ///< array of filenames we (should) have open
 	char *shortnames[MAX_FILE_SLOTS];      ///< array of short names for spriteloader's use
+	size_t starts[MAX_FILE_SLOTS];         ///< file positions of the start of the files; non-zero for files in tars
+	size_t ends[MAX_FILE_SLOTS];           ///< file positions of the end of the files
+	FioMapping mappings[MAX_FILE_SLOTS];   ///< the files in memory, for reading them without the data buffer
+	size_t mapped_size;                    ///< total length of the mapped memory
+	uint64 mapping_uses;                   ///< number of acquired views on the mappings
 #if defined(LIMITED_FDS)
 	uint open_handles;                     ///< current amount of open handles
 	uint usage_count[MAX_FILE_SLOTS];      ///< count how many times this file has been opened
@@ -54,6 +78,7 @@ struct Fio {
 };
 
 static Fio _fio; ///< #Fio instance.
+static ThreadMutex *_fio_mapping_mutex = ThreadMutex::New(); ///< Guards the mappings of #_fio, as views on them may be acquired by any thread.
 
 /** Whether the working directory should be scanned. */
 static bool _do_scan_working_directory = true;
@@ -190,6 +215,146 @@ void FioReadBlock(void *ptr, size_t size)
 	_fio.pos += fread(ptr, 1, size, _fio.cur_fh);
 }
 
+/**
+ * Map a slotted file into memory.
+ * @param slot Slot of the file.
+ * @param m The mapping to fill.
+ * @return Whether the file could be mapped.
+ * @pre The caller holds #_fio_mapping_mutex.
+ */
+static bool FioMapFile(uint slot, FioMapping *m)
+{
+	size_t start = _fio.starts[slot];
+	size_t length = _fio.ends[slot] - start;
+	size_t offset = 0;
+	void *address = NULL;
+
+	/* Mappings start at a multiple of the page size, or the allocation granularity on Windows. */
+#if defined(WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	offset = start % info.dwAllocationGranularity;
+	HANDLE mapping = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(_fio.handles[slot])), NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping != NULL) {
+		uint64 aligned_start = start - offset;
+		address = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(aligned_start >> 32), (DWORD)aligned_start, length + offset);
+		/* The view keeps the mapping alive. */
+		CloseHandle(mapping);
+	}
+#elif defined(WITH_MMAP)
+	offset = start % sysconf(_SC_PAGESIZE);
+	address = mmap(NULL, length + offset, PROT_READ, MAP_PRIVATE, fileno(_fio.handles[slot]), start - offset);
+	if (address == MAP_FAILED) address = NULL;
+#else
+	/* Files cannot be mapped on this platform. */
+	m->failed = true;
+	return false;
+#endif
+
+	if (address == NULL) {
+		DEBUG(misc, 1, "Mapping %s into memory failed, reading it through the buffer instead", _fio.filenames[slot]);
+		m->failed = true;
+		return false;
+	}
+
+	m->address = address;
+	m->length = length + offset;
+	m->data = (const byte *)address + offset;
+	_fio.mapped_size += m->length;
+	return true;
+}
+
+/**
+ * Unmap a slotted file mapped by #FioMapFile.
+ * @param m The mapping.
+ * @pre The caller holds #_fio_mapping_mutex and there are no views on the mapping.
+ */
+static void FioUnmapFile(FioMapping *m)
+{
+	assert(m->users == 0);
+	if (m->address != NULL) {
+#if defined(WIN32)
+		UnmapViewOfFile(m->address);
+#elif defined(WITH_MMAP)
+		munmap(m->address, m->length);
+#endif
+		_fio.mapped_size -= m->length;
+	}
+	m->address = NULL;
+	m->length = 0;
+	m->data = NULL;
+}
+
+/**
+ * Unmap the least recently used files without views until another mapping fits within #FIO_MAX_MAPPED_SIZE.
+ * @param length Length of the other mapping.
+ * @return Whether the other mapping fits.
+ * @pre The caller holds #_fio_mapping_mutex.
+ */
+static bool FioMakeRoomForMapping(size_t length)
+{
+	while (_fio.mapped_size + length > FIO_MAX_MAPPED_SIZE) {
+		FioMapping *lru = NULL;
+		for (uint i = 0; i < MAX_FILE_SLOTS; i++) {
+			FioMapping *m = &_fio.mappings[i];
+			if (m->address != NULL && m->users == 0 && (lru == NULL || m->last_use < lru->last_use)) lru = m;
+		}
+		if (lru == NULL) return false;
+		FioUnmapFile(lru);
+	}
+	return true;
+}
+
+/**
+ * Acquire a view on the data of a slotted file in memory, so it can be read without
+ * the data buffer and file position shared by the other Fio functions. The file is
+ * mapped on demand and stays mapped at least until the view is released by
+ * #FioReleaseFileView. Views may be acquired, read and released by any thread.
+ * When the file cannot be mapped, the data of the view is \c NULL and the file has
+ * to be read through the data buffer instead, which only the main thread may do.
+ * @param slot Slot of the file.
+ * @return The view; file positions of the slot are positions in the view.
+ */
+FioFileView FioAcquireFileView(uint slot)
+{
+	ThreadMutexLocker lock(_fio_mapping_mutex);
+
+	FioFileView view;
+	view.begin = _fio.starts[slot];
+	view.end = _fio.ends[slot];
+	view.data = NULL;
+
+	FioMapping *m = &_fio.mappings[slot];
+	if (m->address == NULL) {
+		/* Without a file handle the file is closed, because of LIMITED_FDS; only the data buffer can reopen it. */
+		if (m->failed || _fio.handles[slot] == NULL || view.end == view.begin) return view;
+		if (view.end - view.begin > FIO_MAX_MAPPED_SIZE) {
+			m->failed = true;
+			return view;
+		}
+		if (!FioMakeRoomForMapping(view.end - view.begin) || !FioMapFile(slot, m)) return view;
+	}
+
+	m->users++;
+	m->last_use = ++_fio.mapping_uses;
+	view.data = m->data;
+	return view;
+}
+
+/**
+ * Release a view acquired by #FioAcquireFileView, allowing its file to be unmapped.
+ * @param slot Slot of the file.
+ * @param view The view.
+ */
+void FioReleaseFileView(uint slot, const FioFileView &view)
+{
+	if (view.data == NULL) return;
+
+	ThreadMutexLocker lock(_fio_mapping_mutex);
+	assert(_fio.mappings[slot].users > 0);
+	_fio.mappings[slot].users--;
+}
+
 /**
  * Close the file at the given slot number.
  * @param slot File index to close.
@@ -197,6 +362,11 @@ void FioReadBlock(void *ptr, size_t size)
 static inline void FioCloseFile(int slot)
 {
 	if (_fio.handles[slot] != NULL) {
+		{
+			ThreadMutexLocker lock(_fio_mapping_mutex);
+			FioUnmapFile(&_fio.mappings[slot]);
+			_fio.mappings[slot].failed = false;
+		}
 		fclose(_fio.handles[slot]);
 
 		free(_fio.shortnames[slot]);
@@ -250,11 +420,12 @@ static void FioFreeHandle()
 void FioOpenFile(uint slot, const char *filename, Subdirectory subdir)
 {
 	FILE *f;
+	size_t size;
 
 #if defined(LIMITED_FDS)
 	FioFreeHandle();
 #endif /* LIMITED_FDS */
-	f = FioFOpenFile(filename, "rb", subdir);
+	f = FioFOpenFile(filename, "rb", subdir, &size);
 	if (f == NULL) usererror("Cannot open file '%s'", filename);
 	long pos = ftell(f);
 	if (pos < 0) usererror("Cannot read file '%s'", filename);
@@ -262,6 +433,8 @@ void FioOpenFile(uint slot, const char *filename, Subdirectory subdir)
 	FioCloseFile(slot); // if file was opened before, close it
 	_fio.handles[slot] = f;
 	_fio.filenames[slot] = filename;
+	_fio.starts[slot] = pos;
+	_fio.ends[slot] = pos + size;
 
 	/* Store the filename without path and extension */
 	const char *t = strrchr(filename, PATHSEPCHAR);
@@ -1234,6 +1407,8 @@ void DeterminePaths(const char *exe)
 	_hotkeys_file = str_fmt("%shotkeys.cfg", config_dir);
 	extern char *_windows_file;
 	_windows_file = str_fmt("%swindows.cfg", config_dir);
+	extern char *_newgrf_scan_cache_file;
+	_newgrf_scan_cache_file = str_fmt("%snewgrf_scan.dat", config_dir);
 
 #if defined(WITH_XDG_BASEDIR) && defined(WITH_PERSONAL_DIR)
 	if (config_dir == config_home) {
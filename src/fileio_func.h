@@ -27,6 +27,16 @@ void FioOpenFile(uint slot, const char *filename, Subdirectory subdir);
 void FioReadBlock(void *ptr, size_t size);
 void FioSkipBytes(int n);
 
+/** View on the data of a slotted file in memory, addressed by file positions. */
+struct FioFileView {
+	const byte *data; ///< The data at file position #begin, or \c NULL if the file is not in memory.
+	size_t begin;     ///< File position of the first byte of the data.
+	size_t end;       ///< File position just after the last byte of the data.
+};
+
+FioFileView FioAcquireFileView(uint slot);
+void FioReleaseFileView(uint slot, const FioFileView &view);
+
 /**
  * The search paths OpenTTD could search through.
  * At least one of the slots has to be filled with a path.
@@ -0,0 +1,464 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file framerate_gui.cpp Recording and display of the time spent in the phases of the game loop. */
+
+#include "stdafx.h"
+#include "framerate_type.h"
+#include "window_gui.h"
+#include "window_func.h"
+#include "gfx_func.h"
+#include "core/geometry_func.hpp"
+#include "strings_func.h"
+#include "console_func.h"
+#include "console_type.h"
+#include "widgets/framerate_widget.h"
+#include "table/strings.h"
+
+#include <chrono>
+#include <vector>
+
+#include "safeguards.h"
+
+/** Number of data points kept in the history of each element. */
+static const int NUM_FRAMERATE_POINTS = 512;
+/** Number of data points used for the "current" value of an element. */
+static const int NUM_FRAMERATE_POINTS_CURRENT = 8;
+/** Maximum number of data points used to determine the game loop rate. */
+static const int NUM_FRAMERATE_POINTS_RATE = 64;
+
+/** Rolling history of the durations of one #PerformanceElement. */
+struct PerformanceData {
+	TimingMeasurement durations[NUM_FRAMERATE_POINTS];  ///< Recorded durations, in microseconds.
+	TimingMeasurement timestamps[NUM_FRAMERATE_POINTS]; ///< Start time of each recorded duration.
+	int next_index;                                     ///< Index of the next data point to be written.
+	int num_valid;                                      ///< Number of valid data points in the history.
+	int num_since_pause;                                ///< Number of data points recorded since the last pause.
+	TimingMeasurement acc_duration;                     ///< Duration accumulated since the last commit.
+	TimingMeasurement acc_timestamp;                    ///< Start time of the current accumulation.
+	PerformanceTotals totals;                           ///< Totals since the last reset of the performance data.
+
+	/**
+	 * Add a data point to the history.
+	 * @param start_time Time the measured element started.
+	 * @param duration Time taken by the measured element.
+	 */
+	void Add(TimingMeasurement start_time, TimingMeasurement duration)
+	{
+		this->durations[this->next_index] = duration;
+		this->timestamps[this->next_index] = start_time;
+		this->next_index = (this->next_index + 1) % NUM_FRAMERATE_POINTS;
+		this->num_valid = min(this->num_valid + 1, NUM_FRAMERATE_POINTS);
+		this->num_since_pause++;
+		this->totals.samples++;
+		this->totals.total_duration += duration;
+		this->totals.peak_duration = max(this->totals.peak_duration, duration);
+	}
+
+	/**
+	 * Get the index of a data point, counting backwards from the most recent one.
+	 * @param age Number of data points to go back, 0 is the most recent one.
+	 * @return Index into #durations and #timestamps.
+	 */
+	inline int GetIndex(int age) const
+	{
+		return (this->next_index - 1 - age + NUM_FRAMERATE_POINTS) % NUM_FRAMERATE_POINTS;
+	}
+
+	/**
+	 * Get the average duration of the most recent data points.
+	 * @param count Maximum number of data points to consider.
+	 * @return Average duration in milliseconds.
+	 */
+	double GetAverageDurationMilliseconds(int count) const
+	{
+		count = min(count, this->num_valid);
+		if (count == 0) return 0;
+
+		TimingMeasurement sum = 0;
+		for (int i = 0; i < count; i++) sum += this->durations[this->GetIndex(i)];
+		return (double)sum / count / 1000.0;
+	}
+
+	/**
+	 * Get the largest duration in the history.
+	 * @return Peak duration in milliseconds.
+	 */
+	double GetPeakDurationMilliseconds() const
+	{
+		TimingMeasurement peak = 0;
+		for (int i = 0; i < this->num_valid; i++) peak = max(peak, this->durations[this->GetIndex(i)]);
+		return (double)peak / 1000.0;
+	}
+
+	/**
+	 * Get the rate at which data points have been recorded since the last pause.
+	 * @return Data points per second, 0 if not enough data is available.
+	 */
+	double GetRate() const
+	{
+		int count = min(min(this->num_valid, this->num_since_pause), NUM_FRAMERATE_POINTS_RATE);
+		if (count < 2) return 0;
+
+		TimingMeasurement span = this->timestamps[this->GetIndex(0)] - this->timestamps[this->GetIndex(count - 1)];
+		if (span == 0) return 0;
+		return (double)(count - 1) * 1000000.0 / (double)span;
+	}
+};
+
+/** Performance data of all elements. */
+static PerformanceData _pf_data[PFE_MAX];
+
+/** Names of the elements, also used for indentation in the window. */
+static const StringID _pf_element_names[PFE_AI0] = {
+	STR_FRAMERATE_GAMELOOP,
+	STR_FRAMERATE_GL_TILELOOP,
+	STR_FRAMERATE_GL_ECONOMY,
+	STR_FRAMERATE_GL_TRAINS,
+	STR_FRAMERATE_GL_ROADVEHS,
+	STR_FRAMERATE_GL_SHIPS,
+	STR_FRAMERATE_GL_AIRCRAFT,
+	STR_FRAMERATE_GL_TOWNS,
+	STR_FRAMERATE_GL_STATIONS,
+	STR_FRAMERATE_GL_INDUSTRIES,
+	STR_FRAMERATE_GL_LANDSCAPE,
+	STR_FRAMERATE_GL_LINKGRAPH,
+	STR_FRAMERATE_ALLSCRIPTS,
+	STR_FRAMERATE_GAMESCRIPT,
+};
+
+/**
+ * Get the current time of the performance timer.
+ * @return Time in microseconds, with an arbitrary epoch.
+ */
+TimingMeasurement GetPerformanceTimer()
+{
+	using namespace std::chrono;
+	return (TimingMeasurement)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Begin a measurement of an element.
+ * @param elem Element to measure.
+ */
+PerformanceMeasurer::PerformanceMeasurer(PerformanceElement elem)
+{
+	assert(elem < PFE_MAX);
+	this->elem = elem;
+	this->start_time = GetPerformanceTimer();
+}
+
+/** Finish the measurement and record it in the history of the element. */
+PerformanceMeasurer::~PerformanceMeasurer()
+{
+	_pf_data[this->elem].Add(this->start_time, GetPerformanceTimer() - this->start_time);
+}
+
+/**
+ * Indicate that an element is paused, so that its rate is not computed across the pause.
+ * @param elem Element which is paused.
+ */
+/* static */ void PerformanceMeasurer::Paused(PerformanceElement elem)
+{
+	_pf_data[elem].num_since_pause = 0;
+}
+
+/**
+ * Begin a measurement which is added to the accumulated time of an element.
+ * @param elem Element to measure.
+ */
+PerformanceAccumulator::PerformanceAccumulator(PerformanceElement elem)
+{
+	assert(elem < PFE_MAX);
+	this->elem = elem;
+	this->start_time = GetPerformanceTimer();
+}
+
+/** Finish the measurement and add it to the accumulated time of the element. */
+PerformanceAccumulator::~PerformanceAccumulator()
+{
+	_pf_data[this->elem].acc_duration += GetPerformanceTimer() - this->start_time;
+}
+
+/**
+ * Commit the accumulated time of an element as a data point and start a new accumulation.
+ * @param elem Element to commit.
+ */
+/* static */ void PerformanceAccumulator::Reset(PerformanceElement elem)
+{
+	PerformanceData &pf = _pf_data[elem];
+	TimingMeasurement now = GetPerformanceTimer();
+	if (pf.acc_timestamp != 0) pf.Add(pf.acc_timestamp, pf.acc_duration);
+	pf.acc_duration = 0;
+	pf.acc_timestamp = now;
+}
+
+/** Clear the recorded history and totals of all elements. */
+void ResetPerformanceData()
+{
+	for (PerformanceElement e = PFE_FIRST; e < PFE_MAX; e++) {
+		_pf_data[e] = PerformanceData();
+	}
+}
+
+/**
+ * Get the totals of an element since the last call to ResetPerformanceData().
+ * @param elem Element to get the totals of.
+ * @return The totals.
+ */
+PerformanceTotals GetPerformanceTotals(PerformanceElement elem)
+{
+	return _pf_data[elem].totals;
+}
+
+/**
+ * Get the name of an element.
+ * @param elem Element to get the name of.
+ * @return String of the name, the parameters of which have been set.
+ */
+static StringID GetPerformanceElementName(PerformanceElement elem)
+{
+	if (elem >= PFE_AI0) {
+		SetDParam(0, elem - PFE_AI0 + 1);
+		return STR_FRAMERATE_AI;
+	}
+	return _pf_element_names[elem];
+}
+
+/**
+ * Get the name of an element as text.
+ * @param elem Element to get the name of.
+ * @param buf Buffer to write the name to.
+ * @param last Last valid position in the buffer.
+ * @return Position of the terminating null character in the buffer.
+ */
+char *GetPerformanceElementName(PerformanceElement elem, char *buf, const char *last)
+{
+	return GetString(buf, GetPerformanceElementName(elem), last);
+}
+
+/**
+ * Get the indentation level of an element, sub-phases are shown below the phase containing them.
+ * @param elem Element to get the indentation level of.
+ * @return Indentation level.
+ */
+static int GetPerformanceElementIndent(PerformanceElement elem)
+{
+	switch (elem) {
+		case PFE_GAMELOOP:
+		case PFE_ALLSCRIPTS:
+			return 0;
+
+		default:
+			return 1;
+	}
+}
+
+/** Window showing the time spent in each element of the game loop. */
+struct FramerateWindow : Window {
+	static const int INDENT_WIDTH = 8;  ///< Width of one indentation level.
+	static const int NUM_TICKS_REFRESH = 30; ///< Number of game ticks between refreshes.
+
+	Scrollbar *vscroll;
+	std::vector<PerformanceElement> elements; ///< Elements which have data to show.
+	uint name_width;                          ///< Width of the name column.
+	uint value_width;                         ///< Width of each value column.
+	int refresh_counter;                      ///< Ticks until the next refresh.
+
+	FramerateWindow(WindowDesc *desc, WindowNumber number) : Window(desc), name_width(0), value_width(0), refresh_counter(0)
+	{
+		this->CreateNestedTree();
+		this->vscroll = this->GetScrollbar(WID_FRW_SCROLLBAR);
+		this->FinishInitNested(number);
+		this->RebuildElements();
+	}
+
+	/** Rebuild the list of elements which have data to show. */
+	void RebuildElements()
+	{
+		this->elements.clear();
+		for (PerformanceElement e = PFE_FIRST; e < PFE_MAX; e++) {
+			if (_pf_data[e].num_valid > 0) this->elements.push_back(e);
+		}
+		this->vscroll->SetCount((int)this->elements.size());
+	}
+
+	virtual void OnTick()
+	{
+		if (--this->refresh_counter > 0) return;
+		this->refresh_counter = NUM_TICKS_REFRESH;
+		this->RebuildElements();
+		this->SetDirty();
+	}
+
+	virtual void SetStringParameters(int widget) const
+	{
+		switch (widget) {
+			case WID_FRW_RATE_GAMELOOP:
+				SetDParam(0, (uint64)(_pf_data[PFE_GAMELOOP].GetRate() * 100));
+				SetDParam(1, 2);
+				break;
+		}
+	}
+
+	virtual void UpdateWidgetSize(int widget, Dimension *size, const Dimension &padding, Dimension *fill, Dimension *resize)
+	{
+		switch (widget) {
+			case WID_FRW_RATE_GAMELOOP:
+				SetDParamMaxDigits(0, 6);
+				SetDParam(1, 2);
+				*size = maxdim(*size, GetStringBoundingBox(STR_FRAMERATE_RATE_GAMELOOP));
+				break;
+
+			case WID_FRW_TIMES: {
+				this->name_width = GetStringBoundingBox(STR_FRAMERATE_ELEMENT).width;
+				for (PerformanceElement e = PFE_FIRST; e < PFE_MAX; e++) {
+					StringID str = GetPerformanceElementName(e);
+					this->name_width = max(this->name_width, GetStringBoundingBox(str).width + GetPerformanceElementIndent(e) * INDENT_WIDTH);
+				}
+				SetDParamMaxDigits(0, 7);
+				SetDParam(1, 2);
+				this->value_width = GetStringBoundingBox(STR_FRAMERATE_MS).width;
+				this->value_width = max(this->value_width, GetStringBoundingBox(STR_FRAMERATE_CURRENT).width);
+				this->value_width = max(this->value_width, GetStringBoundingBox(STR_FRAMERATE_AVERAGE).width);
+				this->value_width = max(this->value_width, GetStringBoundingBox(STR_FRAMERATE_PEAK).width);
+
+				resize->height = FONT_HEIGHT_NORMAL;
+				size->width = WD_FRAMERECT_LEFT + this->name_width + 3 * (WD_FRAMERECT_LEFT + this->value_width) + WD_FRAMERECT_RIGHT;
+				size->height = WD_FRAMERECT_TOP + (PFE_AI0 + 1) * resize->height + WD_FRAMERECT_BOTTOM;
+				break;
+			}
+		}
+	}
+
+	virtual void OnResize()
+	{
+		this->vscroll->SetCapacityFromWidget(this, WID_FRW_TIMES, WD_FRAMERECT_TOP + WD_FRAMERECT_BOTTOM + FONT_HEIGHT_NORMAL);
+	}
+
+	/**
+	 * Draw one row of the times panel.
+	 * @param r Rectangle of the panel.
+	 * @param y Top of the row.
+	 * @param name Name of the row, its parameters must have been set.
+	 * @param indent Indentation level of the name.
+	 * @param values Strings of the three value columns, their parameters are set from \a ms.
+	 * @param ms Values to show in the value columns, in milliseconds.
+	 * @param colour Colour of the row.
+	 */
+	void DrawRow(const Rect &r, int y, StringID name, int indent, const StringID values[3], const double ms[3], TextColour colour) const
+	{
+		bool rtl = _current_text_dir == TD_RTL;
+		int left = r.left + WD_FRAMERECT_LEFT;
+		int right = r.right - WD_FRAMERECT_RIGHT;
+		int indent_px = indent * INDENT_WIDTH;
+		if (rtl) {
+			DrawString(right - this->name_width, right - indent_px, y, name, colour);
+		} else {
+			DrawString(left + indent_px, left + this->name_width, y, name, colour);
+		}
+
+		for (int i = 0; i < 3; i++) {
+			int col_left = left + this->name_width + WD_FRAMERECT_LEFT + i * (this->value_width + WD_FRAMERECT_LEFT);
+			int col_right = col_left + this->value_width;
+			if (rtl) {
+				int w = col_right - col_left;
+				col_right = right - (col_left - left);
+				col_left = col_right - w;
+			}
+			if (ms != NULL) {
+				SetDParam(0, (uint64)(ms[i] * 100));
+				SetDParam(1, 2);
+			}
+			DrawString(col_left, col_right, y, values[i], colour, SA_RIGHT);
+		}
+	}
+
+	virtual void DrawWidget(const Rect &r, int widget) const
+	{
+		if (widget != WID_FRW_TIMES) return;
+
+		int y = r.top + WD_FRAMERECT_TOP;
+		static const StringID headers[3] = { STR_FRAMERATE_CURRENT, STR_FRAMERATE_AVERAGE, STR_FRAMERATE_PEAK };
+		this->DrawRow(r, y, STR_FRAMERATE_ELEMENT, 0, headers, NULL, TC_WHITE);
+		y += FONT_HEIGHT_NORMAL;
+
+		static const StringID values[3] = { STR_FRAMERATE_MS, STR_FRAMERATE_MS, STR_FRAMERATE_MS };
+		int max_rows = this->vscroll->GetCapacity();
+		for (int i = this->vscroll->GetPosition(); i < (int)this->elements.size() && max_rows > 0; i++, max_rows--) {
+			PerformanceElement e = this->elements[i];
+			const PerformanceData &pf = _pf_data[e];
+			double ms[3] = {
+				pf.GetAverageDurationMilliseconds(NUM_FRAMERATE_POINTS_CURRENT),
+				pf.GetAverageDurationMilliseconds(NUM_FRAMERATE_POINTS),
+				pf.GetPeakDurationMilliseconds(),
+			};
+			StringID name = GetPerformanceElementName(e);
+			/* The name may use parameter 0, so draw it before the values set their parameters. */
+			this->DrawRow(r, y, name, GetPerformanceElementIndent(e), values, ms, GetPerformanceElementIndent(e) == 0 ? TC_ORANGE : TC_BLACK);
+			y += FONT_HEIGHT_NORMAL;
+		}
+	}
+};
+
+static const NWidgetPart _nested_framerate_widgets[] = {
+	NWidget(NWID_HORIZONTAL),
+		NWidget(WWT_CLOSEBOX, COLOUR_GREY),
+		NWidget(WWT_CAPTION, COLOUR_GREY, WID_FRW_CAPTION), SetDataTip(STR_FRAMERATE_CAPTION, STR_TOOLTIP_WINDOW_TITLE_DRAG_THIS),
+		NWidget(WWT_SHADEBOX, COLOUR_GREY),
+		NWidget(WWT_STICKYBOX, COLOUR_GREY),
+	EndContainer(),
+	NWidget(WWT_PANEL, COLOUR_GREY),
+		NWidget(WWT_TEXT, COLOUR_GREY, WID_FRW_RATE_GAMELOOP), SetPadding(WD_FRAMERECT_TOP, WD_FRAMERECT_RIGHT, WD_FRAMERECT_BOTTOM, WD_FRAMERECT_LEFT), SetFill(1, 0), SetDataTip(STR_FRAMERATE_RATE_GAMELOOP, STR_FRAMERATE_RATE_GAMELOOP_TOOLTIP),
+	EndContainer(),
+	NWidget(NWID_HORIZONTAL),
+		NWidget(WWT_PANEL, COLOUR_GREY, WID_FRW_TIMES), SetResize(0, 1), SetScrollbar(WID_FRW_SCROLLBAR), EndContainer(),
+		NWidget(NWID_VERTICAL),
+			NWidget(NWID_VSCROLLBAR, COLOUR_GREY, WID_FRW_SCROLLBAR),
+			NWidget(WWT_RESIZEBOX, COLOUR_GREY),
+		EndContainer(),
+	EndContainer(),
+};
+
+static WindowDesc _framerate_display_desc(
+	WDP_AUTO, "framerate_display", 0, 0,
+	WC_FRAMERATE_DISPLAY, WC_NONE,
+	0,
+	_nested_framerate_widgets, lengthof(_nested_framerate_widgets)
+);
+
+/** Open the window showing the time spent in each element of the game loop. */
+void ShowFramerateWindow()
+{
+	AllocateWindowDescFront<FramerateWindow>(&_framerate_display_desc, 0);
+}
+
+/** Print the time spent in each element of the game loop to the console. */
+void ConPrintFramerate()
+{
+	IConsolePrintF(CC_INFO, "Simulation rate: %.2f ticks/s", _pf_data[PFE_GAMELOOP].GetRate());
+	IConsolePrintF(CC_INFO, "%-24s %10s %10s %10s", "Element", "Current", "Average", "Peak");
+
+	char name[64];
+	bool printed_anything = false;
+	for (PerformanceElement e = PFE_FIRST; e < PFE_MAX; e++) {
+		const PerformanceData &pf = _pf_data[e];
+		if (pf.num_valid == 0) continue;
+
+		GetPerformanceElementName(e, name, lastof(name));
+		IConsolePrintF(GetPerformanceElementIndent(e) == 0 ? CC_WHITE : CC_DEFAULT, "%*s%-*s %7.2f ms %7.2f ms %7.2f ms",
+				GetPerformanceElementIndent(e) * 2, "", 24 - GetPerformanceElementIndent(e) * 2, name,
+				pf.GetAverageDurationMilliseconds(NUM_FRAMERATE_POINTS_CURRENT),
+				pf.GetAverageDurationMilliseconds(NUM_FRAMERATE_POINTS),
+				pf.GetPeakDurationMilliseconds());
+		printed_anything = true;
+	}
+
+	if (!printed_anything) IConsolePrint(CC_ERROR, "No performance measurements have been recorded yet.");
+}
@@ -0,0 +1,95 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file framerate_type.h
+ * Types for recording the time spent in the phases of the game loop.
+ *
+ * Each #PerformanceElement keeps a rolling history of its most recent
+ * durations. Phases which run once per game tick are recorded with a
+ * #PerformanceMeasurer, phases which are made up of many small pieces
+ * (such as the individual vehicle ticks) are summed up with a
+ * #PerformanceAccumulator and committed once per tick with
+ * PerformanceAccumulator::Reset().
+ */
+
+#ifndef FRAMERATE_TYPE_H
+#define FRAMERATE_TYPE_H
+
+#include "core/enum_type.hpp"
+#include "company_type.h"
+
+/** Elements of the game loop which have their time usage recorded. */
+enum PerformanceElement {
+	PFE_FIRST = 0,
+	PFE_GAMELOOP = 0,  ///< Complete game loop tick, also used for the simulation rate.
+	PFE_GL_TILELOOP,   ///< Time spent in the tile loop.
+	PFE_GL_ECONOMY,    ///< Time spent loading and unloading vehicles at stations.
+	PFE_GL_TRAINS,     ///< Time spent in the ticks of trains.
+	PFE_GL_ROADVEHS,   ///< Time spent in the ticks of road vehicles.
+	PFE_GL_SHIPS,      ///< Time spent in the ticks of ships.
+	PFE_GL_AIRCRAFT,   ///< Time spent in the ticks of aircraft.
+	PFE_GL_TOWNS,      ///< Time spent in OnTick_Town.
+	PFE_GL_STATIONS,   ///< Time spent in OnTick_Station.
+	PFE_GL_INDUSTRIES, ///< Time spent in OnTick_Industry.
+	PFE_GL_LANDSCAPE,  ///< Time spent in the remaining landscape ticks (trees, companies).
+	PFE_GL_LINKGRAPH,  ///< Time spent spawning and joining link graph jobs.
+	PFE_ALLSCRIPTS,    ///< Time spent in all scripts (game script and AIs).
+	PFE_GAMESCRIPT,    ///< Time spent in the game script.
+	PFE_AI0,           ///< Time spent in the AI of the first company, the other companies follow.
+	PFE_AI_LAST = PFE_AI0 + MAX_COMPANIES - 1,
+	PFE_MAX,           ///< End of enum, must be last.
+};
+DECLARE_POSTFIX_INCREMENT(PerformanceElement)
+
+/** Type used to hold a performance timing measurement, in microseconds. */
+typedef uint64 TimingMeasurement;
+
+/** Totals of an element since the performance data was last reset. */
+struct PerformanceTotals {
+	uint64 samples;                   ///< Number of recorded data points.
+	TimingMeasurement total_duration; ///< Sum of all recorded durations.
+	TimingMeasurement peak_duration;  ///< Largest recorded duration.
+};
+
+TimingMeasurement GetPerformanceTimer();
+void ResetPerformanceData();
+PerformanceTotals GetPerformanceTotals(PerformanceElement elem);
+char *GetPerformanceElementName(PerformanceElement elem, char *buf, const char *last);
+
+/**
+ * RAII class for measuring a simple element of the game loop.
+ * The measurement is recorded as a single data point when the object is destroyed.
+ */
+class PerformanceMeasurer {
+	PerformanceElement elem;      ///< Element being measured.
+	TimingMeasurement start_time; ///< Time the measurement was started.
+public:
+	PerformanceMeasurer(PerformanceElement elem);
+	~PerformanceMeasurer();
+
+	static void Paused(PerformanceElement elem);
+};
+
+/**
+ * RAII class for measuring an element of the game loop which is run many times per tick.
+ * Measurements are summed up until PerformanceAccumulator::Reset() commits them as a data point.
+ */
+class PerformanceAccumulator {
+	PerformanceElement elem;      ///< Element being measured.
+	TimingMeasurement start_time; ///< Time the measurement was started.
+public:
+	PerformanceAccumulator(PerformanceElement elem);
+	~PerformanceAccumulator();
+
+	static void Reset(PerformanceElement elem);
+};
+
+void ShowFramerateWindow();
+
+#endif /* FRAMERATE_TYPE_H */
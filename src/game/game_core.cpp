@@ -20,6 +20,7 @@
 #include "game_config.hpp"
 #include "game_instance.hpp"
 #include "game_info.hpp"
+#include "../framerate_type.h"
 
 #include "../safeguards.h"
 
@@ -36,6 +37,8 @@
 
 	Game::frame_counter++;
 
+	PerformanceMeasurer framerate(PFE_GAMESCRIPT);
+
 	Backup<CompanyByte> cur_company(_current_company, FILE_LINE);
 	cur_company.Change(OWNER_DEITY);
 	Game::instance->GameLoop();
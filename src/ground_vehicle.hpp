@@ -263,7 +263,7 @@ struct GroundVehicle : public SpecializedVehicle<T, Type> {
 	/**
 	 * Set front engine state.
 	 */
-	inline void SetFrontEngine() { SetBit(this->subtype, GVSF_FRONT); }
+	inline void SetFrontEngine() { SetBit(this->subtype, GVSF_FRONT); this->ResetTickKind(); }
 
 	/**
 	 * Remove the front engine state.
@@ -288,7 +288,7 @@ struct GroundVehicle : public SpecializedVehicle<T, Type> {
 	/**
 	 * Clear wagon property.
 	 */
-	inline void ClearWagon() { ClrBit(this->subtype, GVSF_WAGON); }
+	inline void ClearWagon() { ClrBit(this->subtype, GVSF_WAGON); this->ResetTickKind(); }
 
 	/**
 	 * Set engine status.
@@ -303,7 +303,7 @@ struct GroundVehicle : public SpecializedVehicle<T, Type> {
 	/**
 	 * Set a vehicle as a free wagon.
 	 */
-	inline void SetFreeWagon() { SetBit(this->subtype, GVSF_FREE_WAGON); }
+	inline void SetFreeWagon() { SetBit(this->subtype, GVSF_FREE_WAGON); this->ResetTickKind(); }
 
 	/**
 	 * Clear a vehicle from being a free wagon.
@@ -35,6 +35,8 @@
 #include "saveload/saveload.h"
 #include "3rdparty/cpp-btree/btree_set.h"
 #include "scope_info.h"
+#include "framerate_type.h"
+#include "newgrf_callback_cache.h"
 #include <deque>
 
 #include "table/strings.h"
@@ -728,6 +730,8 @@ TileIndex _cur_tileloop_tile;
  */
 void RunTileLoop()
 {
+	PerformanceMeasurer framerate(PFE_GL_TILELOOP);
+
 	/* The pseudorandom sequence of tiles is generated using a Galois linear feedback
 	 * shift register (LFSR). This allows a deterministic pseudorandom ordering, but
 	 * still with minimal state and fast iteration. */
@@ -1315,11 +1319,33 @@ void OnTick_LinkGraph();
 
 void CallLandscapeTick()
 {
-	OnTick_Town();
-	OnTick_Trees();
-	OnTick_Station();
-	OnTick_Industry();
+	/* Trees and companies share one element, the order of the ticks must not change. */
+	PerformanceAccumulator::Reset(PFE_GL_LANDSCAPE);
 
-	OnTick_Companies();
-	OnTick_LinkGraph();
+	{
+		PerformanceMeasurer framerate(PFE_GL_TOWNS);
+		OnTick_Town();
+	}
+	{
+		PerformanceAccumulator framerate(PFE_GL_LANDSCAPE);
+		OnTick_Trees();
+	}
+	{
+		PerformanceMeasurer framerate(PFE_GL_STATIONS);
+		/* The houses do not change during the station ticks, except for what invalidates the callback cache. */
+		NewGRFCallbackCacheScope cb_cache(1 << GSF_HOUSES);
+		OnTick_Station();
+	}
+	{
+		PerformanceMeasurer framerate(PFE_GL_INDUSTRIES);
+		OnTick_Industry();
+	}
+	{
+		PerformanceAccumulator framerate(PFE_GL_LANDSCAPE);
+		OnTick_Companies();
+	}
+	{
+		PerformanceMeasurer framerate(PFE_GL_LINKGRAPH);
+		OnTick_LinkGraph();
+	}
 }
@@ -14,6 +14,8 @@
 #include "../window_func.h"
 #include "linkgraphjob.h"
 #include "linkgraphschedule.h"
+#include "../map_func.h"
+#include <algorithm>
 
 #include "../safeguards.h"
 
@@ -47,6 +49,7 @@ LinkGraphJob::LinkGraphJob(const LinkGraph &orig, uint duration_multiplier) :
 		/* Copying the link graph here also copies its index member.
 		 * This is on purpose. */
 		link_graph(orig),
+		task(&LinkGraphSchedule::Run, this),
 		settings(_settings_game.linkgraph),
 		join_date_ticks(GetLinkGraphJobJoinDateTicks(duration_multiplier)),
 		start_date_ticks((_date * DAY_TICKS) + _date_fract),
@@ -66,20 +69,13 @@ void LinkGraphJob::EraseFlows(NodeID from)
 	}
 }
 
-void LinkGraphJob::SetJobGroup(std::shared_ptr<LinkGraphJobGroup> group)
-{
-	this->group = std::move(group);
-}
-
 /**
- * Join the calling thread with this job's thread if threading is enabled.
+ * Wait until the worker running this job has finished it. If the job has not
+ * been picked up by a worker yet, it is run in the calling thread.
  */
 void LinkGraphJob::JoinThread()
 {
-	if (this->group != nullptr) {
-		this->group->JoinThread();
-		this->group.reset();
-	}
+	LinkGraphSchedule::workers.Wait(&this->task);
 }
 
 /**
@@ -123,7 +119,7 @@ void LinkGraphJob::FinaliseJob()
 		FlowStatMap &flows = from.Flows();
 
 		for (EdgeIterator it(from.Begin()); it != from.End(); ++it) {
-			if (from[it->first].Flow() == 0) continue;
+			if (it->second.Flow() == 0) continue;
 			StationID to = (*this)[it->first].Station();
 			Station *st2 = Station::GetIfValid(to);
 			if (st2 == NULL || st2->goods[this->Cargo()].link_graph != this->link_graph.index ||
@@ -221,7 +217,8 @@ void LinkGraphJob::AbortJob()
 }
 
 /**
- * Initialize the link graph job: Resize nodes and edges and populate them.
+ * Initialize the link graph job: Resize nodes and demands and populate them,
+ * and collect the edges of the link graph into the flat edge array.
  * This is done after the constructor so that we can do it in the calculation
  * thread without delaying the main game.
  */
@@ -229,23 +226,52 @@ void LinkGraphJob::Init()
 {
 	uint size = this->Size();
 	this->nodes.resize(size);
-	this->edges.Resize(size, size);
+	this->demands.Resize(size, size);
+	this->edges.clear();
+	this->edge_offsets.resize(size + 1);
 	for (uint i = 0; i < size; ++i) {
-		this->nodes[i].Init(this->link_graph[i].Supply());
-		EdgeAnnotation *node_edges = this->edges[i];
+		LinkGraph::ConstNode from = this->link_graph[i];
+		this->nodes[i].Init(from.Supply());
+		DemandAnnotation *node_demands = this->demands[i];
 		for (uint j = 0; j < size; ++j) {
-			node_edges[j].Init();
+			node_demands[j].Init();
+		}
+
+		this->edge_offsets[i] = (uint)this->edges.size();
+		for (LinkGraph::ConstEdgeIterator it(from.Begin()); it != from.End(); ++it) {
+			EdgeAnnotation edge;
+			edge.to = it->first;
+			edge.capacity = it->second.Capacity();
+			edge.distance = DistanceMaxPlusManhattan(from.XY(), this->link_graph[it->first].XY());
+			edge.flow = 0;
+			this->edges.push_back(edge);
 		}
+		std::sort(this->edges.begin() + this->edge_offsets[i], this->edges.end(),
+				[](const EdgeAnnotation &a, const EdgeAnnotation &b) { return a.to < b.to; });
 	}
+	this->edge_offsets[size] = (uint)this->edges.size();
+}
+
+/**
+ * Find the edge between two nodes.
+ * @param from Source node of the edge.
+ * @param to Destination node of the edge.
+ * @return The edge annotation, or NULL if the nodes aren't connected.
+ */
+LinkGraphJob::EdgeAnnotation *LinkGraphJob::FindEdge(NodeID from, NodeID to)
+{
+	EdgeAnnotation *begin = this->edges.data() + this->edge_offsets[from];
+	EdgeAnnotation *end = this->edges.data() + this->edge_offsets[from + 1];
+	EdgeAnnotation *edge = std::lower_bound(begin, end, to, [](const EdgeAnnotation &e, NodeID to) { return e.to < to; });
+	return (edge != end && edge->to == to) ? edge : NULL;
 }
 
 /**
- * Initialize a linkgraph job edge.
+ * Initialize the demand annotation of a pair of nodes.
  */
-void LinkGraphJob::EdgeAnnotation::Init()
+void LinkGraphJob::DemandAnnotation::Init()
 {
 	this->demand = 0;
-	this->flow = 0;
 	this->unsatisfied_demand = 0;
 }
 
@@ -12,15 +12,15 @@
 #ifndef LINKGRAPHJOB_H
 #define LINKGRAPHJOB_H
 
-#include "../thread/thread.h"
+#include "../thread/thread_pool.h"
 #include "../core/dyn_arena_alloc.hpp"
 #include "linkgraph.h"
+#include "linkgraphschedule.h"
 #include <vector>
 #include <memory>
 
 class LinkGraphJob;
 class Path;
-class LinkGraphJobGroup;
 typedef std::vector<Path *> PathList;
 
 /** Type of the pool for link graph jobs. */
@@ -34,15 +34,28 @@ extern LinkGraphJobPool _link_graph_job_pool;
 class LinkGraphJob : public LinkGraphJobPool::PoolItem<&_link_graph_job_pool>{
 private:
 	/**
-	 * Annotation for a link graph edge.
+	 * Annotation for a pair of link graph nodes. Demand is assigned between
+	 * any two nodes, whether they are connected by an edge or not.
 	 */
-	struct EdgeAnnotation {
+	struct DemandAnnotation {
 		uint demand;             ///< Transport demand between the nodes.
-		uint unsatisfied_demand; ///< Demand over this edge that hasn't been satisfied yet.
-		uint flow;               ///< Planned flow over this edge.
+		uint unsatisfied_demand; ///< Demand between the nodes that hasn't been satisfied yet.
 		void Init();
 	};
 
+	/**
+	 * Annotation for a link graph edge. The edges of all nodes are stored in
+	 * one flat array, grouped by their source node and sorted by their
+	 * destination node, so that the edges of a node can be iterated
+	 * sequentially.
+	 */
+	struct EdgeAnnotation {
+		NodeID to;     ///< Destination of the edge.
+		uint capacity; ///< Capacity of the edge.
+		uint distance; ///< Distance between the stations of the nodes.
+		uint flow;     ///< Planned flow over this edge.
+	};
+
 	/**
 	 * Annotation for a link graph node.
 	 */
@@ -54,73 +67,99 @@ private:
 	};
 
 	typedef std::vector<NodeAnnotation> NodeAnnotationVector;
-	typedef SmallMatrix<EdgeAnnotation> EdgeAnnotationMatrix;
+	typedef SmallMatrix<DemandAnnotation> DemandAnnotationMatrix;
+	typedef std::vector<EdgeAnnotation> EdgeAnnotationVector;
 
 	friend const SaveLoad *GetLinkGraphJobDesc();
 	friend void GetLinkGraphJobDayLengthScaleAfterLoad(LinkGraphJob *lgj);
 	friend class LinkGraphSchedule;
-	friend class LinkGraphJobGroup;
 
 protected:
 	const LinkGraph link_graph;       ///< Link graph to by analyzed. Is copied when job is started and mustn't be modified later.
-	std::shared_ptr<LinkGraphJobGroup> group; ///< JOb group thread the job is running in or NULL if it's running in the main thread.
+	ThreadPoolTask task;              ///< Task running the job in the link graph worker pool.
 	const LinkGraphSettings settings; ///< Copy of _settings_game.linkgraph at spawn time.
 	DateTicks join_date_ticks;        ///< Date when the job is to be joined.
 	DateTicks start_date_ticks;       ///< Date when the job was started.
 	NodeAnnotationVector nodes;       ///< Extra node data necessary for link graph calculation.
-	EdgeAnnotationMatrix edges;       ///< Extra edge data necessary for link graph calculation.
+	DemandAnnotationMatrix demands;   ///< Extra data for each pair of nodes necessary for link graph calculation.
+	EdgeAnnotationVector edges;       ///< Edges of all nodes with the extra data necessary for link graph calculation.
+	std::vector<uint> edge_offsets;   ///< Index of the first edge of each node in #edges, with the total number of edges appended.
 	bool job_completed;               ///< Is the job still running. This is accessed by multiple threads and is permitted to be spuriously incorrect.
 	bool abort_job;                   ///< Abort the job at the next available opportunity. This is accessed by multiple threads.
 
 	void EraseFlows(NodeID from);
 	void JoinThread();
-	void SetJobGroup(std::shared_ptr<LinkGraphJobGroup> group);
+	EdgeAnnotation *FindEdge(NodeID from, NodeID to);
 
 public:
 
-	DynUniformArenaAllocator path_allocator; ///< Arena allocator used for paths
+	/**
+	 * Number of path searches the parallel flow calculation runs at the same time.
+	 * It does not depend on the number of threads, as changing it changes the result of the calculation.
+	 */
+	static const uint PARALLEL_PATH_SEARCHES = 16;
+
+	DynUniformArenaAllocator path_allocators[PARALLEL_PATH_SEARCHES]; ///< Arena allocators used for paths, one for each concurrent path search.
 
 	bool IsJobAborted() const;
 
 	/**
-	 * A job edge. Wraps a link graph edge and an edge annotation. The
-	 * annotation can be modified, the edge is constant.
+	 * A job edge between two nodes. Wraps the demand annotation of the pair of
+	 * nodes and, if the nodes are connected, the annotation of the edge
+	 * between them. Nodes which aren't connected have no capacity and flow.
 	 */
-	class Edge : public LinkGraph::ConstEdge {
+	class Edge {
 	private:
-		EdgeAnnotation &anno; ///< Annotation being wrapped.
+		DemandAnnotation &demand_anno; ///< Demand annotation being wrapped.
+		EdgeAnnotation *anno;          ///< Edge annotation being wrapped, NULL if there is no edge.
 	public:
 		/**
 		 * Constructor.
-		 * @param edge Link graph edge to be wrapped.
-		 * @param anno Annotation to be wrapped.
+		 * @param demand_anno Demand annotation to be wrapped.
+		 * @param anno Edge annotation to be wrapped, may be NULL.
 		 */
-		Edge(const LinkGraph::BaseEdge &edge, EdgeAnnotation &anno) :
-				LinkGraph::ConstEdge(edge), anno(anno) {}
+		Edge(DemandAnnotation &demand_anno, EdgeAnnotation *anno) :
+				demand_anno(demand_anno), anno(anno) {}
+
+		/**
+		 * Get edge's capacity.
+		 * @return Capacity.
+		 */
+		uint Capacity() const { return this->anno != NULL ? this->anno->capacity : 0; }
+
+		/**
+		 * Get the distance between the ends of the edge.
+		 * @return Distance.
+		 */
+		uint Distance() const { return this->anno != NULL ? this->anno->distance : 0; }
 
 		/**
 		 * Get the transport demand between end the points of the edge.
 		 * @return Demand.
 		 */
-		uint Demand() const { return this->anno.demand; }
+		uint Demand() const { return this->demand_anno.demand; }
 
 		/**
 		 * Get the transport demand that hasn't been satisfied by flows, yet.
 		 * @return Unsatisfied demand.
 		 */
-		uint UnsatisfiedDemand() const { return this->anno.unsatisfied_demand; }
+		uint UnsatisfiedDemand() const { return this->demand_anno.unsatisfied_demand; }
 
 		/**
 		 * Get the total flow on the edge.
 		 * @return Flow.
 		 */
-		uint Flow() const { return this->anno.flow; }
+		uint Flow() const { return this->anno != NULL ? this->anno->flow : 0; }
 
 		/**
 		 * Add some flow.
 		 * @param flow Flow to be added.
 		 */
-		void AddFlow(uint flow) { this->anno.flow += flow; }
+		void AddFlow(uint flow)
+		{
+			assert(this->anno != NULL);
+			this->anno->flow += flow;
+		}
 
 		/**
 		 * Remove some flow.
@@ -128,8 +167,8 @@ public:
 		 */
 		void RemoveFlow(uint flow)
 		{
-			assert(flow <= this->anno.flow);
-			this->anno.flow -= flow;
+			assert(this->anno != NULL && flow <= this->anno->flow);
+			this->anno->flow -= flow;
 		}
 
 		/**
@@ -138,8 +177,8 @@ public:
 		 */
 		void AddDemand(uint demand)
 		{
-			this->anno.demand += demand;
-			this->anno.unsatisfied_demand += demand;
+			this->demand_anno.demand += demand;
+			this->demand_anno.unsatisfied_demand += demand;
 		}
 
 		/**
@@ -148,40 +187,85 @@ public:
 		 */
 		void SatisfyDemand(uint demand)
 		{
-			assert(demand <= this->anno.unsatisfied_demand);
-			this->anno.unsatisfied_demand -= demand;
+			assert(demand <= this->demand_anno.unsatisfied_demand);
+			this->demand_anno.unsatisfied_demand -= demand;
 		}
 	};
 
 	/**
-	 * Iterator for job edges.
+	 * Iterator for the edges of a job node. The edges are iterated in the
+	 * order of their destination nodes.
 	 */
-	class EdgeIterator : public LinkGraph::BaseEdgeIterator<const LinkGraph::BaseEdge, Edge, EdgeIterator> {
-		EdgeAnnotation *base_anno; ///< Array of annotations to be (indirectly) iterated.
+	class EdgeIterator {
+		EdgeAnnotation *current;       ///< Edge currently pointed to.
+		DemandAnnotation *demand_row;  ///< Demand annotations of the source node.
+
+		/**
+		 * A "fake" pointer to enable operator-> on temporaries, see
+		 * LinkGraph::BaseEdgeIterator::FakePointer.
+		 */
+		class FakePointer : public SmallPair<NodeID, Edge> {
+		public:
+			FakePointer(const SmallPair<NodeID, Edge> &pair) : SmallPair<NodeID, Edge>(pair) {}
+			SmallPair<NodeID, Edge> *operator->() { return this; }
+		};
+
 	public:
 		/**
 		 * Constructor.
-		 * @param base Array of edges to be iterated.
-		 * @param base_anno Array of annotations to be iterated.
-		 * @param current Start offset of iteration.
+		 * @param current Edge to start the iteration at.
+		 * @param demand_row Demand annotations of the source node.
 		 */
-		EdgeIterator(const LinkGraph::BaseEdge *base, EdgeAnnotation *base_anno, NodeID current) :
-				LinkGraph::BaseEdgeIterator<const LinkGraph::BaseEdge, Edge, EdgeIterator>(base, current),
-				base_anno(base_anno) {}
+		EdgeIterator(EdgeAnnotation *current, DemandAnnotation *demand_row) :
+				current(current), demand_row(demand_row) {}
+
+		/**
+		 * Prefix-increment.
+		 * @return This.
+		 */
+		EdgeIterator &operator++()
+		{
+			this->current++;
+			return *this;
+		}
+
+		/**
+		 * Postfix-increment.
+		 * @return Version of this before increment.
+		 */
+		EdgeIterator operator++(int)
+		{
+			EdgeIterator ret(*this);
+			this->current++;
+			return ret;
+		}
+
+		/**
+		 * Compare with some other edge iterator.
+		 * @param other Instance of other iterator.
+		 * @return If the iterators point to the same edge.
+		 */
+		bool operator==(const EdgeIterator &other) const { return this->current == other.current; }
+
+		/**
+		 * Compare for inequality with some other edge iterator.
+		 * @param other Instance of other iterator.
+		 * @return If the iterators point to different edges.
+		 */
+		bool operator!=(const EdgeIterator &other) const { return this->current != other.current; }
 
 		/**
 		 * Dereference.
-		 * @return Pair of the edge currently pointed to and the ID of its
-		 *         other end.
+		 * @return Pair of the ID of the other end of the edge currently
+		 *         pointed to and the edge.
 		 */
 		SmallPair<NodeID, Edge> operator*() const
 		{
-			return SmallPair<NodeID, Edge>(this->current, Edge(this->base[this->current], this->base_anno[this->current]));
+			return SmallPair<NodeID, Edge>(this->current->to, Edge(this->demand_row[this->current->to], this->current));
 		}
 
 		/**
-		 * Dereference. Has to be repeated here as operator* is different than
-		 * in LinkGraph::EdgeWrapper.
+		 * Dereference with operator->.
 		 * @return Fake pointer to pair of NodeID/Edge.
 		 */
 		FakePointer operator->() const {
@@ -195,8 +279,9 @@ public:
 	 */
 	class Node : public LinkGraph::ConstNode {
 	private:
-		NodeAnnotation &node_anno;  ///< Annotation being wrapped.
-		EdgeAnnotation *edge_annos; ///< Edge annotations belonging to this node.
+		LinkGraphJob *job;              ///< Job the node belongs to.
+		NodeAnnotation &node_anno;      ///< Annotation being wrapped.
+		DemandAnnotation *demand_annos; ///< Demand annotations belonging to this node.
 	public:
 
 		/**
@@ -205,8 +290,8 @@ public:
 		 * @param node ID of the node.
 		 */
 		Node (LinkGraphJob *lgj, NodeID node) :
-			LinkGraph::ConstNode(&lgj->link_graph, node),
-			node_anno(lgj->nodes[node]), edge_annos(lgj->edges[node])
+			LinkGraph::ConstNode(&lgj->link_graph, node), job(lgj),
+			node_anno(lgj->nodes[node]), demand_annos(lgj->demands[node])
 		{}
 
 		/**
@@ -215,21 +300,29 @@ public:
 		 * @param to Remote end of the edge.
 		 * @return Edge between this node and "to".
 		 */
-		Edge operator[](NodeID to) const { return Edge(this->edges[to], this->edge_annos[to]); }
+		Edge operator[](NodeID to) const { return Edge(this->demand_annos[to], this->job->FindEdge(this->index, to)); }
+
+		/**
+		 * Get the transport demand to another node that hasn't been satisfied
+		 * by flows, yet. Unlike retrieving the edge this does not search for it.
+		 * @param to Remote end of the edge.
+		 * @return Unsatisfied demand.
+		 */
+		uint UnsatisfiedDemandTo(NodeID to) const { return this->demand_annos[to].unsatisfied_demand; }
 
 		/**
 		 * Iterator for the "begin" of the edge array. Only edges with capacity
-		 * are iterated. The others are skipped.
+		 * are iterated.
 		 * @return Iterator pointing to the first edge.
 		 */
-		EdgeIterator Begin() const { return EdgeIterator(this->edges, this->edge_annos, index); }
+		EdgeIterator Begin() const { return EdgeIterator(this->job->edges.data() + this->job->edge_offsets[this->index], this->demand_annos); }
 
 		/**
 		 * Iterator for the "end" of the edge array. Only edges with capacity
-		 * are iterated. The others are skipped.
+		 * are iterated.
 		 * @return Iterator pointing beyond the last edge.
 		 */
-		EdgeIterator End() const { return EdgeIterator(this->edges, this->edge_annos, INVALID_NODE); }
+		EdgeIterator End() const { return EdgeIterator(this->job->edges.data() + this->job->edge_offsets[this->index + 1], this->demand_annos); }
 
 		/**
 		 * Get amount of supply that hasn't been delivered, yet.
@@ -278,7 +371,7 @@ public:
 	 * Bare constructor, only for save/load. link_graph, join_date and actually
 	 * settings have to be brutally const-casted in order to populate them.
 	 */
-	LinkGraphJob() : settings(_settings_game.linkgraph),
+	LinkGraphJob() : task(&LinkGraphSchedule::Run, this), settings(_settings_game.linkgraph),
 			join_date_ticks(INVALID_DATE), start_date_ticks(INVALID_DATE), job_completed(false) {}
 
 	LinkGraphJob(const LinkGraph &orig, uint duration_multiplier);
@@ -20,6 +20,12 @@
 
 #include "../safeguards.h"
 
+/**
+ * Worker pool running the link graph jobs. It is declared before the schedule,
+ * so that it is destroyed after the schedule has aborted and joined its jobs.
+ */
+/* static */ ThreadPool LinkGraphSchedule::workers("ottd:linkgraph");
+
 /**
  * Static instance of LinkGraphSchedule.
  * Note: This instance is created on task start.
@@ -64,7 +70,7 @@ void LinkGraphSchedule::SpawnNext()
 	uint scaling = 1 + FindLastBit(total_cost);
 	uint64 cost_budget = total_cost / scaling;
 	uint64 used_budget = 0;
-	std::vector<LinkGraphJobGroup::JobInfo> jobs_to_execute;
+	std::vector<LinkGraphJob *> jobs_to_execute;
 	while (used_budget < cost_budget && !this->schedule.empty()) {
 		LinkGraph *lg = this->schedule.front();
 		assert(lg == LinkGraph::Get(lg->index));
@@ -74,7 +80,7 @@ void LinkGraphSchedule::SpawnNext()
 		if (LinkGraphJob::CanAllocateItem()) {
 			uint duration_multiplier = CeilDivT<uint64_t>(scaling * cost, total_cost);
 			std::unique_ptr<LinkGraphJob> job(new LinkGraphJob(*lg, duration_multiplier));
-			jobs_to_execute.emplace_back(job.get(), cost);
+			jobs_to_execute.push_back(job.get());
 			if (this->running.empty() || job->JoinDateTicks() >= this->running.back()->JoinDateTicks()) {
 				this->running.push_back(std::move(job));
 				DEBUG(linkgraph, 3, "LinkGraphSchedule::SpawnNext(): Running job: id: %u, nodes: %u, cost: " OTTD_PRINTF64U ", duration_multiplier: %u",
@@ -95,7 +101,7 @@ void LinkGraphSchedule::SpawnNext()
 
 	this->schedule.splice(this->schedule.end(), schedule_to_back);
 
-	LinkGraphJobGroup::ExecuteJobSet(std::move(jobs_to_execute));
+	this->StartJobs(jobs_to_execute);
 
 	DEBUG(linkgraph, 2, "LinkGraphSchedule::SpawnNext(): Linkgraph job totals: cost: " OTTD_PRINTF64U ", budget: " OTTD_PRINTF64U ", scaling: %u, scheduled: %zu, running: %zu",
 			total_cost, cost_budget, scaling, this->schedule.size(), this->running.size());
@@ -142,7 +148,7 @@ void LinkGraphSchedule::JoinNext()
 
 /**
  * Run all handlers for the given Job. This method is tailored to
- * ThreadObject::New.
+ * ThreadPoolTask.
  * @param j Pointer to a link graph job.
  */
 /* static */ void LinkGraphSchedule::Run(void *j)
@@ -175,11 +181,28 @@ void LinkGraphSchedule::JoinNext()
  */
 void LinkGraphSchedule::SpawnAll()
 {
-	std::vector<LinkGraphJobGroup::JobInfo> jobs_to_execute;
+	std::vector<LinkGraphJob *> jobs_to_execute;
 	for (JobList::iterator i = this->running.begin(); i != this->running.end(); ++i) {
-		jobs_to_execute.emplace_back(i->get());
+		jobs_to_execute.push_back(i->get());
+	}
+	this->StartJobs(jobs_to_execute);
+}
+
+/**
+ * Submit jobs to the worker pool. The most expensive jobs are submitted first,
+ * so that the cheap ones fill up the remaining workers and the load is spread
+ * evenly over them.
+ * @param jobs Jobs to be started.
+ */
+void LinkGraphSchedule::StartJobs(std::vector<LinkGraphJob *> &jobs)
+{
+	std::stable_sort(jobs.begin(), jobs.end(), [](const LinkGraphJob *a, const LinkGraphJob *b) {
+		return a->Graph().CalculateCostEstimate() > b->Graph().CalculateCostEstimate();
+	});
+
+	for (LinkGraphJob *job : jobs) {
+		LinkGraphSchedule::workers.Submit(&job->task);
 	}
-	LinkGraphJobGroup::ExecuteJobSet(std::move(jobs_to_execute));
 }
 
 /**
@@ -228,82 +251,6 @@ LinkGraphSchedule::~LinkGraphSchedule()
 	this->Clear();
 }
 
-LinkGraphJobGroup::LinkGraphJobGroup(constructor_token token, std::vector<LinkGraphJob *> jobs) :
-	jobs(std::move(jobs)) { }
-
-void LinkGraphJobGroup::SpawnThread() {
-	ThreadObject *t = nullptr;
-
-	/**
-	 * Spawn a thread if possible and run the link graph job in the thread. If
-	 * that's not possible run the job right now in the current thread.
-	 */
-	if (ThreadObject::New(&(LinkGraphJobGroup::Run), this, &t, "ottd:linkgraph")) {
-		this->thread.reset(t);
-		for (auto &it : this->jobs) {
-			it->SetJobGroup(this->shared_from_this());
-		}
-	} else {
-		this->thread.reset();
-		/* Of course this will hang a bit.
-		 * On the other hand, if you want to play games which make this hang noticably
-		 * on a platform without threads then you'll probably get other problems first.
-		 * OK:
-		 * If someone comes and tells me that this hangs for him/her, I'll implement a
-		 * smaller grained "Step" method for all handlers and add some more ticks where
-		 * "Step" is called. No problem in principle. */
-		LinkGraphJobGroup::Run(this);
-	}
-}
-
-void LinkGraphJobGroup::JoinThread() {
-	if (!this->thread || this->joined_thread) return;
-	this->thread->Join();
-	this->joined_thread = true;
-}
-
-/**
- * Run all jobs for the given LinkGraphJobGroup. This method is tailored to
- * ThreadObject::New.
- * @param j Pointer to a LinkGraphJobGroup.
- */
-/* static */ void LinkGraphJobGroup::Run(void *group)
-{
-	LinkGraphJobGroup *job_group = (LinkGraphJobGroup *)group;
-	for (LinkGraphJob *job : job_group->jobs) {
-		LinkGraphSchedule::Run(job);
-	}
-}
-
-/* static */ void LinkGraphJobGroup::ExecuteJobSet(std::vector<JobInfo> jobs) {
-	const uint thread_budget = 200000;
-
-	std::sort(jobs.begin(), jobs.end(), [](const JobInfo &a, const JobInfo &b) {
-		return a.cost_estimate < b.cost_estimate;
-	});
-
-	std::vector<LinkGraphJob *> bucket;
-	uint bucket_cost = 0;
-	auto flush_bucket = [&]() {
-		if (!bucket_cost) return;
-		DEBUG(linkgraph, 2, "LinkGraphJobGroup::ExecuteJobSet: Creating Job Group: jobs: %zu, cost: %u", bucket.size(), bucket_cost);
-		auto group = std::make_shared<LinkGraphJobGroup>(constructor_token(), std::move(bucket));
-		group->SpawnThread();
-		bucket_cost = 0;
-		bucket.clear();
-	};
-
-	for (JobInfo &it : jobs) {
-		if (bucket_cost && (bucket_cost + it.cost_estimate > thread_budget)) flush_bucket();
-		bucket.push_back(it.job);
-		bucket_cost += it.cost_estimate;
-	}
-	flush_bucket();
-}
-
-LinkGraphJobGroup::JobInfo::JobInfo(LinkGraphJob *job) :
-		job(job), cost_estimate(job->Graph().CalculateCostEstimate()) { }
-
 /**
  * Pause the game if on the next _date_fract tick, we would do a join with the next
  * link graph job, but it is still running.
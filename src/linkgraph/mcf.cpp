@@ -5,6 +5,7 @@
 #include "mcf.h"
 #include "../3rdparty/cpp-btree/btree_map.h"
 #include <set>
+#include <memory>
 
 #include "../safeguards.h"
 
@@ -111,8 +112,9 @@ public:
 class GraphEdgeIterator {
 private:
 	LinkGraphJob &job; ///< Job being executed
-	EdgeIterator i;    ///< Iterator pointing to current edge.
+	EdgeIterator i;    ///< Iterator pointing to the next edge.
 	EdgeIterator end;  ///< Iterator pointing beyond last edge.
+	EdgeIterator last; ///< Iterator pointing to the edge returned by Next().
 
 public:
 
@@ -121,7 +123,7 @@ public:
 	 * @param job Job to iterate on.
 	 */
 	GraphEdgeIterator(LinkGraphJob &job) : job(job),
-		i(NULL, NULL, INVALID_NODE), end(NULL, NULL, INVALID_NODE)
+		i(NULL, NULL), end(NULL, NULL), last(NULL, NULL)
 	{}
 
 	/**
@@ -141,7 +143,19 @@ public:
 	 */
 	NodeID Next()
 	{
-		return this->i != this->end ? (this->i++)->first : INVALID_NODE;
+		if (this->i == this->end) return INVALID_NODE;
+		this->last = this->i++;
+		return this->last->first;
+	}
+
+	/**
+	 * Get the edge to the node returned by the last call to Next(), without
+	 * looking it up again.
+	 * @return The edge.
+	 */
+	Edge GetEdge() const
+	{
+		return this->last->second;
 	}
 };
 
@@ -151,6 +165,8 @@ public:
 class FlowEdgeIterator {
 private:
 	LinkGraphJob &job; ///< Link graph job we're working with.
+	NodeID node;       ///< Node the flows are retrieved from.
+	NodeID next;       ///< Node returned by the last call to Next().
 
 	/** Lookup table for getting NodeIDs from StationIDs. */
 	std::vector<NodeID> station_to_node;
@@ -166,7 +182,7 @@ public:
 	 * Constructor.
 	 * @param job Link graph job to work with.
 	 */
-	FlowEdgeIterator(LinkGraphJob &job) : job(job)
+	FlowEdgeIterator(LinkGraphJob &job) : job(job), node(INVALID_NODE), next(INVALID_NODE)
 	{
 		for (NodeID i = 0; i < job.Size(); ++i) {
 			StationID st = job[i].Station();
@@ -184,6 +200,7 @@ public:
 	 */
 	void SetNode(NodeID source, NodeID node)
 	{
+		this->node = node;
 		const FlowStatMap &flows = this->job[node].Flows();
 		FlowStatMap::const_iterator it = flows.find(this->job[source].Station());
 		if (it != flows.end()) {
@@ -202,7 +219,18 @@ public:
 	NodeID Next()
 	{
 		if (this->it == this->end) return INVALID_NODE;
-		return this->station_to_node[(this->it++)->second];
+		this->next = this->station_to_node[(this->it++)->second];
+		return this->next;
+	}
+
+	/**
+	 * Get the edge to the node returned by the last call to Next().
+	 * Flows are not stored along with the edges, so the edge is looked up.
+	 * @return The edge.
+	 */
+	Edge GetEdge() const
+	{
+		return this->job[this->node][this->next];
 	}
 };
 
@@ -363,9 +391,10 @@ struct AnnosWrapper : public Tannotation {
  * @tparam Tedge_iterator Iterator to be used for getting outgoing edges.
  * @param source_node Node where the algorithm starts.
  * @param paths Container for the paths to be calculated.
+ * @param allocator Allocator for the paths.
  */
 template<class Tannotation, class Tedge_iterator>
-void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths)
+void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths, DynUniformArenaAllocator &allocator)
 {
 #ifdef CUSTOM_ALLOCATOR
 	typedef std::set<AnnoSetItem<Tannotation>, typename Tannotation::Comparator, AnnoSetAllocator<AnnoSetItem<Tannotation> > > AnnoSet;
@@ -379,10 +408,10 @@ void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths)
 	uint size = this->job.Size();
 	paths.resize(size, NULL);
 
-	this->job.path_allocator.SetParameters(sizeof(AnnosWrapper<Tannotation>), (8192 - 32) / sizeof(AnnosWrapper<Tannotation>));
+	allocator.SetParameters(sizeof(AnnosWrapper<Tannotation>), (8192 - 32) / sizeof(AnnosWrapper<Tannotation>));
 
 	for (NodeID node = 0; node < size; ++node) {
-		AnnosWrapper<Tannotation> *anno = new (this->job.path_allocator.Allocate()) AnnosWrapper<Tannotation>(node, node == source_node);
+		AnnosWrapper<Tannotation> *anno = new (allocator.Allocate()) AnnosWrapper<Tannotation>(node, node == source_node);
 		anno->UpdateAnnotation();
 		anno->self_iter = (node == source_node) ? annos.insert(AnnoSetItem<Tannotation>(anno)).first : annos.end(); // only insert the source node, the other nodes will be added as reached
 		paths[node] = anno;
@@ -396,7 +425,7 @@ void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths)
 		iter.SetNode(source_node, from);
 		for (NodeID to = iter.Next(); to != INVALID_NODE; to = iter.Next()) {
 			if (to == from) continue; // Not a real edge but a consumption sign.
-			Edge edge = this->job[from][to];
+			Edge edge = iter.GetEdge();
 			uint capacity = edge.Capacity();
 			if (this->max_saturation != UINT_MAX) {
 				capacity *= this->max_saturation;
@@ -404,7 +433,7 @@ void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths)
 				if (capacity == 0) capacity = 1;
 			}
 			/* punish in-between stops a little */
-			uint distance = DistanceMaxPlusManhattan(this->job[from].XY(), this->job[to].XY()) + 1;
+			uint distance = edge.Distance() + 1;
 			AnnosWrapper<Tannotation> *dest = static_cast<AnnosWrapper<Tannotation> *>(paths[to]);
 			if (dest->IsBetter(source, capacity, capacity - edge.Flow(), distance)) {
 				if (dest->self_iter != annos.end()) annos.erase(dest->self_iter);
@@ -416,13 +445,55 @@ void MultiCommodityFlow::Dijkstra(NodeID source_node, PathVector &paths)
 	}
 }
 
+/**
+ * Run a path search of a batch. This method is tailored to ThreadPoolTask.
+ * @param search Pointer to the PathSearch to run.
+ */
+template<class Tannotation, class Tedge_iterator>
+/* static */ void MultiCommodityFlow::RunPathSearch(void *search)
+{
+	PathSearch *s = (PathSearch *)search;
+	s->mcf->Dijkstra<Tannotation, Tedge_iterator>(s->source, s->mcf->paths[s->slot], s->mcf->job.path_allocators[s->slot]);
+}
+
+/**
+ * Search the paths from a batch of consecutive source nodes. The searches of
+ * a batch only read the job, so they are run concurrently on the link graph
+ * workers. The results only depend on the batch size: each search sees the
+ * flows as they were at the start of the batch, and the caller pushes the
+ * flows of the batch in the order of the source nodes afterwards.
+ * @param first_source First node of the batch.
+ * @param count Number of nodes in the batch.
+ */
+template<class Tannotation, class Tedge_iterator>
+void MultiCommodityFlow::FindPaths(NodeID first_source, uint count)
+{
+	assert(count <= this->batch_size);
+	PathSearch searches[LinkGraphJob::PARALLEL_PATH_SEARCHES];
+	std::vector<std::unique_ptr<ThreadPoolTask>> tasks;
+	for (uint slot = 0; slot < count; slot++) {
+		searches[slot] = { this, (NodeID)(first_source + slot), slot };
+		if (slot == 0) continue;
+		tasks.emplace_back(new ThreadPoolTask(&MultiCommodityFlow::RunPathSearch<Tannotation, Tedge_iterator>, &searches[slot]));
+		LinkGraphSchedule::workers.Submit(tasks.back().get());
+	}
+
+	/* Do the first search in this thread while the workers pick up the others. */
+	RunPathSearch<Tannotation, Tedge_iterator>(&searches[0]);
+	for (auto &task : tasks) {
+		LinkGraphSchedule::workers.Wait(task.get());
+	}
+}
+
 /**
  * Clean up paths that lead nowhere and the root path.
  * @param source_id ID of the root node.
- * @param paths Paths to be cleaned up.
+ * @param slot Position of the source in the current batch.
  */
-void MultiCommodityFlow::CleanupPaths(NodeID source_id, PathVector &paths)
+void MultiCommodityFlow::CleanupPaths(NodeID source_id, uint slot)
 {
+	PathVector &paths = this->paths[slot];
+	DynUniformArenaAllocator &allocator = this->job.path_allocators[slot];
 	Path *source = paths[source_id];
 	paths[source_id] = NULL;
 	for (PathVector::iterator i = paths.begin(); i != paths.end(); ++i) {
@@ -434,12 +505,12 @@ void MultiCommodityFlow::CleanupPaths(NodeID source_id, PathVector &paths)
 			path->Detach();
 			if (path->GetNumChildren() == 0) {
 				paths[path->GetNode()] = NULL;
-				this->job.path_allocator.Free(path);
+				allocator.Free(path);
 			}
 			path = parent;
 		}
 	}
-	this->job.path_allocator.Free(source);
+	allocator.Free(source);
 	paths.clear();
 }
 
@@ -613,37 +684,42 @@ bool MCF1stPass::EliminateCycles()
  */
 MCF1stPass::MCF1stPass(LinkGraphJob &job) : MultiCommodityFlow(job)
 {
-	PathVector paths;
 	uint size = job.Size();
 	uint accuracy = job.Settings().accuracy;
 	bool more_loops;
 
 	do {
 		more_loops = false;
-		for (NodeID source = 0; source < size; ++source) {
+		for (NodeID first = 0; first < size; first += this->batch_size) {
+			uint count = min(this->batch_size, size - first);
 			/* First saturate the shortest paths. */
-			this->Dijkstra<DistanceAnnotation, GraphEdgeIterator>(source, paths);
-
-			for (NodeID dest = 0; dest < size; ++dest) {
-				Edge edge = job[source][dest];
-				if (edge.UnsatisfiedDemand() > 0) {
-					Path *path = paths[dest];
-					assert(path != NULL);
-					/* Generally only allow paths that don't exceed the
-					 * available capacity. But if no demand has been assigned
-					 * yet, make an exception and allow any valid path *once*. */
-					if (path->GetFreeCapacity() > 0 && this->PushFlow(edge, path,
-							accuracy, this->max_saturation) > 0) {
-						/* If a path has been found there is a chance we can
-						 * find more. */
-						more_loops = more_loops || (edge.UnsatisfiedDemand() > 0);
-					} else if (edge.UnsatisfiedDemand() == edge.Demand() &&
-							path->GetFreeCapacity() > INT_MIN) {
-						this->PushFlow(edge, path, accuracy, UINT_MAX);
+			this->FindPaths<DistanceAnnotation, GraphEdgeIterator>(first, count);
+
+			for (uint slot = 0; slot < count; ++slot) {
+				NodeID source = first + slot;
+				Node src_node = job[source];
+				PathVector &paths = this->paths[slot];
+				for (NodeID dest = 0; dest < size; ++dest) {
+					if (src_node.UnsatisfiedDemandTo(dest) > 0) {
+						Edge edge = src_node[dest];
+						Path *path = paths[dest];
+						assert(path != NULL);
+						/* Generally only allow paths that don't exceed the
+						 * available capacity. But if no demand has been assigned
+						 * yet, make an exception and allow any valid path *once*. */
+						if (path->GetFreeCapacity() > 0 && this->PushFlow(edge, path,
+								accuracy, this->max_saturation) > 0) {
+							/* If a path has been found there is a chance we can
+							 * find more. */
+							more_loops = more_loops || (edge.UnsatisfiedDemand() > 0);
+						} else if (edge.UnsatisfiedDemand() == edge.Demand() &&
+								path->GetFreeCapacity() > INT_MIN) {
+							this->PushFlow(edge, path, accuracy, UINT_MAX);
+						}
 					}
 				}
+				this->CleanupPaths(source, slot);
 			}
-			this->CleanupPaths(source, paths);
 		}
 	} while ((more_loops || this->EliminateCycles()) && !job.IsJobAborted());
 }
@@ -656,23 +732,28 @@ MCF1stPass::MCF1stPass(LinkGraphJob &job) : MultiCommodityFlow(job)
 MCF2ndPass::MCF2ndPass(LinkGraphJob &job) : MultiCommodityFlow(job)
 {
 	this->max_saturation = UINT_MAX; // disable artificial cap on saturation
-	PathVector paths;
 	uint size = job.Size();
 	uint accuracy = job.Settings().accuracy;
 	bool demand_left = true;
 	while (demand_left && !job.IsJobAborted()) {
 		demand_left = false;
-		for (NodeID source = 0; source < size; ++source) {
-			this->Dijkstra<CapacityAnnotation, FlowEdgeIterator>(source, paths);
-			for (NodeID dest = 0; dest < size; ++dest) {
-				Edge edge = this->job[source][dest];
-				Path *path = paths[dest];
-				if (edge.UnsatisfiedDemand() > 0 && path->GetFreeCapacity() > INT_MIN) {
-					this->PushFlow(edge, path, accuracy, UINT_MAX);
-					if (edge.UnsatisfiedDemand() > 0) demand_left = true;
+		for (NodeID first = 0; first < size; first += this->batch_size) {
+			uint count = min(this->batch_size, size - first);
+			this->FindPaths<CapacityAnnotation, FlowEdgeIterator>(first, count);
+			for (uint slot = 0; slot < count; ++slot) {
+				NodeID source = first + slot;
+				Node src_node = this->job[source];
+				PathVector &paths = this->paths[slot];
+				for (NodeID dest = 0; dest < size; ++dest) {
+					Path *path = paths[dest];
+					if (src_node.UnsatisfiedDemandTo(dest) > 0 && path->GetFreeCapacity() > INT_MIN) {
+						Edge edge = src_node[dest];
+						this->PushFlow(edge, path, accuracy, UINT_MAX);
+						if (edge.UnsatisfiedDemand() > 0) demand_left = true;
+					}
 				}
+				this->CleanupPaths(source, slot);
 			}
-			this->CleanupPaths(source, paths);
 		}
 	}
 }
@@ -18,18 +18,34 @@ protected:
 	 * @param job Link graph job being executed.
 	 */
 	MultiCommodityFlow(LinkGraphJob &job) : job(job),
-			max_saturation(job.Settings().short_path_saturation)
+			max_saturation(job.Settings().short_path_saturation),
+			batch_size(job.Settings().parallel_mcf ? LinkGraphJob::PARALLEL_PATH_SEARCHES : 1)
 	{}
 
+	/** A path search of a batch, see MultiCommodityFlow::FindPaths. */
+	struct PathSearch {
+		MultiCommodityFlow *mcf; ///< Calculation the search belongs to.
+		NodeID source;           ///< Node to search the paths from.
+		uint slot;               ///< Position in the batch, selects the path vector and the path allocator.
+	};
+
+	template<class Tannotation, class Tedge_iterator>
+	void Dijkstra(NodeID from, PathVector &paths, DynUniformArenaAllocator &allocator);
+
+	template<class Tannotation, class Tedge_iterator>
+	static void RunPathSearch(void *search);
+
 	template<class Tannotation, class Tedge_iterator>
-	void Dijkstra(NodeID from, PathVector &paths);
+	void FindPaths(NodeID first_source, uint count);
 
 	uint PushFlow(Edge &edge, Path *path, uint accuracy, uint max_saturation);
 
-	void CleanupPaths(NodeID source, PathVector &paths);
+	void CleanupPaths(NodeID source, uint slot);
 
 	LinkGraphJob &job;   ///< Job we're working with.
 	uint max_saturation; ///< Maximum saturation for edges.
+	uint batch_size;     ///< Number of sources whose paths are searched together.
+	PathVector paths[LinkGraphJob::PARALLEL_PATH_SEARCHES]; ///< Paths of the sources of the current batch.
 };
 
 /**
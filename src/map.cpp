@@ -78,6 +78,10 @@ void AllocateMap(uint size_x, uint size_y)
 
 	_m = CallocT<Tile>(_map_size);
 	_me = CallocT<TileExtended>(_map_size);
+
+	/* The vehicle tile hash is sized after the map. */
+	extern void AllocateVehicleTileHash();
+	AllocateVehicleTileHash();
 }
 
 
@@ -35,6 +35,7 @@
 #include "command_func.h"
 #include "zoning.h"
 #include "cargopacket.h"
+#include "pathfinder/yapf/yapf_cache.h"
 
 #include "safeguards.h"
 
@@ -116,6 +117,7 @@ void InitializeGame(uint size_x, uint size_y, bool reset_date, bool reset_settin
 	InitializeBuildingCounts();
 
 	InitializeNPF();
+	YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
 
 	InitializeCompanies();
 	AI::Initialize();
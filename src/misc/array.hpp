@@ -52,6 +52,19 @@ public:
 		data.Clear();
 	}
 
+	/**
+	 * Destroy all items, but keep the first sub-array allocated so the
+	 *  array can be filled again without allocating memory.
+	 */
+	inline void Reset()
+	{
+		if (data.Length() > 1) {
+			data.Clear();
+		} else if (data.Length() == 1) {
+			data[0].Clear();
+		}
+	}
+
 	/** Return actual number of items */
 	inline uint Length() const
 	{
@@ -63,7 +76,7 @@ public:
 	/** return true if array is empty */
 	inline bool IsEmpty()
 	{
-		return data.IsEmpty();
+		return Length() == 0;
 	}
 
 	/** return true if array is full */
@@ -183,10 +183,11 @@ public:
 		return m_num_items;
 	}
 
-	/** simple clear - forget all items - used by CSegmentCostCacheT.Flush() */
+	/** simple clear - forget all items - used by CSegmentCostCacheT.Flush() and the node lists */
 	inline void Clear()
 	{
 		for (int i = 0; i < Tcapacity; i++) m_slots[i].Clear();
+		m_num_items = 0;
 	}
 
 	/** const item search */
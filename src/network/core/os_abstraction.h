@@ -155,6 +155,7 @@ static inline void OTTDfreeaddrinfo(struct addrinfo *ai)
 #		define INADDR_NONE INADDR_BROADCAST
 #	else
 #		include <sys/socket.h>
+#		include <sys/uio.h>
 #		include <netinet/in.h>
 #		include <netinet/tcp.h>
 #		include <arpa/inet.h>
@@ -325,6 +326,41 @@ static inline bool SetNonBlocking(SOCKET d)
 #endif
 }
 
+/** Maximum number of buffers which are sent with a single call to #SendBuffers. */
+static const uint MAX_SEND_BUFFERS = 64;
+
+/**
+ * Send the data of several buffers at once, i.e. with a single system call when the OS supports that.
+ * @param d      The socket to send the data over.
+ * @param data   The buffers to send.
+ * @param length The number of bytes of each of the buffers.
+ * @param count  The number of buffers, at most #MAX_SEND_BUFFERS.
+ * @return The number of bytes sent, or -1 on error just like send().
+ */
+static inline ssize_t SendBuffers(SOCKET d, const byte * const *data, const size_t *length, uint count)
+{
+	assert(count > 0 && count <= MAX_SEND_BUFFERS);
+#if defined(WIN32)
+	WSABUF buffers[MAX_SEND_BUFFERS];
+	for (uint i = 0; i < count; i++) {
+		buffers[i].buf = (char *)const_cast<byte *>(data[i]);
+		buffers[i].len = (u_long)length[i];
+	}
+	DWORD sent;
+	if (WSASend(d, buffers, count, &sent, 0, NULL, NULL) != 0) return -1;
+	return sent;
+#elif defined(UNIX) && !defined(__OS2__) && !defined(BEOS_NET_SERVER) && !defined(__MORPHOS__) && !defined(__AMIGA__)
+	struct iovec buffers[MAX_SEND_BUFFERS];
+	for (uint i = 0; i < count; i++) {
+		buffers[i].iov_base = const_cast<byte *>(data[i]);
+		buffers[i].iov_len = length[i];
+	}
+	return writev(d, buffers, count);
+#else
+	return send(d, (const char *)data[0], length[0], 0);
+#endif
+}
+
 /**
  * Try to set the socket to not delay sending.
  * @param d The socket to disable the delaying for.
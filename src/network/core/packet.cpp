@@ -17,10 +17,54 @@
 #include "../../string_func.h"
 #include "../../command_type.h"
 
+#include "../../thread/thread.h"
+
 #include "packet.h"
 
 #include "../../safeguards.h"
 
+/**
+ * Maximum number of unused packet buffers to keep for reuse. Almost all packets
+ * fit in SEND_MTU bytes, so this keeps at most a few hundred kilobytes around,
+ * while it saves an allocation for every packet sent or received.
+ */
+static const uint PACKET_BUFFER_POOL_SIZE = 256;
+
+static byte *_packet_buffer_pool[PACKET_BUFFER_POOL_SIZE]; ///< Unused buffers of SEND_MTU bytes.
+static uint _packet_buffer_pool_count = 0;                 ///< Number of buffers in #_packet_buffer_pool.
+static ThreadMutex *_packet_buffer_pool_mutex = ThreadMutex::New(); ///< Mutex protecting #_packet_buffer_pool.
+
+/**
+ * Get a buffer of SEND_MTU bytes for a packet.
+ * @return The buffer, reused from an earlier packet when possible.
+ */
+static byte *AllocatePacketBuffer()
+{
+	byte *buffer = NULL;
+
+	_packet_buffer_pool_mutex->BeginCritical();
+	if (_packet_buffer_pool_count > 0) buffer = _packet_buffer_pool[--_packet_buffer_pool_count];
+	_packet_buffer_pool_mutex->EndCritical();
+
+	return buffer != NULL ? buffer : MallocT<byte>(SEND_MTU);
+}
+
+/**
+ * Release a buffer of SEND_MTU bytes of a packet, so it can be reused.
+ * @param buffer The buffer to release.
+ */
+static void FreePacketBuffer(byte *buffer)
+{
+	_packet_buffer_pool_mutex->BeginCritical();
+	if (_packet_buffer_pool_count < PACKET_BUFFER_POOL_SIZE) {
+		_packet_buffer_pool[_packet_buffer_pool_count++] = buffer;
+		buffer = NULL;
+	}
+	_packet_buffer_pool_mutex->EndCritical();
+
+	free(buffer);
+}
+
 /**
  * Create a packet that is used to read from a network socket
  * @param cs the socket handler associated with the socket we are reading from
@@ -31,9 +75,10 @@ Packet::Packet(NetworkSocketHandler *cs)
 
 	this->cs     = cs;
 	this->next   = NULL;
-	this->pos    = 0; // We start reading from here
-	this->size   = 0;
-	this->buffer = MallocT<byte>(SHRT_MAX);
+	this->pos      = 0; // We start reading from here
+	this->size     = 0;
+	this->buffer   = AllocatePacketBuffer();
+	this->capacity = SEND_MTU;
 }
 
 /**
@@ -48,7 +93,8 @@ Packet::Packet(PacketType type)
 	/* Skip the size so we can write that in before sending the packet */
 	this->pos                  = 0;
 	this->size                 = sizeof(PacketSize);
-	this->buffer               = MallocT<byte>(SHRT_MAX);
+	this->buffer               = AllocatePacketBuffer();
+	this->capacity             = SEND_MTU;
 	this->buffer[this->size++] = type;
 }
 
@@ -57,7 +103,23 @@ Packet::Packet(PacketType type)
  */
 Packet::~Packet()
 {
-	free(this->buffer);
+	if (this->capacity == SEND_MTU) {
+		FreePacketBuffer(this->buffer);
+	} else {
+		free(this->buffer);
+	}
+}
+
+/**
+ * Replace the buffer by one large enough for the largest possible packet.
+ */
+void Packet::GrowBuffer()
+{
+	byte *buffer = MallocT<byte>(SHRT_MAX);
+	memcpy(buffer, this->buffer, this->size);
+	FreePacketBuffer(this->buffer);
+	this->buffer = buffer;
+	this->capacity = SHRT_MAX;
 }
 
 /**
@@ -100,7 +162,7 @@ void Packet::Send_bool(bool data)
  */
 void Packet::Send_uint8(uint8 data)
 {
-	assert(this->size < SHRT_MAX - sizeof(data));
+	this->EnsureFreeSpace(sizeof(data));
 	this->buffer[this->size++] = data;
 }
 
@@ -110,7 +172,7 @@ void Packet::Send_uint8(uint8 data)
  */
 void Packet::Send_uint16(uint16 data)
 {
-	assert(this->size < SHRT_MAX - sizeof(data));
+	this->EnsureFreeSpace(sizeof(data));
 	this->buffer[this->size++] = GB(data, 0, 8);
 	this->buffer[this->size++] = GB(data, 8, 8);
 }
@@ -121,7 +183,7 @@ void Packet::Send_uint16(uint16 data)
  */
 void Packet::Send_uint32(uint32 data)
 {
-	assert(this->size < SHRT_MAX - sizeof(data));
+	this->EnsureFreeSpace(sizeof(data));
 	this->buffer[this->size++] = GB(data,  0, 8);
 	this->buffer[this->size++] = GB(data,  8, 8);
 	this->buffer[this->size++] = GB(data, 16, 8);
@@ -134,7 +196,7 @@ void Packet::Send_uint32(uint32 data)
  */
 void Packet::Send_uint64(uint64 data)
 {
-	assert(this->size < SHRT_MAX - sizeof(data));
+	this->EnsureFreeSpace(sizeof(data));
 	this->buffer[this->size++] = GB(data,  0, 8);
 	this->buffer[this->size++] = GB(data,  8, 8);
 	this->buffer[this->size++] = GB(data, 16, 8);
@@ -153,8 +215,7 @@ void Packet::Send_uint64(uint64 data)
 void Packet::Send_string(const char *data)
 {
 	assert(data != NULL);
-	/* The <= *is* valid due to the fact that we are comparing sizes and not the index. */
-	assert(this->size + strlen(data) + 1 <= SHRT_MAX);
+	this->EnsureFreeSpace(strlen(data) + 1);
 	while ((this->buffer[this->size++] = *data++) != '\0') {}
 }
 
@@ -166,6 +227,7 @@ void Packet::Send_binary(const char *data, const size_t size)
 {
 	assert(data != NULL);
 	assert(size < MAX_CMD_TEXT_LENGTH);
+	this->EnsureFreeSpace(size);
 	memcpy(&this->buffer[this->size], data, size);
 	this->size += (PacketSize) size;
 }
@@ -54,11 +54,25 @@ struct Packet {
 	PacketSize pos;
 	/** The buffer of this packet, of basically variable length up to SHRT_MAX. */
 	byte *buffer;
+	/** The number of bytes allocated for the buffer; SEND_MTU unless a larger packet is written. */
+	PacketSize capacity;
 
 private:
 	/** Socket we're associated with. */
 	NetworkSocketHandler *cs;
 
+	void GrowBuffer();
+
+	/**
+	 * Make sure the buffer can hold some more bytes.
+	 * @param bytes The number of bytes that are going to be written.
+	 */
+	inline void EnsureFreeSpace(size_t bytes)
+	{
+		assert(this->size + bytes <= SHRT_MAX);
+		if (this->size + bytes > this->capacity) this->GrowBuffer();
+	}
+
 public:
 	Packet(NetworkSocketHandler *cs);
 	Packet(PacketType type);
@@ -27,7 +27,9 @@
 NetworkTCPSocketHandler::NetworkTCPSocketHandler(SOCKET s) :
 		NetworkSocketHandler(),
 		packet_queue(NULL), packet_recv(NULL),
-		sock(s), writable(false)
+		sock(s), writable(false),
+		packets_sent(0), bytes_sent(0), send_calls(0),
+		packets_received(0), bytes_received(0), receive_calls(0)
 {
 }
 
@@ -69,11 +71,6 @@ void NetworkTCPSocketHandler::SendPacket(Packet *packet)
 
 	packet->PrepareToSend();
 
-	/* Reallocate the packet as in 99+% of the times we send at most 25 bytes and
-	 * keeping the other 1400+ bytes wastes memory, especially when someone tries
-	 * to do a denial of service attack! */
-	packet->buffer = ReallocT(packet->buffer, packet->size);
-
 	/* Locate last packet buffered for the client */
 	p = this->packet_queue;
 	if (p == NULL) {
@@ -92,22 +89,31 @@ void NetworkTCPSocketHandler::SendPacket(Packet *packet)
  *   2) the OS reports back that it can not send any more
  *      data right now (full network-buffer, it happens ;))
  *   3) sending took too long
+ * The queued packets are handed to the OS in batches, so sending
+ * many small packets does not cost a system call for each packet.
  * @param closing_down Whether we are closing down the connection.
  * @return \c true if a (part of a) packet could be sent and
  *         the connection is not closed yet.
  */
 SendPacketsState NetworkTCPSocketHandler::SendPackets(bool closing_down)
 {
-	ssize_t res;
-	Packet *p;
-
 	/* We can not write to this socket!! */
 	if (!this->writable) return SPS_NONE_SENT;
 	if (!this->IsConnected()) return SPS_CLOSED;
 
-	p = this->packet_queue;
-	while (p != NULL) {
-		res = send(this->sock, (const char*)p->buffer + p->pos, p->size - p->pos, 0);
+	while (this->packet_queue != NULL) {
+		const byte *data[MAX_SEND_BUFFERS];
+		size_t length[MAX_SEND_BUFFERS];
+		size_t total = 0;
+		uint count = 0;
+		for (Packet *p = this->packet_queue; p != NULL && count < MAX_SEND_BUFFERS; p = p->next, count++) {
+			data[count] = p->buffer + p->pos;
+			length[count] = p->size - p->pos;
+			total += length[count];
+		}
+
+		ssize_t res = SendBuffers(this->sock, data, length, count);
+		this->send_calls++;
 		if (res == -1) {
 			int err = GET_LAST_ERROR();
 			if (err != EWOULDBLOCK) {
@@ -126,17 +132,25 @@ SendPacketsState NetworkTCPSocketHandler::SendPackets(bool closing_down)
 			return SPS_CLOSED;
 		}
 
-		p->pos += res;
+		this->bytes_sent += res;
+
+		/* Remove the packets which are sent completely */
+		for (size_t sent = res; sent > 0;) {
+			Packet *p = this->packet_queue;
+			size_t left = p->size - p->pos;
+			if (sent < left) {
+				p->pos += (PacketSize)sent;
+				break;
+			}
 
-		/* Is this packet sent? */
-		if (p->pos == p->size) {
-			/* Go to the next packet */
+			sent -= left;
 			this->packet_queue = p->next;
+			this->packets_sent++;
 			delete p;
-			p = this->packet_queue;
-		} else {
-			return SPS_PARTLY_SENT;
 		}
+
+		/* The OS could not take everything, so its buffer is full. */
+		if ((size_t)res != total) return SPS_PARTLY_SENT;
 	}
 
 	return SPS_ALL_SENT;
@@ -163,6 +177,7 @@ Packet *NetworkTCPSocketHandler::ReceivePacket()
 		while (p->pos < sizeof(PacketSize)) {
 		/* Read the size of the packet */
 			res = recv(this->sock, (char*)p->buffer + p->pos, sizeof(PacketSize) - p->pos, 0);
+			this->receive_calls++;
 			if (res == -1) {
 				int err = GET_LAST_ERROR();
 				if (err != EWOULDBLOCK) {
@@ -180,6 +195,7 @@ Packet *NetworkTCPSocketHandler::ReceivePacket()
 				return NULL;
 			}
 			p->pos += res;
+			this->bytes_received += res;
 		}
 
 		/* Read the packet size from the received packet */
@@ -194,6 +210,7 @@ Packet *NetworkTCPSocketHandler::ReceivePacket()
 	/* Read rest of packet */
 	while (p->pos < p->size) {
 		res = recv(this->sock, (char*)p->buffer + p->pos, p->size - p->pos, 0);
+		this->receive_calls++;
 		if (res == -1) {
 			int err = GET_LAST_ERROR();
 			if (err != EWOULDBLOCK) {
@@ -212,10 +229,12 @@ Packet *NetworkTCPSocketHandler::ReceivePacket()
 		}
 
 		p->pos += res;
+		this->bytes_received += res;
 	}
 
 	/* Prepare for receiving a new packet */
 	this->packet_recv = NULL;
+	this->packets_received++;
 
 	p->PrepareToRead();
 	return p;
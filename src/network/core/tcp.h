@@ -36,6 +36,13 @@ public:
 	SOCKET sock;              ///< The socket currently connected to
 	bool writable;            ///< Can we write to this socket?
 
+	uint64 packets_sent;      ///< Number of packets sent over this socket.
+	uint64 bytes_sent;        ///< Number of bytes sent over this socket.
+	uint64 send_calls;        ///< Number of system calls made for sending.
+	uint64 packets_received;  ///< Number of packets received over this socket.
+	uint64 bytes_received;    ///< Number of bytes received over this socket.
+	uint64 receive_calls;     ///< Number of system calls made for receiving.
+
 	/**
 	 * Whether this socket is currently bound to a socket.
 	 * @return true when the socket is bound, false otherwise
@@ -175,6 +175,7 @@ protected:
 	 * string  Name of the client (max NETWORK_NAME_LENGTH).
 	 * uint8   ID of the company to play as (1..MAX_COMPANIES).
 	 * uint8   ID of the clients Language.
+	 * bool    Whether the client can load a map compressed with zstd; optional.
 	 * @param p The packet that was just received.
 	 */
 	virtual NetworkRecvStatus Receive_CLIENT_JOIN(Packet *p);
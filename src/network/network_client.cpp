@@ -340,6 +340,11 @@ NetworkRecvStatus ClientNetworkGameSocketHandler::SendJoin()
 	p->Send_string(_settings_client.network.client_name); // Client name
 	p->Send_uint8 (_network_join_as);     // PlayAs
 	p->Send_uint8 (NETLANG_ANY);          // Language
+#if defined(WITH_ZSTD)
+	p->Send_bool  (true);                 // Can load zstd compressed maps
+#else
+	p->Send_bool  (false);                // Can load zstd compressed maps
+#endif
 	my_client->SendPacket(p);
 	return NETWORK_RECV_STATUS_OKAY;
 }
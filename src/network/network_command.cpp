@@ -183,20 +183,20 @@ void NetworkSendCommand(TileIndex tile, uint32 p1, uint32 p2, uint32 cmd, Comman
 }
 
 /**
- * Sync our local command queue to the command queue of the given
- * socket. This is needed for the case where we receive a command
- * before saving the game for a joining client, but without the
- * execution of those commands. Not syncing those commands means
- * that the client will never get them and as such will be in a
- * desynced state from the time it started with joining.
- * @param cs The client to sync the queue to.
+ * Sync our local command queue to the given command queue, e.g.
+ * the one of a map snapshot. This is needed for the case where we
+ * receive a command before saving the game for a joining client,
+ * but without the execution of those commands. Not syncing those
+ * commands means that the client will never get them and as such
+ * will be in a desynced state from the time it started with joining.
+ * @param queue The queue to sync to.
  */
-void NetworkSyncCommandQueue(NetworkClientSocket *cs)
+void NetworkSyncCommandQueue(CommandQueue *queue)
 {
 	for (CommandPacket *p = _local_execution_queue.Peek(); p != NULL; p = p->next) {
 		CommandPacket c = *p;
 		c.callback = 0;
-		cs->outgoing_queue.Append(&c);
+		queue->Append(&c);
 	}
 }
 
@@ -264,6 +264,11 @@ static void DistributeCommandPacket(CommandPacket &cp, const NetworkClientSocket
 		}
 	}
 
+	/* Clients which start downloading the map snapshot later on need the command as well. */
+	cp.callback = NULL;
+	cp.my_cmd = false;
+	NetworkAddMapSnapshotCommand(&cp);
+
 	cp.callback = (cs != owner) ? NULL : callback;
 	cp.my_cmd = (cs == owner);
 	_local_execution_queue.Append(&cp);
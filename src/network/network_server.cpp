@@ -54,168 +54,236 @@ INSTANTIATE_POOL_METHODS(NetworkClientSocket)
 /** Instantiate the listen sockets. */
 template SocketList TCPListenHandler<ServerNetworkGameSocketHandler, PACKET_SERVER_FULL, PACKET_SERVER_BANNED>::sockets;
 
-/** Writing a savegame directly to a number of packets. */
-struct PacketWriter : SaveFilter {
-	ServerNetworkGameSocketHandler *cs; ///< Socket we are associated with.
-	Packet *current;                    ///< The packet we're currently writing to.
-	size_t total_size;                  ///< Total size of the compressed savegame.
-	Packet *packets;                    ///< Packet queue of the savegame; send these "slowly" to the client.
-	ThreadMutex *mutex;                 ///< Mutex for making threaded saving safe.
+/**
+ * A compressed savegame made for joining clients. Every client which starts
+ * downloading the map while the snapshot is not too old shares it, so the
+ * game is saved and compressed only once for all of them. The snapshot is
+ * reference counted by the clients downloading it and by the PacketWriter
+ * which is still saving into it, so it lives as long as either needs it.
+ */
+struct NetworkMapSnapshot {
+	uint32 frame;            ///< The frame the game was saved at.
+	CommandQueue commands;   ///< Commands to execute after #frame, to be replayed by every client downloading the snapshot.
+	uint clients;            ///< Number of clients downloading the snapshot. Only used by the main thread.
+	bool zstd;               ///< Whether the savegame is compressed with zstd, so only clients supporting it can download it.
+	bool closed;             ///< Whether no more clients may start downloading the snapshot, so #commands is not kept anymore.
+
+	ThreadMutex *mutex;      ///< Mutex for the members below, as the savegame is written by the saving thread.
+	std::vector<byte> data;  ///< The compressed savegame, as far as it is written.
+	bool finished;           ///< Whether the whole savegame is written.
+	bool failed;             ///< Whether saving failed or was cancelled.
+	uint refs;               ///< Number of references to this snapshot.
 
 	/**
-	 * Create the packet writer.
-	 * @param cs The socket handler we're making the packets for.
+	 * Create a snapshot of the current game state.
+	 * The commands which are waiting for execution are copied, as they are not part of the saved state.
+	 * @param zstd Whether to compress the savegame with zstd.
 	 */
-	PacketWriter(ServerNetworkGameSocketHandler *cs) : SaveFilter(NULL), cs(cs), current(NULL), total_size(0), packets(NULL)
+	NetworkMapSnapshot(bool zstd) : frame(_frame_counter), clients(0), zstd(zstd), closed(false), mutex(ThreadMutex::New()), finished(false), failed(false), refs(0)
 	{
-		this->mutex = ThreadMutex::New();
+		NetworkSyncCommandQueue(&this->commands);
 	}
 
-	/** Make sure everything is cleaned up. */
-	~PacketWriter()
+	~NetworkMapSnapshot()
 	{
-		if (this->mutex != NULL) this->mutex->BeginCritical();
-
-		if (this->cs != NULL && this->mutex != NULL) {
-			this->mutex->WaitForSignal();
-		}
-
-		/* This must all wait until the Destroy function is called. */
-
-		while (this->packets != NULL) {
-			Packet *p = this->packets->next;
-			delete this->packets;
-			this->packets = p;
-		}
+		delete this->mutex;
+	}
 
-		delete this->current;
+	/** Add a reference to the snapshot. */
+	void AddRef()
+	{
+		this->mutex->BeginCritical();
+		this->refs++;
+		this->mutex->EndCritical();
+	}
 
-		if (this->mutex != NULL) this->mutex->EndCritical();
+	/** Remove a reference to the snapshot, deleting it when it was the last one. */
+	void Release()
+	{
+		this->mutex->BeginCritical();
+		bool last = --this->refs == 0;
+		this->mutex->EndCritical();
 
-		delete this->mutex;
-		this->mutex = NULL;
+		if (last) delete this;
 	}
 
 	/**
-	 * Begin the destruction of this packet writer. It can happen in two ways:
-	 * in the first case the client disconnected while saving the map. In this
-	 * case the saving has not finished and killed this PacketWriter. In that
-	 * case we simply set cs to NULL, triggering the appending to fail due to
-	 * the connection problem and eventually triggering the destructor. In the
-	 * second case the destructor is already called, and it is waiting for our
-	 * signal which we will send. Only then the packets will be removed by the
-	 * destructor.
+	 * Append a part of the compressed savegame.
+	 * @param buf The bytes to append.
+	 * @param size Amount of bytes to append.
+	 * @return False when no client is downloading the snapshot anymore, so saving can be cancelled.
 	 */
-	void Destroy()
+	bool Append(const byte *buf, size_t size)
 	{
-		if (this->mutex != NULL) this->mutex->BeginCritical();
-
-		this->cs = NULL;
-
-		if (this->mutex != NULL) this->mutex->SendSignal();
-
-		if (this->mutex != NULL) this->mutex->EndCritical();
-
-		/* Make sure the saving is completely cancelled. Yes,
-		 * we need to handle the save finish as well as the
-		 * next connection might just be requesting a map. */
-		WaitTillSaved();
-		ProcessAsyncSaveFinish();
+		this->mutex->BeginCritical();
+		/* The only reference left is the one of the writer. */
+		bool ok = this->refs > 1;
+		if (ok) {
+			this->data.insert(this->data.end(), buf, buf + size);
+		} else {
+			this->failed = true;
+		}
+		this->mutex->EndCritical();
+		return ok;
 	}
 
 	/**
-	 * Checks whether there are packets.
-	 * It's not 100% threading safe, but this is only asked for when checking
-	 * whether there still is something to send. Then another call will be made
-	 * to actually get the Packet, which will be the only one popping packets
-	 * and thus eventually setting this on false.
+	 * Mark the end of writing the savegame.
+	 * @param success Whether the savegame has been written completely.
 	 */
-	bool HasPackets()
+	void SetFinished(bool success)
 	{
-		return this->packets != NULL;
+		this->mutex->BeginCritical();
+		if (success) {
+			this->finished = true;
+		} else if (!this->finished) {
+			this->failed = true;
+		}
+		this->mutex->EndCritical();
 	}
 
 	/**
-	 * Pop a single created packet from the queue with packets.
+	 * Check whether saving the snapshot failed.
+	 * @return True when the snapshot will never be complete.
 	 */
-	Packet *PopPacket()
+	bool HasFailed()
 	{
-		if (this->mutex != NULL) this->mutex->BeginCritical();
-
-		Packet *p = this->packets;
-		this->packets = p->next;
-		p->next = NULL;
-
-		if (this->mutex != NULL) this->mutex->EndCritical();
-
-		return p;
+		this->mutex->BeginCritical();
+		bool failed = this->failed;
+		this->mutex->EndCritical();
+		return failed;
 	}
 
-	/** Append the current packet to the queue. */
-	void AppendQueue()
+	/**
+	 * Get the next packet for a client downloading the snapshot.
+	 * @param[in,out] pos       Number of bytes of the savegame the client already got.
+	 * @param[in,out] size_sent Whether the client already got the size of the savegame.
+	 * @return The packet, or NULL when the next packet is not available yet.
+	 */
+	Packet *GetPacket(size_t &pos, bool &size_sent)
 	{
-		if (this->current == NULL) return;
-
-		Packet **p = &this->packets;
-		while (*p != NULL) {
-			p = &(*p)->next;
+		Packet *p = NULL;
+
+		this->mutex->BeginCritical();
+		if (this->finished && !size_sent) {
+			/* Fast-track the size to the client. */
+			p = new Packet(PACKET_SERVER_MAP_SIZE);
+			p->Send_uint32((uint32)this->data.size());
+			size_sent = true;
+		} else if (pos < this->data.size() && (this->finished || this->data.size() - pos >= SEND_MTU)) {
+			/* Only send partially filled packets at the end of the savegame. */
+			p = new Packet(PACKET_SERVER_MAP_DATA);
+			size_t to_write = min<size_t>(SEND_MTU - p->size, this->data.size() - pos);
+			memcpy(p->buffer + p->size, this->data.data() + pos, to_write);
+			p->size += (PacketSize)to_write;
+			pos += to_write;
+		} else if (this->finished) {
+			p = new Packet(PACKET_SERVER_MAP_DONE);
 		}
-		*p = this->current;
+		this->mutex->EndCritical();
 
-		this->current = NULL;
+		return p;
 	}
+};
 
-	/* virtual */ void Write(byte *buf, size_t size)
-	{
-		/* We want to abort the saving when the socket is closed. */
-		if (this->cs == NULL) SlError(STR_NETWORK_ERROR_LOSTCONNECTION);
+/** The map snapshot new joining clients can start downloading, if any. */
+static NetworkMapSnapshot *_network_map_snapshot = NULL;
 
-		if (this->current == NULL) this->current = new Packet(PACKET_SERVER_MAP_DATA);
+/** Maximum number of commands kept for clients starting to download a map snapshot; after that the snapshot is closed. */
+static const uint MAX_MAP_SNAPSHOT_COMMANDS = 4096;
 
-		if (this->mutex != NULL) this->mutex->BeginCritical();
+/**
+ * Check whether joining clients can still start downloading the current map snapshot.
+ * @return True when there is a snapshot which is not closed, not failed and still young enough.
+ */
+static bool IsMapSnapshotOpen()
+{
+	return _network_map_snapshot != NULL && !_network_map_snapshot->closed && !_network_map_snapshot->HasFailed() &&
+			_frame_counter - _network_map_snapshot->frame < _settings_client.network.map_snapshot_window;
+}
 
-		byte *bufe = buf + size;
-		while (buf != bufe) {
-			size_t to_write = min(SEND_MTU - this->current->size, bufe - buf);
-			memcpy(this->current->buffer + this->current->size, buf, to_write);
-			this->current->size += (PacketSize)to_write;
-			buf += to_write;
+/**
+ * Queue a command for the clients which start downloading the current map snapshot later on.
+ * Once nobody can start downloading the snapshot anymore, or when too many commands would
+ * have to be replayed, the snapshot is closed and its commands are freed.
+ * @param cp The command to queue.
+ */
+void NetworkAddMapSnapshotCommand(CommandPacket *cp)
+{
+	if (_network_map_snapshot == NULL || _network_map_snapshot->closed) return;
 
-			if (this->current->size == SEND_MTU) {
-				this->AppendQueue();
-				if (buf != bufe) this->current = new Packet(PACKET_SERVER_MAP_DATA);
-			}
-		}
+	if (!IsMapSnapshotOpen() || _network_map_snapshot->commands.Count() >= MAX_MAP_SNAPSHOT_COMMANDS) {
+		_network_map_snapshot->closed = true;
+		_network_map_snapshot->commands.Free();
+		return;
+	}
+
+	_network_map_snapshot->commands.Append(cp);
+}
 
-		if (this->mutex != NULL) this->mutex->EndCritical();
+/**
+ * Check whether a joining client can download the current map snapshot.
+ * @param cs The joining client.
+ * @return True when there is an open snapshot which the client can load.
+ */
+static bool CanJoinMapSnapshot(const NetworkClientSocket *cs)
+{
+	return IsMapSnapshotOpen() && (!_network_map_snapshot->zstd || cs->supports_zstd);
+}
 
-		this->total_size += size;
-	}
+/**
+ * Check whether a new map snapshot can be compressed with zstd.
+ * The clients waiting for the map will download the same snapshot, so all of them must be able to load it.
+ * @param cs The client the snapshot is made for.
+ * @return True when this server and all clients about to download the snapshot support zstd.
+ */
+static bool CanUseZstdForMapSnapshot(const NetworkClientSocket *cs)
+{
+#if defined(WITH_ZSTD)
+	if (!cs->supports_zstd) return false;
 
-	/* virtual */ void Finish()
-	{
-		/* We want to abort the saving when the socket is closed. */
-		if (this->cs == NULL) SlError(STR_NETWORK_ERROR_LOSTCONNECTION);
+	const NetworkClientSocket *new_cs;
+	FOR_ALL_CLIENT_SOCKETS(new_cs) {
+		if (new_cs->status == NetworkClientSocket::STATUS_MAP_WAIT && !new_cs->supports_zstd) return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
 
-		if (this->mutex != NULL) this->mutex->BeginCritical();
+/** Writing a savegame directly to a map snapshot. */
+struct PacketWriter : SaveFilter {
+	NetworkMapSnapshot *snapshot; ///< The snapshot we are writing to.
 
-		/* Make sure the last packet is flushed. */
-		this->AppendQueue();
+	/**
+	 * Create the packet writer.
+	 * @param snapshot The snapshot to write the savegame to.
+	 */
+	PacketWriter(NetworkMapSnapshot *snapshot) : SaveFilter(NULL), snapshot(snapshot)
+	{
+		this->snapshot->AddRef();
+	}
 
-		/* Add a packet stating that this is the end to the queue. */
-		this->current = new Packet(PACKET_SERVER_MAP_DONE);
-		this->AppendQueue();
+	/** Release the snapshot; when saving did not finish nobody will be waiting for it anymore. */
+	~PacketWriter()
+	{
+		this->snapshot->SetFinished(false);
+		this->snapshot->Release();
+	}
 
-		/* Fast-track the size to the client. */
-		Packet *p = new Packet(PACKET_SERVER_MAP_SIZE);
-		p->Send_uint32((uint32)this->total_size);
-		this->cs->NetworkTCPSocketHandler::SendPacket(p);
+	/* virtual */ void Write(byte *buf, size_t size)
+	{
+		/* We want to abort the saving when all downloading clients are gone. */
+		if (!this->snapshot->Append(buf, size)) SlError(STR_NETWORK_ERROR_LOSTCONNECTION);
+	}
 
-		if (this->mutex != NULL) this->mutex->EndCritical();
+	/* virtual */ void Finish()
+	{
+		this->snapshot->SetFinished(true);
 	}
 };
 
-
 /**
  * Create a new socket for the server side of the game connection.
  * @param s The socket to connect with.
@@ -240,10 +308,18 @@ ServerNetworkGameSocketHandler::~ServerNetworkGameSocketHandler()
 	if (_redirect_console_to_client == this->client_id) _redirect_console_to_client = INVALID_CLIENT_ID;
 	OrderBackup::ResetUser(this->client_id);
 
-	if (this->savegame != NULL) {
-		this->savegame->Destroy();
-		this->savegame = NULL;
-	}
+	if (this->map_snapshot != NULL) this->LeaveMapSnapshot();
+}
+
+/**
+ * Stop downloading the map snapshot. When this was the last client downloading the current
+ * snapshot, new joining clients can not start downloading it anymore.
+ */
+void ServerNetworkGameSocketHandler::LeaveMapSnapshot()
+{
+	if (--this->map_snapshot->clients == 0 && this->map_snapshot == _network_map_snapshot) _network_map_snapshot = NULL;
+	this->map_snapshot->Release();
+	this->map_snapshot = NULL;
 }
 
 Packet *ServerNetworkGameSocketHandler::ReceivePacket()
@@ -572,83 +648,113 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::SendWait()
 	return NETWORK_RECV_STATUS_OKAY;
 }
 
+/**
+ * Let the clients waiting for the map start downloading it, once nobody is downloading it anymore.
+ */
+/* static */ void ServerNetworkGameSocketHandler::StartWaitingMapDownloads()
+{
+	/* Find the best candidate for joining, i.e. the first joiner. */
+	NetworkClientSocket *new_cs;
+	NetworkClientSocket *best = NULL;
+	FOR_ALL_CLIENT_SOCKETS(new_cs) {
+		if (new_cs->status == STATUS_MAP) return;
+
+		if (new_cs->status == STATUS_MAP_WAIT) {
+			if (best == NULL || best->GetInfo()->join_date > new_cs->GetInfo()->join_date || (best->GetInfo()->join_date == new_cs->GetInfo()->join_date && best->client_id > new_cs->client_id)) {
+				best = new_cs;
+			}
+		}
+	}
+
+	/* Is there someone else to join? */
+	if (best == NULL) return;
+
+	/* Let the first start joining. */
+	best->status = STATUS_AUTHORIZED;
+	best->SendMap();
+
+	/* And let the rest download the same snapshot, or update them when they have to wait. */
+	FOR_ALL_CLIENT_SOCKETS(new_cs) {
+		if (new_cs->status != STATUS_MAP_WAIT) continue;
+
+		if (CanJoinMapSnapshot(new_cs)) {
+			new_cs->status = STATUS_AUTHORIZED;
+			new_cs->SendMap();
+		} else {
+			new_cs->SendWait();
+		}
+	}
+}
+
 /** This sends the map to the client */
 NetworkRecvStatus ServerNetworkGameSocketHandler::SendMap()
 {
-	static uint sent_packets; // How many packets we did send successfully last time
-
 	if (this->status < STATUS_AUTHORIZED) {
 		/* Illegal call, return error and ignore the packet */
 		return this->SendError(NETWORK_ERROR_NOT_AUTHORIZED);
 	}
 
 	if (this->status == STATUS_AUTHORIZED) {
-		this->savegame = new PacketWriter(this);
+		bool new_snapshot = !CanJoinMapSnapshot(this);
+		if (new_snapshot) {
+			/* Make sure the saving of a previous snapshot is completely handled. */
+			WaitTillSaved();
+			_network_map_snapshot = new NetworkMapSnapshot(CanUseZstdForMapSnapshot(this));
+		}
 
-		/* Now send the _frame_counter and how many packets are coming */
+		this->map_snapshot = _network_map_snapshot;
+		this->map_snapshot->AddRef();
+		this->map_snapshot->clients++;
+		this->map_pos = 0;
+		this->map_size_sent = false;
+		DEBUG(net, 3, "[server] Client #%d downloads the %smap snapshot of frame %u, shared by %u clients", this->client_id, this->map_snapshot->zstd ? "zstd compressed " : "", this->map_snapshot->frame, this->map_snapshot->clients);
+
+		/* Now send the frame of the snapshot, from where on the client gets the commands to execute */
 		Packet *p = new Packet(PACKET_SERVER_MAP_BEGIN);
-		p->Send_uint32(_frame_counter);
+		p->Send_uint32(this->map_snapshot->frame);
 		this->SendPacket(p);
 
-		NetworkSyncCommandQueue(this);
+		for (CommandPacket *cp = this->map_snapshot->commands.Peek(); cp != NULL; cp = cp->next) {
+			this->outgoing_queue.Append(cp);
+		}
 		this->status = STATUS_MAP;
 		/* Mark the start of download */
 		this->last_frame = _frame_counter;
 		this->last_frame_server = _frame_counter;
 
-		sent_packets = 4; // We start with trying 4 packets
+		this->map_send_packets = 4; // We start with trying 4 packets
 
 		/* Make a dump of the current game */
-		if (SaveWithFilter(this->savegame, true) != SL_OK) usererror("network savedump failed");
+		if (new_snapshot && SaveWithFilter(new PacketWriter(this->map_snapshot), true, this->map_snapshot->zstd) != SL_OK) usererror("network savedump failed");
 	}
 
 	if (this->status == STATUS_MAP) {
 		bool last_packet = false;
-		bool has_packets = false;
+		uint sent_packets = 0;
 
-		for (uint i = 0; (has_packets = this->savegame->HasPackets()) && i < sent_packets; i++) {
-			Packet *p = this->savegame->PopPacket();
-			last_packet = p->buffer[2] == PACKET_SERVER_MAP_DONE;
+		while (sent_packets < this->map_send_packets) {
+			Packet *p = this->map_snapshot->GetPacket(this->map_pos, this->map_size_sent);
+			if (p == NULL) break;
 
+			last_packet = p->buffer[2] == PACKET_SERVER_MAP_DONE;
 			this->SendPacket(p);
+			sent_packets++;
 
 			if (last_packet) {
-				/* There is no more data, so break the for */
+				/* There is no more data, so break the loop */
 				break;
 			}
 		}
 
 		if (last_packet) {
-			/* Done reading, make sure saving is done as well */
-			this->savegame->Destroy();
-			this->savegame = NULL;
+			/* Done reading, other clients might still download the snapshot though */
+			this->LeaveMapSnapshot();
 
 			/* Set the status to DONE_MAP, no we will wait for the client
 			 *  to send it is ready (maybe that happens like never ;)) */
 			this->status = STATUS_DONE_MAP;
 
-			/* Find the best candidate for joining, i.e. the first joiner. */
-			NetworkClientSocket *new_cs;
-			NetworkClientSocket *best = NULL;
-			FOR_ALL_CLIENT_SOCKETS(new_cs) {
-				if (new_cs->status == STATUS_MAP_WAIT) {
-					if (best == NULL || best->GetInfo()->join_date > new_cs->GetInfo()->join_date || (best->GetInfo()->join_date == new_cs->GetInfo()->join_date && best->client_id > new_cs->client_id)) {
-						best = new_cs;
-					}
-				}
-			}
-
-			/* Is there someone else to join? */
-			if (best != NULL) {
-				/* Let the first start joining. */
-				best->status = STATUS_AUTHORIZED;
-				best->SendMap();
-
-				/* And update the rest. */
-				FOR_ALL_CLIENT_SOCKETS(new_cs) {
-					if (new_cs->status == STATUS_MAP_WAIT) new_cs->SendWait();
-				}
-			}
+			StartWaitingMapDownloads();
 		}
 
 		switch (this->SendPackets()) {
@@ -656,8 +762,8 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::SendMap()
 				return NETWORK_RECV_STATUS_CONN_LOST;
 
 			case SPS_ALL_SENT:
-				/* All are sent, increase the sent_packets */
-				if (has_packets) sent_packets *= 2;
+				/* All are sent, increase the number of packets when there might be more */
+				if (sent_packets == this->map_send_packets) this->map_send_packets *= 2;
 				break;
 
 			case SPS_PARTLY_SENT:
@@ -665,8 +771,8 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::SendMap()
 				break;
 
 			case SPS_NONE_SENT:
-				/* Not everything is sent, decrease the sent_packets */
-				if (sent_packets > 1) sent_packets /= 2;
+				/* Not everything is sent, decrease the number of packets */
+				if (this->map_send_packets > 1) this->map_send_packets /= 2;
 				break;
 		}
 	}
@@ -916,6 +1022,8 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::Receive_CLIENT_JOIN(Packet *p)
 	p->Recv_string(name, sizeof(name));
 	playas = (Owner)p->Recv_uint8();
 	client_lang = (NetworkLanguage)p->Recv_uint8();
+	/* Clients which do not tell they can load zstd get the map in the default format. */
+	this->supports_zstd = p->pos < p->size && p->Recv_bool();
 
 	if (this->HasClientQuit()) return NETWORK_RECV_STATUS_CONN_LOST;
 
@@ -1024,6 +1132,9 @@ NetworkRecvStatus ServerNetworkGameSocketHandler::Receive_CLIENT_GETMAP(Packet *
 		return this->SendError(NETWORK_ERROR_NOT_AUTHORIZED);
 	}
 
+	/* Download the map together with the clients which just started downloading it */
+	if (CanJoinMapSnapshot(this)) return this->SendMap();
+
 	/* Check if someone else is receiving the map */
 	FOR_ALL_CLIENT_SOCKETS(new_cs) {
 		if (new_cs->status == STATUS_MAP) {
@@ -1879,6 +1990,13 @@ void NetworkServer_Tick(bool send_frame)
 				break;
 
 			case NetworkClientSocket::STATUS_MAP:
+				/* The snapshot will never be complete, so do not let the client wait for it. */
+				if (cs->map_snapshot->HasFailed()) {
+					IConsolePrintF(CC_ERROR, "Client #%d is dropped because saving the map failed", cs->client_id);
+					cs->SendError(NETWORK_ERROR_SAVEGAME_FAILED);
+					continue;
+				}
+
 				/* Downloading the map... this is the amount of time since starting the saving. */
 				if (lag > _settings_client.network.max_download_time) {
 					IConsolePrintF(CC_ERROR, "Client #%d is dropped because it took longer than %d ticks to download the map", cs->client_id, _settings_client.network.max_download_time);
@@ -1909,7 +2027,10 @@ void NetworkServer_Tick(bool send_frame)
 
 			case NetworkClientSocket::STATUS_MAP_WAIT:
 				/* This is an internal state where we do not wait
-				 * on the client to move to a different state. */
+				 * on the client to move to a different state. But
+				 * the downloads it waits for might have ended without
+				 * a successor, e.g. when those clients were dropped. */
+				ServerNetworkGameSocketHandler::StartWaitingMapDownloads();
 				break;
 
 			case NetworkClientSocket::STATUS_END:
@@ -1995,6 +2116,8 @@ void NetworkServerShowStatusToConsole()
 			cs->client_id, ci->client_name, status, lag,
 			ci->client_playas + (Company::IsValidID(ci->client_playas) ? 1 : 0),
 			cs->GetClientIP());
+		IConsolePrintF(CC_INFO, "  sent: " OTTD_PRINTF64U " packets, " OTTD_PRINTF64U " bytes, " OTTD_PRINTF64U " calls  received: " OTTD_PRINTF64U " packets, " OTTD_PRINTF64U " bytes, " OTTD_PRINTF64U " calls",
+			cs->packets_sent, cs->bytes_sent, cs->send_calls, cs->packets_received, cs->bytes_received, cs->receive_calls);
 	}
 }
 
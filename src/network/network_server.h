@@ -52,6 +52,8 @@ protected:
 	NetworkRecvStatus SendNeedGamePassword();
 	NetworkRecvStatus SendNeedCompanyPassword();
 
+	void LeaveMapSnapshot();
+
 public:
 	/** Status of a client */
 	enum ClientStatus {
@@ -75,7 +77,11 @@ public:
 	CommandQueue outgoing_queue; ///< The command-queue awaiting delivery
 	int receive_limit;           ///< Amount of bytes that we can receive at this moment
 
-	struct PacketWriter *savegame; ///< Writer used to write the savegame.
+	struct NetworkMapSnapshot *map_snapshot; ///< The map snapshot the client is downloading.
+	size_t map_pos;                ///< Number of bytes of the map snapshot sent to the client.
+	bool map_size_sent;            ///< Whether the size of the map snapshot is sent to the client.
+	uint map_send_packets;         ///< Number of map packets to queue for the client at once.
+	bool supports_zstd;            ///< Whether the client can load a map compressed with zstd.
 	NetworkAddress client_address; ///< IP-address of the client (so he can be banned)
 
 	ServerNetworkGameSocketHandler(SOCKET s);
@@ -104,6 +110,7 @@ public:
 	NetworkRecvStatus SendConfigUpdate();
 
 	static void Send();
+	static void StartWaitingMapDownloads();
 	static void AcceptConnection(SOCKET s, const NetworkAddress &address);
 	static bool AllowConnection();
 
@@ -47,6 +47,7 @@
 #include "vehicle_func.h"
 #include "language.h"
 #include "vehicle_base.h"
+#include "newgrf_callback_cache.h"
 
 #include "table/strings.h"
 #include "table/build_industry.h"
@@ -4705,6 +4706,7 @@ static void NewSpriteGroup(ByteReader *buf)
 			}
 
 			group->default_group = GetGroupFromGroupID(setid, type, buf->ReadWord());
+			group->Optimise();
 			break;
 		}
 
@@ -8040,6 +8042,7 @@ static void ResetNewGRFErrors()
  */
 void ResetNewGRFData()
 {
+	InvalidateNewGRFCallbackCache();
 	CleanUpStrings();
 	CleanUpGRFTownNames();
 
@@ -0,0 +1,152 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file newgrf_callback_cache.cpp Memoisation of the results of NewGRF callbacks. */
+
+#include "stdafx.h"
+#include "newgrf_callback_cache.h"
+#include "newgrf_spritegroup.h"
+#include <unordered_map>
+
+#include "safeguards.h"
+
+/** Bitmask of the features of which callback results are memoised right now; none outside of a #NewGRFCallbackCacheScope. */
+uint32 _newgrf_callback_cache_features = 0;
+/** Incremented on every invalidation of the callback cache; 64 bits wide, so it never wraps around. */
+static uint64 _newgrf_callback_cache_epoch = 0;
+/** Number of lookups in the callback cache, per feature. */
+NewGRFCallbackCacheStats _newgrf_callback_cache_stats[GSF_END];
+
+/** Hash of a #NewGRFCallbackCacheKey. */
+struct NewGRFCallbackCacheKeyHash {
+	size_t operator()(const NewGRFCallbackCacheKey &key) const
+	{
+		size_t hash = (size_t)key.spec;
+		hash = hash * 31 + key.object;
+		hash = hash * 31 + key.state;
+		hash = hash * 31 + key.param1;
+		hash = hash * 31 + key.param2;
+		hash = hash * 31 + (key.callback | key.feature << 16);
+		return hash;
+	}
+};
+
+static const size_t MAX_CALLBACK_CACHE_SIZE = 1 << 16; ///< Number of memoised results after which the cache starts over.
+
+/** A memoised callback result. */
+struct NewGRFCallbackCacheEntry {
+	uint64 epoch;  ///< The value of #_newgrf_callback_cache_epoch the result is valid for.
+	uint16 result; ///< The result of the callback.
+};
+
+/** The memoised callback results; entries of an older epoch are stale and overwritten on demand. */
+static std::unordered_map<NewGRFCallbackCacheKey, NewGRFCallbackCacheEntry, NewGRFCallbackCacheKeyHash> _callback_cache;
+
+/**
+ * Check whether the results of a callback are memoised.
+ * These callbacks are queried repeatedly for unchanged objects. Their results do not depend on
+ * anything but the state of the game, and are not accompanied by values in the registers.
+ * @param feature The feature of the resolved object.
+ * @param callback The callback.
+ * @return Whether the callback is memoised when its feature is.
+ */
+bool IsMemoisedNewGRFCallback(GrfSpecFeature feature, CallbackID callback)
+{
+	switch (feature) {
+		case GSF_TRAINS:
+		case GSF_ROADVEHICLES:
+		case GSF_SHIPS:
+		case GSF_AIRCRAFT:
+			switch (callback) {
+				case CBID_VEHICLE_MODIFY_PROPERTY:
+				case CBID_VEHICLE_LENGTH:
+				case CBID_VEHICLE_REFIT_CAPACITY:
+				case CBID_VEHICLE_LOAD_AMOUNT:
+				case CBID_VEHICLE_VISUAL_EFFECT:
+				case CBID_VEHICLE_COLOUR_MAPPING:
+				case CBID_VEHICLE_ARTIC_ENGINE:
+					return true;
+
+				default:
+					return false;
+			}
+
+		case GSF_STATIONS:
+			switch (callback) {
+				case CBID_STATION_AVAILABILITY:
+				case CBID_STATION_SPRITE_LAYOUT:
+				case CBID_STATION_TILE_LAYOUT:
+					return true;
+
+				default:
+					return false;
+			}
+
+		case GSF_HOUSES:
+			switch (callback) {
+				case CBID_HOUSE_COLOUR:
+				case CBID_HOUSE_CARGO_ACCEPTANCE:
+				case CBID_HOUSE_ACCEPT_CARGO:
+				case CBID_HOUSE_DRAW_FOUNDATIONS:
+					return true;
+
+				default:
+					return false;
+			}
+
+		default:
+			return false;
+	}
+}
+
+/**
+ * Invalidate all memoised callback results, e.g. after a change of state they may depend on.
+ * Stale results are overwritten when the callbacks are memoised again.
+ */
+void InvalidateNewGRFCallbackCache()
+{
+	_newgrf_callback_cache_epoch++;
+}
+
+/**
+ * Look up the memoised result of a callback.
+ * @param key The callback and the object to look up.
+ * @param[out] result The result of the callback, when found.
+ * @return Whether the result was found.
+ * @pre #UseNewGRFCallbackCache for the feature and callback of \a key.
+ */
+bool LookupNewGRFCallbackCache(const NewGRFCallbackCacheKey &key, uint16 *result)
+{
+	auto it = _callback_cache.find(key);
+	if (it == _callback_cache.end() || it->second.epoch != _newgrf_callback_cache_epoch) {
+		_newgrf_callback_cache_stats[key.feature].misses++;
+		return false;
+	}
+
+	_newgrf_callback_cache_stats[key.feature].hits++;
+	*result = it->second.result;
+	return true;
+}
+
+/**
+ * Memoise the result of a callback after a failed lookup.
+ * Results of resolving which stored into persistent storage are not memoised, as the store
+ * would not be repeated.
+ * @param key The callback and the object it was resolved for.
+ * @param object The resolver object the callback was resolved with.
+ * @param result The result of the callback.
+ */
+void StoreNewGRFCallbackCache(const NewGRFCallbackCacheKey &key, const ResolverObject &object, uint16 result)
+{
+	if (object.psa_stored) return;
+	if (_callback_cache.size() >= MAX_CALLBACK_CACHE_SIZE) _callback_cache.clear();
+	NewGRFCallbackCacheEntry &entry = _callback_cache[key];
+	entry.epoch = _newgrf_callback_cache_epoch;
+	entry.result = result;
+}
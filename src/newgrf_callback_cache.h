@@ -0,0 +1,100 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file newgrf_callback_cache.h Memoisation of the results of NewGRF callbacks. */
+
+#ifndef NEWGRF_CALLBACK_CACHE_H
+#define NEWGRF_CALLBACK_CACHE_H
+
+#include "newgrf.h"
+#include "newgrf_callbacks.h"
+
+/**
+ * Identification of a callback resolved for an object.
+ * Besides the object itself it contains the parts of the state of the object that are
+ * changed temporarily, e.g. when the capacity of a vehicle is determined for a refit.
+ */
+struct NewGRFCallbackCacheKey {
+	const void *spec; ///< Specification of the object: engine, house or station spec.
+	uint32 object;    ///< Index of the object, e.g. the vehicle or the tile.
+	uint32 state;     ///< Temporarily changed state of the object.
+	uint32 param1;    ///< First parameter (var 10) of the callback.
+	uint32 param2;    ///< Second parameter (var 18) of the callback.
+	uint16 callback;  ///< The callback.
+	uint8 feature;    ///< GrfSpecFeature of the object.
+
+	NewGRFCallbackCacheKey(GrfSpecFeature feature, CallbackID callback, uint32 param1, uint32 param2, const void *spec, uint32 object, uint32 state = 0) :
+			spec(spec), object(object), state(state), param1(param1), param2(param2), callback(callback), feature(feature) {}
+
+	inline bool operator ==(const NewGRFCallbackCacheKey &other) const
+	{
+		return this->spec == other.spec && this->object == other.object && this->state == other.state &&
+				this->param1 == other.param1 && this->param2 == other.param2 && this->callback == other.callback && this->feature == other.feature;
+	}
+};
+
+/** Number of lookups in the callback cache of a feature. */
+struct NewGRFCallbackCacheStats {
+	uint64 hits;   ///< Number of lookups which found the result.
+	uint64 misses; ///< Number of lookups which had to resolve the callback.
+};
+
+/** The vehicle features, of which the callbacks are memoised in the vehicle and loading loops. */
+static const uint32 NEWGRF_CALLBACK_CACHE_VEHICLES = 1 << GSF_TRAINS | 1 << GSF_ROADVEHICLES | 1 << GSF_SHIPS | 1 << GSF_AIRCRAFT;
+
+struct ResolverObject;
+
+extern uint32 _newgrf_callback_cache_features;
+extern NewGRFCallbackCacheStats _newgrf_callback_cache_stats[GSF_END];
+
+bool IsMemoisedNewGRFCallback(GrfSpecFeature feature, CallbackID callback);
+bool LookupNewGRFCallbackCache(const NewGRFCallbackCacheKey &key, uint16 *result);
+void StoreNewGRFCallbackCache(const NewGRFCallbackCacheKey &key, const ResolverObject &object, uint16 result);
+void InvalidateNewGRFCallbackCache();
+
+/**
+ * Check whether the result of a callback may be taken from the callback cache.
+ * @param feature The feature of the resolved object.
+ * @param callback The callback.
+ * @return Whether the callback is memoised right now.
+ */
+static inline bool UseNewGRFCallbackCache(GrfSpecFeature feature, CallbackID callback)
+{
+	return HasBit(_newgrf_callback_cache_features, feature) && IsMemoisedNewGRFCallback(feature, callback);
+}
+
+/**
+ * Sets the features of which callback results are memoised while it exists.
+ * Outside of any scope nothing is memoised. A scope enabling a feature may only
+ * be used where every change of the state read by its memoised callbacks
+ * invalidates the cache; commands run within a scope disabling all features.
+ * The cache is invalidated when the scope is entered and when it is left, so
+ * results never outlive the scope they were memoised in.
+ */
+struct NewGRFCallbackCacheScope {
+	uint32 old_features; ///< The memoised features outside of the scope.
+
+	/**
+	 * Enter the scope.
+	 * @param features Bitmask of the features memoised within the scope.
+	 */
+	NewGRFCallbackCacheScope(uint32 features) : old_features(_newgrf_callback_cache_features)
+	{
+		_newgrf_callback_cache_features = features;
+		InvalidateNewGRFCallbackCache();
+	}
+
+	~NewGRFCallbackCacheScope()
+	{
+		_newgrf_callback_cache_features = this->old_features;
+		InvalidateNewGRFCallbackCache();
+	}
+};
+
+#endif /* NEWGRF_CALLBACK_CACHE_H */
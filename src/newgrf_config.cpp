@@ -24,6 +24,12 @@
 
 #include "fileio_func.h"
 #include "fios.h"
+#include "rev.h"
+#include "thread/thread_pool.h"
+#include <sys/stat.h>
+#include <string>
+#include <unordered_map>
+#include <memory>
 
 #include "safeguards.h"
 
@@ -405,13 +411,13 @@ static bool CalcGRFMD5Sum(GRFConfig *config, Subdirectory subdir)
 
 
 /**
- * Find the GRFID of a given grf, and calculate its md5sum.
+ * Find the GRFID and the other details of a given grf, but do not calculate its md5sum.
  * @param config    grf to fill.
  * @param is_static grf is static.
  * @param subdir    the subdirectory to search in.
- * @return Operation was successfully completed.
+ * @return Whether the grf is usable.
  */
-bool FillGRFDetails(GRFConfig *config, bool is_static, Subdirectory subdir)
+static bool ReadGRFDetails(GRFConfig *config, bool is_static, Subdirectory subdir)
 {
 	if (!FioCheckFileExists(config->filename, subdir)) {
 		config->status = GCS_NOT_FOUND;
@@ -434,7 +440,19 @@ bool FillGRFDetails(GRFConfig *config, bool is_static, Subdirectory subdir)
 		if (HasBit(config->flags, GCF_UNSAFE)) return false;
 	}
 
-	return CalcGRFMD5Sum(config, subdir);
+	return true;
+}
+
+/**
+ * Find the GRFID of a given grf, and calculate its md5sum.
+ * @param config    grf to fill.
+ * @param is_static grf is static.
+ * @param subdir    the subdirectory to search in.
+ * @return Operation was successfully completed.
+ */
+bool FillGRFDetails(GRFConfig *config, bool is_static, Subdirectory subdir)
+{
+	return ReadGRFDetails(config, is_static, subdir) && CalcGRFMD5Sum(config, subdir);
 }
 
 
@@ -625,13 +643,311 @@ compatible_grf:
 	return res;
 }
 
+char *_newgrf_scan_cache_file; ///< The file to store the details of the scanned NewGRFs in.
+
+static const uint32 NEWGRF_SCAN_CACHE_VERSION = 1;        ///< Version of the format of the NewGRF scan cache.
+static const char NEWGRF_SCAN_CACHE_MAGIC[4] = {'O', 'G', 'S', 'C'}; ///< First bytes of the NewGRF scan cache.
+static const uint32 MAX_SCAN_CACHE_KEY_LENGTH = 4096;     ///< Maximum length of a key in the NewGRF scan cache.
+
+/** A NewGRF found by #GRFFileScanner. */
+struct ScannedGRF {
+	GRFConfig *config; ///< The details of the NewGRF.
+	std::string key;   ///< Key of the NewGRF in the scan cache; empty if the details are not to be cached.
+	uint64 size;       ///< Size of the file, or of the tar containing it.
+	int64 mtime;       ///< Modification time of the file, or of the tar containing it.
+	bool usable;       ///< Whether the NewGRF is to be added to the list of all NewGRFs.
+	bool hash;         ///< Whether the MD5 sum of the NewGRF still has to be calculated.
+};
+
+/** Write a value to the NewGRF scan cache. */
+template <typename T>
+static inline bool WriteScanCacheValue(FILE *f, const T &value)
+{
+	return fwrite(&value, sizeof(value), 1, f) == 1;
+}
+
+/** Read a value from the NewGRF scan cache. */
+template <typename T>
+static inline bool ReadScanCacheValue(FILE *f, T *value)
+{
+	return fread(value, sizeof(*value), 1, f) == 1;
+}
+
+/**
+ * Write the details of a scanned NewGRF to the scan cache.
+ * @param f The file of the scan cache.
+ * @param grf The NewGRF.
+ * @return Whether all was written.
+ */
+static bool SaveScannedGRF(FILE *f, const ScannedGRF &grf)
+{
+	const GRFConfig *c = grf.config;
+	uint32 key_length = (uint32)grf.key.size();
+	if (!WriteScanCacheValue(f, key_length) || fwrite(grf.key.data(), 1, key_length, f) != key_length) return false;
+	if (!WriteScanCacheValue(f, grf.size) || !WriteScanCacheValue(f, grf.mtime)) return false;
+
+	if (!WriteScanCacheValue(f, c->ident) || !WriteScanCacheValue(f, c->version) || !WriteScanCacheValue(f, c->min_loadable_version)) return false;
+	if (!WriteScanCacheValue(f, c->flags) || !WriteScanCacheValue(f, (uint8)c->status) || !WriteScanCacheValue(f, c->palette)) return false;
+	if (!WriteScanCacheValue(f, c->num_valid_params) || !WriteScanCacheValue(f, (uint8)c->has_param_defaults)) return false;
+	if (!SaveGRFTextList(f, c->name->text) || !SaveGRFTextList(f, c->info->text) || !SaveGRFTextList(f, c->url->text)) return false;
+
+	if (!WriteScanCacheValue(f, (uint32)c->param_info.Length())) return false;
+	for (uint i = 0; i < c->param_info.Length(); i++) {
+		const GRFParameterInfo *info = c->param_info[i];
+		if (!WriteScanCacheValue(f, (uint8)(info != NULL))) return false;
+		if (info == NULL) continue;
+
+		if (!SaveGRFTextList(f, info->name) || !SaveGRFTextList(f, info->desc)) return false;
+		if (!WriteScanCacheValue(f, (uint8)info->type) || !WriteScanCacheValue(f, info->min_value) ||
+				!WriteScanCacheValue(f, info->max_value) || !WriteScanCacheValue(f, info->def_value)) {
+			return false;
+		}
+		if (!WriteScanCacheValue(f, info->param_nr) || !WriteScanCacheValue(f, info->first_bit) || !WriteScanCacheValue(f, info->num_bit)) return false;
+
+		if (!WriteScanCacheValue(f, (uint32)info->value_names.Length())) return false;
+		for (const SmallPair<uint32, GRFText *> *name = info->value_names.Begin(); name != info->value_names.End(); name++) {
+			if (!WriteScanCacheValue(f, name->first) || !SaveGRFTextList(f, name->second)) return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Read the details of a NewGRF from the scan cache.
+ * @param f The file of the scan cache.
+ * @param[out] grf The NewGRF; its config is allocated even when reading fails.
+ * @return Whether all was read.
+ */
+static bool LoadScannedGRF(FILE *f, ScannedGRF *grf)
+{
+	GRFConfig *c = grf->config = new GRFConfig();
+
+	uint32 key_length;
+	if (!ReadScanCacheValue(f, &key_length) || key_length > MAX_SCAN_CACHE_KEY_LENGTH) return false;
+	grf->key.resize(key_length);
+	if (fread(&grf->key[0], 1, key_length, f) != key_length) return false;
+	if (!ReadScanCacheValue(f, &grf->size) || !ReadScanCacheValue(f, &grf->mtime)) return false;
+
+	uint8 status, has_param_defaults;
+	if (!ReadScanCacheValue(f, &c->ident) || !ReadScanCacheValue(f, &c->version) || !ReadScanCacheValue(f, &c->min_loadable_version)) return false;
+	if (!ReadScanCacheValue(f, &c->flags) || !ReadScanCacheValue(f, &status) || !ReadScanCacheValue(f, &c->palette)) return false;
+	if (!ReadScanCacheValue(f, &c->num_valid_params) || !ReadScanCacheValue(f, &has_param_defaults)) return false;
+	c->status = (GRFStatus)status;
+	c->has_param_defaults = has_param_defaults != 0;
+	if (!LoadGRFTextList(f, &c->name->text) || !LoadGRFTextList(f, &c->info->text) || !LoadGRFTextList(f, &c->url->text)) return false;
+
+	uint32 num_param_info;
+	if (!ReadScanCacheValue(f, &num_param_info) || num_param_info > lengthof(c->param)) return false;
+	for (uint i = 0; i < num_param_info; i++) {
+		uint8 present;
+		if (!ReadScanCacheValue(f, &present)) return false;
+		if (present == 0) {
+			*c->param_info.Append() = NULL;
+			continue;
+		}
+
+		GRFParameterInfo *info = new GRFParameterInfo(i);
+		*c->param_info.Append() = info;
+
+		uint8 type;
+		if (!LoadGRFTextList(f, &info->name) || !LoadGRFTextList(f, &info->desc)) return false;
+		if (!ReadScanCacheValue(f, &type) || type >= PTYPE_END || !ReadScanCacheValue(f, &info->min_value) ||
+				!ReadScanCacheValue(f, &info->max_value) || !ReadScanCacheValue(f, &info->def_value)) {
+			return false;
+		}
+		info->type = (GRFParameterType)type;
+		if (!ReadScanCacheValue(f, &info->param_nr) || !ReadScanCacheValue(f, &info->first_bit) || !ReadScanCacheValue(f, &info->num_bit)) return false;
+
+		uint32 num_names;
+		if (!ReadScanCacheValue(f, &num_names)) return false;
+		for (; num_names > 0; num_names--) {
+			uint32 value;
+			GRFText *name = NULL;
+			if (!ReadScanCacheValue(f, &value) || !LoadGRFTextList(f, &name)) {
+				CleanUpGRFText(name);
+				return false;
+			}
+			info->value_names.Insert(value, name);
+		}
+	}
+	return true;
+}
+
+/**
+ * The details of the NewGRFs found by the previous scan, so the files which did
+ * not change since do not need to be read again.
+ * The details are cached per path of a file, or per tar and path within the tar,
+ * and are valid as long as the size and the modification time of the file are.
+ */
+class NewGRFScanCache {
+	typedef std::unordered_map<std::string, ScannedGRF> ScannedGRFMap;
+	ScannedGRFMap grfs; ///< The cached NewGRFs, by their key.
+
+public:
+	~NewGRFScanCache()
+	{
+		for (ScannedGRFMap::iterator it = this->grfs.begin(); it != this->grfs.end(); ++it) delete it->second.config;
+	}
+
+	/**
+	 * Get the number of NewGRFs in the cache.
+	 * @return The number of cached NewGRFs.
+	 */
+	uint Count() const { return (uint)this->grfs.size(); }
+
+	/**
+	 * Find the cached details of a NewGRF.
+	 * @param key The key of the file.
+	 * @param size The current size of the file.
+	 * @param mtime The current modification time of the file.
+	 * @return The details, or \c NULL if the file is not cached or changed.
+	 */
+	const GRFConfig *Find(const std::string &key, uint64 size, int64 mtime) const
+	{
+		ScannedGRFMap::const_iterator it = this->grfs.find(key);
+		if (it == this->grfs.end() || it->second.size != size || it->second.mtime != mtime) return NULL;
+		return it->second.config;
+	}
+
+	void Load();
+	static void Save(const std::vector<ScannedGRF> &scanned);
+};
+
+/** Read the scan cache from #_newgrf_scan_cache_file. A cache of another format or build is ignored. */
+void NewGRFScanCache::Load()
+{
+	if (_newgrf_scan_cache_file == NULL) return;
+
+	FILE *f = FioFOpenFile(_newgrf_scan_cache_file, "rb", NO_DIRECTORY);
+	if (f == NULL) return;
+
+	char magic[lengthof(NEWGRF_SCAN_CACHE_MAGIC)];
+	uint32 version, revision_length, count;
+	char revision[64];
+	if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, NEWGRF_SCAN_CACHE_MAGIC, sizeof(magic)) != 0 ||
+			!ReadScanCacheValue(f, &version) || version != NEWGRF_SCAN_CACHE_VERSION ||
+			!ReadScanCacheValue(f, &revision_length) || revision_length != strlen(_openttd_revision) || revision_length >= sizeof(revision) ||
+			fread(revision, 1, revision_length, f) != revision_length || memcmp(revision, _openttd_revision, revision_length) != 0 ||
+			!ReadScanCacheValue(f, &count)) {
+		FioFCloseFile(f);
+		return;
+	}
+
+	for (; count > 0; count--) {
+		ScannedGRF grf;
+		if (!LoadScannedGRF(f, &grf)) {
+			DEBUG(grf, 1, "NewGRF scan cache %s is corrupt", _newgrf_scan_cache_file);
+			delete grf.config;
+			break;
+		}
+		grf.usable = true;
+
+		std::pair<ScannedGRFMap::iterator, bool> inserted = this->grfs.insert(std::make_pair(grf.key, grf));
+		if (!inserted.second) delete grf.config;
+	}
+	FioFCloseFile(f);
+}
+
+/**
+ * Write the scan cache to #_newgrf_scan_cache_file.
+ * @param scanned The NewGRFs found by the scan; those without a key are not cached.
+ */
+/* static */ void NewGRFScanCache::Save(const std::vector<ScannedGRF> &scanned)
+{
+	if (_newgrf_scan_cache_file == NULL) return;
+
+	FILE *f = FioFOpenFile(_newgrf_scan_cache_file, "wb", NO_DIRECTORY);
+	if (f == NULL) return;
+
+	uint32 count = 0;
+	for (const ScannedGRF &grf : scanned) {
+		if (!grf.key.empty()) count++;
+	}
+
+	uint32 revision_length = (uint32)strlen(_openttd_revision);
+	bool ok = fwrite(NEWGRF_SCAN_CACHE_MAGIC, sizeof(NEWGRF_SCAN_CACHE_MAGIC), 1, f) == 1 &&
+			WriteScanCacheValue(f, NEWGRF_SCAN_CACHE_VERSION) && WriteScanCacheValue(f, revision_length) &&
+			fwrite(_openttd_revision, 1, revision_length, f) == revision_length && WriteScanCacheValue(f, count);
+	for (const ScannedGRF &grf : scanned) {
+		if (!ok) break;
+		if (!grf.key.empty()) ok = SaveScannedGRF(f, grf);
+	}
+	FioFCloseFile(f);
+
+	if (!ok) {
+		DEBUG(grf, 0, "Failed to write NewGRF scan cache %s", _newgrf_scan_cache_file);
+		unlink(_newgrf_scan_cache_file);
+	}
+}
+
+/**
+ * Get the key of a file in the scan cache and the state of the file the cached details are valid for.
+ * @param filename The full path of the file, or its path within \a tar_filename.
+ * @param tar_filename The tar containing the file, or \c NULL.
+ * @param[out] grf The NewGRF to fill the key, size and modification time of.
+ * @return Whether the state of the file is known.
+ */
+static bool GetGRFScanCacheKey(const char *filename, const char *tar_filename, ScannedGRF *grf)
+{
+	const char *path = tar_filename != NULL ? tar_filename : filename;
+#ifdef WIN32
+	struct _stat sb;
+	if (_tstat(OTTD2FS(path), &sb) != 0) return false;
+#else
+	struct stat sb;
+	if (stat(path, &sb) != 0) return false;
+#endif
+	grf->size = sb.st_size;
+	grf->mtime = sb.st_mtime;
+
+	grf->key = path;
+	if (tar_filename != NULL) {
+		grf->key += PATHSEPCHAR;
+		grf->key += filename;
+	}
+	return true;
+}
+
+/** The NewGRFs of which one task calculates the MD5 sum. */
+struct GRFHashBatch {
+	std::vector<ScannedGRF *> *grfs; ///< All NewGRFs to calculate the MD5 sum of.
+	uint first;                      ///< Index of the first NewGRF of this batch.
+	uint step;                       ///< Distance between the NewGRFs of this batch.
+};
+
+/**
+ * Calculate the MD5 sums of a batch of NewGRFs. This method is tailored to ThreadPoolTask.
+ * @param data The batch.
+ */
+static void CalcGRFMD5SumBatch(void *data)
+{
+	GRFHashBatch *batch = (GRFHashBatch *)data;
+	for (uint i = batch->first; i < batch->grfs->size(); i += batch->step) {
+		ScannedGRF *grf = (*batch->grfs)[i];
+		if (!CalcGRFMD5Sum(grf->config, NEWGRF_DIR)) {
+			/* The file went away, so do not remember it. */
+			grf->usable = false;
+			grf->key.clear();
+		}
+		grf->hash = false;
+	}
+}
+
+static ThreadPool _grf_hash_workers("ottd:grfhash"); ///< Workers calculating the MD5 sums of the scanned NewGRFs.
+
 /** Helper for scanning for files with GRF as extension */
 class GRFFileScanner : FileScanner {
-	uint next_update; ///< The next (realtime tick) we do update the screen.
-	uint num_scanned; ///< The number of GRFs we have scanned.
+	uint next_update;              ///< The next (realtime tick) we do update the screen.
+	uint num_scanned;              ///< The number of GRFs we have scanned.
+	uint num_cached;               ///< The number of GRFs of which the details were taken from the cache.
+	const NewGRFScanCache &cache;  ///< The details of the previous scan.
+	std::vector<ScannedGRF> found; ///< The GRFs found, in the order of scanning.
+
+	void CalcMD5Sums();
+	uint AddToList();
 
 public:
-	GRFFileScanner() : next_update(_realtime_tick), num_scanned(0)
+	GRFFileScanner(const NewGRFScanCache &cache) : next_update(_realtime_tick), num_scanned(0), num_cached(0), cache(cache)
 	{
 	}
 
@@ -640,8 +956,22 @@ public:
 	/** Do the scan for GRFs. */
 	static uint DoScan()
 	{
-		GRFFileScanner fs;
-		int ret = fs.Scan(".grf", NEWGRF_DIR);
+		NewGRFScanCache cache;
+		cache.Load();
+
+		GRFFileScanner fs(cache);
+		fs.Scan(".grf", NEWGRF_DIR);
+		fs.CalcMD5Sums();
+		DEBUG(grf, 1, "Details of %u of %u files taken from the NewGRF scan cache", fs.num_cached, fs.num_scanned);
+
+		/* Only rewrite the cache when files were added, changed or removed. */
+		uint num_cacheable = 0;
+		for (const ScannedGRF &grf : fs.found) {
+			if (!grf.key.empty()) num_cacheable++;
+		}
+		if (num_cacheable != fs.num_cached || cache.Count() != fs.num_cached) NewGRFScanCache::Save(fs.found);
+
+		uint ret = fs.AddToList();
 		/* The number scanned and the number returned may not be the same;
 		 * duplicate NewGRFs and base sets are ignored in the return value. */
 		_settings_client.gui.last_newgrf_count = fs.num_scanned;
@@ -651,36 +981,27 @@ public:
 
 bool GRFFileScanner::AddFile(const char *filename, size_t basepath_length, const char *tar_filename)
 {
-	GRFConfig *c = new GRFConfig(filename + basepath_length);
+	ScannedGRF grf;
+	const GRFConfig *cached = NULL;
+	if (GetGRFScanCacheKey(filename, tar_filename, &grf)) cached = this->cache.Find(grf.key, grf.size, grf.mtime);
 
-	bool added = true;
-	if (FillGRFDetails(c, false)) {
-		if (_all_grfs == NULL) {
-			_all_grfs = c;
-		} else {
-			/* Insert file into list at a position determined by its
-			 * name, so the list is sorted as we go along */
-			GRFConfig **pd, *d;
-			bool stop = false;
-			for (pd = &_all_grfs; (d = *pd) != NULL; pd = &d->next) {
-				if (c->ident.grfid == d->ident.grfid && memcmp(c->ident.md5sum, d->ident.md5sum, sizeof(c->ident.md5sum)) == 0) added = false;
-				/* Because there can be multiple grfs with the same name, make sure we checked all grfs with the same name,
-				 *  before inserting the entry. So insert a new grf at the end of all grfs with the same name, instead of
-				 *  just after the first with the same name. Avoids doubles in the list. */
-				if (strcasecmp(c->GetName(), d->GetName()) <= 0) {
-					stop = true;
-				} else if (stop) {
-					break;
-				}
-			}
-			if (added) {
-				c->next = d;
-				*pd = c;
-			}
-		}
+	GRFConfig *c;
+	if (cached != NULL) {
+		c = new GRFConfig(*cached);
+		c->filename = stredup(filename + basepath_length);
+		c->SetSuitablePalette();
+		c->FinalizeParameterInfo();
+		grf.usable = c->ident.grfid != 0 && !HasBit(c->flags, GCF_SYSTEM);
+		grf.hash = false;
+		this->num_cached++;
 	} else {
-		added = false;
+		c = new GRFConfig(filename + basepath_length);
+		grf.usable = ReadGRFDetails(c, false, NEWGRF_DIR);
+		grf.hash = grf.usable;
+		if (c->status == GCS_NOT_FOUND) grf.key.clear();
 	}
+	grf.config = c;
+	this->found.push_back(grf);
 
 	this->num_scanned++;
 	if (this->next_update <= _realtime_tick) {
@@ -698,13 +1019,84 @@ bool GRFFileScanner::AddFile(const char *filename, size_t basepath_length, const
 		this->next_update = _realtime_tick + 200;
 	}
 
-	if (!added) {
-		/* File couldn't be opened, or is either not a NewGRF or is a
-		 * 'system' NewGRF or it's already known, so forget about it. */
-		delete c;
+	return grf.usable;
+}
+
+/** Calculate the MD5 sums of the found GRFs which were not taken from the cache, spread over all cores. */
+void GRFFileScanner::CalcMD5Sums()
+{
+	std::vector<ScannedGRF *> grfs;
+	for (ScannedGRF &grf : this->found) {
+		if (grf.hash) grfs.push_back(&grf);
+	}
+	if (grfs.empty()) return;
+
+	/* The first batch is done by this thread. */
+	uint num_batches = Clamp<uint>(GetCPUCoreCount(), 1, (uint)grfs.size());
+	std::vector<GRFHashBatch> batches(num_batches);
+	for (uint i = 0; i < num_batches; i++) {
+		batches[i].grfs = &grfs;
+		batches[i].first = i;
+		batches[i].step = num_batches;
 	}
 
-	return added;
+	std::vector<std::unique_ptr<ThreadPoolTask>> tasks;
+	for (uint i = 1; i < num_batches; i++) {
+		tasks.emplace_back(new ThreadPoolTask(&CalcGRFMD5SumBatch, &batches[i]));
+		_grf_hash_workers.Submit(tasks.back().get());
+	}
+	CalcGRFMD5SumBatch(&batches[0]);
+	for (auto &task : tasks) {
+		_grf_hash_workers.Wait(task.get());
+	}
+}
+
+/**
+ * Add the usable found GRFs to the list of all GRFs, and forget about the others.
+ * @return The number of GRFs added to the list.
+ */
+uint GRFFileScanner::AddToList()
+{
+	uint num = 0;
+	for (ScannedGRF &grf : this->found) {
+		GRFConfig *c = grf.config;
+		bool added = grf.usable;
+		if (added) {
+			if (_all_grfs == NULL) {
+				_all_grfs = c;
+			} else {
+				/* Insert file into list at a position determined by its
+				 * name, so the list is sorted as we go along */
+				GRFConfig **pd, *d;
+				bool stop = false;
+				for (pd = &_all_grfs; (d = *pd) != NULL; pd = &d->next) {
+					if (c->ident.grfid == d->ident.grfid && memcmp(c->ident.md5sum, d->ident.md5sum, sizeof(c->ident.md5sum)) == 0) added = false;
+					/* Because there can be multiple grfs with the same name, make sure we checked all grfs with the same name,
+					 *  before inserting the entry. So insert a new grf at the end of all grfs with the same name, instead of
+					 *  just after the first with the same name. Avoids doubles in the list. */
+					if (strcasecmp(c->GetName(), d->GetName()) <= 0) {
+						stop = true;
+					} else if (stop) {
+						break;
+					}
+				}
+				if (added) {
+					c->next = d;
+					*pd = c;
+				}
+			}
+		}
+
+		if (added) {
+			num++;
+		} else {
+			/* File couldn't be opened, or is either not a NewGRF or is a
+			 * 'system' NewGRF or it's already known, so forget about it. */
+			delete c;
+		}
+	}
+	this->found.clear();
+	return num;
 }
 
 /**
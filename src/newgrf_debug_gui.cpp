@@ -41,6 +41,7 @@
 #include "newgrf_industrytiles.h"
 
 #include "widgets/newgrf_debug_widget.h"
+#include "newgrf_callback_cache.h"
 
 #include "table/strings.h"
 
@@ -544,6 +545,16 @@ struct NewGRFInspectWindow : Window {
 			}
 		}
 
+		GrfSpecFeature f = GetFeatureNum(this->window_number);
+		if (f < GSF_END) {
+			const NewGRFCallbackCacheStats &stats = _newgrf_callback_cache_stats[f];
+			uint64 lookups = stats.hits + stats.misses;
+			if (lookups != 0) {
+				this->DrawString(r, i++, "Callback cache (all objects of this feature):");
+				this->DrawString(r, i++, "  " OTTD_PRINTF64U " hits, " OTTD_PRINTF64U " misses (%u%% hit rate)", stats.hits, stats.misses, (uint)(stats.hits * 100 / lookups));
+			}
+		}
+
 		/* Not nice and certainly a hack, but it beats duplicating
 		 * this whole function just to count the actual number of
 		 * elements. Especially because they need to be redrawn. */
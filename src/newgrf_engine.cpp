@@ -24,6 +24,7 @@
 #include "company_base.h"
 #include "newgrf_railtype.h"
 #include "ship.h"
+#include "newgrf_callback_cache.h"
 
 #include "safeguards.h"
 
@@ -1087,8 +1088,23 @@ bool UsesWagonOverride(const Vehicle *v)
  */
 uint16 GetVehicleCallback(CallbackID callback, uint32 param1, uint32 param2, EngineID engine, const Vehicle *v)
 {
+	const Engine *e = Engine::Get(engine);
+	GrfSpecFeature feature = (GrfSpecFeature)(GSF_TRAINS + e->type);
+	if (!UseNewGRFCallbackCache(feature, callback)) {
+		VehicleResolverObject object(engine, v, VehicleResolverObject::WO_UNCACHED, false, callback, param1, param2);
+		return object.ResolveCallback();
+	}
+
+	/* The cargo is changed temporarily to determine the capacity and cost of refits. */
+	NewGRFCallbackCacheKey key(feature, callback, param1, param2, e,
+			v != NULL ? v->index : INVALID_VEHICLE, v != NULL ? v->cargo_type | v->cargo_subtype << 8 : 0);
+	uint16 result;
+	if (LookupNewGRFCallbackCache(key, &result)) return result;
+
 	VehicleResolverObject object(engine, v, VehicleResolverObject::WO_UNCACHED, false, callback, param1, param2);
-	return object.ResolveCallback();
+	result = object.ResolveCallback();
+	StoreNewGRFCallbackCache(key, object, result);
+	return result;
 }
 
 /**
@@ -1145,6 +1161,7 @@ static void DoTriggerVehicle(Vehicle *v, VehicleTrigger trigger, byte base_rando
 	uint32 reseed = object.GetReseedSum();
 	v->random_bits &= ~reseed;
 	v->random_bits |= (first ? new_random_bits : base_random_bits) & reseed;
+	if (reseed != 0) InvalidateNewGRFCallbackCache();
 
 	switch (trigger) {
 		case VEHICLE_TRIGGER_NEW_CARGO:
@@ -24,6 +24,7 @@
 #include "newgrf_animation_base.h"
 #include "newgrf_cargo.h"
 #include "station_base.h"
+#include "newgrf_callback_cache.h"
 
 #include "safeguards.h"
 
@@ -513,9 +514,21 @@ static uint32 GetDistanceFromNearbyHouse(uint8 parameter, TileIndex tile, HouseI
 uint16 GetHouseCallback(CallbackID callback, uint32 param1, uint32 param2, HouseID house_id, Town *town, TileIndex tile,
 		bool not_yet_constructed, uint8 initial_random_bits, uint32 watched_cargo_triggers)
 {
-	HouseResolverObject object(house_id, tile, town, callback, param1, param2,
-			not_yet_constructed, initial_random_bits, watched_cargo_triggers);
-	return object.ResolveCallback();
+	/* Houses which are not built yet or with triggered watched cargo are not memoised, as they are not an unchanged house. */
+	if (not_yet_constructed || watched_cargo_triggers != 0 || !UseNewGRFCallbackCache(GSF_HOUSES, callback)) {
+		HouseResolverObject object(house_id, tile, town, callback, param1, param2,
+				not_yet_constructed, initial_random_bits, watched_cargo_triggers);
+		return object.ResolveCallback();
+	}
+
+	NewGRFCallbackCacheKey key(GSF_HOUSES, callback, param1, param2, HouseSpec::Get(house_id), tile, town != NULL ? town->index : INVALID_TOWN);
+	uint16 result;
+	if (LookupNewGRFCallbackCache(key, &result)) return result;
+
+	HouseResolverObject object(house_id, tile, town, callback, param1, param2, false, 0, 0);
+	result = object.ResolveCallback();
+	StoreNewGRFCallbackCache(key, object, result);
+	return result;
 }
 
 /**
@@ -781,6 +794,7 @@ static void DoTriggerHouse(TileIndex tile, HouseTrigger trigger, byte base_rando
 	random_bits &= ~reseed;
 	random_bits |= (first ? new_random_bits : base_random) & reseed;
 	SetHouseRandomBits(tile, random_bits);
+	if (reseed != 0) InvalidateNewGRFCallbackCache();
 
 	switch (trigger) {
 		case HOUSE_TRIGGER_TILE_LOOP:
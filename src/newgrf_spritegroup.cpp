@@ -15,6 +15,8 @@
 #include "core/pool_func.hpp"
 #include "vehicle_type.h"
 
+#include <algorithm>
+
 #include "safeguards.h"
 
 SpriteGroupPool _spritegroup_pool("SpriteGroup");
@@ -188,10 +190,10 @@ static uint32 RotateRight(uint32 val, uint32 rot)
 }
 
 
-/* Evaluate an adjustment for a variable of the given size.
+/* Adjust the value of a variable of the given size: shift, mask, add and divide.
  * U is the unsigned type and S is the signed type to use. */
 template <typename U, typename S>
-static U EvalAdjustT(const DeterministicSpriteGroupAdjust *adjust, ScopeResolver *scope, U last_value, uint32 value)
+static uint32 GetAdjustedValueT(const DeterministicSpriteGroupAdjust *adjust, uint32 value)
 {
 	value >>= adjust->shift_num;
 	value  &= adjust->and_mask;
@@ -204,6 +206,14 @@ static U EvalAdjustT(const DeterministicSpriteGroupAdjust *adjust, ScopeResolver
 		case DSGA_TYPE_NONE: break;
 	}
 
+	return value;
+}
+
+/* Evaluate the operation of an adjustment for an adjusted value of the given size.
+ * U is the unsigned type and S is the signed type to use. */
+template <typename U, typename S>
+static U EvalAdjustOperationT(const DeterministicSpriteGroupAdjust *adjust, ScopeResolver *scope, U last_value, uint32 value)
+{
 	switch (adjust->operation) {
 		case DSGA_OP_ADD:  return last_value + value;
 		case DSGA_OP_SUB:  return last_value - value;
@@ -221,7 +231,7 @@ static U EvalAdjustT(const DeterministicSpriteGroupAdjust *adjust, ScopeResolver
 		case DSGA_OP_XOR:  return last_value ^ value;
 		case DSGA_OP_STO:  _temp_store.StoreValue((U)value, (S)last_value); return last_value;
 		case DSGA_OP_RST:  return value;
-		case DSGA_OP_STOP: scope->StorePSA((U)value, (S)last_value); return last_value;
+		case DSGA_OP_STOP: scope->ro.psa_stored = true; scope->StorePSA((U)value, (S)last_value); return last_value;
 		case DSGA_OP_ROR:  return RotateRight(last_value, value);
 		case DSGA_OP_SCMP: return ((S)last_value == (S)value) ? 1 : ((S)last_value < (S)value ? 0 : 2);
 		case DSGA_OP_UCMP: return ((U)last_value == (U)value) ? 1 : ((U)last_value < (U)value ? 0 : 2);
@@ -232,99 +242,289 @@ static U EvalAdjustT(const DeterministicSpriteGroupAdjust *adjust, ScopeResolver
 	}
 }
 
+/**
+ * Adjust the value of a variable for the size of a group.
+ * @param size Size of the group.
+ * @param adjust The var adjust.
+ * @param value The value of the variable.
+ * @return The adjusted value.
+ */
+static inline uint32 GetAdjustedValue(DeterministicSpriteGroupSize size, const DeterministicSpriteGroupAdjust *adjust, uint32 value)
+{
+	switch (size) {
+		case DSG_SIZE_BYTE:  return GetAdjustedValueT<uint8,  int8> (adjust, value);
+		case DSG_SIZE_WORD:  return GetAdjustedValueT<uint16, int16>(adjust, value);
+		case DSG_SIZE_DWORD: return GetAdjustedValueT<uint32, int32>(adjust, value);
+		default: NOT_REACHED();
+	}
+}
+
+/**
+ * Evaluate the operation of a var adjust for the size of a group.
+ * @param size Size of the group.
+ * @param adjust The var adjust.
+ * @param scope Scope for storing into the persistent storage.
+ * @param last_value The value so far.
+ * @param value The adjusted value.
+ * @return The new value.
+ */
+static inline uint32 EvalAdjustOperation(DeterministicSpriteGroupSize size, const DeterministicSpriteGroupAdjust *adjust, ScopeResolver *scope, uint32 last_value, uint32 value)
+{
+	switch (size) {
+		case DSG_SIZE_BYTE:  return EvalAdjustOperationT<uint8,  int8> (adjust, scope, last_value, value);
+		case DSG_SIZE_WORD:  return EvalAdjustOperationT<uint16, int16>(adjust, scope, last_value, value);
+		case DSG_SIZE_DWORD: return EvalAdjustOperationT<uint32, int32>(adjust, scope, last_value, value);
+		default: NOT_REACHED();
+	}
+}
+
+/**
+ * Get the effect of a variable on #_sprite_group_resolve_check_veh_check.
+ * @param variable The variable.
+ * @return The effect.
+ */
+static DeterministicSpriteGroupAdjustVehCheck GetVariableVehCheck(byte variable)
+{
+	switch (variable) {
+		// whitelist of variables which can be checked without requiring an immediate re-check on the next tick
+		case 0xC:
+		case 0x1A:
+		case 0x1C:
+		case 0x25:
+		case 0x40:
+		case 0x41:
+		case 0x42:
+		case 0x47:
+		case 0x49:
+		case 0x4B:
+		case 0x4D:
+		case 0x60:
+		case 0x7D:
+		case 0x7F:
+		case 0x80 + 0x0:
+		case 0x80 + 0x1:
+		case 0x80 + 0x4:
+		case 0x80 + 0x5:
+		case 0x80 + 0x39:
+		case 0x80 + 0x3A:
+		case 0x80 + 0x3B:
+		case 0x80 + 0x3C:
+		case 0x80 + 0x3D:
+		case 0x80 + 0x44:
+		case 0x80 + 0x45:
+		case 0x80 + 0x46:
+		case 0x80 + 0x47:
+		case 0x80 + 0x5A:
+		case 0x80 + 0x72:
+		case 0x80 + 0x7A:
+			return DSGAVC_KEEP;
+
+		case 0x80 + 0x62:
+			// RoadVehicle::state
+			return DSGAVC_CLEAR_UNLESS_ROAD;
+
+		case 0x7B:
+		case 0x7E:
+		default:
+			return DSGAVC_CLEAR;
+	}
+}
+
+/**
+ * Get the group for a value of the var adjusts: the group of the first range with the value, or the default group.
+ * @param value The value.
+ * @return The group.
+ */
+const SpriteGroup *DeterministicSpriteGroup::GetGroupForValue(uint32 value) const
+{
+	auto it = std::upper_bound(this->segments.begin(), this->segments.end(), value, [](uint32 value, const DeterministicSpriteGroupSegment &segment) {
+		return value < segment.low;
+	});
+	return (it - 1)->group;
+}
+
+/**
+ * Get the callback result of this group when called as a procedure, if it does not depend on the resolved object.
+ * @param[out] result The callback result.
+ * @param[out] last_value The last value left behind for variable 1C.
+ * @return True if the result is constant.
+ */
+bool DeterministicSpriteGroup::GetConstantProcedureResult(uint16 *result, uint32 *last_value) const
+{
+	if (this->first_adjust < this->num_adjusts) return false;
+
+	*last_value = this->calculated_value;
+	if (this->num_ranges == 0) {
+		uint32 value = this->calculated_value;
+		if (value != CALLBACK_FAILED) value = GB(value, 0, 15);
+		*result = value;
+		return true;
+	}
+
+	const SpriteGroup *group = this->GetGroupForValue(this->calculated_value);
+	if (group == NULL) {
+		*result = CALLBACK_FAILED;
+		return true;
+	}
+
+	switch (group->type) {
+		case SGT_CALLBACK:
+			*result = group->GetCallbackResult();
+			return true;
+
+		case SGT_DETERMINISTIC:
+			return static_cast<const DeterministicSpriteGroup *>(group)->GetConstantProcedureResult(result, last_value);
+
+		default:
+			return false;
+	}
+}
+
+/**
+ * Prepare the group for fast resolving, after it has been loaded.
+ * The variables of the var adjusts are decoded, constant values and procedures with a constant
+ * result are calculated, the leading constant var adjusts are folded into one value, and the
+ * ranges are turned into sorted segments for a binary search. Resolving gives the same results.
+ */
+void DeterministicSpriteGroup::Optimise()
+{
+	for (uint i = 0; i < this->num_adjusts; i++) {
+		DeterministicSpriteGroupAdjust *adjust = &this->adjusts[i];
+		adjust->veh_check = GetVariableVehCheck(adjust->variable);
+		adjust->value = 0;
+		adjust->procedure_last_value = 0;
+
+		/* A division which could trap is left to the resolving. */
+		int32 divisor = this->size == DSG_SIZE_BYTE ? (int8)adjust->divmod_val : this->size == DSG_SIZE_WORD ? (int16)adjust->divmod_val : (int32)adjust->divmod_val;
+		bool can_adjust = adjust->type == DSGA_TYPE_NONE || (divisor != 0 && divisor != -1);
+
+		uint16 result;
+		switch (adjust->variable) {
+			case 0x1A:
+				adjust->source = can_adjust ? DSGAS_CONSTANT : DSGAS_VARIABLE;
+				if (can_adjust) adjust->value = GetAdjustedValue(this->size, adjust, UINT_MAX);
+				break;
+
+			case 0x7B:
+				adjust->source = DSGAS_INDIRECT;
+				break;
+
+			case 0x7E:
+				if (can_adjust && adjust->subroutine != NULL && adjust->subroutine->type == SGT_DETERMINISTIC &&
+						static_cast<const DeterministicSpriteGroup *>(adjust->subroutine)->GetConstantProcedureResult(&result, &adjust->procedure_last_value)) {
+					adjust->source = DSGAS_CONSTANT;
+					adjust->value = GetAdjustedValue(this->size, adjust, result);
+				} else {
+					adjust->source = DSGAS_PROCEDURE;
+				}
+				break;
+
+			default:
+				/* Variables up to 24 can be global variables; 5F, 7D and 7F are handled by GetVariable as well. */
+				adjust->source = (adjust->variable <= 0x24 || adjust->variable == 0x5F || adjust->variable == 0x7D || adjust->variable == 0x7F) ? DSGAS_VARIABLE : DSGAS_SCOPE;
+				break;
+		}
+	}
+
+	/* Fold the leading constant var adjusts without side effects. */
+	uint32 last_value = 0;
+	uint first = 0;
+	for (; first < this->num_adjusts; first++) {
+		const DeterministicSpriteGroupAdjust *adjust = &this->adjusts[first];
+		if (adjust->source != DSGAS_CONSTANT || adjust->variable == 0x7E || adjust->operation == DSGA_OP_STO || adjust->operation == DSGA_OP_STOP) break;
+		last_value = EvalAdjustOperation(this->size, adjust, NULL, last_value, adjust->value);
+	}
+	this->first_adjust = first;
+	this->calculated_value = last_value;
+
+	/* Every value belongs to the first range containing it, or else to the default group. */
+	std::vector<uint32> bounds;
+	bounds.push_back(0);
+	for (uint i = 0; i < this->num_ranges; i++) {
+		if (this->ranges[i].low > this->ranges[i].high) continue;
+		bounds.push_back(this->ranges[i].low);
+		if (this->ranges[i].high != UINT32_MAX) bounds.push_back(this->ranges[i].high + 1);
+	}
+	std::sort(bounds.begin(), bounds.end());
+	bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+	this->segments.clear();
+	for (uint32 low : bounds) {
+		const SpriteGroup *group = this->default_group;
+		for (uint i = 0; i < this->num_ranges; i++) {
+			if (this->ranges[i].low <= low && low <= this->ranges[i].high) {
+				group = this->ranges[i].group;
+				break;
+			}
+		}
+		if (this->segments.empty() || this->segments.back().group != group) this->segments.push_back({ low, group });
+	}
+}
+
 bool _sprite_group_resolve_check_veh_check = false;
 VehicleType _sprite_group_resolve_check_veh_type;
 
 const SpriteGroup *DeterministicSpriteGroup::Resolve(ResolverObject &object) const
 {
-	uint32 last_value = 0;
-	uint32 value = 0;
-	uint i;
+	uint32 last_value = this->calculated_value;
+	uint32 value = this->calculated_value;
 
-	ScopeResolver *scope = object.GetScope(this->var_scope);
+	if (this->first_adjust < this->num_adjusts) {
+		ScopeResolver *scope = object.GetScope(this->var_scope);
 
-	for (i = 0; i < this->num_adjusts; i++) {
-		DeterministicSpriteGroupAdjust *adjust = &this->adjusts[i];
+		for (uint i = this->first_adjust; i < this->num_adjusts; i++) {
+			const DeterministicSpriteGroupAdjust *adjust = &this->adjusts[i];
 
-		/* Try to get the variable. We shall assume it is available, unless told otherwise. */
-		bool available = true;
-		if (adjust->variable == 0x7E) {
-			_sprite_group_resolve_check_veh_check = false;
-			const SpriteGroup *subgroup = SpriteGroup::Resolve(adjust->subroutine, object, false);
-			if (subgroup == NULL) {
-				value = CALLBACK_FAILED;
-			} else {
-				value = subgroup->GetCallbackResult();
+			switch (adjust->veh_check) {
+				case DSGAVC_KEEP: break;
+				case DSGAVC_CLEAR: _sprite_group_resolve_check_veh_check = false; break;
+				case DSGAVC_CLEAR_UNLESS_ROAD: if (_sprite_group_resolve_check_veh_type != VEH_ROAD) _sprite_group_resolve_check_veh_check = false; break;
 			}
 
-			/* Note: 'last_value' and 'reseed' are shared between the main chain and the procedure */
-		} else if (adjust->variable == 0x7B) {
-			_sprite_group_resolve_check_veh_check = false;
-			value = GetVariable(object, scope, adjust->parameter, last_value, &available);
-		} else {
-			if (_sprite_group_resolve_check_veh_check) {
-				switch (adjust->variable) {
-					// whitelist of variables which can be checked without requiring an immediate re-check on the next tick
-					case 0xC:
-					case 0x1A:
-					case 0x1C:
-					case 0x25:
-					case 0x40:
-					case 0x41:
-					case 0x42:
-					case 0x47:
-					case 0x49:
-					case 0x4B:
-					case 0x4D:
-					case 0x60:
-					case 0x7D:
-					case 0x7F:
-					case 0x80 + 0x0:
-					case 0x80 + 0x1:
-					case 0x80 + 0x4:
-					case 0x80 + 0x5:
-					case 0x80 + 0x39:
-					case 0x80 + 0x3A:
-					case 0x80 + 0x3B:
-					case 0x80 + 0x3C:
-					case 0x80 + 0x3D:
-					case 0x80 + 0x44:
-					case 0x80 + 0x45:
-					case 0x80 + 0x46:
-					case 0x80 + 0x47:
-					case 0x80 + 0x5A:
-					case 0x80 + 0x72:
-					case 0x80 + 0x7A:
-						break;
-
-					case 0x80 + 0x62:
-						// RoadVehicle::state
-						if (_sprite_group_resolve_check_veh_type != VEH_ROAD) {
-							_sprite_group_resolve_check_veh_check = false;
-						}
-						break;
-
-					default:
-						_sprite_group_resolve_check_veh_check = false;
-						break;
+			/* Try to get the variable. We shall assume it is available, unless told otherwise. */
+			bool available = true;
+			switch (adjust->source) {
+				case DSGAS_CONSTANT:
+					/* Procedures with a constant result still leave their last value behind. */
+					if (adjust->variable == 0x7E) object.last_value = adjust->procedure_last_value;
+					value = adjust->value;
+					break;
+
+				case DSGAS_PROCEDURE: {
+					const SpriteGroup *subgroup = SpriteGroup::Resolve(adjust->subroutine, object, false);
+					if (subgroup == NULL) {
+						value = CALLBACK_FAILED;
+					} else {
+						value = subgroup->GetCallbackResult();
+					}
+					value = GetAdjustedValue(this->size, adjust, value);
+
+					/* Note: 'last_value' and 'reseed' are shared between the main chain and the procedure */
+					break;
 				}
+
+				case DSGAS_INDIRECT:
+					value = GetAdjustedValue(this->size, adjust, GetVariable(object, scope, adjust->parameter, last_value, &available));
+					break;
+
+				case DSGAS_VARIABLE:
+					value = GetAdjustedValue(this->size, adjust, GetVariable(object, scope, adjust->variable, adjust->parameter, &available));
+					break;
+
+				case DSGAS_SCOPE:
+					value = GetAdjustedValue(this->size, adjust, scope->GetVariable(adjust->variable, adjust->parameter, &available));
+					break;
 			}
-			value = GetVariable(object, scope, adjust->variable, adjust->parameter, &available);
-		}
 
-		if (!available) {
-			/* Unsupported variable: skip further processing and return either
-			 * the group from the first range or the default group. */
-			return SpriteGroup::Resolve(this->num_ranges > 0 ? this->ranges[0].group : this->default_group, object, false);
-		}
+			if (!available) {
+				/* Unsupported variable: skip further processing and return either
+				 * the group from the first range or the default group. */
+				return SpriteGroup::Resolve(this->num_ranges > 0 ? this->ranges[0].group : this->default_group, object, false);
+			}
 
-		switch (this->size) {
-			case DSG_SIZE_BYTE:  value = EvalAdjustT<uint8,  int8> (adjust, scope, last_value, value); break;
-			case DSG_SIZE_WORD:  value = EvalAdjustT<uint16, int16>(adjust, scope, last_value, value); break;
-			case DSG_SIZE_DWORD: value = EvalAdjustT<uint32, int32>(adjust, scope, last_value, value); break;
-			default: NOT_REACHED();
+			value = EvalAdjustOperation(this->size, adjust, scope, last_value, value);
+			last_value = value;
 		}
-		last_value = value;
 	}
 
 	object.last_value = last_value;
@@ -337,13 +537,7 @@ const SpriteGroup *DeterministicSpriteGroup::Resolve(ResolverObject &object) con
 		return &nvarzero;
 	}
 
-	for (i = 0; i < this->num_ranges; i++) {
-		if (this->ranges[i].low <= value && value <= this->ranges[i].high) {
-			return SpriteGroup::Resolve(this->ranges[i].group, object, false);
-		}
-	}
-
-	return SpriteGroup::Resolve(this->default_group, object, false);
+	return SpriteGroup::Resolve(this->GetGroupForValue(value), object, false);
 }
 
 
@@ -21,6 +21,8 @@
 #include "newgrf_storage.h"
 #include "newgrf_commons.h"
 
+#include <vector>
+
 /**
  * Gets the value of a so-called newgrf "register".
  * @param i index of the register
@@ -147,6 +149,22 @@ enum DeterministicSpriteGroupAdjustOperation {
 };
 
 
+/** How a var adjust gets its value, decided by #DeterministicSpriteGroup::Optimise. */
+enum DeterministicSpriteGroupAdjustSource {
+	DSGAS_VARIABLE,  ///< Any variable, through the variables common to all features.
+	DSGAS_SCOPE,     ///< A variable of the scope only, directly from the scope resolver.
+	DSGAS_INDIRECT,  ///< Variable 7B: the variable in \c parameter with the last value as parameter.
+	DSGAS_PROCEDURE, ///< Variable 7E: the callback result of a procedure.
+	DSGAS_CONSTANT,  ///< The adjusted value is always the same; variable 1A, or variable 7E with a procedure with a constant result.
+};
+
+/** Effect of a var adjust on #_sprite_group_resolve_check_veh_check. */
+enum DeterministicSpriteGroupAdjustVehCheck {
+	DSGAVC_KEEP,              ///< The variable can be checked without a re-check on the next tick.
+	DSGAVC_CLEAR,             ///< The variable requires a re-check on the next tick.
+	DSGAVC_CLEAR_UNLESS_ROAD, ///< The variable requires a re-check on the next tick, unless the vehicle is a road vehicle.
+};
+
 struct DeterministicSpriteGroupAdjust {
 	DeterministicSpriteGroupAdjustOperation operation;
 	DeterministicSpriteGroupAdjustType type;
@@ -157,6 +175,11 @@ struct DeterministicSpriteGroupAdjust {
 	uint32 add_val;
 	uint32 divmod_val;
 	const SpriteGroup *subroutine;
+
+	DeterministicSpriteGroupAdjustSource source;      ///< How the value is fetched.
+	DeterministicSpriteGroupAdjustVehCheck veh_check; ///< Effect of the variable on the vehicle sprite check.
+	uint32 value;                                     ///< The adjusted value of #DSGAS_CONSTANT.
+	uint32 procedure_last_value;                      ///< The last value left by the procedure of #DSGAS_CONSTANT with variable 7E.
 };
 
 
@@ -166,9 +189,15 @@ struct DeterministicSpriteGroupRange {
 	uint32 high;
 };
 
+/** Part of the values of a #DeterministicSpriteGroup which all give the same group, lasting until the next segment. */
+struct DeterministicSpriteGroupSegment {
+	uint32 low;               ///< First value of the segment.
+	const SpriteGroup *group; ///< Group of the values in the segment.
+};
+
 
 struct DeterministicSpriteGroup : SpriteGroup {
-	DeterministicSpriteGroup() : SpriteGroup(SGT_DETERMINISTIC) {}
+	DeterministicSpriteGroup() : SpriteGroup(SGT_DETERMINISTIC), first_adjust(0), calculated_value(0) {}
 	~DeterministicSpriteGroup();
 
 	VarSpriteGroupScope var_scope;
@@ -181,8 +210,18 @@ struct DeterministicSpriteGroup : SpriteGroup {
 	/* Dynamically allocated, this is the sole owner */
 	const SpriteGroup *default_group;
 
+	uint first_adjust;                                     ///< First var adjust which is evaluated; the ones before are folded into #calculated_value.
+	uint32 calculated_value;                               ///< Value of the var adjusts before #first_adjust.
+	std::vector<DeterministicSpriteGroupSegment> segments; ///< The ranges and the default group, as sorted segments.
+
+	void Optimise();
+
 protected:
 	const SpriteGroup *Resolve(ResolverObject &object) const;
+
+private:
+	const SpriteGroup *GetGroupForValue(uint32 value) const;
+	bool GetConstantProcedureResult(uint16 *result, uint32 *last_value) const;
 };
 
 enum RandomizedSpriteGroupCompareMode {
@@ -319,6 +358,7 @@ struct ResolverObject {
 	uint32 waiting_triggers;    ///< Waiting triggers to be used by any rerandomisation. (scope independent)
 	uint32 used_triggers;       ///< Subset of cur_triggers, which actually triggered some rerandomisation. (scope independent)
 	uint32 reseed[VSG_END];     ///< Collects bits to rerandomise while triggering triggers.
+	bool psa_stored;            ///< Whether a value was stored into persistent storage while resolving.
 
 	const GRFFile *grffile;     ///< GRFFile the resolved SpriteGroup belongs to
 	const SpriteGroup *root_spritegroup; ///< Root SpriteGroup to use for resolving
@@ -378,6 +418,7 @@ struct ResolverObject {
 		this->waiting_triggers = 0;
 		this->used_triggers = 0;
 		memset(this->reseed, 0, sizeof(this->reseed));
+		this->psa_stored = false;
 	}
 };
 
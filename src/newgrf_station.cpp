@@ -25,6 +25,7 @@
 #include "tunnelbridge_map.h"
 #include "newgrf_animation_base.h"
 #include "newgrf_class_func.h"
+#include "newgrf_callback_cache.h"
 
 #include "safeguards.h"
 
@@ -635,8 +636,19 @@ SpriteID GetCustomStationFoundationRelocation(const StationSpec *statspec, BaseS
 
 uint16 GetStationCallback(CallbackID callback, uint32 param1, uint32 param2, const StationSpec *statspec, BaseStation *st, TileIndex tile)
 {
+	if (!UseNewGRFCallbackCache(GSF_STATIONS, callback)) {
+		StationResolverObject object(statspec, st, tile, callback, param1, param2);
+		return object.ResolveCallback();
+	}
+
+	NewGRFCallbackCacheKey key(GSF_STATIONS, callback, param1, param2, statspec, tile, st != NULL ? st->index : INVALID_STATION);
+	uint16 result;
+	if (LookupNewGRFCallbackCache(key, &result)) return result;
+
 	StationResolverObject object(statspec, st, tile, callback, param1, param2);
-	return object.ResolveCallback();
+	result = object.ResolveCallback();
+	StoreNewGRFCallbackCache(key, object, result);
+	return result;
 }
 
 /**
@@ -1025,6 +1037,7 @@ void TriggerStationRandomisation(Station *st, TileIndex tile, StationRandomTrigg
 					random_bits &= ~reseed;
 					random_bits |= Random() & reseed;
 					SetStationTileRandomBits(tile, random_bits);
+					InvalidateNewGRFCallbackCache();
 
 					MarkTileDirtyByTile(tile, ZOOM_LVL_DRAW_MAP);
 				}
@@ -1037,6 +1050,7 @@ void TriggerStationRandomisation(Station *st, TileIndex tile, StationRandomTrigg
 	if ((whole_reseed & 0xFFFF) != 0) {
 		st->random_bits &= ~whole_reseed;
 		st->random_bits |= Random() & whole_reseed;
+		InvalidateNewGRFCallbackCache();
 	}
 }
 
@@ -640,6 +640,57 @@ GRFText *DuplicateGRFText(GRFText *orig)
 	return newtext;
 }
 
+/** Maximum length of a text read by #LoadGRFTextList; anything longer is a corrupt file. */
+static const uint32 MAX_SAVED_GRFTEXT_LENGTH = 1 << 20;
+
+/**
+ * Write a GRFText list, including the translated texts, to a file.
+ * @param f The file to write to.
+ * @param list The GRFText list to write.
+ * @return Whether all was written.
+ */
+bool SaveGRFTextList(FILE *f, const GRFText *list)
+{
+	uint32 count = 0;
+	for (const GRFText *text = list; text != NULL; text = text->next) count++;
+	if (fwrite(&count, sizeof(count), 1, f) != 1) return false;
+
+	for (const GRFText *text = list; text != NULL; text = text->next) {
+		uint32 len = (uint32)text->len;
+		if (fwrite(&text->langid, sizeof(text->langid), 1, f) != 1 ||
+				fwrite(&len, sizeof(len), 1, f) != 1 ||
+				fwrite(text->text, 1, len, f) != len) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Read a GRFText list written by #SaveGRFTextList.
+ * @param f The file to read from.
+ * @param[out] list The list to add the read texts to.
+ * @return Whether the list was read completely.
+ */
+bool LoadGRFTextList(FILE *f, GRFText **list)
+{
+	uint32 count;
+	if (fread(&count, sizeof(count), 1, f) != 1) return false;
+
+	for (; count > 0; count--) {
+		byte langid;
+		uint32 len;
+		if (fread(&langid, sizeof(langid), 1, f) != 1 || fread(&len, sizeof(len), 1, f) != 1 || len > MAX_SAVED_GRFTEXT_LENGTH) return false;
+
+		char *buffer = MallocT<char>(len);
+		bool ok = fread(buffer, 1, len, f) == len;
+		if (ok) AddGRFTextToList(list, GRFText::New(langid, buffer, len));
+		free(buffer);
+		if (!ok) return false;
+	}
+	return true;
+}
+
 /**
  * Add the new read string into our structure.
  */
@@ -32,6 +32,8 @@ void AddGRFTextToList(struct GRFText **list, struct GRFText *text_to_add);
 void AddGRFTextToList(struct GRFText **list, byte langid, uint32 grfid, bool allow_newlines, const char *text_to_add);
 void AddGRFTextToList(struct GRFText **list, const char *text_to_add);
 void CleanUpGRFText(struct GRFText *grftext);
+bool SaveGRFTextList(FILE *f, const struct GRFText *list);
+bool LoadGRFTextList(FILE *f, struct GRFText **list);
 
 bool CheckGrfLangID(byte lang_id, byte grf_version);
 
@@ -74,6 +74,9 @@
 
 #include "linkgraph/linkgraphschedule.h"
 #include "tracerestrict.h"
+#include "framerate_type.h"
+#include "benchmark.h"
+#include "thread/thread_pool.h"
 
 #include <stdarg.h>
 
@@ -205,6 +208,7 @@ static void ShowHelp()
 		"  -c config_file      = Use 'config_file' instead of 'openttd.cfg'\n"
 		"  -x                  = Do not automatically save to config file on exit\n"
 		"  -q savegame         = Write some information about the savegame and exit\n"
+		"  -B ticks[:report]   = Benchmark the game (-g) for the given number of ticks and exit\n"
 		"\n",
 		lastof(buf)
 	);
@@ -575,6 +579,7 @@ static const OptionData _options[] = {
 	 GETOPT_SHORT_VALUE('q'),
 	 GETOPT_SHORT_NOVAL('h'),
 	 GETOPT_SHORT_VALUE('J'),
+	 GETOPT_SHORT_VALUE('B'),
 	GETOPT_END()
 };
 
@@ -724,6 +729,21 @@ int openttd_main(int argc, char *argv[])
 		case 'c': free(_config_file); _config_file = stredup(mgo.opt); break;
 		case 'x': scanner->save_config = false; break;
 		case 'J': _quit_after_days = Clamp(atoi(mgo.opt), 0, INT_MAX); break;
+		case 'B':
+			if (!ParseBenchmarkOption(mgo.opt)) {
+				fprintf(stderr, "Invalid benchmark specification '%s', expected ticks[:report_file]\n", mgo.opt);
+				ret = 1;
+				goto exit_noshutdown;
+			}
+			free(musicdriver);
+			free(sounddriver);
+			free(videodriver);
+			free(blitter);
+			musicdriver = stredup("null");
+			sounddriver = stredup("null");
+			videodriver = stredup("null");
+			blitter = stredup("null");
+			break;
 		case 'h':
 			i = -2; // Force printing of help.
 			break;
@@ -952,6 +972,9 @@ exit_bootstrap:
 	free(sounddriver);
 
 exit_normal:
+	/* Join the workers now, instead of during static destruction after returning. */
+	ThreadPool::StopAll();
+
 	free(BaseGraphics::ini_set);
 	free(BaseSounds::ini_set);
 	free(BaseMusic::ini_set);
@@ -1523,6 +1546,7 @@ void StateGameLoop()
 
 	/* don't execute the state loop during pause */
 	if (_pause_mode != PM_UNPAUSED) {
+		PerformanceMeasurer::Paused(PFE_GAMELOOP);
 		UpdateLandscapingLimits();
 #ifndef DEBUG_DUMP_COMMANDS
 		Game::GameLoop();
@@ -1532,6 +1556,8 @@ void StateGameLoop()
 	}
 	if (HasModalProgress()) return;
 
+	PerformanceMeasurer framerate(PFE_GAMELOOP);
+
 	Layouter::ReduceLineCache();
 
 	if (_game_mode == GM_EDITOR) {
@@ -1576,8 +1602,11 @@ void StateGameLoop()
 		BasePersistentStorageArray::SwitchMode(PSM_LEAVE_GAMELOOP);
 
 #ifndef DEBUG_DUMP_COMMANDS
-		AI::GameLoop();
-		Game::GameLoop();
+		{
+			PerformanceMeasurer framerate(PFE_ALLSCRIPTS);
+			AI::GameLoop();
+			Game::GameLoop();
+		}
 #endif
 		UpdateLandscapingLimits();
 
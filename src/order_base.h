@@ -503,6 +503,7 @@ struct OrderList : OrderListPool::PoolItem<&_orderlist_pool> {
 private:
 	friend void AfterLoadVehicles(bool part_of_load); ///< For instantiating the shared vehicle chain
 	friend const struct SaveLoad *GetOrderListDescription(); ///< Saving and loading of order lists.
+	friend void RebuildOrderListDestinationIndex(); ///< For resetting the destination index after changes in place.
 
 	StationID GetBestLoadableNext(const Vehicle *v, const Order *o1, const Order *o2) const;
 
@@ -523,6 +524,10 @@ private:
 	int32 scheduled_dispatch_last_dispatch;    ///< Last vehicle dispatched offset
 	int32 scheduled_dispatch_max_delay;        ///< Maximum allowed delay
 
+	std::vector<uint32> destination_keys;      ///< NOSAVE: Sorted keys of the destinations of this list in the destination index.
+
+	void RemoveFromDestinationIndex();
+
 public:
 	/** Default constructor producing an invalid order list. */
 	OrderList(VehicleOrderID num_orders = INVALID_VEH_ORDER_ID)
@@ -539,9 +544,15 @@ public:
 	OrderList(Order *chain, Vehicle *v) { this->Initialize(chain, v); }
 
 	/** Destructor. Invalidates OrderList for re-usage by the pool. */
-	~OrderList() {}
+	~OrderList()
+	{
+		if (!CleaningPool()) this->RemoveFromDestinationIndex();
+	}
+
+	static void PreCleanPool();
 
 	void Initialize(Order *chain, Vehicle *v);
+	void UpdateDestinationIndex();
 
 	/**
 	 * Get the first order of the order chain.
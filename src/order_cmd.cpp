@@ -38,9 +38,12 @@
 #include "viewport_func.h"
 #include "order_cmd.h"
 #include "vehiclelist.h"
+#include "3rdparty/cpp-btree/btree_set.h"
 
 #include "table/strings.h"
 
+#include <algorithm>
+
 #include "safeguards.h"
 
 /* DestinationID must be at least as large as every these below, because it can
@@ -54,6 +57,38 @@ INSTANTIATE_POOL_METHODS(Order)
 OrderListPool _orderlist_pool("OrderList");
 INSTANTIATE_POOL_METHODS(OrderList)
 
+/**
+ * Index of the order lists by the destinations of their orders, as pairs of destination key and order list.
+ * Station and waypoint keys are the StationID, depot keys have bit 16 set as well.
+ * @see GetOrderDestinationKey
+ */
+static btree::btree_set<std::pair<uint32, OrderListID>> _order_destination_index;
+
+/** Key for orders without a destination in #_order_destination_index. */
+static const uint32 INVALID_ORDER_DESTINATION_KEY = UINT32_MAX;
+
+/**
+ * Get the key of the destination of an order in #_order_destination_index.
+ * @param o The order.
+ * @return The key, or #INVALID_ORDER_DESTINATION_KEY if the order has no fixed destination.
+ */
+static uint32 GetOrderDestinationKey(const Order *o)
+{
+	switch (o->GetType()) {
+		case OT_GOTO_STATION:
+		case OT_GOTO_WAYPOINT:
+		case OT_IMPLICIT:
+			return o->GetDestination();
+
+		case OT_GOTO_DEPOT:
+			if (o->GetDepotActionType() & ODATFB_NEAREST_DEPOT) return INVALID_ORDER_DESTINATION_KEY;
+			return (1 << 16) | o->GetDestination();
+
+		default:
+			return INVALID_ORDER_DESTINATION_KEY;
+	}
+}
+
 /** Clean everything up. */
 Order::~Order()
 {
@@ -387,6 +422,70 @@ void OrderList::Initialize(Order *chain, Vehicle *v)
 	}
 
 	for (const Vehicle *u = v->NextShared(); u != NULL; u = u->NextShared()) ++this->num_vehicles;
+
+	this->UpdateDestinationIndex();
+}
+
+/**
+ * Update the entries of this list in the destination index after its orders were changed.
+ */
+void OrderList::UpdateDestinationIndex()
+{
+	std::vector<uint32> keys;
+	for (const Order *o = this->first; o != NULL; o = o->next) {
+		uint32 key = GetOrderDestinationKey(o);
+		if (key != INVALID_ORDER_DESTINATION_KEY) keys.push_back(key);
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	if (keys == this->destination_keys) return;
+
+	this->RemoveFromDestinationIndex();
+	for (uint32 key : keys) _order_destination_index.insert(std::make_pair(key, this->index));
+	this->destination_keys = std::move(keys);
+}
+
+/**
+ * Remove all entries of this list from the destination index.
+ */
+void OrderList::RemoveFromDestinationIndex()
+{
+	for (uint32 key : this->destination_keys) _order_destination_index.erase(std::make_pair(key, this->index));
+	this->destination_keys.clear();
+}
+
+/* static */ void OrderList::PreCleanPool()
+{
+	_order_destination_index.clear();
+}
+
+/**
+ * Get the order lists which have an order to a destination.
+ * Orders to the nearest depot do not count; implicit orders do.
+ * @param[out] lists The order lists, ordered by their index.
+ * @param destination The station, waypoint or depot.
+ * @param depot Whether to look for depot orders instead of station and waypoint orders.
+ */
+void GetOrderListsWithDestination(std::vector<const OrderList *> &lists, DestinationID destination, bool depot)
+{
+	uint32 key = (depot ? (1 << 16) : 0) | destination;
+	for (auto it = _order_destination_index.lower_bound(std::make_pair(key, (OrderListID)0)); it != _order_destination_index.end() && it->first == key; ++it) {
+		lists.push_back(OrderList::Get(it->second));
+	}
+}
+
+/**
+ * Rebuild the destination index of all order lists, after their orders were changed in place, e.g. by loading a game.
+ */
+void RebuildOrderListDestinationIndex()
+{
+	_order_destination_index.clear();
+
+	OrderList *list;
+	FOR_ALL_ORDER_LISTS(list) {
+		list->destination_keys.clear();
+		list->UpdateDestinationIndex();
+	}
 }
 
 /**
@@ -407,6 +506,7 @@ void OrderList::FreeChain(bool keep_orderlist)
 		this->num_orders = 0;
 		this->num_manual_orders = 0;
 		this->timetable_duration = 0;
+		this->RemoveFromDestinationIndex();
 	} else {
 		delete this;
 	}
@@ -612,6 +712,7 @@ void OrderList::InsertOrderAt(Order *new_order, int index)
 		if (bs->owner == OWNER_NONE) InvalidateWindowClassesData(WC_STATION_LIST, 0);
 	}
 
+	this->UpdateDestinationIndex();
 }
 
 
@@ -640,6 +741,8 @@ void OrderList::DeleteOrderAt(int index)
 		this->total_duration -= (to_remove->GetWaitTime() + to_remove->GetTravelTime());
 	}
 	delete to_remove;
+
+	this->UpdateDestinationIndex();
 }
 
 /**
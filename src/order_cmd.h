@@ -61,6 +61,8 @@ restart:
 			}
 		}
 	}
+
+	if (v->orders.list != NULL) v->orders.list->UpdateDestinationIndex();
 }
 
 #endif /* ORDER_CMD_H */
@@ -15,9 +15,12 @@
 #include "order_type.h"
 #include "vehicle_type.h"
 #include "company_type.h"
+#include <vector>
 
 /* Functions */
 void RemoveOrderFromAllVehicles(OrderType type, DestinationID destination);
+void GetOrderListsWithDestination(std::vector<const OrderList *> &lists, DestinationID destination, bool depot);
+void RebuildOrderListDestinationIndex();
 void InvalidateVehicleOrder(const Vehicle *v, int data);
 void CheckOrders(const Vehicle*);
 void DeleteVehicleOrders(Vehicle *v, bool keep_orderlist = false, bool reset_order_indices = true);
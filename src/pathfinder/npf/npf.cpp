@@ -288,7 +288,8 @@ static void NPFMarkTile(TileIndex tile)
 			break;
 
 		case MP_ROAD:
-			if (!IsRoadDepot(tile)) {
+			/* Leave road works alone, ending them would change the road layout. */
+			if (!IsRoadDepot(tile) && !HasRoadWorks(tile)) {
 				SetRoadside(tile, ROADSIDE_BARREN);
 				MarkTileDirtyByTile(tile, ZOOM_LVL_DRAW_MAP);
 			}
@@ -13,6 +13,7 @@
 #define PF_PERFORMANCE_TIMER_HPP
 
 #include "../debug.h"
+#include <chrono>
 
 struct CPerformanceTimer
 {
@@ -38,12 +39,12 @@ struct CPerformanceTimer
 
 	inline int64 QueryTime()
 	{
-		return ottd_rdtsc();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 	}
 
 	inline int64 QueryFrequency()
 	{
-		return ((int64)2200 * 1000000);
+		return (int64)1000000000;
 	}
 };
 
@@ -77,6 +78,16 @@ struct CPerfStartFake
 	inline void Stop() {}
 };
 
+/** Performance timer which is only running when the detailed timings are going to be shown. */
+struct CPerfStartDebug : CPerfStartReal
+{
+	inline CPerfStartDebug(CPerformanceTimer *perf) : CPerfStartReal(_debug_yapf_level >= 3 ? perf : NULL) {}
+};
+
+#ifdef NO_DEBUG_MESSAGES
 typedef CPerfStartFake CPerfStart;
+#else
+typedef CPerfStartDebug CPerfStart;
+#endif /* NO_DEBUG_MESSAGES */
 
 #endif /* PF_PERFORMANCE_TIMER_HPP */
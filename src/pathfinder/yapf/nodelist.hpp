@@ -15,11 +15,21 @@
 #include "../../misc/array.hpp"
 #include "../../misc/hashtable.hpp"
 #include "../../misc/binaryheap.hpp"
+#include <atomic>
+
+extern std::atomic<uint> _yapf_nodelist_allocs; ///< Number of node list storages allocated.
+extern std::atomic<uint> _yapf_nodelist_reuses; ///< Number of node lists which reused the storage of a previous search.
 
 /**
  * Hash table based node list multi-container class.
  *  Implements open list, closed list and priority queue for A-star
  *  path finder.
+ *  The containers are not owned by the node list: they are taken from a
+ *  per-thread free list and returned to it (emptied, but still allocated)
+ *  when the node list is destroyed, so successive searches do not allocate.
+ *  A node list destroyed by another thread than the one which created it
+ *  returns the storage to the free list of the destroying thread, so the
+ *  free lists are limited in size.
  */
 template <class Titem_, int Thash_bits_open_, int Thash_bits_closed_>
 class CNodeList_HashTableT {
@@ -32,22 +42,94 @@ public:
 	typedef CBinaryHeapT<Titem_> CPriorityQueue;                 ///< How the priority queue will be managed.
 
 protected:
-	CItemArray      m_arr;        ///< Here we store full item data (Titem_).
-	COpenList       m_open;       ///< Hash table of pointers to open item data.
-	CClosedList     m_closed;     ///< Hash table of pointers to closed item data.
-	CPriorityQueue  m_open_queue; ///< Priority queue of pointers to open item data.
+	/** The containers of a node list. */
+	struct Storage {
+		CItemArray      arr;        ///< Full item data.
+		COpenList       open;       ///< Hash table of pointers to open item data.
+		CClosedList     closed;     ///< Hash table of pointers to closed item data.
+		CPriorityQueue  open_queue; ///< Priority queue of pointers to open item data.
+		Storage        *next;       ///< Next storage in the free list.
+
+		Storage() : open_queue(2048), next(NULL) {}
+
+		/** Forget all items, keeping the allocated memory. */
+		void Reset()
+		{
+			arr.Reset();
+			open.Clear();
+			closed.Clear();
+			open_queue.Clear();
+		}
+	};
+
+	static const uint MAX_FREE_STORAGES = 8; ///< Maximum number of unused storages kept by a thread.
+
+	/** Unused storages of a thread, freed when the thread exits. */
+	struct StorageFreeList {
+		Storage *first; ///< First unused storage.
+		uint count;     ///< Number of unused storages.
+
+		StorageFreeList() : first(NULL), count(0) {}
+
+		~StorageFreeList()
+		{
+			while (first != NULL) {
+				Storage *s = first;
+				first = s->next;
+				delete s;
+			}
+		}
+	};
+
+	/** Get the free list of storages of the current thread. */
+	static StorageFreeList &GetFreeList()
+	{
+		static thread_local StorageFreeList list;
+		return list;
+	}
+
+	/** Take a storage from the free list of the current thread, or allocate one when it is empty. */
+	static Storage *AcquireStorage()
+	{
+		StorageFreeList &list = GetFreeList();
+		Storage *s = list.first;
+		if (s == NULL) {
+			_yapf_nodelist_allocs++;
+			return new Storage();
+		}
+		_yapf_nodelist_reuses++;
+		list.first = s->next;
+		list.count--;
+		s->next = NULL;
+		return s;
+	}
+
+	Storage        *m_storage;    ///< The containers used by this node list.
+	CItemArray     &m_arr;        ///< Here we store full item data (Titem_).
+	COpenList      &m_open;       ///< Hash table of pointers to open item data.
+	CClosedList    &m_closed;     ///< Hash table of pointers to closed item data.
+	CPriorityQueue &m_open_queue; ///< Priority queue of pointers to open item data.
 	Titem          *m_new_node;   ///< New open node under construction.
 
 public:
 	/** default constructor */
-	CNodeList_HashTableT() : m_open_queue(2048)
+	CNodeList_HashTableT() : m_storage(AcquireStorage()), m_arr(m_storage->arr), m_open(m_storage->open),
+			m_closed(m_storage->closed), m_open_queue(m_storage->open_queue), m_new_node(NULL)
 	{
-		m_new_node = NULL;
 	}
 
-	/** destructor */
+	/** destructor - return the emptied storage to the free list */
 	~CNodeList_HashTableT()
 	{
+		StorageFreeList &list = GetFreeList();
+		if (list.count >= MAX_FREE_STORAGES) {
+			delete m_storage;
+			return;
+		}
+		m_storage->Reset();
+		m_storage->next = list.first;
+		list.first = m_storage;
+		list.count++;
 	}
 
 	/** return number of open nodes */
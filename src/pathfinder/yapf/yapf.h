@@ -16,6 +16,7 @@
 #include "../../track_type.h"
 #include "../../vehicle_type.h"
 #include "../pathfinder_type.h"
+#include <vector>
 
 /**
  * Finds the best path for given ship using YAPF.
@@ -97,4 +98,25 @@ bool YapfTrainCheckReverse(const Train *v);
  */
 bool YapfTrainFindNearestSafeTile(const Train *v, TileIndex tile, Trackdir td, bool override_railtype);
 
+/** A train whose path is searched in advance by #YapfTrainPredictPaths. */
+struct YapfTrainPathRequest {
+	const Train *v;     ///< The train.
+	TileIndex tile;     ///< Last tile of the reserved path the train is expected to have when it chooses its track.
+	Trackdir trackdir;  ///< Last trackdir of that reserved path.
+};
+
+/**
+ * Search the paths of trains which are expected to choose a track during this tick, on worker threads.
+ * The game state must not change while this runs. The results are used by #YapfTrainChooseTrack
+ * when the train indeed chooses its track from the given origin and still has the same destination,
+ * until #YapfTrainFinishPredictions is called.
+ * @param requests The trains and the ends of their reservations, sorted by vehicle index.
+ */
+void YapfTrainPredictPaths(const std::vector<YapfTrainPathRequest> &requests);
+
+/**
+ * Drop the unused results of #YapfTrainPredictPaths.
+ */
+void YapfTrainFinishPredictions();
+
 #endif /* YAPF_H */
@@ -14,8 +14,12 @@
 
 #include "../../debug.h"
 #include "../../settings_type.h"
+#include <atomic>
 
-extern int _total_pf_time_us;
+extern std::atomic<int> _total_pf_time_us;
+extern uint _yapf_train_predictions_made;      ///< Number of train paths searched in advance, see YapfTrainPredictPaths.
+extern uint _yapf_train_predictions_used;      ///< Number of train paths searched in advance which were used.
+extern uint _yapf_train_predictions_conflicts; ///< Number of train paths searched in advance which could not be reserved anymore.
 
 /**
  * CYapfBaseT - A-star type path finder base class.
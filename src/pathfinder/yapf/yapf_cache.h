@@ -16,9 +16,17 @@
 
 /**
  * Use this function to notify YAPF that track layout (or signal configuration) has change.
- * @param tile  the tile that is changed
+ * Every tile whose tracks change has to be notified, as only the cached segments near it are invalidated.
+ * @param tile  the tile that is changed, or INVALID_TILE to invalidate all cached segments
  * @param track what piece of track is changed
  */
 void YapfNotifyTrackLayoutChange(TileIndex tile, Track track);
 
+/**
+ * Use this function to notify YAPF that the road layout of a tile, or anything else road vehicles' path costs depend on, has changed.
+ * Every tile whose roads change has to be notified, as only the cached segments near it are invalidated.
+ * @param tile the tile that is changed, or INVALID_TILE to invalidate all cached segments
+ */
+void YapfNotifyRoadLayoutChange(TileIndex tile);
+
 #endif /* YAPF_CACHE_H */
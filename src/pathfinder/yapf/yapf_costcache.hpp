@@ -13,6 +13,9 @@
 #define YAPF_COSTCACHE_HPP
 
 #include "../../date_func.h"
+#include "../../transport_type.h"
+#include <unordered_map>
+#include <vector>
 
 /**
  * CYapfSegmentCostCacheNoneT - the formal only yapf cost cache provider that implements
@@ -89,23 +92,69 @@ public:
 	inline void PfNodeCacheFlush(Node &n)
 	{
 	}
+
+	/**
+	 * Called by the cost calculation for the tiles the cost of a segment depends on.
+	 *  Local segments are never reused, so this does nothing.
+	 */
+	inline void PfNodeCacheAddTiles(Node &n, TileIndex from, TileIndex to)
+	{
+	}
 };
 
 
 /**
- * Base class for segment cost cache providers. Contains global counter
- *  of track layout changes and static notification function called whenever
- *  the track layout changes. It is implemented as base class because it needs
- *  to be shared between all rail YAPF types (one shared counter, one notification
- *  function.
+ * Base class for segment cost caches. Contains the list of all caches and the static
+ *  notification function called whenever the track or road layout changes. It is implemented
+ *  as base class because it needs to be shared between all YAPF types (one list
+ *  of caches, one notification function).
+ *  The changed tiles are only queued here, they are processed by the cache itself when
+ *  the next path finder using it is created, so no segment is invalidated while a
+ *  path finder might still be using it.
  */
 struct CSegmentCostCacheBase
 {
-	static int   s_rail_change_counter;
+	static const uint MAX_CHANGED_TILES = 4096; ///< Maximum number of queued changed tiles of a cache; when there are more it is flushed completely.
+	static const uint BLOCK_SHIFT = 3;          ///< Log2 of the width and height of the blocks of tiles the segments are registered in.
 
-	static void NotifyTrackLayoutChange(TileIndex tile, Track track)
+	static std::vector<CSegmentCostCacheBase *> s_caches; ///< All segment cost caches.
+
+	TransportType m_transport;              ///< Transport type of the segments in the cache.
+	std::vector<TileIndex> m_changed_tiles; ///< Tiles whose layout changed since the last update of the cache.
+	bool m_flush_pending;                   ///< Whether the whole cache has to be flushed at the next update.
+
+	inline CSegmentCostCacheBase(TransportType transport) : m_transport(transport), m_flush_pending(false)
 	{
-		s_rail_change_counter++;
+		s_caches.push_back(this);
+	}
+
+	/**
+	 * Get the block of tiles a tile is part of.
+	 * @param x X coordinate of the tile.
+	 * @param y Y coordinate of the tile.
+	 * @return Identifier of the block.
+	 */
+	static inline uint32 GetBlock(uint x, uint y)
+	{
+		return (y >> BLOCK_SHIFT) << 16 | (x >> BLOCK_SHIFT);
+	}
+
+	/**
+	 * Invalidate the cached segments touching a tile, or all of them.
+	 * @param tile The tile whose layout changed, INVALID_TILE to flush the caches completely.
+	 * @param transport The transport type whose layout changed, only the caches of this type are affected.
+	 */
+	static void NotifyLayoutChange(TileIndex tile, TransportType transport)
+	{
+		for (CSegmentCostCacheBase *cache : s_caches) {
+			if (cache->m_transport != transport || cache->m_flush_pending) continue;
+			if (tile == INVALID_TILE || cache->m_changed_tiles.size() >= MAX_CHANGED_TILES) {
+				cache->m_flush_pending = true;
+				cache->m_changed_tiles.clear();
+			} else {
+				cache->m_changed_tiles.push_back(tile);
+			}
+		}
 	}
 };
 
@@ -118,7 +167,13 @@ struct CSegmentCostCacheBase
  *  be always the same (TileIndex + DiagDirection) that represent the beginning
  *  of the segment (origin tile and exit-dir from this tile).
  *  Different CYapfCachedCostT types can share the same type of CSegmentCostCacheT.
- *  Look at CYapfRailSegment (yapf_node_rail.hpp) for the segment example
+ *  Look at CYapfRailSegment (yapf_node_rail.hpp) for the segment example.
+ *  The segment type also defines the transport type of the cache.
+ *
+ *  Each segment is registered in the blocks of tiles its cost depends on. When the
+ *  layout of a tile changes only the segments registered in its block are
+ *  removed from the hash-map. Their storage is only reclaimed by flushing the whole
+ *  cache, which happens when more than half of the heap is taken by removed segments.
  */
 template <class Tsegment>
 struct CSegmentCostCacheT : public CSegmentCostCacheBase {
@@ -127,17 +182,74 @@ struct CSegmentCostCacheT : public CSegmentCostCacheBase {
 	typedef CHashTableT<Tsegment, C_HASH_BITS> HashTable;
 	typedef SmallArray<Tsegment> Heap;
 	typedef typename Tsegment::Key Key;    ///< key to hash table
+	typedef std::unordered_map<uint32, std::vector<Tsegment *>> BlockMap;
 
 	HashTable    m_map;
 	Heap         m_heap;
+	BlockMap     m_blocks;       ///< Segments registered in each block of tiles, may contain removed segments.
+	uint         m_removed;      ///< Number of removed segments still in the heap.
+
+	uint         m_stat_hits;    ///< Number of segments found in the cache.
+	uint         m_stat_misses;  ///< Number of segments not found in the cache.
+	uint         m_stat_removed; ///< Number of segments removed due to layout changes.
+	uint         m_stat_flushes; ///< Number of times the whole cache was flushed.
 
-	inline CSegmentCostCacheT() {}
+	inline CSegmentCostCacheT() : CSegmentCostCacheBase(Tsegment::TRANSPORT_TYPE), m_removed(0), m_stat_hits(0), m_stat_misses(0), m_stat_removed(0), m_stat_flushes(0) {}
 
 	/** flush (clear) the cache */
 	inline void Flush()
 	{
 		m_map.Clear();
 		m_heap.Clear();
+		m_blocks.clear();
+		m_removed = 0;
+		m_stat_flushes++;
+	}
+
+	/** Process the layout changes since the last call. */
+	inline void Update()
+	{
+		if (m_flush_pending) {
+			m_flush_pending = false;
+			Flush();
+			return;
+		}
+
+		for (TileIndex tile : m_changed_tiles) {
+			typename BlockMap::iterator it = m_blocks.find(GetBlock(TileX(tile), TileY(tile)));
+			if (it == m_blocks.end()) continue;
+			for (Tsegment *segment : it->second) {
+				/* The segment might have been removed already via another block. */
+				if (m_map.TryPop(*segment)) {
+					m_removed++;
+					m_stat_removed++;
+				}
+			}
+			m_blocks.erase(it);
+		}
+		m_changed_tiles.clear();
+
+		if (m_removed > 1024 && m_removed > (uint)m_map.Count()) Flush();
+	}
+
+	/**
+	 * Register a segment in the blocks of tiles it depends on.
+	 * @param segment The segment.
+	 * @param from First tile of a straight line of tiles the segment depends on.
+	 * @param to Last tile of the line.
+	 */
+	inline void AddTiles(Tsegment &segment, TileIndex from, TileIndex to)
+	{
+		uint x1 = TileX(from) >> BLOCK_SHIFT, x2 = TileX(to) >> BLOCK_SHIFT;
+		uint y1 = TileY(from) >> BLOCK_SHIFT, y2 = TileY(to) >> BLOCK_SHIFT;
+		if (x1 > x2) Swap(x1, x2);
+		if (y1 > y2) Swap(y1, y2);
+		for (uint y = y1; y <= y2; y++) {
+			for (uint x = x1; x <= x2; x++) {
+				std::vector<Tsegment *> &list = m_blocks[GetBlock(x << BLOCK_SHIFT, y << BLOCK_SHIFT)];
+				if (list.empty() || list.back() != &segment) list.push_back(&segment);
+			}
+		}
 	}
 
 	inline Tsegment& Get(Key &key, bool *found)
@@ -147,8 +259,10 @@ struct CSegmentCostCacheT : public CSegmentCostCacheBase {
 			*found = false;
 			item = new (m_heap.Append()) Tsegment(key);
 			m_map.Push(*item);
+			m_stat_misses++;
 		} else {
 			*found = true;
+			m_stat_hits++;
 		}
 		return *item;
 	}
@@ -183,7 +297,6 @@ protected:
 
 	inline static Cache& stGetGlobalCache()
 	{
-		static int last_rail_change_counter = 0;
 		static Date last_date = 0;
 		static Cache C;
 
@@ -191,14 +304,18 @@ protected:
 		if (last_date != _date) {
 			last_date = _date;
 			DEBUG(yapf, 2, "Pf time today: %5d ms", _total_pf_time_us / 1000);
+			DEBUG(yapf, 2, "Segment cache today: %u hits, %u misses, %u segments invalidated, %u flushes, %d cached",
+					C.m_stat_hits, C.m_stat_misses, C.m_stat_removed, C.m_stat_flushes, C.m_map.Count());
+			DEBUG(yapf, 2, "Node lists today: %u allocated, %u reused", _yapf_nodelist_allocs.load(), _yapf_nodelist_reuses.load());
+			DEBUG(yapf, 2, "Train path predictions today: %u made, %u used, %u conflicts", _yapf_train_predictions_made, _yapf_train_predictions_used, _yapf_train_predictions_conflicts);
 			_total_pf_time_us = 0;
+			_yapf_nodelist_allocs = _yapf_nodelist_reuses = 0;
+			_yapf_train_predictions_made = _yapf_train_predictions_used = _yapf_train_predictions_conflicts = 0;
+			C.m_stat_hits = C.m_stat_misses = C.m_stat_removed = C.m_stat_flushes = 0;
 		}
 
-		/* delete the cache sometimes... */
-		if (last_rail_change_counter != Cache::s_rail_change_counter) {
-			last_rail_change_counter = Cache::s_rail_change_counter;
-			C.Flush();
-		}
+		/* remove the segments affected by layout changes */
+		C.Update();
 		return C;
 	}
 
@@ -226,6 +343,18 @@ public:
 	inline void PfNodeCacheFlush(Node &n)
 	{
 	}
+
+	/**
+	 * Called by the cost calculation for the tiles the cost of a segment depends on,
+	 *  so that the segment is invalidated when the layout of these tiles changes.
+	 * @param n The node whose segment is calculated.
+	 * @param from First tile of a straight line of tiles.
+	 * @param to Last tile of the line.
+	 */
+	inline void PfNodeCacheAddTiles(Node &n, TileIndex from, TileIndex to)
+	{
+		if (Yapf().CanUseGlobalCache(n)) m_global_cache.AddTiles(*n.m_segment, from, to);
+	}
 };
 
 #endif /* YAPF_COSTCACHE_HPP */
@@ -519,6 +519,9 @@ public:
 
 no_entry_cost: // jump here at the beginning if the node has no parent (it is the first node)
 
+			/* The segment depends on this tile and the tiles skipped to get here. */
+			Yapf().PfNodeCacheAddTiles(n, prev.tile != INVALID_TILE ? prev.tile : cur.tile, cur.tile);
+
 			/* All other tile costs will be calculated here. */
 			segment_cost += Yapf().OneTileCost(cur.tile, cur.td);
 
@@ -631,7 +634,12 @@ no_entry_cost: // jump here at the beginning if the node has no parent (it is th
 			tf = &tf_local;
 			tf_local.Init(v, Yapf().GetCompatibleRailTypes(), &Yapf().m_perf_ts_cost);
 
-			if (!tf_local.Follow(cur.tile, cur.td)) {
+			bool can_follow = tf_local.Follow(cur.tile, cur.td);
+
+			/* The next tile decides whether the segment ends here, so it depends on that tile too. */
+			if (tf_local.m_new_tile != INVALID_TILE) Yapf().PfNodeCacheAddTiles(n, cur.tile, tf_local.m_new_tile);
+
+			if (!can_follow) {
 				assert(tf_local.m_err != TrackFollower::EC_NONE);
 				/* Can't move to the next tile (EOL?). */
 				if (tf_local.m_err == TrackFollower::EC_RAIL_TYPE) {
@@ -120,6 +120,7 @@ protected:
 	TileIndex    m_destTile;
 	TrackdirBits m_destTrackdirs;
 	StationID    m_dest_station_id;
+	RailLandmarks::Target m_landmark_target; ///< distances of the destination from the landmarks, for a better estimate on long routes
 
 	/** to access inherited path finder */
 	Tpf& Yapf()
@@ -154,6 +155,11 @@ public:
 				m_destTrackdirs = TrackStatusToTrackdirBits(GetTileTrackStatus(v->dest_tile, TRANSPORT_RAIL, 0));
 				break;
 		}
+		if (_settings_game.pf.yapf.rail_landmarks && _rail_landmarks.IsReady()) {
+			_rail_landmarks.SetTarget(m_landmark_target, m_destTile, m_dest_station_id);
+		} else {
+			m_landmark_target.valid = false;
+		}
 		CYapfDestinationRailBase::SetDestination(v);
 	}
 
@@ -202,6 +208,10 @@ public:
 		int dmin = min(dx, dy);
 		int dxy = abs(dx - dy);
 		int d = dmin * YAPF_TILE_CORNER_LENGTH + (dxy - 1) * (YAPF_TILE_LENGTH / 2);
+		if (m_landmark_target.valid) {
+			/* Every tile the rest of the path enters costs at least YAPF_TILE_CORNER_LENGTH. */
+			d = max<int>(d, _rail_landmarks.GetLowerBound(m_landmark_target, tile) * YAPF_TILE_CORNER_LENGTH);
+		}
 		n.m_estimate = n.m_cost + d;
 		assert(n.m_estimate >= n.m_parent->m_estimate);
 		return true;
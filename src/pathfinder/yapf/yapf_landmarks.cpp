@@ -0,0 +1,437 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file yapf_landmarks.cpp Lower bounds of rail path lengths from distances to landmarks. */
+
+#include "../../stdafx.h"
+#include "yapf_landmarks.h"
+#include "../../map_func.h"
+#include "../../track_func.h"
+#include "../../tunnelbridge_map.h"
+#include "../../station_map.h"
+#include "../../base_station_base.h"
+#include "../../debug.h"
+#include "../pf_performance_timer.hpp"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_set>
+
+#include "../../safeguards.h"
+
+RailLandmarks _rail_landmarks; ///< The landmarks of the rail network.
+
+/** Entry of the queues of the shortest path calculations: distance and index of a tile. */
+typedef std::pair<uint32, uint32> LandmarkQueueItem;
+/** Queue returning the tile with the shortest distance first. */
+typedef std::priority_queue<LandmarkQueueItem, std::vector<LandmarkQueueItem>, std::greater<LandmarkQueueItem>> LandmarkQueue;
+
+/**
+ * Get the edges of a tile trains can leave it by.
+ * The edge of a tunnel entrance or bridge ramp towards the wormhole is not included.
+ * @param tile The tile.
+ * @return Bitmask of DiagDirections, 0 if the tile has no rail.
+ */
+static uint GetRailExitDirs(TileIndex tile)
+{
+	TrackdirBits trackdirs = TrackStatusToTrackdirBits(GetTileTrackStatus(tile, TRANSPORT_RAIL, 0));
+	uint dirs = 0;
+	while (trackdirs != TRACKDIR_BIT_NONE) {
+		SetBit(dirs, TrackdirToExitdir(RemoveFirstTrackdir(&trackdirs)));
+	}
+	if (dirs != 0 && IsTileType(tile, MP_TUNNELBRIDGE)) ClrBit(dirs, GetTunnelBridgeDirection(tile));
+	return dirs;
+}
+
+/**
+ * Call a function for every tile connected to a tile in the simplified rail network.
+ * @param tile The tile.
+ * @param func Function called with the connected tile and the length of the connection in tiles.
+ */
+template <typename F>
+static void IterateRailNeighbours(TileIndex tile, F func)
+{
+	uint dirs = GetRailExitDirs(tile);
+	if (dirs == 0) return;
+
+	if (IsTileType(tile, MP_TUNNELBRIDGE)) {
+		TileIndex other_end = GetOtherTunnelBridgeEnd(tile);
+		func(other_end, DistanceManhattan(tile, other_end));
+	}
+
+	for (DiagDirection dir = DIAGDIR_BEGIN; dir < DIAGDIR_END; dir++) {
+		if (!HasBit(dirs, dir)) continue;
+		TileIndexDiffC diff = TileIndexDiffCByDiagDir(dir);
+		TileIndex neighbour = TileAddWrap(tile, diff.x, diff.y);
+		if (neighbour != INVALID_TILE && HasBit(GetRailExitDirs(neighbour), ReverseDiagDir(dir))) func(neighbour, 1);
+	}
+}
+
+/**
+ * Get the point on the map border a landmark is chosen next to.
+ * @param l Number of the landmark.
+ * @return The tile of the point.
+ */
+static TileIndex GetLandmarkAnchor(uint l)
+{
+	static const byte x_fract[RailLandmarks::MAX_LANDMARKS] = { 0, 2, 0, 2, 1, 0, 2, 1 };
+	static const byte y_fract[RailLandmarks::MAX_LANDMARKS] = { 0, 0, 2, 2, 0, 1, 1, 2 };
+	return TileXY(MapMaxX() * x_fract[l] / 2, MapMaxY() * y_fract[l] / 2);
+}
+
+RailLandmarks::RailLandmarks()
+{
+	this->Clear();
+}
+
+/** Forget all distances; they are calculated again when they are needed. */
+void RailLandmarks::Clear()
+{
+	if (!this->tiles.empty() || !this->changed_tiles.empty()) {
+		this->index.clear();
+		this->tiles.clear();
+		this->present.clear();
+		this->dist.clear();
+		this->changed_tiles.clear();
+	}
+	for (uint l = 0; l < MAX_LANDMARKS; l++) this->landmarks[l] = UINT32_MAX;
+	this->built = false;
+	this->rebuild = false;
+}
+
+/**
+ * Notify the landmarks that the tracks of a tile have changed.
+ * @param tile The tile, or INVALID_TILE when everything has to be recalculated.
+ */
+void RailLandmarks::NotifyChange(TileIndex tile)
+{
+	if (!this->built || this->rebuild) return;
+
+	if (tile == INVALID_TILE || this->changed_tiles.size() >= MAX_CHANGED_TILES) {
+		this->changed_tiles.clear();
+		this->rebuild = true;
+		return;
+	}
+	this->changed_tiles.push_back(tile);
+}
+
+/**
+ * Add a tile to the rail tiles, not connected to any landmark.
+ * @param tile The tile.
+ * @return The index of the tile.
+ */
+uint32 RailLandmarks::AddTile(TileIndex tile)
+{
+	uint32 idx = (uint32)this->tiles.size();
+	this->index[tile] = idx;
+	this->tiles.push_back(tile);
+	this->present.push_back(true);
+	this->dist.resize(this->dist.size() + MAX_LANDMARKS, (uint32)UNREACHABLE);
+	return idx;
+}
+
+/**
+ * Check whether a tile is a better choice for a landmark than another one.
+ * The landmark is the rail tile closest to its anchor, and the one with the lower tile index of equally close tiles.
+ * @param l Number of the landmark.
+ * @param a Index of the tile to check.
+ * @param b Index of the tile to compare with.
+ * @return True if \a a is the better choice.
+ */
+bool RailLandmarks::IsBetterLandmark(uint l, uint32 a, uint32 b) const
+{
+	TileIndex anchor = GetLandmarkAnchor(l);
+	uint dist_a = DistanceManhattan(anchor, this->tiles[a]);
+	uint dist_b = DistanceManhattan(anchor, this->tiles[b]);
+	if (dist_a != dist_b) return dist_a < dist_b;
+	return this->tiles[a] < this->tiles[b];
+}
+
+/**
+ * Choose the tile of a landmark among all rail tiles.
+ * @param l Number of the landmark.
+ */
+void RailLandmarks::SelectLandmark(uint l)
+{
+	uint32 best = UINT32_MAX;
+	for (uint32 i = 0; i < this->tiles.size(); i++) {
+		if (this->present[i] && (best == UINT32_MAX || this->IsBetterLandmark(l, i, best))) best = i;
+	}
+	this->landmarks[l] = best;
+}
+
+/**
+ * Calculate the distances of all rail tiles from a landmark.
+ * @param l Number of the landmark.
+ */
+void RailLandmarks::CalculateDistances(uint l)
+{
+	for (uint32 i = 0; i < this->tiles.size(); i++) this->dist[i * MAX_LANDMARKS + l] = UNREACHABLE;
+
+	uint32 source = this->landmarks[l];
+	if (source == UINT32_MAX) return;
+
+	LandmarkQueue queue;
+	this->dist[source * MAX_LANDMARKS + l] = 0;
+	queue.push(LandmarkQueueItem(0, source));
+	while (!queue.empty()) {
+		LandmarkQueueItem item = queue.top();
+		queue.pop();
+		if (item.first != this->dist[item.second * MAX_LANDMARKS + l]) continue;
+
+		IterateRailNeighbours(this->tiles[item.second], [&](TileIndex tile, uint length) {
+			auto it = this->index.find(tile);
+			if (it == this->index.end()) return;
+			uint32 &d = this->dist[it->second * MAX_LANDMARKS + l];
+			if (item.first + length < d) {
+				d = item.first + length;
+				queue.push(LandmarkQueueItem(d, it->second));
+			}
+		});
+	}
+}
+
+/**
+ * Update the distances from a landmark after some tiles changed.
+ * First the tiles which lost the connection their distance was based on are found, in the order of their distance.
+ * Then the distances of those tiles, and of the tiles which got shorter connections, are calculated again.
+ * @param l Number of the landmark.
+ * @param seeds Indices of the tiles whose connections may have changed.
+ */
+void RailLandmarks::UpdateDistances(uint l, const std::vector<uint32> &seeds)
+{
+	uint32 source = this->landmarks[l];
+	if (source == UINT32_MAX) return;
+
+	auto get_dist = [&](TileIndex tile, uint32 &idx) -> uint32 {
+		auto it = this->index.find(tile);
+		if (it == this->index.end()) return UNREACHABLE;
+		idx = it->second;
+		return this->dist[idx * MAX_LANDMARKS + l];
+	};
+
+	/* Find the tiles which are not connected with their distance any more. */
+	std::unordered_set<uint32> invalid;
+	LandmarkQueue queue;
+	for (uint32 idx : seeds) {
+		uint32 d = this->dist[idx * MAX_LANDMARKS + l];
+		if (d != UNREACHABLE && idx != source) queue.push(LandmarkQueueItem(d, idx));
+	}
+	while (!queue.empty()) {
+		LandmarkQueueItem item = queue.top();
+		queue.pop();
+		if (invalid.count(item.second) != 0) continue;
+
+		bool supported = false;
+		IterateRailNeighbours(this->tiles[item.second], [&](TileIndex tile, uint length) {
+			uint32 idx;
+			uint32 d = get_dist(tile, idx);
+			if (d != UNREACHABLE && d + length == item.first && invalid.count(idx) == 0) supported = true;
+		});
+		if (supported) continue;
+
+		invalid.insert(item.second);
+		IterateRailNeighbours(this->tiles[item.second], [&](TileIndex tile, uint length) {
+			uint32 idx;
+			uint32 d = get_dist(tile, idx);
+			if (d != UNREACHABLE && d > item.first) queue.push(LandmarkQueueItem(d, idx));
+		});
+	}
+
+	/* Connect the invalidated tiles to their remaining neighbours. */
+	for (uint32 idx : invalid) this->dist[idx * MAX_LANDMARKS + l] = UNREACHABLE;
+	for (uint32 idx : invalid) {
+		uint32 &d = this->dist[idx * MAX_LANDMARKS + l];
+		IterateRailNeighbours(this->tiles[idx], [&](TileIndex tile, uint length) {
+			uint32 neighbour;
+			uint32 nd = get_dist(tile, neighbour);
+			if (nd != UNREACHABLE && nd + length < d) d = nd + length;
+		});
+		if (d != UNREACHABLE) queue.push(LandmarkQueueItem(d, idx));
+	}
+	for (uint32 idx : seeds) {
+		uint32 d = this->dist[idx * MAX_LANDMARKS + l];
+		if (d != UNREACHABLE) queue.push(LandmarkQueueItem(d, idx));
+	}
+
+	/* Propagate the new distances. */
+	while (!queue.empty()) {
+		LandmarkQueueItem item = queue.top();
+		queue.pop();
+		if (item.first != this->dist[item.second * MAX_LANDMARKS + l]) continue;
+
+		IterateRailNeighbours(this->tiles[item.second], [&](TileIndex tile, uint length) {
+			auto it = this->index.find(tile);
+			if (it == this->index.end()) return;
+			uint32 &d = this->dist[it->second * MAX_LANDMARKS + l];
+			if (item.first + length < d) {
+				d = item.first + length;
+				queue.push(LandmarkQueueItem(d, it->second));
+			}
+		});
+	}
+}
+
+/** Collect all rail tiles of the map and calculate their distances from the landmarks. */
+void RailLandmarks::Build()
+{
+	CPerformanceTimer perf;
+	perf.Start();
+
+	this->Clear();
+	for (TileIndex tile = 0; tile < MapSize(); tile++) {
+		switch (GetTileType(tile)) {
+			case MP_RAILWAY:
+			case MP_ROAD:
+			case MP_STATION:
+			case MP_TUNNELBRIDGE:
+				if (GetRailExitDirs(tile) != 0) this->AddTile(tile);
+				break;
+
+			default:
+				break;
+		}
+	}
+	for (uint l = 0; l < MAX_LANDMARKS; l++) {
+		this->SelectLandmark(l);
+		this->CalculateDistances(l);
+	}
+	this->built = true;
+
+	perf.Stop();
+	DEBUG(yapf, 1, "Rail landmarks: %u tiles, built in %d us", (uint)this->tiles.size(), perf.Get(1000000));
+}
+
+/** Bring the distances up to date with the map, if the map has changed since they were calculated. */
+void RailLandmarks::Update()
+{
+	if (this->IsReady()) return;
+	if (!this->built || this->rebuild) {
+		this->Build();
+		return;
+	}
+
+	CPerformanceTimer perf;
+	perf.Start();
+
+	std::sort(this->changed_tiles.begin(), this->changed_tiles.end());
+	this->changed_tiles.erase(std::unique(this->changed_tiles.begin(), this->changed_tiles.end()), this->changed_tiles.end());
+
+	/* Update the changed tiles; their neighbours and the other ends of tunnels and bridges may have changed connections too.
+	 * Tunnels and bridges are built and removed with notifications for both ends. */
+	std::vector<uint32> seeds;
+	std::vector<uint32> changed;
+	auto add_seed = [&](TileIndex tile) {
+		auto it = this->index.find(tile);
+		if (it != this->index.end()) {
+			seeds.push_back(it->second);
+		} else if (GetRailExitDirs(tile) != 0) {
+			seeds.push_back(this->AddTile(tile));
+		}
+	};
+	for (TileIndex tile : this->changed_tiles) {
+		bool has_rail = GetRailExitDirs(tile) != 0;
+		auto it = this->index.find(tile);
+		if (it != this->index.end()) {
+			this->present[it->second] = has_rail;
+			changed.push_back(it->second);
+		} else if (has_rail) {
+			changed.push_back(this->AddTile(tile));
+		}
+
+		add_seed(tile);
+		for (DiagDirection dir = DIAGDIR_BEGIN; dir < DIAGDIR_END; dir++) {
+			TileIndexDiffC diff = TileIndexDiffCByDiagDir(dir);
+			TileIndex neighbour = TileAddWrap(tile, diff.x, diff.y);
+			if (neighbour != INVALID_TILE) add_seed(neighbour);
+		}
+		if (has_rail && IsTileType(tile, MP_TUNNELBRIDGE)) add_seed(GetOtherTunnelBridgeEnd(tile));
+	}
+	std::sort(seeds.begin(), seeds.end());
+	seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+
+	for (uint l = 0; l < MAX_LANDMARKS; l++) {
+		uint32 landmark = this->landmarks[l];
+		if (landmark == UINT32_MAX || !this->present[landmark]) {
+			this->SelectLandmark(l);
+		} else {
+			for (uint32 idx : changed) {
+				if (this->present[idx] && this->IsBetterLandmark(l, idx, this->landmarks[l])) this->landmarks[l] = idx;
+			}
+		}
+
+		if (this->landmarks[l] != landmark) {
+			this->CalculateDistances(l);
+		} else {
+			this->UpdateDistances(l, seeds);
+		}
+	}
+
+	perf.Stop();
+	DEBUG(yapf, 3, "Rail landmarks: updated for %u changed tiles in %d us", (uint)this->changed_tiles.size(), perf.Get(1000000));
+	this->changed_tiles.clear();
+}
+
+/**
+ * Get the distances from the landmarks to the destination of a train.
+ * @param target Target to fill.
+ * @param tile Destination tile, used when there is no destination station.
+ * @param station Destination station or waypoint, or INVALID_STATION.
+ */
+void RailLandmarks::SetTarget(Target &target, TileIndex tile, StationID station) const
+{
+	for (uint l = 0; l < MAX_LANDMARKS; l++) {
+		target.min_dist[l] = UNREACHABLE;
+		target.max_dist[l] = 0;
+	}
+	target.valid = false;
+
+	auto add_tile = [&](TileIndex t) {
+		auto it = this->index.find(t);
+		if (it == this->index.end()) return;
+		const uint32 *d = &this->dist[it->second * MAX_LANDMARKS];
+		for (uint l = 0; l < MAX_LANDMARKS; l++) {
+			if (d[l] == UNREACHABLE) continue;
+			target.min_dist[l] = min(target.min_dist[l], d[l]);
+			target.max_dist[l] = max(target.max_dist[l], d[l]);
+			target.valid = true;
+		}
+	};
+
+	if (station != INVALID_STATION) {
+		const BaseStation *st = BaseStation::GetIfValid(station);
+		if (st == NULL) return;
+		TILE_AREA_LOOP(t, st->train_station) {
+			if (HasStationTileRail(t) && GetStationIndex(t) == station) add_tile(t);
+		}
+	} else {
+		add_tile(tile);
+	}
+}
+
+/**
+ * Get a lower bound of the number of tiles trains have to pass to get from a tile to a target.
+ * @param target The target.
+ * @param tile The tile.
+ * @return The lower bound, 0 if nothing is known about the tile.
+ */
+uint RailLandmarks::GetLowerBound(const Target &target, TileIndex tile) const
+{
+	auto it = this->index.find(tile);
+	if (it == this->index.end()) return 0;
+
+	const uint32 *d = &this->dist[it->second * MAX_LANDMARKS];
+	uint32 bound = 0;
+	for (uint l = 0; l < MAX_LANDMARKS; l++) {
+		if (d[l] == UNREACHABLE || target.min_dist[l] == UNREACHABLE) continue;
+		if (target.min_dist[l] > d[l]) bound = max(bound, target.min_dist[l] - d[l]);
+		if (d[l] > target.max_dist[l]) bound = max(bound, d[l] - target.max_dist[l]);
+	}
+	return bound;
+}
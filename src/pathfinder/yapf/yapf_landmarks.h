@@ -0,0 +1,88 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file yapf_landmarks.h Lower bounds of rail path lengths from distances to landmarks. */
+
+#ifndef YAPF_LANDMARKS_H
+#define YAPF_LANDMARKS_H
+
+#include "../../tile_type.h"
+#include "../../station_type.h"
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Distances over the rail network from a few landmark tiles. By the triangle inequality they give a
+ * lower bound of the length of any path between two tiles, which is a much better estimate than the
+ * straight distance when the rail network makes detours (the ALT heuristic).
+ *
+ * The network is simplified to a graph of tiles: neighbouring tiles are connected when both have
+ * a track leading to their common edge, and the ends of a tunnel or bridge are connected to each
+ * other. Railtypes, owners, signals and the connections of the tracks within a tile are ignored.
+ * That only makes the distances shorter, so the bounds hold for every path YAPF can find; every
+ * tile a path enters costs at least YAPF_TILE_CORNER_LENGTH.
+ *
+ * The landmarks are the rail tiles closest to fixed points on the map border, and the distances
+ * are exact for the current map. So they do not depend on the history of the map, and all clients
+ * of a network game get the same bounds. Track layout changes are queued, and #Update only
+ * recalculates the distances affected by them.
+ */
+class RailLandmarks {
+public:
+	static const uint MAX_LANDMARKS = 8;         ///< Number of landmarks.
+	static const uint32 UNREACHABLE = UINT32_MAX; ///< Distance of tiles not connected to a landmark.
+	static const uint MAX_CHANGED_TILES = 4096;  ///< Maximum number of queued changed tiles; when there are more everything is recalculated.
+
+	/** Distances from the landmarks to a set of destination tiles. */
+	struct Target {
+		uint32 min_dist[MAX_LANDMARKS]; ///< Shortest distance from each landmark to a destination tile, UNREACHABLE if there is none.
+		uint32 max_dist[MAX_LANDMARKS]; ///< Longest distance from each landmark to a destination tile.
+		bool valid;                     ///< Whether any destination tile is connected to a landmark.
+	};
+
+private:
+	std::unordered_map<TileIndex, uint32> index; ///< Index of the rail tiles in #tiles and #dist.
+	std::vector<TileIndex> tiles;                ///< The rail tiles, and tiles which were rail tiles before.
+	std::vector<bool> present;                   ///< Whether the tile of the same index is still a rail tile.
+	std::vector<uint32> dist;                    ///< Distances in tiles, #MAX_LANDMARKS per rail tile.
+	uint32 landmarks[MAX_LANDMARKS];             ///< Index of the landmark tiles, UINT32_MAX for none.
+	std::vector<TileIndex> changed_tiles;        ///< Tiles whose tracks changed since the last #Update.
+	bool built;                                  ///< Whether the distances have been calculated.
+	bool rebuild;                                ///< Whether everything has to be recalculated at the next #Update.
+
+	uint32 AddTile(TileIndex tile);
+	void SelectLandmark(uint l);
+	bool IsBetterLandmark(uint l, uint32 a, uint32 b) const;
+	void CalculateDistances(uint l);
+	void UpdateDistances(uint l, const std::vector<uint32> &seeds);
+	void Build();
+
+public:
+	RailLandmarks();
+
+	void Clear();
+	void NotifyChange(TileIndex tile);
+	void Update();
+
+	/**
+	 * Check whether the distances are calculated and up to date.
+	 * @return True if bounds can be taken from this.
+	 */
+	inline bool IsReady() const
+	{
+		return this->built && this->changed_tiles.empty() && !this->rebuild;
+	}
+
+	void SetTarget(Target &target, TileIndex tile, StationID station) const;
+	uint GetLowerBound(const Target &target, TileIndex tile) const;
+};
+
+extern RailLandmarks _rail_landmarks;
+
+#endif /* YAPF_LANDMARKS_H */
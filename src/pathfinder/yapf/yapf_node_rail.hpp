@@ -65,6 +65,7 @@ struct CYapfRailSegmentKey
 struct CYapfRailSegment
 {
 	typedef CYapfRailSegmentKey Key;
+	static const TransportType TRANSPORT_TYPE = TRANSPORT_RAIL;
 
 	CYapfRailSegmentKey    m_key;
 	TileIndex              m_last_tile;
@@ -12,17 +12,115 @@
 #ifndef YAPF_NODE_ROAD_HPP
 #define YAPF_NODE_ROAD_HPP
 
+/**
+ * Key for cached segment cost for road YAPF. Which roads can be followed depends on the
+ * owner and the road types of the vehicle, so they are part of the key.
+ */
+struct CYapfRoadSegmentKey
+{
+	uint32    m_value;
+	uint8     m_vehicle;
+
+	inline CYapfRoadSegmentKey(const CYapfRoadSegmentKey &src) : m_value(src.m_value), m_vehicle(src.m_vehicle) {}
+
+	inline CYapfRoadSegmentKey(const CYapfNodeKeyExitDir &node_key, const RoadVehicle *v = NULL)
+	{
+		m_value = (((int)node_key.m_tile) << 4) | node_key.m_td;
+		m_vehicle = (v == NULL) ? 0 : (uint8)((Owner)v->owner | (uint)v->compatible_roadtypes << 4);
+	}
+
+	inline int32 CalcHash() const
+	{
+		return m_value ^ (m_vehicle << 24);
+	}
+
+	inline TileIndex GetTile() const
+	{
+		return (TileIndex)(m_value >> 4);
+	}
+
+	inline Trackdir GetTrackdir() const
+	{
+		return (Trackdir)(m_value & 0x0F);
+	}
+
+	inline bool operator==(const CYapfRoadSegmentKey &other) const
+	{
+		return m_value == other.m_value && m_vehicle == other.m_vehicle;
+	}
+};
+
+/** Tile of a road segment where a cost applies that depends on the vehicle or on the state of the game. */
+struct CYapfRoadSegmentTile
+{
+	TileIndex m_tile;      ///< The tile, a road stop, a road depot or a tile with a speed limit.
+	Trackdir  m_td;        ///< Trackdir on the tile.
+	int       m_cost;      ///< Cost of the segment up to and including this tile, without the variable costs.
+	int       m_max_speed; ///< Speed limit when leaving the tile, INT_MAX if there is none.
+};
+
+/**
+ * Cached segment cost for road YAPF. Only the part of the cost which does not depend
+ * on the vehicle, the destination or the occupancy of road stops is cached; the tiles where
+ * such costs apply are kept in the segment, in the order they are passed.
+ */
+struct CYapfRoadSegment
+{
+	typedef CYapfRoadSegmentKey Key;
+	static const TransportType TRANSPORT_TYPE = TRANSPORT_ROAD;
+
+	CYapfRoadSegmentKey    m_key;
+	TileIndex              m_last_tile;
+	Trackdir               m_last_td;
+	int                    m_cost;      ///< Cost of the whole segment without the variable costs, -1 if not calculated yet.
+	bool                   m_loop;      ///< Whether the segment leads back to its start without any junction.
+	std::vector<CYapfRoadSegmentTile> m_tiles; ///< The tiles with variable costs, and the tiles which can be a destination.
+	CYapfRoadSegment      *m_hash_next;
+
+	inline CYapfRoadSegment(const CYapfRoadSegmentKey &key)
+		: m_key(key)
+		, m_last_tile(INVALID_TILE)
+		, m_last_td(INVALID_TRACKDIR)
+		, m_cost(-1)
+		, m_loop(false)
+		, m_hash_next(NULL)
+	{}
+
+	inline const Key& GetKey() const
+	{
+		return m_key;
+	}
+
+	inline TileIndex GetTile() const
+	{
+		return m_key.GetTile();
+	}
+
+	inline CYapfRoadSegment *GetHashNext()
+	{
+		return m_hash_next;
+	}
+
+	inline void SetHashNext(CYapfRoadSegment *next)
+	{
+		m_hash_next = next;
+	}
+};
+
 /** Yapf Node for road YAPF */
 template <class Tkey_>
 struct CYapfRoadNodeT : CYapfNodeT<Tkey_, CYapfRoadNodeT<Tkey_> > {
 	typedef CYapfNodeT<Tkey_, CYapfRoadNodeT<Tkey_> > base;
+	typedef CYapfRoadSegment CachedData;
 
+	CYapfRoadSegment *m_segment;
 	TileIndex m_segment_last_tile;
 	Trackdir  m_segment_last_td;
 
 	void Set(CYapfRoadNodeT *parent, TileIndex tile, Trackdir td, bool is_choice)
 	{
 		base::Set(parent, tile, td, is_choice);
+		m_segment = NULL;
 		m_segment_last_tile = tile;
 		m_segment_last_td = td;
 	}
@@ -13,11 +13,15 @@
 
 #include "yapf.hpp"
 #include "yapf_cache.h"
+#include "yapf_landmarks.h"
 #include "yapf_node_rail.hpp"
 #include "yapf_costrail.hpp"
 #include "yapf_destrail.hpp"
 #include "../../viewport_func.h"
 #include "../../newgrf_station.h"
+#include "../../thread/thread_pool.h"
+#include <algorithm>
+#include <memory>
 
 #include "../../safeguards.h"
 
@@ -64,7 +68,9 @@ template <typename Tpf> void DumpState(Tpf &pf1, Tpf &pf2)
 	fclose(f2);
 }
 
-int _total_pf_time_us = 0;
+std::atomic<int> _total_pf_time_us(0);
+std::atomic<uint> _yapf_nodelist_allocs(0);
+std::atomic<uint> _yapf_nodelist_reuses(0);
 
 template <class Types>
 class CYapfReserveTrack
@@ -210,7 +216,8 @@ public:
 		if (target != NULL) target->okay = true;
 
 		if (Yapf().CanUseGlobalCache(*m_res_node)) {
-			YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
+			/* Reservations do not change the track layout, the landmarks stay valid. */
+			CSegmentCostCacheBase::NotifyLayoutChange(INVALID_TILE, TRANSPORT_RAIL);
 		}
 
 		return true;
@@ -439,6 +446,9 @@ public:
 	typedef typename Types::NodeList::Titem Node;        ///< this will be our node type
 	typedef typename Node::Key Key;                      ///< key to hash tables
 
+private:
+	TileIndex m_path_origin;      ///< Origin tile of the path found by SearchRailTrack to reserve, INVALID_TILE when there is none
+
 protected:
 	/** to access inherited path finder */
 	inline Tpf& Yapf()
@@ -494,13 +504,27 @@ public:
 	{
 		if (target != NULL) target->tile = INVALID_TILE;
 
+		Trackdir next_trackdir = this->SearchRailTrack(v, FollowTrainReservation(v), path_found);
+		if (reserve_track) this->ReserveRailTrack(target);
+		return next_trackdir;
+	}
+
+	/**
+	 * Search the path of a train without reserving it.
+	 * @param v The train.
+	 * @param origin End of the reserved path of the train, where the search starts.
+	 * @param[out] path_found Whether a path has been found, or the search stopped on the first two way signal(s).
+	 * @return The first trackdir of the best path, or INVALID_TRACKDIR.
+	 */
+	inline Trackdir SearchRailTrack(const Train *v, const PBSTileInfo &origin, bool &path_found)
+	{
 		/* set origin and destination nodes */
-		PBSTileInfo origin = FollowTrainReservation(v);
 		Yapf().SetOrigin(origin.tile, origin.trackdir, INVALID_TILE, INVALID_TRACKDIR, 1, true);
 		Yapf().SetDestination(v);
 
 		/* find the best path */
-		path_found = Yapf().FindPath(v);
+		bool found = Yapf().FindPath(v);
+		m_path_origin = INVALID_TILE;
 
 		/* if path not found - return INVALID_TRACKDIR */
 		Trackdir next_trackdir = INVALID_TRACKDIR;
@@ -522,14 +546,26 @@ public:
 			Node &best_next_node = *pPrev;
 			next_trackdir = best_next_node.GetTrackdir();
 
-			if (reserve_track && path_found) this->TryReservePath(target, pNode->GetLastTile());
+			/* only a path which was really found is reserved */
+			if (found) m_path_origin = pNode->GetLastTile();
 		}
 
 		/* Treat the path as found if stopped on the first two way signal(s). */
-		path_found |= Yapf().m_stopped_on_first_two_way_signal;
+		path_found = found || Yapf().m_stopped_on_first_two_way_signal;
 		return next_trackdir;
 	}
 
+	/**
+	 * Reserve the path found by #SearchRailTrack, if any.
+	 * @param[out] target The target tile of the reservation, okay is set when the path was reserved.
+	 * @return False if there is a path, but it could not be reserved.
+	 */
+	inline bool ReserveRailTrack(PBSTileInfo *target)
+	{
+		if (m_path_origin == INVALID_TILE) return true;
+		return this->TryReservePath(target, m_path_origin);
+	}
+
 	static bool stCheckReverseTrain(const Train *v, TileIndex t1, Trackdir td1, TileIndex t2, Trackdir td2, int reverse_penalty)
 	{
 		Tpf pf1;
@@ -576,10 +612,10 @@ public:
 	}
 };
 
-template <class Tpf_, class Ttrack_follower, class Tnode_list, template <class Types> class TdestinationT, template <class Types> class TfollowT>
+template <class Tpf_, class Ttrack_follower, class Tnode_list, template <class Types> class TdestinationT, template <class Types> class TfollowT, template <class Types> class TcacheT = CYapfSegmentCostCacheGlobalT>
 struct CYapfRail_TypesT
 {
-	typedef CYapfRail_TypesT<Tpf_, Ttrack_follower, Tnode_list, TdestinationT, TfollowT>  Types;
+	typedef CYapfRail_TypesT<Tpf_, Ttrack_follower, Tnode_list, TdestinationT, TfollowT, TcacheT>  Types;
 
 	typedef Tpf_                                Tpf;
 	typedef Ttrack_follower                     TrackFollower;
@@ -589,13 +625,17 @@ struct CYapfRail_TypesT
 	typedef TfollowT<Types>                     PfFollow;
 	typedef CYapfOriginTileTwoWayT<Types>       PfOrigin;
 	typedef TdestinationT<Types>                PfDestination;
-	typedef CYapfSegmentCostCacheGlobalT<Types> PfCache;
+	typedef TcacheT<Types>                      PfCache;
 	typedef CYapfCostRailT<Types>               PfCost;
 };
 
 struct CYapfRail1         : CYapfT<CYapfRail_TypesT<CYapfRail1        , CFollowTrackRail    , CRailNodeListTrackDir, CYapfDestinationTileOrStationRailT, CYapfFollowRailT> > {};
 struct CYapfRail2         : CYapfT<CYapfRail_TypesT<CYapfRail2        , CFollowTrackRailNo90, CRailNodeListTrackDir, CYapfDestinationTileOrStationRailT, CYapfFollowRailT> > {};
 
+/* The global segment cost cache is not thread safe, so the searches on worker threads use a local one. */
+struct CYapfRailPredict1  : CYapfT<CYapfRail_TypesT<CYapfRailPredict1 , CFollowTrackRail    , CRailNodeListTrackDir, CYapfDestinationTileOrStationRailT, CYapfFollowRailT, CYapfSegmentCostCacheLocalT> > {};
+struct CYapfRailPredict2  : CYapfT<CYapfRail_TypesT<CYapfRailPredict2 , CFollowTrackRailNo90, CRailNodeListTrackDir, CYapfDestinationTileOrStationRailT, CYapfFollowRailT, CYapfSegmentCostCacheLocalT> > {};
+
 struct CYapfAnyDepotRail1 : CYapfT<CYapfRail_TypesT<CYapfAnyDepotRail1, CFollowTrackRail    , CRailNodeListTrackDir, CYapfDestinationAnyDepotRailT     , CYapfFollowAnyDepotRailT> > {};
 struct CYapfAnyDepotRail2 : CYapfT<CYapfRail_TypesT<CYapfAnyDepotRail2, CFollowTrackRailNo90, CRailNodeListTrackDir, CYapfDestinationAnyDepotRailT     , CYapfFollowAnyDepotRailT> > {};
 
@@ -603,23 +643,233 @@ struct CYapfAnySafeTileRail1 : CYapfT<CYapfRail_TypesT<CYapfAnySafeTileRail1, CF
 struct CYapfAnySafeTileRail2 : CYapfT<CYapfRail_TypesT<CYapfAnySafeTileRail2, CFollowTrackFreeRailNo90, CRailNodeListTrackDir, CYapfDestinationAnySafeTileRailT , CYapfFollowAnySafeTileRailT> > {};
 
 
-Track YapfTrainChooseTrack(const Train *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks, bool &path_found, bool reserve_track, PBSTileInfo *target)
+uint _yapf_train_predictions_made = 0;
+uint _yapf_train_predictions_used = 0;
+uint _yapf_train_predictions_conflicts = 0;
+
+/** The path finder instance holding the result of a search done in advance, so its path can still be reserved. */
+struct TrainPathSearch {
+	virtual ~TrainPathSearch() {}
+
+	/**
+	 * Reserve the path which was found.
+	 * @param[out] target The target tile of the reservation.
+	 * @return False if there is a path, but it could not be reserved.
+	 */
+	virtual bool Reserve(PBSTileInfo *target) = 0;
+};
+
+/** Implementation of #TrainPathSearch for a path finder type. */
+template <class Tpf>
+struct TrainPathSearchT : TrainPathSearch {
+	Tpf pf; ///< The path finder which did the search.
+
+	virtual bool Reserve(PBSTileInfo *target)
+	{
+		return this->pf.ReserveRailTrack(target);
+	}
+};
+
+/** A path of a train searched in advance. */
+struct TrainPathPrediction {
+	const Train *v;           ///< The train.
+	VehicleID index;          ///< Index of the train, it might be deleted before the prediction is used.
+	PBSTileInfo origin;       ///< End of the reserved path the search started at.
+	OrderType order_type;     ///< Type of the current order of the train at the time of the search.
+	DestinationID order_dest; ///< Destination of the current order of the train at the time of the search.
+	TileIndex dest_tile;      ///< Destination tile of the train at the time of the search.
+	Trackdir trackdir;        ///< First trackdir of the best path.
+	bool path_found;          ///< Whether a path was found.
+	TrainPathSearch *search;  ///< The path finder with the result, NULL when the prediction has been used.
+};
+
+/** A batch of predictions searched by one task. */
+struct TrainPathPredictionBatch {
+	TrainPathPrediction *first;    ///< First prediction to search.
+	uint count;                    ///< Number of predictions to search.
+	TrainPathSearch **spent;       ///< Path finders of a previous tick to delete.
+	uint spent_count;              ///< Number of path finders to delete.
+};
+
+static const uint TRAIN_PATH_PREDICTION_BATCH_SIZE = 4; ///< Number of searches per task.
+
+static ThreadPool _train_path_workers("ottd:trainpf");             ///< Workers searching the predicted paths.
+static std::vector<TrainPathPrediction> _train_path_predictions;   ///< Predictions of the current tick, sorted by vehicle index.
+static std::vector<TrainPathSearch *> _spent_train_path_searches;  ///< Path finders which are not used anymore.
+
+/**
+ * Search a predicted path.
+ * @param p The prediction to fill.
+ * @return The path finder which did the search.
+ */
+template <class Tpf>
+static TrainPathSearch *SearchTrainPathPrediction(TrainPathPrediction &p)
 {
-	/* default is YAPF type 2 */
-	typedef Trackdir (*PfnChooseRailTrack)(const Train*, TileIndex, DiagDirection, TrackBits, bool&, bool, PBSTileInfo*);
-	PfnChooseRailTrack pfnChooseRailTrack = &CYapfRail1::stChooseRailTrack;
+	TrainPathSearchT<Tpf> *search = new TrainPathSearchT<Tpf>();
+	p.trackdir = search->pf.SearchRailTrack(p.v, p.origin, p.path_found);
+	return search;
+}
 
-	/* check if non-default YAPF type needed */
-	if (_settings_game.pf.forbid_90_deg) {
-		pfnChooseRailTrack = &CYapfRail2::stChooseRailTrack; // Trackdir, forbid 90-deg
+/**
+ * Run the searches of a batch. This method is tailored to ThreadPoolTask.
+ * The path finders of the previous tick are deleted here as well, so the node list
+ * storage they hold returns to the free list of a worker thread.
+ * @param data The batch.
+ */
+static void RunTrainPathPredictionBatch(void *data)
+{
+	TrainPathPredictionBatch *batch = (TrainPathPredictionBatch *)data;
+	for (uint i = 0; i < batch->spent_count; i++) delete batch->spent[i];
+
+	for (uint i = 0; i < batch->count; i++) {
+		TrainPathPrediction &p = batch->first[i];
+		if (_settings_game.pf.forbid_90_deg) {
+			p.search = SearchTrainPathPrediction<CYapfRailPredict2>(p);
+		} else {
+			p.search = SearchTrainPathPrediction<CYapfRailPredict1>(p);
+		}
+	}
+}
+
+/** Bring the rail landmarks up to date before searching a path, or drop them if they are not used. */
+static void UpdateRailLandmarks()
+{
+	if (_settings_game.pf.yapf.rail_landmarks) {
+		_rail_landmarks.Update();
+	} else {
+		_rail_landmarks.Clear();
+	}
+}
+
+void YapfTrainPredictPaths(const std::vector<YapfTrainPathRequest> &requests)
+{
+	assert(_train_path_predictions.empty());
+	UpdateRailLandmarks();
+
+	for (const YapfTrainPathRequest &request : requests) {
+		const Train *v = request.v;
+		TrainPathPrediction p;
+		p.v = v;
+		p.index = v->index;
+		p.origin = PBSTileInfo(request.tile, request.trackdir, false);
+		p.order_type = v->current_order.GetType();
+		p.order_dest = v->current_order.GetDestination();
+		p.dest_tile = v->dest_tile;
+		p.trackdir = INVALID_TRACKDIR;
+		p.path_found = false;
+		p.search = NULL;
+		_train_path_predictions.push_back(p);
+	}
+
+	uint count = (uint)_train_path_predictions.size();
+	uint num_batches = CeilDiv(count, TRAIN_PATH_PREDICTION_BATCH_SIZE);
+	if (num_batches == 0) {
+		for (TrainPathSearch *search : _spent_train_path_searches) delete search;
+		_spent_train_path_searches.clear();
+		return;
+	}
+	_yapf_train_predictions_made += count;
+
+	/* The first batch runs on this thread, the path finders to delete go to the others. */
+	std::vector<TrainPathPredictionBatch> batches(num_batches);
+	uint spent_count = (uint)_spent_train_path_searches.size();
+	uint spent_per_batch = num_batches > 1 ? CeilDiv(spent_count, num_batches - 1) : spent_count;
+	uint spent_done = 0;
+	for (uint i = 0; i < num_batches; i++) {
+		TrainPathPredictionBatch &batch = batches[i];
+		batch.first = _train_path_predictions.data() + i * TRAIN_PATH_PREDICTION_BATCH_SIZE;
+		batch.count = min(TRAIN_PATH_PREDICTION_BATCH_SIZE, count - i * TRAIN_PATH_PREDICTION_BATCH_SIZE);
+		batch.spent = _spent_train_path_searches.data() + spent_done;
+		batch.spent_count = (i == 0 && num_batches > 1) ? 0 : min(spent_per_batch, spent_count - spent_done);
+		spent_done += batch.spent_count;
+	}
+
+	std::vector<std::unique_ptr<ThreadPoolTask>> tasks;
+	for (uint i = 1; i < num_batches; i++) {
+		tasks.emplace_back(new ThreadPoolTask(&RunTrainPathPredictionBatch, &batches[i]));
+		_train_path_workers.Submit(tasks.back().get());
+	}
+	RunTrainPathPredictionBatch(&batches[0]);
+	for (auto &task : tasks) {
+		_train_path_workers.Wait(task.get());
+	}
+
+	_spent_train_path_searches.clear();
+}
+
+void YapfTrainFinishPredictions()
+{
+	for (TrainPathPrediction &p : _train_path_predictions) {
+		if (p.search != NULL) _spent_train_path_searches.push_back(p.search);
+	}
+	_train_path_predictions.clear();
+}
+
+/**
+ * Use the path predicted for a train, when it was searched from the same origin and for the same destination.
+ * @param v The train.
+ * @param[out] path_found Whether a path has been found.
+ * @param reserve_track Whether the path should be reserved.
+ * @param[out] target The target tile of the reservation.
+ * @param[out] trackdir The first trackdir of the best path.
+ * @return False if there is no usable prediction and the path has to be searched.
+ */
+static bool UseTrainPathPrediction(const Train *v, bool &path_found, bool reserve_track, PBSTileInfo *target, Trackdir &trackdir)
+{
+	if (_train_path_predictions.empty()) return false;
+
+	auto it = std::lower_bound(_train_path_predictions.begin(), _train_path_predictions.end(), v->index,
+			[](const TrainPathPrediction &p, VehicleID index) { return p.index < index; });
+	if (it == _train_path_predictions.end() || it->index != v->index || it->v != v || it->search == NULL) return false;
+
+	TrainPathPrediction &p = *it;
+	if (p.order_type != v->current_order.GetType() || p.order_dest != v->current_order.GetDestination() || p.dest_tile != v->dest_tile) return false;
+
+	PBSTileInfo origin = FollowTrainReservation(v);
+	if (origin.tile != p.origin.tile || origin.trackdir != p.origin.trackdir) return false;
+
+	/* Each prediction is used only once. */
+	TrainPathSearch *search = p.search;
+	p.search = NULL;
+	_spent_train_path_searches.push_back(search);
+
+	if (target != NULL) target->tile = INVALID_TILE;
+	if (reserve_track && !search->Reserve(target)) {
+		/* Another train reserved a part of the path since the search, search again. */
+		_yapf_train_predictions_conflicts++;
+		return false;
 	}
 
-	Trackdir td_ret = pfnChooseRailTrack(v, tile, enterdir, tracks, path_found, reserve_track, target);
+	_yapf_train_predictions_used++;
+	path_found = p.path_found;
+	trackdir = p.trackdir;
+	return true;
+}
+
+Track YapfTrainChooseTrack(const Train *v, TileIndex tile, DiagDirection enterdir, TrackBits tracks, bool &path_found, bool reserve_track, PBSTileInfo *target)
+{
+	UpdateRailLandmarks();
+
+	Trackdir td_ret;
+	if (!UseTrainPathPrediction(v, path_found, reserve_track, target, td_ret)) {
+		/* default is YAPF type 2 */
+		typedef Trackdir (*PfnChooseRailTrack)(const Train*, TileIndex, DiagDirection, TrackBits, bool&, bool, PBSTileInfo*);
+		PfnChooseRailTrack pfnChooseRailTrack = &CYapfRail1::stChooseRailTrack;
+
+		/* check if non-default YAPF type needed */
+		if (_settings_game.pf.forbid_90_deg) {
+			pfnChooseRailTrack = &CYapfRail2::stChooseRailTrack; // Trackdir, forbid 90-deg
+		}
+
+		td_ret = pfnChooseRailTrack(v, tile, enterdir, tracks, path_found, reserve_track, target);
+	}
 	return (td_ret != INVALID_TRACKDIR) ? TrackdirToTrack(td_ret) : FindFirstTrack(tracks);
 }
 
 bool YapfTrainCheckReverse(const Train *v)
 {
+	UpdateRailLandmarks();
+
 	const Train *last_veh = v->Last();
 
 	/* get trackdirs of both ends */
@@ -709,10 +959,11 @@ bool YapfTrainFindNearestSafeTile(const Train *v, TileIndex tile, Trackdir td, b
 	return pfnFindNearestSafeTile(v, tile, td, override_railtype);
 }
 
-/** if any track changes, this counter is incremented - that will invalidate segment cost cache */
-int CSegmentCostCacheBase::s_rail_change_counter = 0;
+/** All segment cost caches, they are notified of track and road layout changes. */
+std::vector<CSegmentCostCacheBase *> CSegmentCostCacheBase::s_caches;
 
 void YapfNotifyTrackLayoutChange(TileIndex tile, Track track)
 {
-	CSegmentCostCacheBase::NotifyTrackLayoutChange(tile, track);
+	CSegmentCostCacheBase::NotifyLayoutChange(tile, TRANSPORT_RAIL);
+	_rail_landmarks.NotifyChange(tile);
 }
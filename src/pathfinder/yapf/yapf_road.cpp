@@ -12,6 +12,7 @@
 #include "../../stdafx.h"
 #include "yapf.hpp"
 #include "yapf_node_road.hpp"
+#include "yapf_cache.h"
 #include "../../roadstop_base.h"
 
 #include "../../safeguards.h"
@@ -33,8 +34,13 @@ public:
 	typedef typename Types::TrackFollower TrackFollower; ///< track follower helper
 	typedef typename Types::NodeList::Titem Node; ///< this will be our node type
 	typedef typename Node::Key Key;    ///< key to hash tables
+	typedef typename Node::CachedData CachedData;
 
 protected:
+	bool m_disable_cache; ///< Whether the global segment cost cache must not be used.
+
+	CYapfCostRoadT() : m_disable_cache(false) {}
+
 	/** to access inherited path finder */
 	Tpf& Yapf()
 	{
@@ -60,42 +66,16 @@ protected:
 		return 0;
 	}
 
-	/** return one tile cost */
+	/** return one tile cost, without the cost of road stops */
 	inline int OneTileCost(TileIndex tile, Trackdir trackdir)
 	{
 		int cost = 0;
 		/* set base cost */
 		if (IsDiagonalTrackdir(trackdir)) {
 			cost += YAPF_TILE_LENGTH;
-			switch (GetTileType(tile)) {
-				case MP_ROAD:
-					/* Increase the cost for level crossings */
-					if (IsLevelCrossing(tile)) {
-						cost += Yapf().PfGetSettings().road_crossing_penalty;
-					}
-					break;
-
-				case MP_STATION: {
-					const RoadStop *rs = RoadStop::GetByTile(tile, GetRoadStopType(tile));
-					if (IsDriveThroughStopTile(tile)) {
-						/* Increase the cost for drive-through road stops */
-						cost += Yapf().PfGetSettings().road_stop_penalty;
-						DiagDirection dir = TrackdirToExitdir(trackdir);
-						if (!RoadStop::IsDriveThroughRoadStopContinuation(tile, tile - TileOffsByDiagDir(dir))) {
-							/* When we're the first road stop in a 'queue' of them we increase
-							 * cost based on the fill percentage of the whole queue. */
-							const RoadStop::Entry *entry = rs->GetEntry(dir);
-							cost += entry->GetOccupied() * Yapf().PfGetSettings().road_stop_occupied_penalty / entry->GetLength();
-						}
-					} else {
-						/* Increase cost for filled road stops */
-						cost += Yapf().PfGetSettings().road_stop_bay_occupied_penalty * (!rs->IsFreeBay(0) + !rs->IsFreeBay(1)) / 2;
-					}
-					break;
-				}
-
-				default:
-					break;
+			/* Increase the cost for level crossings */
+			if (IsLevelCrossingTile(tile)) {
+				cost += Yapf().PfGetSettings().road_crossing_penalty;
 			}
 		} else {
 			/* non-diagonal trackdir */
@@ -104,18 +84,41 @@ protected:
 		return cost;
 	}
 
-public:
+	/** return the additional cost of a road stop tile, which depends on its occupancy */
+	inline int RoadStopCost(TileIndex tile, Trackdir trackdir)
+	{
+		if (!IsDiagonalTrackdir(trackdir) || !IsTileType(tile, MP_STATION)) return 0;
+
+		int cost = 0;
+		const RoadStop *rs = RoadStop::GetByTile(tile, GetRoadStopType(tile));
+		if (IsDriveThroughStopTile(tile)) {
+			/* Increase the cost for drive-through road stops */
+			cost += Yapf().PfGetSettings().road_stop_penalty;
+			DiagDirection dir = TrackdirToExitdir(trackdir);
+			if (!RoadStop::IsDriveThroughRoadStopContinuation(tile, tile - TileOffsByDiagDir(dir))) {
+				/* When we're the first road stop in a 'queue' of them we increase
+				 * cost based on the fill percentage of the whole queue. */
+				const RoadStop::Entry *entry = rs->GetEntry(dir);
+				cost += entry->GetOccupied() * Yapf().PfGetSettings().road_stop_occupied_penalty / entry->GetLength();
+			}
+		} else {
+			/* Increase cost for filled road stops */
+			cost += Yapf().PfGetSettings().road_stop_bay_occupied_penalty * (!rs->IsFreeBay(0) + !rs->IsFreeBay(1)) / 2;
+		}
+		return cost;
+	}
+
 	/**
-	 * Called by YAPF to calculate the cost from the origin to the given node.
-	 *  Calculates only the cost of given node, adds it to the parent node cost
-	 *  and stores the result into Node::m_cost member
+	 * Walk from the start of a segment to its end and store the costs which do not depend on the
+	 * vehicle or on the state of the game in the segment. Road stops, road depots and tiles with
+	 * a speed limit are stored separately, as their cost is variable or they might be the destination.
+	 * @param n Node the segment starts at.
+	 * @param segment The segment to calculate.
+	 * @param detect_destination Whether the segment ends at the destination. The segment is only valid for this search then.
 	 */
-	inline bool PfCalcCost(Node &n, const TrackFollower *tf)
+	void CalcSegment(Node &n, CachedData &segment, bool detect_destination)
 	{
-		/* this is to handle the case where the starting tile is a junction custom bridge head,
-		 * and we have advanced across the bridge in the initial step */
-		int segment_cost = tf->m_tiles_skipped * YAPF_TILE_LENGTH;
-
+		int segment_cost = 0;
 		uint tiles = 0;
 		/* start at n.m_key.m_tile / n.m_key.m_td and walk to the end of segment */
 		TileIndex tile = n.m_key.m_tile;
@@ -124,9 +127,12 @@ public:
 			/* base tile cost depending on distance between edges */
 			segment_cost += Yapf().OneTileCost(tile, trackdir);
 
-			const RoadVehicle *v = Yapf().GetVehicle();
+			/* road stops and depots might be the destination, so the segment cost up to them is needed */
+			bool special_tile = IsTileType(tile, MP_STATION) || IsRoadDepotTile(tile);
+			if (special_tile) segment.m_tiles.push_back({ tile, trackdir, segment_cost, INT_MAX });
+
 			/* we have reached the vehicle's destination - segment should end here to avoid target skipping */
-			if (Yapf().PfDetectDestinationTile(tile, trackdir)) break;
+			if (detect_destination && Yapf().PfDetectDestinationTile(tile, trackdir)) break;
 
 			/* stop if we have just entered the depot */
 			if (IsRoadDepotTile(tile) && trackdir == DiagDirToDiagTrackdir(ReverseDiagDir(GetRoadDepotDirection(tile)))) {
@@ -136,7 +142,14 @@ public:
 
 			/* if there are no reachable trackdirs on new tile, we have end of road */
 			TrackFollower F(Yapf().GetVehicle());
-			if (!F.Follow(tile, trackdir)) break;
+			bool can_follow = F.Follow(tile, trackdir);
+
+			/* the segment depends on the next tile, whether it could be followed or not */
+			TileIndex next_tile = TileAddByDiagDir(tile, TrackdirToExitdir(trackdir));
+			Yapf().PfNodeCacheAddTiles(n, tile, next_tile);
+			if (can_follow && F.m_new_tile != next_tile) Yapf().PfNodeCacheAddTiles(n, tile, F.m_new_tile);
+
+			if (!can_follow) break;
 
 			/* if we skipped some tunnel tiles, add their cost */
 			/* with custom bridge heads, this cost must be added before checking if the segment has ended */
@@ -149,33 +162,136 @@ public:
 			Trackdir new_td = (Trackdir)FindFirstBit2x64(F.m_new_td_bits);
 
 			/* stop if RV is on simple loop with no junctions */
-			if (F.m_new_tile == n.m_key.m_tile && new_td == n.m_key.m_td) return false;
+			if (F.m_new_tile == n.m_key.m_tile && new_td == n.m_key.m_td) {
+				segment.m_loop = true;
+				break;
+			}
+
+			/* the speed penalty depends on the vehicle, remember the speed limit */
+			int max_speed = F.GetSpeedLimit();
+			if (max_speed != INT_MAX) {
+				if (!special_tile) segment.m_tiles.push_back({ tile, trackdir, segment_cost, INT_MAX });
+				segment.m_tiles.back().m_max_speed = max_speed;
+			}
 
 			/* add hilly terrain penalty */
 			segment_cost += Yapf().SlopeCost(tile, F.m_new_tile, trackdir);
 
-			/* add min/max speed penalties */
-			int min_speed = 0;
-			int max_veh_speed = v->GetDisplayMaxSpeed();
-			int max_speed = F.GetSpeedLimit(&min_speed);
-			if (max_speed < max_veh_speed) segment_cost += 1 * (max_veh_speed - max_speed);
-			if (min_speed > max_veh_speed) segment_cost += 10 * (min_speed - max_veh_speed);
-
 			/* move to the next tile */
 			tile = F.m_new_tile;
 			trackdir = new_td;
 			if (tiles > MAX_RV_PF_TILES) break;
 		}
 
-		/* save end of segment back to the node */
-		n.m_segment_last_tile = tile;
-		n.m_segment_last_td = trackdir;
+		segment.m_last_tile = tile;
+		segment.m_last_td = trackdir;
+		segment.m_cost = segment_cost;
+	}
+
+public:
+	/**
+	 * Called by YAPF to calculate the cost from the origin to the given node.
+	 *  Calculates only the cost of given node, adds it to the parent node cost
+	 *  and stores the result into Node::m_cost member
+	 */
+	inline bool PfCalcCost(Node &n, const TrackFollower *tf)
+	{
+		CachedData &segment = *n.m_segment;
+		if (segment.m_cost < 0) CalcSegment(n, segment, !Yapf().CanUseGlobalCache(n));
+
+		/* this is to handle the case where the starting tile is a junction custom bridge head,
+		 * and we have advanced across the bridge in the initial step */
+		int segment_cost = tf->m_tiles_skipped * YAPF_TILE_LENGTH;
+
+		/* add the variable costs, and end the segment early when the destination is on it */
+		const int max_veh_speed = Yapf().GetVehicle()->GetDisplayMaxSpeed();
+		int variable_cost = 0;
+		const CYapfRoadSegmentTile *last = NULL;
+		for (const CYapfRoadSegmentTile &t : segment.m_tiles) {
+			variable_cost += Yapf().RoadStopCost(t.m_tile, t.m_td);
+			if (Yapf().PfDetectDestinationTile(t.m_tile, t.m_td)) {
+				last = &t;
+				break;
+			}
+			if (t.m_max_speed < max_veh_speed) variable_cost += max_veh_speed - t.m_max_speed;
+		}
+
+		if (last != NULL) {
+			segment_cost += last->m_cost + variable_cost;
+			n.m_segment_last_tile = last->m_tile;
+			n.m_segment_last_td = last->m_td;
+		} else {
+			if (segment.m_loop) return false;
+			segment_cost += segment.m_cost + variable_cost;
+			n.m_segment_last_tile = segment.m_last_tile;
+			n.m_segment_last_td = segment.m_last_td;
+		}
 
 		/* save also tile cost */
 		int parent_cost = (n.m_parent != NULL) ? n.m_parent->m_cost : 0;
 		n.m_cost = parent_cost + segment_cost;
 		return true;
 	}
+
+	/**
+	 * Whether the segment of a node can be taken from, and stored in, the global cache.
+	 * Cached segments do not end at the destination, so they can only be used when the
+	 * destination can only be a road stop or depot.
+	 */
+	inline bool CanUseGlobalCache(Node &n)
+	{
+		return !m_disable_cache
+			&& (n.m_parent != NULL)
+			&& Yapf().IsDestinationRoadStopOrDepot();
+	}
+
+	inline void ConnectNodeToCachedData(Node &n, CachedData &ci)
+	{
+		n.m_segment = &ci;
+	}
+
+	void DisableCache(bool disable)
+	{
+		m_disable_cache = disable;
+	}
+};
+
+/**
+ * Segment cost cache provider for road YAPF. The global cache is shared by all road vehicles,
+ * so the key of a cached segment is completed with the properties of the vehicle it depends on.
+ */
+template <class Types>
+class CYapfSegmentCostCacheRoadT : public CYapfSegmentCostCacheGlobalT<Types> {
+public:
+	typedef CYapfSegmentCostCacheGlobalT<Types> Tglobal;
+	typedef typename Types::Tpf Tpf;              ///< the pathfinder class (derived from THIS class)
+	typedef typename Types::NodeList::Titem Node; ///< this will be our node type
+	typedef typename Node::CachedData CachedData;
+	typedef typename CachedData::Key CacheKey;
+
+protected:
+	/** to access inherited path finder */
+	inline Tpf& Yapf()
+	{
+		return *static_cast<Tpf *>(this);
+	}
+
+public:
+	/**
+	 * Called by YAPF to attach cached or local segment cost data to the given node.
+	 *  @return true if globally cached data were used or false if local data was used
+	 */
+	inline bool PfNodeCacheFetch(Node &n)
+	{
+		if (!Yapf().CanUseGlobalCache(n)) {
+			return Tglobal::Tlocal::PfNodeCacheFetch(n);
+		}
+		CacheKey key(n.GetKey(), Yapf().GetVehicle());
+		bool found;
+		CachedData &item = this->m_global_cache.Get(key, &found);
+		Yapf().ConnectNodeToCachedData(n, item);
+		return found;
+	}
 };
 
 
@@ -206,6 +322,12 @@ public:
 		return IsRoadDepotTile(tile);
 	}
 
+	/** Whether the destination can only be detected at road stop or road depot tiles. */
+	inline bool IsDestinationRoadStopOrDepot() const
+	{
+		return true;
+	}
+
 	/**
 	 * Called by YAPF to calculate cost estimate. Calculates distance to the destination
 	 *  adds it to the actual cost from origin and stores the sum to the Node::m_estimate
@@ -276,6 +398,12 @@ public:
 		return tile == m_destTile && ((m_destTrackdirs & TrackdirToTrackdirBits(trackdir)) != TRACKDIR_BIT_NONE);
 	}
 
+	/** Whether the destination can only be detected at road stop or road depot tiles. */
+	inline bool IsDestinationRoadStopOrDepot() const
+	{
+		return m_dest_station != INVALID_STATION || m_destTrackdirs == TRACKDIR_BIT_NONE || IsRoadDepotTile(m_destTile);
+	}
+
 	/**
 	 * Called by YAPF to calculate cost estimate. Calculates distance to the destination
 	 *  adds it to the actual cost from origin and stores the sum to the Node::m_estimate
@@ -347,8 +475,22 @@ public:
 
 	static Trackdir stChooseRoadTrack(const RoadVehicle *v, TileIndex tile, DiagDirection enterdir, bool &path_found)
 	{
-		Tpf pf;
-		return pf.ChooseRoadTrack(v, tile, enterdir, path_found);
+		Tpf pf1;
+		Trackdir result1 = pf1.ChooseRoadTrack(v, tile, enterdir, path_found);
+
+		if (_debug_yapfdesync_level > 0 || _debug_desync_level >= 2) {
+			Tpf pf2;
+			pf2.DisableCache(true);
+			bool path_found2;
+			Trackdir result2 = pf2.ChooseRoadTrack(v, tile, enterdir, path_found2);
+			int cost1 = pf1.GetBestNode() != NULL ? pf1.GetBestNode()->m_cost : -1;
+			int cost2 = pf2.GetBestNode() != NULL ? pf2.GetBestNode()->m_cost : -1;
+			if (result1 != result2 || path_found != path_found2 || cost1 != cost2) {
+				DEBUG(desync, 0, "CACHE ERROR: ChooseRoadTrack() = [%d, %d], cost [%d, %d], vehicle %u", result1, result2, cost1, cost2, v->unitnumber);
+			}
+		}
+
+		return result1;
 	}
 
 	inline Trackdir ChooseRoadTrack(const RoadVehicle *v, TileIndex tile, DiagDirection enterdir, bool &path_found)
@@ -444,8 +586,20 @@ public:
 
 	static FindDepotData stFindNearestDepot(const RoadVehicle *v, TileIndex tile, Trackdir td, int max_distance)
 	{
-		Tpf pf;
-		return pf.FindNearestDepot(v, tile, td, max_distance);
+		Tpf pf1;
+		FindDepotData result1 = pf1.FindNearestDepot(v, tile, td, max_distance);
+
+		if (_debug_yapfdesync_level > 0 || _debug_desync_level >= 2) {
+			Tpf pf2;
+			pf2.DisableCache(true);
+			FindDepotData result2 = pf2.FindNearestDepot(v, tile, td, max_distance);
+			if (result1.tile != result2.tile || result1.best_length != result2.best_length) {
+				DEBUG(desync, 0, "CACHE ERROR: FindNearestDepot() = [%d, %d], cost [%u, %u], vehicle %u",
+						result1.tile, result2.tile, result1.best_length, result2.best_length, v->unitnumber);
+			}
+		}
+
+		return result1;
 	}
 
 	/**
@@ -486,7 +640,7 @@ struct CYapfRoad_TypesT
 	typedef CYapfFollowRoadT<Types>           PfFollow;
 	typedef CYapfOriginTileT<Types>           PfOrigin;
 	typedef Tdestination<Types>               PfDestination;
-	typedef CYapfSegmentCostCacheNoneT<Types> PfCache;
+	typedef CYapfSegmentCostCacheRoadT<Types> PfCache;
 	typedef CYapfCostRoadT<Types>             PfCost;
 };
 
@@ -531,3 +685,8 @@ FindDepotData YapfRoadVehicleFindNearestDepot(const RoadVehicle *v, int max_dist
 
 	return pfnFindNearestDepot(v, tile, trackdir, max_distance);
 }
+
+void YapfNotifyRoadLayoutChange(TileIndex tile)
+{
+	CSegmentCostCacheBase::NotifyLayoutChange(tile, TRANSPORT_ROAD);
+}
@@ -24,6 +24,8 @@ SignalProgram::SignalProgram(TileIndex tile, Track track, bool raw)
 {
 	this->tile  = tile;
 	this->track = track;
+	this->code_valid = false;
+	this->cache_epoch = 0;
 	if (!raw) {
 		this->first_instruction = new SignalSpecial(this, PSO_FIRST);
 		this->last_instruction  = new SignalSpecial(this, PSO_LAST);
@@ -39,31 +41,6 @@ SignalProgram::~SignalProgram()
 	delete this->last_instruction;
 }
 
-struct SignalVM {
-	// Initial information
-	uint num_exits;                 ///< Number of exits from block
-	uint num_green;                 ///< Number of green exits from block
-	SignalProgram *program;         ///< The program being run
-
-	// Current state
-	SignalInstruction *instruction; ///< Instruction to execute next
-
-	// Output state
-	SignalState state;
-
-	void Execute()
-	{
-		DEBUG(misc, 6, "Begining execution of programmable signal on tile %x, track %d",
-					this->program->tile, this->program->track);
-		do {
-			DEBUG(misc, 10, "  Executing instruction %d, opcode %d", this->instruction->Id(), this->instruction->Opcode());
-			this->instruction->Evaluate(*this);
-		} while (this->instruction);
-
-		DEBUG(misc, 6, "Completed");
-	}
-};
-
 // -- Conditions
 
 SignalCondition::~SignalCondition()
@@ -73,15 +50,6 @@ SignalSimpleCondition::SignalSimpleCondition(SignalConditionCode code)
 	: SignalCondition(code)
 {}
 
-/* virtual */ bool SignalSimpleCondition::Evaluate(SignalVM &vm)
-{
-	switch (this->cond_code) {
-		case PSC_ALWAYS:    return true;
-		case PSC_NEVER:     return false;
-		default: NOT_REACHED();
-	}
-}
-
 SignalVariableCondition::SignalVariableCondition(SignalConditionCode code)
 	: SignalCondition(code)
 {
@@ -93,22 +61,22 @@ SignalVariableCondition::SignalVariableCondition(SignalConditionCode code)
 	value = 0;
 }
 
-/*virtual*/ bool SignalVariableCondition::Evaluate(SignalVM &vm)
-{
-	uint32 var_val;
-	switch (this->cond_code) {
-		case PSC_NUM_GREEN:  var_val = vm.num_green; break;
-		case PSC_NUM_RED:    var_val = vm.num_exits - vm.num_green; break;
-		default: NOT_REACHED();
-	}
-
-	switch (this->comparator) {
-		case SGC_EQUALS:            return var_val == this->value;
-		case SGC_NOT_EQUALS:        return var_val != this->value;
-		case SGC_LESS_THAN:         return var_val <  this->value;
-		case SGC_LESS_THAN_EQUALS:  return var_val <= this->value;
-		case SGC_MORE_THAN:         return var_val >  this->value;
-		case SGC_MORE_THAN_EQUALS:  return var_val >= this->value;
+/**
+ * Compare a variable of a signal program against a value.
+ * @param comparator The SignalComparator to use.
+ * @param var_val The value of the variable.
+ * @param value The value to compare against.
+ * @return The result of the comparison.
+ */
+static inline bool EvaluateSignalComparator(byte comparator, uint32 var_val, uint32 value)
+{
+	switch (comparator) {
+		case SGC_EQUALS:            return var_val == value;
+		case SGC_NOT_EQUALS:        return var_val != value;
+		case SGC_LESS_THAN:         return var_val <  value;
+		case SGC_LESS_THAN_EQUALS:  return var_val <= value;
+		case SGC_MORE_THAN:         return var_val >  value;
+		case SGC_MORE_THAN_EQUALS:  return var_val >= value;
 		case SGC_IS_TRUE:           return var_val != 0;
 		case SGC_IS_FALSE:          return !var_val;
 		default: NOT_REACHED();
@@ -164,16 +132,6 @@ void SignalStateCondition::SetSignal(TileIndex tile, Trackdir track)
 																					 this->this_sig);
 }
 
-/*virtual*/ bool SignalStateCondition::Evaluate(SignalVM& vm)
-{
-	if (!this->CheckSignalValid()) {
-		DEBUG(misc, 1, "Signal (%x, %d) has an invalid condition", this->this_sig.tile, this->this_sig.track);
-		return false;
-	}
-
-	return GetSignalStateByTrackdir(this->sig_tile, this->sig_track) == SIGNAL_STATE_GREEN;
-}
-
 // -- Instructions
 SignalInstruction::SignalInstruction(SignalProgram *prog, SignalOpcode op)
 	: opcode(op), previous(NULL), program(prog)
@@ -218,16 +176,6 @@ SignalSpecial::SignalSpecial(SignalProgram *prog, SignalOpcode op)
 	last->previous = first;
 }
 
-void SignalSpecial::Evaluate(SignalVM &vm)
-{
-	if (this->opcode == PSO_FIRST) {
-		DEBUG(misc, 7, "  Executing First");
-		vm.instruction = this->next;
-	} else {
-		DEBUG(misc, 7, "  Executing Last");
-		vm.instruction = NULL;
-	}
-}
 /*virtual*/ void SignalSpecial::SetNext(SignalInstruction *next_insn)
 {
 	this->next = next_insn;
@@ -259,12 +207,6 @@ SignalIf::PseudoInstruction::PseudoInstruction(SignalProgram *prog, SignalIf *bl
 	delete this;
 }
 
-/*virtual*/ void SignalIf::PseudoInstruction::Evaluate(SignalVM &vm)
-{
-	DEBUG(misc, 7, "  Executing If Pseudo Instruction %s", opcode == PSO_IF_ELSE ? "Else" : "Endif");
-	vm.instruction = this->block->after;
-}
-
 /*virtual*/ void SignalIf::PseudoInstruction::SetNext(SignalInstruction *next_insn)
 {
 	if (this->opcode == PSO_IF_ELSE) {
@@ -310,17 +252,6 @@ void SignalIf::SetCondition(SignalCondition *cond)
 	this->condition = cond;
 }
 
-/*virtual*/ void SignalIf::Evaluate(SignalVM &vm)
-{
-	bool is_true = this->condition->Evaluate(vm);
-	DEBUG(misc, 7, "  Executing If, taking %s branch", is_true ? "then" : "else");
-	if (is_true) {
-		vm.instruction = this->if_true;
-	} else {
-		vm.instruction = this->if_false;
-	}
-}
-
 /*virtual*/ void SignalIf::SetNext(SignalInstruction *next_insn)
 {
 	this->if_true = next_insn;
@@ -341,13 +272,6 @@ SignalSet::SignalSet(SignalProgram *prog, SignalState state)
 	delete this;
 }
 
-/*virtual*/ void SignalSet::Evaluate(SignalVM &vm)
-{
-	DEBUG(misc, 7, "  Executing SetSignal, making %s", this->to_state? "green" : "red");
-	vm.state       = this->to_state;
-	vm.instruction = NULL;
-}
-
 
 /*virtual*/ void SignalSet::SetNext(SignalInstruction *next_insn)
 {
@@ -396,21 +320,166 @@ void FreeSignalPrograms()
 	}
 }
 
+/**
+ * Append the code of a chain of instructions to a compiled program.
+ * The chain ends at the end of the program, or at the else or endif of the block it is part of.
+ * @param code The code to append to.
+ * @param insn The first instruction of the chain.
+ */
+static void CompileSignalInstructions(std::vector<SignalCode> &code, SignalInstruction *insn)
+{
+	for (;;) {
+		switch (insn->Opcode()) {
+			case PSO_FIRST:
+				insn = static_cast<SignalSpecial *>(insn)->next;
+				break;
+
+			case PSO_SET_SIGNAL: {
+				/* Setting the signal ends the execution, whatever follows is never reached. */
+				SignalCode c = { SCO_SET, 0, 0, static_cast<SignalSet *>(insn)->to_state, NULL };
+				code.push_back(c);
+				return;
+			}
+
+			case PSO_IF: {
+				SignalIf *si = static_cast<SignalIf *>(insn);
+				SignalCode c = { SCO_JUMP, 0, 0, 0, NULL };
+				switch (si->condition->ConditionCode()) {
+					case PSC_ALWAYS:
+					case PSC_NEVER: // an unconditional jump to the else branch
+						break;
+
+					case PSC_NUM_GREEN:
+					case PSC_NUM_RED: {
+						const SignalVariableCondition *vc = static_cast<const SignalVariableCondition *>(si->condition);
+						c.op = vc->ConditionCode() == PSC_NUM_GREEN ? SCO_IF_NUM_GREEN : SCO_IF_NUM_RED;
+						c.comparator = vc->comparator;
+						c.value = vc->value;
+						break;
+					}
+
+					case PSC_SIGNAL_STATE:
+						c.op = SCO_IF_SIGNAL_STATE;
+						c.cond = static_cast<SignalStateCondition *>(si->condition);
+						break;
+
+					default: NOT_REACHED();
+				}
+
+				/* The condition jumps to the else branch when false; an always true condition needs no code at all. */
+				size_t cond = SIZE_MAX;
+				if (si->condition->ConditionCode() != PSC_ALWAYS) {
+					cond = code.size();
+					code.push_back(c);
+				}
+				CompileSignalInstructions(code, si->if_true);
+
+				size_t jump = code.size();
+				SignalCode j = { SCO_JUMP, 0, 0, 0, NULL };
+				code.push_back(j);
+				if (cond != SIZE_MAX) code[cond].target = (uint16)code.size();
+
+				CompileSignalInstructions(code, si->if_false);
+				code[jump].target = (uint16)code.size();
+
+				insn = si->after;
+				break;
+			}
+
+			case PSO_LAST:
+			case PSO_IF_ELSE:
+			case PSO_IF_ENDIF:
+				return;
+
+			default: NOT_REACHED();
+		}
+	}
+}
+
+/** Flatten the instructions of the program into #code. */
+void SignalProgram::Compile()
+{
+	this->code.clear();
+	CompileSignalInstructions(this->code, this->first_instruction);
+	this->code_valid = true;
+}
+
+/**
+ * Execute the compiled code of a signal program.
+ * @param program The program to execute.
+ * @param num_exits Number of exits from the block of the signal.
+ * @param num_green Number of green exits from the block of the signal.
+ * @return The state the signal is to be set to; red when the end of the program is reached.
+ */
+static SignalState ExecuteSignalProgram(SignalProgram *program, uint num_exits, uint num_green)
+{
+	const SignalCode *code = program->code.data();
+	const size_t size = program->code.size();
+
+	size_t pc = 0;
+	while (pc < size) {
+		const SignalCode &c = code[pc];
+		bool result;
+		switch (c.op) {
+			case SCO_SET:
+				return (SignalState)c.value;
+
+			case SCO_JUMP:
+				pc = c.target;
+				continue;
+
+			case SCO_IF_NUM_GREEN:
+				result = EvaluateSignalComparator(c.comparator, num_green, c.value);
+				break;
+
+			case SCO_IF_NUM_RED:
+				result = EvaluateSignalComparator(c.comparator, num_exits - num_green, c.value);
+				break;
+
+			case SCO_IF_SIGNAL_STATE:
+				if (!c.cond->CheckSignalValid()) {
+					DEBUG(misc, 1, "Signal (%x, %d) has an invalid condition", program->tile, program->track);
+					result = false;
+				} else {
+					result = GetSignalStateByTrackdir(c.cond->sig_tile, c.cond->sig_track) == SIGNAL_STATE_GREEN;
+				}
+				break;
+
+			default: NOT_REACHED();
+		}
+		pc = result ? pc + 1 : c.target;
+	}
+	return SIGNAL_STATE_RED;
+}
+
+/**
+ * Run a signal program.
+ * The result only depends on the number of (green) exits and the state of the signals in the map,
+ * so it is remembered until any signal changes its state; a signal which is evaluated again for
+ * the same block does not run its program again.
+ * @param ref The signal to run the program of.
+ * @param num_exits Number of exits from the block of the signal.
+ * @param num_green Number of green exits from the block of the signal.
+ * @return The state the signal is to be set to.
+ */
 SignalState RunSignalProgram(SignalReference ref, uint num_exits, uint num_green)
 {
 	SignalProgram *program = GetSignalProgram(ref);
-	SignalVM vm;
-	vm.program = program;
-	vm.num_exits = num_exits;
-	vm.num_green = num_green;
+	if (program->cache_epoch == _signal_state_epoch && program->cache_exits == num_exits && program->cache_green == num_green) {
+		return program->cache_state;
+	}
+
+	if (!program->code_valid) program->Compile();
 
-	vm.instruction = program->first_instruction;
-	vm.state = SIGNAL_STATE_RED;
+	DEBUG(misc, 7, "Running program of signal (%x, %d): %d exits, of which %d green", ref.tile, ref.track, num_exits, num_green);
+	SignalState state = ExecuteSignalProgram(program, num_exits, num_green);
+	DEBUG(misc, 7, "Returning %s", state == SIGNAL_STATE_GREEN ? "green" : "red");
 
-	DEBUG(misc, 7, "%d exits, of which %d green", vm.num_exits, vm.num_green);
-	vm.Execute();
-	DEBUG(misc, 7, "Returning %s", vm.state == SIGNAL_STATE_GREEN ? "green" : "red");
-	return vm.state;
+	program->cache_epoch = _signal_state_epoch;
+	program->cache_exits = num_exits;
+	program->cache_green = num_green;
+	program->cache_state = state;
+	return state;
 }
 
 void RemoveProgramDependencies(SignalReference dependency_target, SignalReference signal_to_update)
@@ -428,6 +497,7 @@ void RemoveProgramDependencies(SignalReference dependency_target, SignalReferenc
 				}
 			}
 		}
+	prog->InvalidateCode();
 
 	InvalidateWindowData(WC_SIGNAL_PROGRAM, (signal_to_update.tile << 3) | signal_to_update.track);
 	AddTrackToSignalBuffer(signal_to_update.tile, signal_to_update.track, GetTileOwner(signal_to_update.tile));
@@ -508,6 +578,7 @@ CommandCost CmdInsertSignalInstruction(TileIndex tile, DoCommandFlag flags, uint
 	}
 
 	if (!exec) return CommandCost();
+	prog->InvalidateCode();
 	AddTrackToSignalBuffer(tile, track, GetTileOwner(tile));
 	UpdateSignalsInBuffer();
 	InvalidateWindowData(WC_SIGNAL_PROGRAM, (tile << 3) | track);
@@ -641,6 +712,7 @@ CommandCost CmdModifySignalInstruction(TileIndex tile, DoCommandFlag flags, uint
 
 	if (!exec) return CommandCost();
 
+	prog->InvalidateCode();
 	AddTrackToSignalBuffer(tile, track, GetTileOwner(tile));
 	UpdateSignalsInBuffer();
 	InvalidateWindowData(WC_SIGNAL_PROGRAM, (tile << 3) | track);
@@ -694,6 +766,7 @@ CommandCost CmdRemoveSignalInstruction(TileIndex tile, DoCommandFlag flags, uint
 	}
 
 	if (!exec) return CommandCost();
+	prog->InvalidateCode();
 	AddTrackToSignalBuffer(tile, track, GetTileOwner(tile));
 	UpdateSignalsInBuffer();
 	InvalidateWindowData(WC_SIGNAL_PROGRAM, (tile << 3) | track);
@@ -820,6 +893,7 @@ CommandCost CmdSignalProgramMgmt(TileIndex tile, DoCommandFlag flags, uint32 p1,
 			return CMD_ERROR;
 	}
 	if (exec) {
+		prog->InvalidateCode();
 		AddTrackToSignalBuffer(tile, track, GetTileOwner(tile));
 		UpdateSignalsInBuffer();
 		InvalidateWindowData(WC_SIGNAL_PROGRAM, (tile << 3) | track);
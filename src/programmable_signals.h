@@ -14,18 +14,14 @@
 #include "rail_map.h"
 #include "core/smallvec_type.hpp"
 #include <map>
+#include <vector>
 
 /** @defgroup progsigs Programmable Signals */
 ///@{
 
-/** The Programmable Signal virtual machine.
- *
- * This structure contains the state of the currently executing signal program.
- */
-struct SignalVM;
-
 class SignalInstruction;
 class SignalSpecial;
+class SignalStateCondition;
 typedef SmallVector<SignalInstruction*, 4> InstructionList;
 
 enum SignalProgramMgmtCode {
@@ -33,11 +29,37 @@ enum SignalProgramMgmtCode {
 	SPMC_CLONE,       ///< Clone program
 };
 
+/** Operation of the flat code a signal program is compiled to. */
+enum SignalCodeOp {
+	SCO_SET,              ///< Set the signal to the state in value, and stop
+	SCO_JUMP,             ///< Continue at target
+	SCO_IF_NUM_GREEN,     ///< Continue at target unless the number of green exits matches comparator and value
+	SCO_IF_NUM_RED,       ///< Continue at target unless the number of red exits matches comparator and value
+	SCO_IF_SIGNAL_STATE,  ///< Continue at target unless the signal of cond is green
+};
+
+/** One operation of the flat code a signal program is compiled to. */
+struct SignalCode {
+	SignalCodeOp op;             ///< The operation
+	byte comparator;             ///< SignalComparator of the SCO_IF_NUM_* operations
+	uint16 target;               ///< Index to continue at for jumps and false conditions
+	uint32 value;                ///< Signal state or value to compare against
+	SignalStateCondition *cond;  ///< Condition of SCO_IF_SIGNAL_STATE
+};
+
 /** The actual programmable signal information */
 struct SignalProgram {
 	SignalProgram(TileIndex tile, Track track, bool raw = false);
 	~SignalProgram();
 	void DebugPrintProgram();
+	void Compile();
+
+	/** Mark the compiled code and the cached result as outdated; to be called whenever the instructions change. */
+	inline void InvalidateCode()
+	{
+		this->code_valid = false;
+		this->cache_epoch = 0;
+	}
 
 	TileIndex tile;
 	Track track;
@@ -45,6 +67,14 @@ struct SignalProgram {
 	SignalSpecial *first_instruction;
 	SignalSpecial *last_instruction;
 	InstructionList instructions;
+
+	std::vector<SignalCode> code;  ///< The instructions flattened to the form which is executed
+	bool code_valid;               ///< Whether #code is up to date with the instructions
+
+	uint64 cache_epoch;            ///< #_signal_state_epoch at which #cache_state was determined, 0 if none
+	uint cache_exits;              ///< Number of exits #cache_state was determined for
+	uint cache_green;              ///< Number of green exits #cache_state was determined for
+	SignalState cache_state;       ///< Result of the last run of the program
 };
 
 /** Programmable Signal opcode.
@@ -84,9 +114,6 @@ public:
 	/// Insert this instruction, placing it before @p before_insn
 	virtual void Insert(SignalInstruction *before_insn);
 
-	/// Evaluate the instruction. The instruction should update the VM state.
-	virtual void Evaluate(SignalVM &vm) = 0;
-
 	/// Remove the instruction. When removing itself, an instruction should
 	/// <ul>
 	///   <li>Set next->previous to previous
@@ -140,9 +167,6 @@ public:
 	/// Get the condition's code
 	inline SignalConditionCode ConditionCode() const { return this->cond_code; }
 
-	/// Evaluate the condition
-	virtual bool Evaluate(SignalVM& vm) = 0;
-
 	/// Destroy the condition. Any children should also be destroyed
 	virtual ~SignalCondition();
 
@@ -159,7 +183,6 @@ protected:
 class SignalSimpleCondition: public SignalCondition {
 public:
 	SignalSimpleCondition(SignalConditionCode code);
-	virtual bool Evaluate(SignalVM& vm);
 };
 
 /** Comparator to use for variable conditions. */
@@ -196,9 +219,6 @@ public:
 
 	SignalComparator comparator;
 	uint32 value;
-
-	/// Evaluates the condition
-	virtual bool Evaluate(SignalVM &vm);
 };
 
 /** A condition which is based upon the state of another signal. */
@@ -211,7 +231,6 @@ class SignalStateCondition: public SignalCondition {
 		bool CheckSignalValid();
 		void Invalidate();
 
-		virtual bool Evaluate(SignalVM& vm);
 		virtual ~SignalStateCondition();
 
 		SignalReference this_sig;
@@ -243,12 +262,6 @@ public:
 	 */
 	SignalSpecial(SignalProgram *prog, SignalOpcode op);
 
-	/** Evaluates the instruction. If this is an Start instruction, flow will be
-	 * vectored to the first instruction; if it is an End instruction, the program
-	 * will terminate and the signal will be left red.
-	 */
-	virtual void Evaluate(SignalVM &vm);
-
 	/** Links the first and last instructions in the program. Generally only to be
 	 * called from the SignalProgram constructor.
 	 */
@@ -307,11 +320,6 @@ public:
 		 */
 		virtual void Remove();
 
-		/** Evaluate the pseudo instruction. This involves vectoring execution to
-		 * the instruction after the if.
-		 */
-		virtual void Evaluate(SignalVM &vm);
-
 		/** The block to which this instruction belongs */
 		SignalIf *block;
 		virtual void SetNext(SignalInstruction *next_insn);
@@ -327,9 +335,6 @@ public:
 	/** Sets the instruction's condition, and releases the old condition */
 	void SetCondition(SignalCondition *cond);
 
-	/** Evaluates the If and takes the appropriate branch */
-	virtual void Evaluate(SignalVM &vm);
-
 	virtual void Insert(SignalInstruction *before_insn);
 
 	/** Removes the If and all of its children */
@@ -349,7 +354,6 @@ public:
 	/// Constructs the instruction and sets the state the signal is to be set to
 	SignalSet(SignalProgram *prog, SignalState = SIGNAL_STATE_RED);
 
-	virtual void Evaluate(SignalVM &vm);
 	virtual void Remove();
 
 	/// The state to set the signal to
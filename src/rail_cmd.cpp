@@ -604,6 +604,8 @@ CommandCost CmdBuildSingleRail(TileIndex tile, DoCommandFlag flags, uint32 p1, u
 		MarkTileDirtyByTile(tile);
 		AddTrackToSignalBuffer(tile, track, _current_company);
 		YapfNotifyTrackLayoutChange(tile, track);
+		/* a level crossing might have been built */
+		if (IsTileType(tile, MP_ROAD)) YapfNotifyRoadLayoutChange(tile);
 	}
 
 	cost.AddCost(RailBuildCost(railtype));
@@ -751,6 +753,8 @@ CommandCost CmdRemoveSingleRail(TileIndex tile, DoCommandFlag flags, uint32 p1,
 			AddTrackToSignalBuffer(tile, track, owner);
 			YapfNotifyTrackLayoutChange(tile, track);
 		}
+		/* a level crossing might have been removed */
+		if (IsTileType(tile, MP_ROAD)) YapfNotifyRoadLayoutChange(tile);
 
 		if (v != NULL) TryPathReserve(v, true);
 	}
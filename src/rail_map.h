@@ -86,6 +86,7 @@ static inline void SetHasSignals(TileIndex tile, bool signals)
 {
 	assert(IsPlainRailTile(tile));
 	SB(_m[tile].m5, 6, 1, signals);
+	SignalStateChanged();
 }
 
 /**
@@ -358,6 +359,7 @@ static inline void SetSignalVariant(TileIndex t, Track track, SignalVariant v)
  */
 static inline void SetSignalStates(TileIndex tile, uint state)
 {
+	if (GB(_m[tile].m4, 4, 4) != GB(state, 0, 4)) SignalStateChanged();
 	SB(_m[tile].m4, 4, 4, state);
 }
 
@@ -390,6 +392,7 @@ static inline SignalState GetSingleSignalState(TileIndex t, byte signalbit)
 static inline void SetPresentSignals(TileIndex tile, uint signals)
 {
 	SB(_m[tile].m3, 4, 4, signals);
+	SignalStateChanged();
 }
 
 /**
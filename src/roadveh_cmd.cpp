@@ -38,6 +38,7 @@
 #include "zoom_func.h"
 #include "scope_info.h"
 #include "string_func.h"
+#include "framerate_type.h"
 
 #include "table/strings.h"
 
@@ -1667,6 +1668,8 @@ bool RoadVehicle::Tick()
 	this->tick_counter++;
 
 	if (this->IsFrontEngine()) {
+		PerformanceAccumulator framerate(PFE_GL_ROADVEHS);
+
 		if (!(this->IsRoadVehicleStopped())) this->running_ticks++;
 		return RoadVehController(this);
 	}
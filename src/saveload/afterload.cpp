@@ -28,6 +28,7 @@
 #include "../roadveh.h"
 #include "../train.h"
 #include "../station_base.h"
+#include "../station_func.h"
 #include "../waypoint_base.h"
 #include "../roadstop_base.h"
 #include "../dock_base.h"
@@ -56,6 +57,7 @@
 #include "../smallmap_gui.h"
 #include "../news_func.h"
 #include "../order_backup.h"
+#include "../order_func.h"
 #include "../error.h"
 #include "../disaster_vehicle.h"
 #include "../tracerestrict.h"
@@ -1492,6 +1494,7 @@ bool AfterLoadGame()
 	}
 
 	YapfNotifyTrackLayoutChange(INVALID_TILE, INVALID_TRACK);
+	YapfNotifyRoadLayoutChange(INVALID_TILE);
 
 	if (IsSavegameVersionBefore(34)) {
 		Company *c;
@@ -3441,6 +3444,8 @@ bool AfterLoadGame()
 	AfterLoadLabelMaps();
 	AfterLoadCompanyStats();
 	AfterLoadStoryBook();
+	RebuildStationTickSchedule();
+	RebuildOrderListDestinationIndex();
 
 	GamelogPrintDebug(1);
 
@@ -80,6 +80,9 @@ const SlxiSubChunkInfo _sl_xv_sub_chunk_infos[] = {
 	{ XSLFI_MORE_TOWN_GROWTH_RATES, XSCF_NULL,                1,   1, "more_town_growth_rates",    NULL, NULL, NULL        },
 	{ XSLFI_MULTIPLE_DOCKS,         XSCF_NULL,                1,   1, "multiple_docks",            NULL, NULL, "DOCK"      },
 	{ XSLFI_TIMETABLE_EXTRA,        XSCF_NULL,                1,   1, "timetable_extra",           NULL, NULL, "ORDX"      },
+	{ XSLFI_LINKGRAPH_PARALLEL_MCF, XSCF_NULL,                1,   1, "linkgraph_parallel_mcf",    NULL, NULL, NULL        },
+	{ XSLFI_TRAIN_PATH_PREDICTION,  XSCF_NULL,                1,   1, "train_path_prediction",     NULL, NULL, NULL        },
+	{ XSLFI_RAIL_LANDMARKS,         XSCF_NULL,                1,   1, "rail_landmarks",            NULL, NULL, NULL        },
 	{ XSLFI_NULL, XSCF_NULL, 0, 0, NULL, NULL, NULL, NULL },// This is the end marker
 };
 
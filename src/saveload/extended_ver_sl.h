@@ -54,6 +54,9 @@ enum SlXvFeatureIndex {
 	XSLFI_MORE_TOWN_GROWTH_RATES,                 ///< More town growth rates
 	XSLFI_MULTIPLE_DOCKS,                         ///< Multiple docks
 	XSLFI_TIMETABLE_EXTRA,                        ///< Vehicle timetable extra fields
+	XSLFI_LINKGRAPH_PARALLEL_MCF,                 ///< Link graph setting for the parallel flow calculation
+	XSLFI_TRAIN_PATH_PREDICTION,                  ///< Path finder setting for searching train paths in advance
+	XSLFI_RAIL_LANDMARKS,                         ///< Path finder setting for estimating train path lengths from rail landmarks
 
 	XSLFI_RIFF_HEADER_60_BIT,                     ///< Size field in RIFF chunk header is 60 bit
 	XSLFI_HEIGHT_8_BIT,                           ///< Map tile height is 8 bit instead of 4 bit, but savegame version may be before this became true in trunk
@@ -16,6 +16,7 @@
 #include "../dock_base.h"
 #include "../vehicle_base.h"
 #include "../newgrf_station.h"
+#include "../station_func.h"
 
 #include "saveload.h"
 #include "table/strings.h"
@@ -528,6 +529,8 @@ static void RealSave_STNN(BaseStation *bst)
 
 static void Save_STNN()
 {
+	SyncStationRatingTickCounters();
+
 	BaseStation *st;
 	/* Write the stations */
 	FOR_ALL_BASE_STATIONS(st) {
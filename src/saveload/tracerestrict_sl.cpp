@@ -176,6 +176,9 @@ void AfterLoadTraceRestrict()
 			iter != _tracerestrictprogram_mapping.end(); ++iter) {
 		_tracerestrictprogram_pool.Get(iter->second.program_id)->IncrementRefCount();
 	}
+
+	/* the programs were compiled before the slots they refer to were loaded */
+	TraceRestrictCompileAllPrograms();
 }
 
 extern const ChunkHandler _trace_restrict_chunk_handlers[] = {
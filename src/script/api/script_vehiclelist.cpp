@@ -16,6 +16,7 @@
 #include "script_station.hpp"
 #include "../../depot_map.h"
 #include "../../vehicle_base.h"
+#include "../../order_func.h"
 
 #include "../../safeguards.h"
 
@@ -31,17 +32,19 @@ ScriptVehicleList_Station::ScriptVehicleList_Station(StationID station_id)
 {
 	if (!ScriptBaseStation::IsValidBaseStation(station_id)) return;
 
-	const Vehicle *v;
-	FOR_ALL_VEHICLES(v) {
-		if ((v->owner == ScriptObject::GetCompany() || ScriptObject::GetCompany() == OWNER_DEITY) && v->IsPrimaryVehicle()) {
-			const Order *order;
+	std::vector<const OrderList *> lists;
+	GetOrderListsWithDestination(lists, station_id, false);
 
-			FOR_VEHICLE_ORDERS(v, order) {
-				if ((order->IsType(OT_GOTO_STATION) || order->IsType(OT_GOTO_WAYPOINT)) && order->GetDestination() == station_id) {
-					this->AddItem(v->index);
-					break;
-				}
-			}
+	for (const OrderList *orderlist : lists) {
+		/* The order lists with only implicit orders to the station do not count. */
+		const Order *order;
+		for (order = orderlist->GetFirstOrder(); order != NULL; order = order->next) {
+			if ((order->IsType(OT_GOTO_STATION) || order->IsType(OT_GOTO_WAYPOINT)) && order->GetDestination() == station_id) break;
+		}
+		if (order == NULL) continue;
+
+		for (const Vehicle *v = orderlist->GetFirstSharedVehicle(); v != NULL; v = v->NextShared()) {
+			if ((v->owner == ScriptObject::GetCompany() || ScriptObject::GetCompany() == OWNER_DEITY) && v->IsPrimaryVehicle()) this->AddItem(v->index);
 		}
 	}
 }
@@ -279,6 +279,7 @@ struct NetworkSettings {
 	uint16 max_init_time;                                 ///< maximum amount of time, in game ticks, a client may take to initiate joining
 	uint16 max_join_time;                                 ///< maximum amount of time, in game ticks, a client may take to sync up during joining
 	uint16 max_download_time;                             ///< maximum amount of time, in game ticks, a client may take to download the map
+	uint16 map_snapshot_window;                           ///< maximum age, in game ticks, of a map snapshot joining clients download together with the clients already downloading it
 	uint16 max_password_time;                             ///< maximum amount of time, in game ticks, a client may take to enter the password
 	uint16 max_lag_time;                                  ///< maximum amount of time, in game ticks, a client may be lagging behind the server
 	bool   pause_on_join;                                 ///< pause the game when people join
@@ -459,6 +460,9 @@ struct YAPFSettings {
 	uint32 rail_longer_platform_per_tile_penalty;  ///< penalty for longer  station platform than train (per tile)
 	uint32 rail_shorter_platform_penalty;          ///< penalty for shorter station platform than train
 	uint32 rail_shorter_platform_per_tile_penalty; ///< penalty for shorter station platform than train (per tile)
+
+	bool   rail_path_prediction;                   ///< search the paths of trains which will choose a track this tick in advance, on worker threads
+	bool   rail_landmarks;                         ///< estimate the remaining path length of trains from distances to landmarks of the rail network
 };
 
 /** Settings related to all pathfinders. */
@@ -576,6 +580,7 @@ struct LinkGraphSettings {
 	uint8 demand_size;                          ///< influence of supply ("station size") on the demand function
 	uint8 demand_distance;                      ///< influence of distance between stations on the demand function
 	uint8 short_path_saturation;                ///< percentage up to which short paths are saturated before saturating most capacious paths
+	bool parallel_mcf;                          ///< search the paths from several nodes at once in the flow calculation
 
 	inline DistributionType GetDistributionType(CargoID cargo) const {
 		if (IsCargoInClass(cargo, CC_PASSENGERS)) return this->distribution_pax;
@@ -204,6 +204,8 @@ static SmallSet<DiagDirection, SIG_GLOB_SIZE> _globset("_globset"); ///< set of
 
 static uint _num_signals_evaluated; ///< Number of programmable signals evaluated
 
+uint64 _signal_state_epoch = 1; ///< Incremented whenever the state or presence of a signal changes, see SignalStateChanged
+
 /** Check whether there is a train on rail, not in a depot */
 static Vehicle *TrainOnTileEnum(Vehicle *v, void *)
 {
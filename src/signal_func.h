@@ -19,6 +19,17 @@
 #include "company_type.h"
 #include "debug.h"
 
+extern uint64 _signal_state_epoch;
+
+/**
+ * Note that the state or the presence of a signal in the map changed.
+ * This invalidates the remembered results of the signal programs.
+ */
+static inline void SignalStateChanged()
+{
+	_signal_state_epoch++;
+}
+
 /**
  * Maps a trackdir to the bit that stores its status in the map arrays, in the
  * direction along with the trackdir.
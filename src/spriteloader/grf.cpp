@@ -34,6 +34,108 @@ enum SpriteColourComponent {
 };
 DECLARE_ENUM_AS_BIT_SET(SpriteColourComponent)
 
+/**
+ * Reader of sprite data, which never reads beyond the end of the file. It reads the file
+ * in memory when possible, and through the Fio data buffer otherwise; only the main thread
+ * may use it in the latter case.
+ */
+struct SpriteDataReader {
+	uint8 file_slot;  ///< Slot of the file.
+	FioFileView file; ///< View on the file; its data is \c NULL when reading through the Fio data buffer.
+	size_t pos;       ///< File position of the next byte to read.
+	bool overrun;     ///< Whether more was read or skipped than the file contains.
+
+	/**
+	 * Start reading a file at a position.
+	 * @param file_slot Slot of the file to read.
+	 * @param file_pos The file position to start at.
+	 */
+	SpriteDataReader(uint8 file_slot, size_t file_pos) : file_slot(file_slot), file(FioAcquireFileView(file_slot)), pos(file_pos), overrun(false)
+	{
+		if (file_pos < this->file.begin || file_pos > this->file.end) {
+			this->pos = this->file.end;
+			this->overrun = true;
+		}
+		if (this->file.data == NULL) FioSeekToFile(file_slot, this->pos);
+	}
+
+	~SpriteDataReader()
+	{
+		FioReleaseFileView(this->file_slot, this->file);
+	}
+
+	/**
+	 * Read a byte.
+	 * @return The byte, or 0 when at the end of the file.
+	 */
+	inline byte ReadByte()
+	{
+		if (this->pos == this->file.end) {
+			this->overrun = true;
+			return 0;
+		}
+		byte b = this->file.data != NULL ? this->file.data[this->pos - this->file.begin] : FioReadByte();
+		this->pos++;
+		return b;
+	}
+
+	/**
+	 * Read a word (16 bits) in little endian format.
+	 * @return The word.
+	 */
+	inline uint16 ReadWord()
+	{
+		byte b = this->ReadByte();
+		return (this->ReadByte() << 8) | b;
+	}
+
+	/**
+	 * Read a double word (32 bits) in little endian format.
+	 * @return The double word.
+	 */
+	inline uint32 ReadDword()
+	{
+		uint b = this->ReadWord();
+		return (this->ReadWord() << 16) | b;
+	}
+
+	/**
+	 * Read a block of bytes.
+	 * @param dest The buffer to read into.
+	 * @param size The number of bytes to read.
+	 * @return False if the file does not contain that many bytes anymore.
+	 */
+	inline bool ReadBlock(byte *dest, size_t size)
+	{
+		if (size > this->file.end - this->pos) {
+			this->overrun = true;
+			return false;
+		}
+		if (this->file.data != NULL) {
+			memcpy(dest, this->file.data + (this->pos - this->file.begin), size);
+		} else {
+			FioReadBlock(dest, size);
+		}
+		this->pos += size;
+		return true;
+	}
+
+	/**
+	 * Skip bytes.
+	 * @param size The number of bytes to skip.
+	 */
+	inline void Skip(size_t size)
+	{
+		if (size > this->file.end - this->pos) {
+			this->pos = this->file.end;
+			this->overrun = true;
+		} else {
+			if (this->file.data == NULL) FioSkipBytes((int)size);
+			this->pos += size;
+		}
+	}
+};
+
 /**
  * We found a corrupted sprite. This means that the sprite itself
  * contains invalid data or is too small for the given dimensions.
@@ -59,6 +161,7 @@ static bool WarnCorruptSprite(uint8 file_slot, size_t file_pos, int line)
  * @param[in,out] sprite Filled with the sprite image data.
  * @param file_slot File slot.
  * @param file_pos File position.
+ * @param reader Reader positioned at the encoded image data.
  * @param sprite_type Type of the sprite we're decoding.
  * @param num Size of the decompressed sprite.
  * @param type Type of the encoded sprite.
@@ -67,7 +170,7 @@ static bool WarnCorruptSprite(uint8 file_slot, size_t file_pos, int line)
  * @param container_format Container format of the GRF this sprite is in.
  * @return True if the sprite was successfully loaded.
  */
-bool DecodeSingleSprite(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t file_pos, SpriteType sprite_type, int64 num, byte type, ZoomLevel zoom_lvl, byte colour_fmt, byte container_format)
+bool DecodeSingleSprite(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t file_pos, SpriteDataReader &reader, SpriteType sprite_type, int64 num, byte type, ZoomLevel zoom_lvl, byte colour_fmt, byte container_format)
 {
 	AutoFreePtr<byte> dest_orig(MallocT<byte>(num));
 	byte *dest = dest_orig;
@@ -75,20 +178,17 @@ bool DecodeSingleSprite(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t fi
 
 	/* Read the file, which has some kind of compression */
 	while (num > 0) {
-		int8 code = FioReadByte();
+		int8 code = reader.ReadByte();
 
 		if (code >= 0) {
 			/* Plain bytes to read */
 			int size = (code == 0) ? 0x80 : code;
 			num -= size;
-			if (num < 0) return WarnCorruptSprite(file_slot, file_pos, __LINE__);
-			for (; size > 0; size--) {
-				*dest = FioReadByte();
-				dest++;
-			}
+			if (num < 0 || !reader.ReadBlock(dest, size)) return WarnCorruptSprite(file_slot, file_pos, __LINE__);
+			dest += size;
 		} else {
 			/* Copy bytes from earlier in the sprite */
-			const uint data_offset = ((code & 7) << 8) | FioReadByte();
+			const uint data_offset = ((code & 7) << 8) | reader.ReadByte();
 			if (dest - data_offset < dest_orig) return WarnCorruptSprite(file_slot, file_pos, __LINE__);
 			int size = -(code >> 3);
 			num -= size;
@@ -100,7 +200,7 @@ bool DecodeSingleSprite(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t fi
 		}
 	}
 
-	if (num != 0) return WarnCorruptSprite(file_slot, file_pos, __LINE__);
+	if (num != 0 || reader.overrun) return WarnCorruptSprite(file_slot, file_pos, __LINE__);
 
 	sprite->AllocateData(zoom_lvl, sprite->width * sprite->height);
 
@@ -220,24 +320,24 @@ uint8 LoadSpriteV1(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t file_po
 	/* Check the requested colour depth. */
 	if (load_32bpp) return 0;
 
-	/* Open the right file and go to the correct position */
-	FioSeekToFile(file_slot, file_pos);
+	/* Read the file from the correct position */
+	SpriteDataReader reader(file_slot, file_pos);
 
 	/* Read the size and type */
-	int num = FioReadWord();
-	byte type = FioReadByte();
+	int num = reader.ReadWord();
+	byte type = reader.ReadByte();
 
 	/* Type 0xFF indicates either a colourmap or some other non-sprite info; we do not handle them here */
 	if (type == 0xFF) return 0;
 
 	ZoomLevel zoom_lvl = (sprite_type != ST_MAPGEN) ? ZOOM_LVL_OUT_4X : ZOOM_LVL_NORMAL;
 
-	sprite[zoom_lvl].height = FioReadByte();
-	sprite[zoom_lvl].width  = FioReadWord();
-	sprite[zoom_lvl].x_offs = FioReadWord();
-	sprite[zoom_lvl].y_offs = FioReadWord();
+	sprite[zoom_lvl].height = reader.ReadByte();
+	sprite[zoom_lvl].width  = reader.ReadWord();
+	sprite[zoom_lvl].x_offs = reader.ReadWord();
+	sprite[zoom_lvl].y_offs = reader.ReadWord();
 
-	if (sprite[zoom_lvl].width > INT16_MAX) {
+	if (reader.overrun || sprite[zoom_lvl].width > INT16_MAX) {
 		WarnCorruptSprite(file_slot, file_pos, __LINE__);
 		return 0;
 	}
@@ -246,7 +346,7 @@ uint8 LoadSpriteV1(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t file_po
 	 * In case it is uncompressed, the size is 'num' - 8 (header-size). */
 	num = (type & 0x02) ? sprite[zoom_lvl].width * sprite[zoom_lvl].height : num - 8;
 
-	if (DecodeSingleSprite(&sprite[zoom_lvl], file_slot, file_pos, sprite_type, num, type, zoom_lvl, SCC_PAL, 1)) return 1 << zoom_lvl;
+	if (DecodeSingleSprite(&sprite[zoom_lvl], file_slot, file_pos, reader, sprite_type, num, type, zoom_lvl, SCC_PAL, 1)) return 1 << zoom_lvl;
 
 	return 0;
 }
@@ -258,22 +358,22 @@ uint8 LoadSpriteV2(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t file_po
 	/* Is the sprite not present/stripped in the GRF? */
 	if (file_pos == SIZE_MAX) return 0;
 
-	/* Open the right file and go to the correct position */
-	FioSeekToFile(file_slot, file_pos);
+	/* Read the file from the correct position */
+	SpriteDataReader reader(file_slot, file_pos);
 
-	uint32 id = FioReadDword();
+	uint32 id = reader.ReadDword();
 
 	uint8 loaded_sprites = 0;
 	do {
-		int64 num = FioReadDword();
-		size_t start_pos = FioGetPos();
-		byte type = FioReadByte();
+		int64 num = reader.ReadDword();
+		size_t start = reader.pos;
+		byte type = reader.ReadByte();
 
 		/* Type 0xFF indicates either a colourmap or some other non-sprite info; we do not handle them here. */
 		if (type == 0xFF) return 0;
 
 		byte colour = type & SCC_MASK;
-		byte zoom = FioReadByte();
+		byte zoom = reader.ReadByte();
 
 		if (colour != 0 && (load_32bpp ? colour != SCC_PAL : colour == SCC_PAL) && (sprite_type != ST_MAPGEN ? zoom < lengthof(zoom_lvl_map) : zoom == 0)) {
 			ZoomLevel zoom_lvl = (sprite_type != ST_MAPGEN) ? zoom_lvl_map[zoom] : ZOOM_LVL_NORMAL;
@@ -281,16 +381,16 @@ uint8 LoadSpriteV2(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t file_po
 			if (HasBit(loaded_sprites, zoom_lvl)) {
 				/* We already have this zoom level, skip sprite. */
 				DEBUG(sprite, 1, "Ignoring duplicate zoom level sprite %u from %s", id, FioGetFilename(file_slot));
-				FioSkipBytes(num - 2);
+				reader.Skip(num - 2);
 				continue;
 			}
 
-			sprite[zoom_lvl].height = FioReadWord();
-			sprite[zoom_lvl].width  = FioReadWord();
-			sprite[zoom_lvl].x_offs = FioReadWord();
-			sprite[zoom_lvl].y_offs = FioReadWord();
+			sprite[zoom_lvl].height = reader.ReadWord();
+			sprite[zoom_lvl].width  = reader.ReadWord();
+			sprite[zoom_lvl].x_offs = reader.ReadWord();
+			sprite[zoom_lvl].y_offs = reader.ReadWord();
 
-			if (sprite[zoom_lvl].width > INT16_MAX || sprite[zoom_lvl].height > INT16_MAX) {
+			if (reader.overrun || sprite[zoom_lvl].width > INT16_MAX || sprite[zoom_lvl].height > INT16_MAX) {
 				WarnCorruptSprite(file_slot, file_pos, __LINE__);
 				return 0;
 			}
@@ -306,10 +406,10 @@ uint8 LoadSpriteV2(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t file_po
 
 			/* For chunked encoding we store the decompressed size in the file,
 			 * otherwise we can calculate it from the image dimensions. */
-			uint decomp_size = (type & 0x08) ? FioReadDword() : sprite[zoom_lvl].width * sprite[zoom_lvl].height * bpp;
+			uint decomp_size = (type & 0x08) ? reader.ReadDword() : sprite[zoom_lvl].width * sprite[zoom_lvl].height * bpp;
 
-			bool valid = DecodeSingleSprite(&sprite[zoom_lvl], file_slot, file_pos, sprite_type, decomp_size, type, zoom_lvl, colour, 2);
-			if (FioGetPos() != start_pos + num) {
+			bool valid = DecodeSingleSprite(&sprite[zoom_lvl], file_slot, file_pos, reader, sprite_type, decomp_size, type, zoom_lvl, colour, 2);
+			if ((int64)(reader.pos - start) != num) {
 				WarnCorruptSprite(file_slot, file_pos, __LINE__);
 				return 0;
 			}
@@ -317,10 +417,10 @@ uint8 LoadSpriteV2(SpriteLoader::Sprite *sprite, uint8 file_slot, size_t file_po
 			if (valid) SetBit(loaded_sprites, zoom_lvl);
 		} else {
 			/* Not the wanted zoom level or colour depth, continue searching. */
-			FioSkipBytes(num - 2);
+			reader.Skip(num - 2);
 		}
 
-	} while (FioReadDword() == id);
+	} while (reader.ReadDword() == id);
 
 	return loaded_sprites;
 }
@@ -28,18 +28,24 @@
 #include "linkgraph/linkgraph.h"
 #include "linkgraph/linkgraphschedule.h"
 #include "tracerestrict.h"
+#include "station_func.h"
 
 #include "table/strings.h"
 
+#include <algorithm>
+
 #include "safeguards.h"
 
 /** The pool of stations. */
 StationPool _station_pool("Station");
+std::set<StationID> _loading_stations; ///< Stations with vehicles loading or unloading, @see Station::loading_vehicles
 INSTANTIATE_POOL_METHODS(Station)
 
 typedef StationIDStack::SmallStackPool StationIDStackPool;
 template<> StationIDStackPool StationIDStack::_pool = StationIDStackPool();
 
+static void SetCatchmentIndexBlocks(Station *st, const Rect &blocks);
+
 BaseStation::~BaseStation()
 {
 	free(this->name);
@@ -64,7 +70,9 @@ Station::Station(TileIndex tile) :
 	indtype(IT_INVALID),
 	time_since_load(255),
 	time_since_unload(255),
-	last_vehicle_type(VEH_INVALID)
+	last_vehicle_type(VEH_INVALID),
+	catchment_index_blocks({ 0, 0, -1, -1 }),
+	rating_tick_slot(INVALID_RATING_TICK_SLOT)
 {
 	/* this->random_bits is set in Station::AddFacility() */
 }
@@ -85,6 +93,9 @@ Station::~Station()
 		return;
 	}
 
+	SetCatchmentIndexBlocks(this, { 0, 0, -1, -1 });
+	this->UpdateRatingTickSlot(false);
+
 	while (!this->loading_vehicles.empty()) {
 		this->loading_vehicles.front()->LeaveStation();
 	}
@@ -198,6 +209,27 @@ void Station::AddFacility(StationFacility new_facility_bit, TileIndex facil_xy)
 	this->facilities |= new_facility_bit;
 	this->owner = _current_company;
 	this->build_date = _date;
+	this->UpdateRatingTickSlot(true);
+}
+
+/**
+ * Add a vehicle to the vehicles loading or unloading at the station.
+ * @param v The front vehicle.
+ */
+void Station::AddLoadingVehicle(Vehicle *v)
+{
+	this->loading_vehicles.push_back(v);
+	_loading_stations.insert(this->index);
+}
+
+/**
+ * Remove a vehicle from the vehicles loading or unloading at the station, if it is there.
+ * @param v The front vehicle.
+ */
+void Station::RemoveLoadingVehicle(const Vehicle *v)
+{
+	this->loading_vehicles.erase(std::remove(this->loading_vehicles.begin(), this->loading_vehicles.end(), v), this->loading_vehicles.end());
+	if (this->loading_vehicles.empty()) _loading_stations.erase(this->index);
 }
 
 /**
@@ -369,6 +401,8 @@ static bool FindIndustryToDeliver(TileIndex ind_tile, void *user_data)
  */
 void Station::RecomputeIndustriesNear()
 {
+	this->UpdateCatchmentIndex();
+
 	this->industries_near.Clear();
 	if (this->rect.IsEmpty()) return;
 
@@ -396,6 +430,119 @@ void Station::RecomputeIndustriesNear()
 	FOR_ALL_STATIONS(st) st->RecomputeIndustriesNear();
 }
 
+/************************************************************************/
+/*                    Catchment index implementation                    */
+/************************************************************************/
+
+static const uint CATCHMENT_INDEX_BLOCK_SHIFT = 4; ///< Log2 of the width and height of a block of the catchment index, in tiles.
+
+/**
+ * For each block of tiles of the map, the stations whose catchment rectangle overlaps that block.
+ * The index is allocated when the first station is registered and cleared together with the station pool.
+ */
+static std::vector<std::vector<StationID>> _catchment_index;
+
+/**
+ * Get the list of stations of a block of the catchment index.
+ * @param bx X coordinate of the block.
+ * @param by Y coordinate of the block.
+ * @return The stations whose catchment overlaps the block.
+ */
+static inline std::vector<StationID> &GetCatchmentIndexBlock(int bx, int by)
+{
+	return _catchment_index[(by << (MapLogX() - CATCHMENT_INDEX_BLOCK_SHIFT)) + bx];
+}
+
+/**
+ * Move a station to other blocks of the catchment index.
+ * @param st The station.
+ * @param blocks The blocks to register the station in, an empty rectangle to remove it from the index.
+ */
+static void SetCatchmentIndexBlocks(Station *st, const Rect &blocks)
+{
+	const Rect &old = st->catchment_index_blocks;
+	if (old.left == blocks.left && old.top == blocks.top && old.right == blocks.right && old.bottom == blocks.bottom) return;
+
+	for (int by = old.top; by <= old.bottom; by++) {
+		for (int bx = old.left; bx <= old.right; bx++) {
+			std::vector<StationID> &list = GetCatchmentIndexBlock(bx, by);
+			std::vector<StationID>::iterator it = std::find(list.begin(), list.end(), st->index);
+			assert(it != list.end());
+			*it = list.back();
+			list.pop_back();
+		}
+	}
+
+	if (blocks.left <= blocks.right && _catchment_index.empty()) {
+		_catchment_index.resize(MapSize() >> (2 * CATCHMENT_INDEX_BLOCK_SHIFT));
+	}
+	for (int by = blocks.top; by <= blocks.bottom; by++) {
+		for (int bx = blocks.left; bx <= blocks.right; bx++) {
+			GetCatchmentIndexBlock(bx, by).push_back(st->index);
+		}
+	}
+
+	st->catchment_index_blocks = blocks;
+}
+
+/**
+ * Update the blocks of the catchment index this station is registered in to its current catchment.
+ * This is done together with recomputing the nearby industries, as both depend on the same things.
+ * @see FindStationsAroundTiles()
+ */
+void Station::UpdateCatchmentIndex()
+{
+	Rect blocks = { 0, 0, -1, -1 };
+	if (!this->rect.IsEmpty()) {
+		/* Without modified catchment every station tile is searched with the same radius, regardless of the facilities. */
+		uint radius = _settings_game.station.modified_catchment ? this->GetCatchmentRadius() : CA_UNMODIFIED + _settings_game.station.catchment_increase;
+		Rect r = this->GetCatchmentRectUsingRadius(radius);
+		blocks.left   = r.left   >> CATCHMENT_INDEX_BLOCK_SHIFT;
+		blocks.top    = r.top    >> CATCHMENT_INDEX_BLOCK_SHIFT;
+		blocks.right  = r.right  >> CATCHMENT_INDEX_BLOCK_SHIFT;
+		blocks.bottom = r.bottom >> CATCHMENT_INDEX_BLOCK_SHIFT;
+	}
+	SetCatchmentIndexBlocks(this, blocks);
+}
+
+/**
+ * Get the stations whose catchment might cover a part of an area.
+ * These are all stations registered in the blocks of the catchment index which overlap the area,
+ * so the caller still has to check whether the station tiles are close enough.
+ * @param area The area, e.g. the tiles of a producer.
+ * @param[out] candidates The stations, each only once and in no particular order.
+ */
+/* static */ void Station::GetCatchmentIndexCandidates(const TileArea &area, std::vector<Station *> &candidates)
+{
+	candidates.clear();
+	if (_catchment_index.empty()) return;
+
+	uint left = TileX(area.tile) >> CATCHMENT_INDEX_BLOCK_SHIFT;
+	uint top = TileY(area.tile) >> CATCHMENT_INDEX_BLOCK_SHIFT;
+	uint right = (TileX(area.tile) + area.w - 1) >> CATCHMENT_INDEX_BLOCK_SHIFT;
+	uint bottom = (TileY(area.tile) + area.h - 1) >> CATCHMENT_INDEX_BLOCK_SHIFT;
+
+	for (uint by = top; by <= bottom; by++) {
+		for (uint bx = left; bx <= right; bx++) {
+			for (StationID id : GetCatchmentIndexBlock(bx, by)) candidates.push_back(Station::Get(id));
+		}
+	}
+
+	if (left != right || top != bottom) {
+		std::sort(candidates.begin(), candidates.end(), [](const Station *a, const Station *b) { return a->index < b->index; });
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	}
+}
+
+/**
+ * The station pool is about to be cleaned, so forget all registered stations.
+ */
+/* static */ void BaseStation::PreCleanPool()
+{
+	_catchment_index.clear();
+	ClearStationTickSchedule();
+}
+
 /************************************************************************/
 /*                     StationRect implementation                       */
 /************************************************************************/
@@ -21,12 +21,16 @@
 #include "newgrf_storage.h"
 #include "3rdparty/cpp-btree/btree_map.h"
 #include <map>
+#include <set>
 #include <vector>
 
 typedef Pool<BaseStation, StationID, 32, 64000> StationPool;
 extern StationPool _station_pool;
 
 static const byte INITIAL_STATION_RATING = 175;
+static const byte INVALID_RATING_TICK_SLOT = 0xFF; ///< Rating tick slot of stations which are not in use.
+
+extern std::set<StationID> _loading_stations;
 
 /**
  * Flow statistics telling how much flow should be sent along a link. This is
@@ -471,17 +475,23 @@ public:
 	byte time_since_unload;
 
 	byte last_vehicle_type;
-	std::vector<Vehicle *> loading_vehicles;
+	std::vector<Vehicle *> loading_vehicles;  ///< Vehicles loading or unloading at the station, in the order they arrived; modify with AddLoadingVehicle() and RemoveLoadingVehicle()
 	GoodsEntry goods[NUM_CARGO];  ///< Goods at this station
 	uint32 always_accepted;       ///< Bitmask of always accepted cargo types (by houses, HQs, industry tiles when industry doesn't accept cargo)
 
 	IndustryVector industries_near; ///< Cached list of industries near the station that can accept cargo, @see DeliverGoodsToIndustry()
+	Rect catchment_index_blocks;    ///< NOSAVE: Blocks of the catchment index the station is registered in, empty if it is not registered, @see Station::UpdateCatchmentIndex()
+	byte rating_tick_slot;          ///< NOSAVE: Tick of the rating cycle the rating of the station is updated at, #INVALID_RATING_TICK_SLOT if it is not in use, @see Station::UpdateRatingTickSlot()
 
 	Station(TileIndex tile = INVALID_TILE);
 	~Station();
 
 	void AddFacility(StationFacility new_facility_bit, TileIndex facil_xy);
 
+	void AddLoadingVehicle(Vehicle *v);
+	void RemoveLoadingVehicle(const Vehicle *v);
+	void UpdateRatingTickSlot(bool in_use);
+
 	void MarkTilesDirty(bool cargo_change) const;
 
 	void UpdateVirtCoord();
@@ -491,6 +501,9 @@ public:
 	void RecomputeIndustriesNear();
 	static void RecomputeIndustriesNearForAll();
 
+	void UpdateCatchmentIndex();
+	static void GetCatchmentIndexCandidates(const TileArea &area, std::vector<Station *> &candidates);
+
 	Dock *GetPrimaryDock() const { return docks; }
 
 	uint GetCatchmentRadius() const;
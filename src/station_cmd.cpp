@@ -49,12 +49,16 @@
 #include "table/airporttile_ids.h"
 #include "newgrf_airporttiles.h"
 #include "order_backup.h"
+#include "order_func.h"
 #include "newgrf_house.h"
 #include "company_gui.h"
 #include "linkgraph/linkgraph_base.h"
 #include "linkgraph/refresh.h"
 #include "widgets/station_widget.h"
 #include "zoning.h"
+#include "newgrf_callback_cache.h"
+
+#include <algorithm>
 
 #include "table/strings.h"
 
@@ -710,6 +714,7 @@ static CommandCost BuildStationPart(Station **st, DoCommandFlag flags, bool reus
 static void DeleteStationIfEmpty(BaseStation *st)
 {
 	if (!st->IsInUse()) {
+		if (Station::IsExpected(st)) Station::From(st)->UpdateRatingTickSlot(false);
 		st->delete_ctr = 0;
 		InvalidateWindowData(WC_STATION_LIST, st->owner, 0);
 	}
@@ -1392,10 +1397,10 @@ CommandCost CmdBuildRailStation(TileIndex tile_org, DoCommandFlag flags, uint32
 					TriggerStationAnimation(st, tile, SAT_BUILT);
 				}
 
+				YapfNotifyTrackLayoutChange(tile, track);
 				tile += tile_delta;
 			} while (--w);
 			AddTrackToSignalBuffer(tile_track, track, _current_company);
-			YapfNotifyTrackLayoutChange(tile_track, track);
 			tile_track += tile_delta ^ TileDiffXY(1, 1); // perpendicular to tile_delta
 		} while (--numtracks);
 
@@ -1915,6 +1920,7 @@ CommandCost CmdBuildRoadStop(TileIndex tile, DoCommandFlag flags, uint32 p1, uin
 			DirtyCompanyInfrastructureWindows(st->owner);
 
 			MarkTileDirtyByTile(cur_tile);
+			YapfNotifyRoadLayoutChange(cur_tile);
 		}
 		ZoningMarkDirtyStationCoverageArea(st);
 	}
@@ -2020,6 +2026,7 @@ static CommandCost RemoveRoadStop(TileIndex tile, DoCommandFlag flags)
 		} else {
 			DoClearSquare(tile);
 		}
+		YapfNotifyRoadLayoutChange(tile);
 
 		SetWindowWidgetDirty(WC_STATION_VIEW, st->index, WID_SV_ROADVEHS);
 		delete cur_stop;
@@ -2559,14 +2566,20 @@ CommandCost CmdOpenCloseAirport(TileIndex tile, DoCommandFlag flags, uint32 p1,
  */
 bool HasStationInUse(StationID station, bool include_company, CompanyID company)
 {
-	const Vehicle *v;
-	FOR_ALL_VEHICLES(v) {
-		if ((v->owner == company) == include_company) {
-			const Order *order;
-			FOR_VEHICLE_ORDERS(v, order) {
-				if ((order->IsType(OT_GOTO_STATION) || order->IsType(OT_GOTO_WAYPOINT)) && order->GetDestination() == station) {
-					return true;
-				}
+	std::vector<const OrderList *> lists;
+	GetOrderListsWithDestination(lists, station, false);
+
+	for (const OrderList *orderlist : lists) {
+		const Vehicle *v;
+		for (v = orderlist->GetFirstSharedVehicle(); v != NULL; v = v->NextShared()) {
+			if ((v->owner == company) == include_company) break;
+		}
+		if (v == NULL) continue;
+
+		/* Implicit orders do not count. */
+		for (const Order *order = orderlist->GetFirstOrder(); order != NULL; order = order->next) {
+			if ((order->IsType(OT_GOTO_STATION) || order->IsType(OT_GOTO_WAYPOINT)) && order->GetDestination() == station) {
+				return true;
 			}
 		}
 	}
@@ -3385,9 +3398,14 @@ static bool StationHandleBigTick(BaseStation *st)
 	if (Station::IsExpected(st)) {
 		TriggerWatchedCargoCallbacks(Station::From(st));
 
+		bool accepted = false;
 		for (CargoID i = 0; i < NUM_CARGO; i++) {
-			ClrBit(Station::From(st)->goods[i].status, GoodsEntry::GES_ACCEPTED_BIGTICK);
+			GoodsEntry *ge = &Station::From(st)->goods[i];
+			if (HasBit(ge->status, GoodsEntry::GES_ACCEPTED_BIGTICK)) accepted = true;
+			ClrBit(ge->status, GoodsEntry::GES_ACCEPTED_BIGTICK);
 		}
+		/* The acceptance history is read by the callbacks of nearby houses, and the watched cargo callbacks may have changed the houses. */
+		if (accepted) InvalidateNewGRFCallbackCache();
 	}
 
 
@@ -3751,25 +3769,112 @@ void IncreaseStats(Station *st, CargoID cargo, StationID next_station_id, uint c
 	}
 }
 
-/* called for every station each tick */
-static void StationHandleSmallTick(BaseStation *st)
+/************************************************************************/
+/*                    Station tick schedule                             */
+/************************************************************************/
+
+/**
+ * The stations in use, by the tick of the rating cycle their rating is updated at.
+ * A station in slot k is due when #_rating_tick_slot is k; the lists are sorted by index.
+ * Instead of counting delete_ctr up every tick for every station in use, the counter is derived
+ * from the slot, see SyncStationRatingTickCounters().
+ */
+static std::vector<StationID> _rating_tick_stations[STATION_RATING_TICKS];
+static uint _rating_tick_slot = 0; ///< Slot of #_rating_tick_stations which is due at the next tick.
+
+/**
+ * Get the value delete_ctr of a station in use would have when it was counted up every tick.
+ * @param slot The rating tick slot of the station.
+ * @return The value of the counter.
+ */
+static byte GetRatingTickCounter(uint slot)
 {
-	if ((st->facilities & FACIL_WAYPOINT) != 0 || !st->IsInUse()) return;
+	return (2 * STATION_RATING_TICKS - 1 + _rating_tick_slot - slot) % STATION_RATING_TICKS;
+}
+
+/**
+ * Put the station in the rating tick slot it is due in when it is in use, or take it out when it is not.
+ * Must be called whenever a station starts or stops being in use.
+ * @param in_use Whether the station is in use.
+ */
+void Station::UpdateRatingTickSlot(bool in_use)
+{
+	if (in_use == (this->rating_tick_slot != INVALID_RATING_TICK_SLOT)) return;
+
+	if (in_use) {
+		/* The counter is increased every tick and the rating updated when it reaches STATION_RATING_TICKS. */
+		uint ticks_left = STATION_RATING_TICKS - 1 - min<uint>(this->delete_ctr, STATION_RATING_TICKS - 1);
+		this->rating_tick_slot = (_rating_tick_slot + ticks_left) % STATION_RATING_TICKS;
+		std::vector<StationID> &list = _rating_tick_stations[this->rating_tick_slot];
+		list.insert(std::lower_bound(list.begin(), list.end(), this->index), this->index);
+	} else {
+		this->delete_ctr = GetRatingTickCounter(this->rating_tick_slot);
+		std::vector<StationID> &list = _rating_tick_stations[this->rating_tick_slot];
+		list.erase(std::lower_bound(list.begin(), list.end(), this->index));
+		this->rating_tick_slot = INVALID_RATING_TICK_SLOT;
+	}
+}
+
+/** Forget all scheduled stations, as the station pool is cleaned. */
+void ClearStationTickSchedule()
+{
+	for (std::vector<StationID> &list : _rating_tick_stations) list.clear();
+	_loading_stations.clear();
+}
+
+/** Schedule the ticks of all stations after loading a game. */
+void RebuildStationTickSchedule()
+{
+	ClearStationTickSchedule();
+
+	Station *st;
+	FOR_ALL_STATIONS(st) {
+		st->rating_tick_slot = INVALID_RATING_TICK_SLOT;
+		st->UpdateRatingTickSlot(st->IsInUse());
+		if (!st->loading_vehicles.empty()) _loading_stations.insert(st->index);
+	}
+}
 
-	byte b = st->delete_ctr + 1;
-	if (b >= STATION_RATING_TICKS) b = 0;
-	st->delete_ctr = b;
+/** Store the rating tick counters of the stations in use in their delete_ctr, before saving the stations. */
+void SyncStationRatingTickCounters()
+{
+	Station *st;
+	FOR_ALL_STATIONS(st) {
+		if (st->rating_tick_slot != INVALID_RATING_TICK_SLOT) st->delete_ctr = GetRatingTickCounter(st->rating_tick_slot);
+	}
+}
 
-	if (b == 0) UpdateStationRating(Station::From(st));
+/**
+ * Add the stations whose index is due for a periodic check this tick to a list.
+ * @param due The list to add to.
+ * @param interval The interval of the check; a station is due when (_tick_counter + index) % interval == 0.
+ */
+static void AddPeriodicallyDueStations(std::vector<StationID> &due, uint interval)
+{
+	uint pool_size = (uint)BaseStation::GetPoolSize();
+	for (uint index = (interval - _tick_counter % interval) % interval; index < pool_size; index += interval) {
+		if (BaseStation::IsValidID(index)) due.push_back(index);
+	}
 }
 
 void OnTick_Station()
 {
 	if (_game_mode == GM_EDITOR) return;
 
-	BaseStation *st;
-	FOR_ALL_BASE_STATIONS(st) {
-		StationHandleSmallTick(st);
+	/* Only visit the stations with something to do this tick, but in the order of their index like a loop over all stations. */
+	static std::vector<StationID> due;
+	uint slot = _rating_tick_slot;
+	due = _rating_tick_stations[slot];
+	AddPeriodicallyDueStations(due, STATION_LINKGRAPH_TICKS);
+	AddPeriodicallyDueStations(due, STATION_ACCEPTANCE_TICKS);
+	std::sort(due.begin(), due.end());
+	due.erase(std::unique(due.begin(), due.end()), due.end());
+
+	for (StationID index : due) {
+		BaseStation *st = BaseStation::GetIfValid(index);
+		if (st == NULL) continue;
+
+		if (Station::IsExpected(st) && Station::From(st)->rating_tick_slot == slot) UpdateStationRating(Station::From(st));
 
 		/* Clean up the link graph about once a week. */
 		if (Station::IsExpected(st) && (_tick_counter + st->index) % STATION_LINKGRAPH_TICKS == 0) {
@@ -3786,6 +3891,8 @@ void OnTick_Station()
 			if (Station::IsExpected(st)) AirportAnimationTrigger(Station::From(st), AAT_STATION_250_TICKS);
 		}
 	}
+
+	_rating_tick_slot = (slot + 1) % STATION_RATING_TICKS;
 }
 
 /** Monthly loop for stations. */
@@ -3915,6 +4022,10 @@ CommandCost CmdRenameStation(TileIndex tile, DoCommandFlag flags, uint32 p1, uin
 /**
  * Find all stations around a rectangular producer (industry, house, headquarter, ...)
  *
+ * The candidates are taken from the catchment index, so only the tiles of stations which are
+ * actually near the producer are looked at. The stations are added in the order in which a
+ * row by row scan of the search area would find their first tile.
+ *
  * @param location The location/area of the producer
  * @param stations The list to store the stations in
  */
@@ -3924,43 +4035,59 @@ void FindStationsAroundTiles(const TileArea &location, StationList *stations)
 	uint max_rad = (_settings_game.station.modified_catchment ? MAX_CATCHMENT : CA_UNMODIFIED);
 	max_rad += _settings_game.station.catchment_increase;
 
-	uint x = TileX(location.tile);
-	uint y = TileY(location.tile);
+	int x = TileX(location.tile);
+	int y = TileY(location.tile);
 
-	uint min_x = (x > max_rad) ? x - max_rad : 0;
-	uint max_x = x + location.w + max_rad;
-	uint min_y = (y > max_rad) ? y - max_rad : 0;
-	uint max_y = y + location.h + max_rad;
+	int min_x = (x > (int)max_rad) ? x - max_rad : 0;
+	int max_x = x + location.w + max_rad;
+	int min_y = (y > (int)max_rad) ? y - max_rad : 0;
+	int max_y = y + location.h + max_rad;
 
 	if (min_x == 0 && _settings_game.construction.freeform_edges) min_x = 1;
 	if (min_y == 0 && _settings_game.construction.freeform_edges) min_y = 1;
-	if (max_x >= MapSizeX()) max_x = MapSizeX() - 1;
-	if (max_y >= MapSizeY()) max_y = MapSizeY() - 1;
-
-	for (uint cy = min_y; cy < max_y; cy++) {
-		for (uint cx = min_x; cx < max_x; cx++) {
-			TileIndex cur_tile = TileXY(cx, cy);
-			if (!IsTileType(cur_tile, MP_STATION)) continue;
-
-			Station *st = Station::GetByTile(cur_tile);
-			/* st can be NULL in case of waypoints */
-			if (st == NULL) continue;
-
-			if (_settings_game.station.modified_catchment) {
-				int rad = st->GetCatchmentRadius();
-				int rad_x = cx - x;
-				int rad_y = cy - y;
+	if (max_x >= (int)MapSizeX()) max_x = MapSizeX() - 1;
+	if (max_y >= (int)MapSizeY()) max_y = MapSizeY() - 1;
+
+	static std::vector<Station *> candidates;
+	Station::GetCatchmentIndexCandidates(location, candidates);
+
+	/* The first tile of each station in the search area, and the station. */
+	static std::vector<std::pair<TileIndex, Station *>> found;
+	found.clear();
+
+	for (Station *st : candidates) {
+		if (st->rect.IsEmpty()) continue;
+
+		int left = max<int>(min_x, st->rect.left);
+		int top = max<int>(min_y, st->rect.top);
+		int right = min<int>(max_x - 1, st->rect.right);
+		int bottom = min<int>(max_y - 1, st->rect.bottom);
+
+		if (_settings_game.station.modified_catchment) {
+			int rad = st->GetCatchmentRadius();
+			left = max(left, x - rad);
+			top = max(top, y - rad);
+			right = min(right, x + location.w + rad - 1);
+			bottom = min(bottom, y + location.h + rad - 1);
+		}
+		if (left > right || top > bottom) continue;
 
-				if (rad_x < -rad || rad_x >= rad + location.w) continue;
-				if (rad_y < -rad || rad_y >= rad + location.h) continue;
+		TileArea ta(TileXY(left, top), TileXY(right, bottom));
+		TILE_AREA_LOOP(tile, ta) {
+			if (IsTileType(tile, MP_STATION) && GetStationIndex(tile) == st->index) {
+				found.emplace_back(tile, st);
+				break;
 			}
-
-			/* Insert the station in the set. This will fail if it has
-			 * already been added.
-			 */
-			stations->Include(st);
 		}
 	}
+
+	std::sort(found.begin(), found.end());
+	for (const auto &it : found) {
+		/* Insert the station in the set. This will fail if it has
+		 * already been added.
+		 */
+		stations->Include(it.second);
+	}
 }
 
 /**
@@ -4071,6 +4198,7 @@ void BuildOilRig(TileIndex tile)
 		st->dock_station.tile = tile;
 		st->facilities |= FACIL_DOCK;
 	}
+	st->UpdateRatingTickSlot(true);
 
 	st->build_date = _date;
 
@@ -39,6 +39,10 @@ bool HasStationInUse(StationID station, bool include_company, CompanyID company)
 
 void DeleteOilRig(TileIndex t);
 
+void ClearStationTickSchedule();
+void RebuildStationTickSchedule();
+void SyncStationRatingTickCounters();
+
 /* Check if a rail station tile is traversable. */
 bool IsStationTileBlocked(TileIndex tile);
 
@@ -18,6 +18,7 @@
 #include "object_base.h"
 #include "company_base.h"
 #include "company_func.h"
+#include "pathfinder/yapf/yapf_cache.h"
 
 #include "table/strings.h"
 
@@ -322,6 +323,9 @@ CommandCost CmdTerraformLand(TileIndex tile, DoCommandFlag flags, uint32 p1, uin
 		for (TileIndexSet::const_iterator it = ts.dirty_tiles.begin(); it != ts.dirty_tiles.end(); it++) {
 			MarkTileDirtyByTile(*it);
 
+			/* The slope of roads is part of the cost of road vehicle paths */
+			if (IsTileType(*it, MP_ROAD) || IsTileType(*it, MP_STATION) || IsTileType(*it, MP_TUNNELBRIDGE)) YapfNotifyRoadLayoutChange(*it);
+
 			int height = TerraformGetHeightOfTile(&ts, *it);
 
 			/* Now, if we alter the height of the map edge, we need to take care
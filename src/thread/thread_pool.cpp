@@ -0,0 +1,201 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file thread_pool.cpp Pool of persistent worker threads. */
+
+#include "../stdafx.h"
+#include "../debug.h"
+#include "../core/math_func.hpp"
+#include "thread_pool.h"
+#include <algorithm>
+
+#include "../safeguards.h"
+
+/**
+ * Create a task.
+ * @param proc The procedure to call when the task is executed.
+ * @param param The parameter to give to \a proc.
+ */
+ThreadPoolTask::ThreadPoolTask(OTTDThreadFunc proc, void *param) :
+		proc(proc), param(param), done_mutex(ThreadMutex::New()), queued(false), finished(true)
+{
+}
+
+ThreadPoolTask::~ThreadPoolTask()
+{
+	assert(!this->queued);
+	delete this->done_mutex;
+}
+
+/**
+ * Get the thread pools which exist.
+ * @return The pools.
+ */
+static std::vector<ThreadPool *> &GetThreadPools()
+{
+	static std::vector<ThreadPool *> pools;
+	return pools;
+}
+
+/**
+ * Create a thread pool. The worker threads are only started when the first task is submitted.
+ * @param name Name of the worker threads.
+ */
+ThreadPool::ThreadPool(const char *name) :
+		name(name), mutex(ThreadMutex::New()), started(false), exit(false)
+{
+	GetThreadPools().push_back(this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	this->Stop();
+	delete this->mutex;
+
+	std::vector<ThreadPool *> &pools = GetThreadPools();
+	pools.erase(std::find(pools.begin(), pools.end(), this));
+}
+
+/**
+ * Stop and join all worker threads. Tasks which are still queued are not executed by the workers,
+ * and tasks submitted afterwards are executed in the submitting thread.
+ */
+void ThreadPool::Stop()
+{
+	this->mutex->BeginCritical();
+	this->exit = true;
+	/* Each worker passes the signal on to the next before it exits. */
+	this->mutex->SendSignal();
+	this->mutex->EndCritical();
+
+	for (ThreadObject *t : this->workers) {
+		t->Join();
+		delete t;
+	}
+	this->workers.clear();
+	this->started = true;
+}
+
+/**
+ * Stop the worker threads of all pools, so they are not left running until static destruction.
+ */
+/* static */ void ThreadPool::StopAll()
+{
+	for (ThreadPool *pool : GetThreadPools()) pool->Stop();
+}
+
+/**
+ * Start the worker threads, one for each processor core.
+ */
+void ThreadPool::Start()
+{
+	this->started = true;
+
+	uint count = max<uint>(1, GetCPUCoreCount());
+	for (uint i = 0; i < count; i++) {
+		ThreadObject *t;
+		if (!ThreadObject::New(&ThreadPool::WorkerMain, this, &t, this->name)) break;
+		this->workers.push_back(t);
+	}
+	DEBUG(misc, 3, "Started %u worker threads for %s", (uint)this->workers.size(), this->name);
+}
+
+/**
+ * Execute a task and notify the threads waiting for it.
+ * @param task The task to execute.
+ */
+/* static */ void ThreadPool::RunTask(ThreadPoolTask *task)
+{
+	task->proc(task->param);
+
+	task->done_mutex->BeginCritical();
+	task->finished = true;
+	task->done_mutex->SendSignal();
+	task->done_mutex->EndCritical();
+}
+
+/**
+ * Main loop of a worker thread. This method is tailored to ThreadObject::New.
+ * @param pool Pointer to the ThreadPool the worker belongs to.
+ */
+/* static */ void ThreadPool::WorkerMain(void *pool)
+{
+	ThreadPool *self = (ThreadPool *)pool;
+
+	self->mutex->BeginCritical();
+	for (;;) {
+		while (self->queue.empty() && !self->exit) self->mutex->WaitForSignal();
+		/* Signals may wake only one worker, e.g. with the auto-reset events on Windows, so pass them on. */
+		if (self->exit) {
+			self->mutex->SendSignal();
+			break;
+		}
+
+		ThreadPoolTask *task = self->queue.front();
+		self->queue.pop_front();
+		task->queued = false;
+		if (!self->queue.empty()) self->mutex->SendSignal();
+		self->mutex->EndCritical();
+
+		RunTask(task);
+
+		self->mutex->BeginCritical();
+	}
+	self->mutex->EndCritical();
+}
+
+/**
+ * Queue a task for execution by one of the workers.
+ * If no worker threads are available the task is executed right away.
+ * @param task The task to execute.
+ * @pre The task is not queued or running.
+ */
+void ThreadPool::Submit(ThreadPoolTask *task)
+{
+	assert(task->finished);
+	if (!this->started) this->Start();
+
+	task->finished = false;
+	if (this->workers.empty()) {
+		RunTask(task);
+		return;
+	}
+
+	this->mutex->BeginCritical();
+	task->queued = true;
+	this->queue.push_back(task);
+	this->mutex->SendSignal();
+	this->mutex->EndCritical();
+}
+
+/**
+ * Wait until a task has been executed.
+ * If no worker has picked up the task yet, it is taken out of the queue and executed in the calling thread.
+ * This means a worker waiting for tasks it submitted itself can not deadlock the pool.
+ * @param task The task to wait for. When it was never submitted this returns immediately.
+ */
+void ThreadPool::Wait(ThreadPoolTask *task)
+{
+	this->mutex->BeginCritical();
+	bool steal = task->queued;
+	if (steal) {
+		this->queue.erase(std::find(this->queue.begin(), this->queue.end(), task));
+		task->queued = false;
+	}
+	this->mutex->EndCritical();
+
+	if (steal) {
+		RunTask(task);
+		return;
+	}
+
+	task->done_mutex->BeginCritical();
+	while (!task->finished) task->done_mutex->WaitForSignal();
+	task->done_mutex->EndCritical();
+}
@@ -0,0 +1,78 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file thread_pool.h Pool of persistent worker threads. */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "thread.h"
+#include <deque>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * A task which can be executed by a #ThreadPool.
+ * The task must outlive its execution, i.e. it must not be destroyed before ThreadPool::Wait returned for it.
+ */
+class ThreadPoolTask {
+	friend class ThreadPool;
+
+	OTTDThreadFunc proc;     ///< The procedure to call.
+	void *param;             ///< The parameter to pass to #proc.
+	ThreadMutex *done_mutex; ///< Mutex signalled when the task has finished.
+	bool queued;             ///< Whether the task is waiting in the queue of a pool. Protected by the mutex of the pool.
+	bool finished;           ///< Whether the task is not queued nor running. Protected by #done_mutex.
+
+public:
+	ThreadPoolTask(OTTDThreadFunc proc, void *param);
+	~ThreadPoolTask();
+
+private:
+	ThreadPoolTask(const ThreadPoolTask &) { NOT_REACHED(); }
+	ThreadPoolTask &operator=(const ThreadPoolTask &) { NOT_REACHED(); return *this; }
+};
+
+/**
+ * Pool of worker threads which execute #ThreadPoolTask%s.
+ * The workers are started when the first task is submitted and stay alive until the pool is stopped,
+ * so submitting a task does not create a thread. When no threads can be created the tasks are run
+ * in the submitting thread instead.
+ */
+class ThreadPool {
+	const char *name;                      ///< Name of the worker threads.
+	ThreadMutex *mutex;                    ///< Mutex protecting the queue, signalled when a task is queued.
+	std::deque<ThreadPoolTask *> queue;    ///< Tasks waiting to be executed.
+	std::vector<ThreadObject *> workers;   ///< The worker threads.
+	bool started;                          ///< Whether starting the workers has been attempted.
+	bool exit;                             ///< Whether the workers should exit. Protected by #mutex.
+
+	static void WorkerMain(void *pool);
+	static void RunTask(ThreadPoolTask *task);
+	void Start();
+
+public:
+	ThreadPool(const char *name);
+	~ThreadPool();
+
+	void Submit(ThreadPoolTask *task);
+	void Wait(ThreadPoolTask *task);
+	void Stop();
+
+	static void StopAll();
+
+	/**
+	 * Get the number of worker threads of this pool.
+	 * @return The number of workers, 0 if the pool is not started or runs the tasks in the submitting thread.
+	 */
+	uint GetWorkerCount() const { return (uint)this->workers.size(); }
+};
+
+#endif /* THREAD_POOL_H */
@@ -21,6 +21,7 @@
 #include "group.h"
 #include "string_func.h"
 #include "pathfinder/yapf/yapf_cache.h"
+#include "framerate_type.h"
 
 #include "safeguards.h"
 
@@ -74,6 +75,8 @@ INSTANTIATE_POOL_METHODS(TraceRestrictSlot)
  */
 TraceRestrictMapping _tracerestrictprogram_mapping;
 
+bool _tracerestrict_profile = false; ///< Whether the time spent executing each program is measured
+
 /**
  * List of pre-defined pathfinder penalty values
  * This is indexed by TraceRestrictPathfinderPenaltyPresetIndex
@@ -169,359 +172,470 @@ static bool TestCondition(int value, TraceRestrictCondOp condop, int condvalue)
 }
 
 /**
- * Binary condition testing helper function
+ * Test order condition of a compiled instruction
+ * @p order may be NULL
  */
-static bool TestBinaryConditionCommon(TraceRestrictItem item, bool input)
+static bool TestOrderCondition(const Order *order, const TraceRestrictCompiledInstruction &insn)
 {
-	switch (GetTraceRestrictCondOp(item)) {
-		case TRCO_IS:
-			return input;
-
-		case TRCO_ISNOT:
-			return !input;
+	return order != NULL && order->IsType(static_cast<OrderType>(insn.aux)) && order->GetDestination() == insn.value;
+}
 
-		default:
-			NOT_REACHED();
-			return false;
+/**
+ * Execute program on train and store results in out
+ * @p v may not be NULL
+ * @p out should be zero-initialised
+ */
+void TraceRestrictProgram::Execute(const Train* v, const TraceRestrictProgramInput &input, TraceRestrictProgramResult& out) const
+{
+	this->eval_count.fetch_add(1, std::memory_order_relaxed);
+	if (_tracerestrict_profile) {
+		TimingMeasurement start = GetPerformanceTimer();
+		this->ExecuteCompiled(v, input, out);
+		this->eval_time.fetch_add(GetPerformanceTimer() - start, std::memory_order_relaxed);
+	} else {
+		this->ExecuteCompiled(v, input, out);
 	}
 }
 
 /**
- * Test order condition
- * @p order may be NULL
+ * Execute the compiled form of the program, see Execute
  */
-static bool TestOrderCondition(const Order *order, TraceRestrictItem item)
+void TraceRestrictProgram::ExecuteCompiled(const Train* v, const TraceRestrictProgramInput &input, TraceRestrictProgramResult& out) const
 {
-	bool result = false;
+	bool have_previous_signal = false;
+	TileIndex previous_signal_tile = INVALID_TILE;
+
+	const TraceRestrictCompiledInstruction *code = this->compiled.data();
+	size_t size = this->compiled.size();
+	size_t i = 0;
+	while (i < size) {
+		const TraceRestrictCompiledInstruction &insn = code[i];
+		bool result = false;
+		switch (insn.op) {
+			case TRCOP_JUMP:
+				i = insn.target;
+				continue;
+
+			case TRCOP_COND_CONST:
+				result = insn.value != 0;
+				break;
+
+			case TRCOP_COND_TRAIN_LENGTH:
+				result = TestCondition(CeilDiv(v->gcache.cached_total_length, TILE_SIZE), insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_MAX_SPEED:
+				result = TestCondition(v->GetDisplayMaxSpeed(), insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_CURRENT_ORDER:
+				result = TestOrderCondition(&(v->current_order), insn);
+				break;
+
+			case TRCOP_COND_NEXT_ORDER: {
+				if (v->orders.list == NULL) break;
+				if (v->orders.list->GetNumOrders() == 0) break;
+
+				const Order *current_order = v->GetOrder(v->cur_real_order_index);
+				for (const Order *order = v->orders.list->GetNext(current_order); order != current_order; order = v->orders.list->GetNext(order)) {
+					if (order->IsGotoOrder()) {
+						result = TestOrderCondition(order, insn);
+						break;
+					}
+				}
+				break;
+			}
 
-	if (order) {
-		DestinationID condvalue = GetTraceRestrictValue(item);
-		switch (static_cast<TraceRestrictOrderCondAuxField>(GetTraceRestrictAuxField(item))) {
-			case TROCAF_STATION:
-				result = order->IsType(OT_GOTO_STATION) && order->GetDestination() == condvalue;
+			case TRCOP_COND_LAST_STATION:
+				result = v->last_station_visited == insn.value;
 				break;
 
-			case TROCAF_WAYPOINT:
-				result = order->IsType(OT_GOTO_WAYPOINT) && order->GetDestination() == condvalue;
+			case TRCOP_COND_CARGO:
+				for (const Vehicle *v_iter = v; v_iter != NULL; v_iter = v_iter->Next()) {
+					if (v_iter->cargo_type == insn.value && v_iter->cargo_cap > 0) {
+						result = true;
+						break;
+					}
+				}
+				break;
+
+			case TRCOP_COND_ENTRY_DIRECTION:
+				result = (static_cast<DiagDirection>(insn.value) == TrackdirToExitdir(ReverseTrackdir(input.trackdir)));
+				break;
+
+			case TRCOP_COND_ENTRY_FRONT:
+				result = IsTileType(input.tile, MP_RAILWAY) && HasSignalOnTrackdir(input.tile, input.trackdir);
+				break;
+
+			case TRCOP_COND_ENTRY_BACK:
+				result = IsTileType(input.tile, MP_RAILWAY) && !HasSignalOnTrackdir(input.tile, input.trackdir);
 				break;
 
-			case OT_GOTO_DEPOT:
-				result = order->IsType(OT_GOTO_DEPOT) && order->GetDestination() == condvalue;
+			case TRCOP_COND_PBS_ENTRY_SIGNAL:
+				if (!have_previous_signal) {
+					if (input.previous_signal_callback) {
+						previous_signal_tile = input.previous_signal_callback(v, input.previous_signal_ptr);
+					}
+					have_previous_signal = true;
+				}
+				result = (insn.value != INVALID_TILE) && (previous_signal_tile == insn.value);
 				break;
 
+			case TRCOP_COND_TRAIN_GROUP:
+				result = GroupIsInGroup(v->group_id, insn.value);
+				break;
+
+			case TRCOP_COND_TRAIN_IN_SLOT:
+				result = insn.slot != NULL && insn.slot->IsOccupant(v->index);
+				break;
+
+			case TRCOP_COND_SLOT_OCCUPANTS:
+				result = TestCondition(insn.slot != NULL ? insn.slot->occupants.size() : 0, insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_SLOT_REMAINING:
+				result = TestCondition(insn.slot != NULL ? insn.slot->max_occupancy - insn.slot->occupants.size() : 0, insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_WEIGHT:
+				result = TestCondition(v->gcache.cached_weight, insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_POWER:
+				result = TestCondition(v->gcache.cached_power, insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_MAX_TE:
+				result = TestCondition(v->gcache.cached_max_te / 1000, insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_POWER_WEIGHT:
+				result = TestCondition(min<uint>(UINT16_MAX, (100 * v->gcache.cached_power) / max<uint>(1, v->gcache.cached_weight)), insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_MAX_TE_WEIGHT:
+				result = TestCondition(min<uint>(UINT16_MAX, (v->gcache.cached_max_te / 10) / max<uint>(1, v->gcache.cached_weight)), insn.condop, insn.value);
+				break;
+
+			case TRCOP_COND_TRAIN_OWNER:
+				result = v->owner == insn.value;
+				break;
+
+			case TRCOP_SET_FLAGS:
+				out.flags |= static_cast<TraceRestrictProgramResultFlags>(insn.value);
+				i++;
+				continue;
+
+			case TRCOP_CLEAR_FLAGS:
+				out.flags &= ~static_cast<TraceRestrictProgramResultFlags>(insn.value);
+				i++;
+				continue;
+
+			case TRCOP_PENALTY:
+				out.penalty += insn.value;
+				i++;
+				continue;
+
+			case TRCOP_SLOT_ACQUIRE_WAIT:
+				if (input.permitted_slot_operations & TRPISP_ACQUIRE) {
+					if (!insn.slot->Occupy(v->index)) out.flags |= TRPRF_WAIT_AT_PBS;
+				}
+				i++;
+				continue;
+
+			case TRCOP_SLOT_ACQUIRE_TRY:
+				if (input.permitted_slot_operations & TRPISP_ACQUIRE) insn.slot->Occupy(v->index);
+				i++;
+				continue;
+
+			case TRCOP_SLOT_RELEASE_BACK:
+				if (input.permitted_slot_operations & TRPISP_RELEASE_BACK) insn.slot->Vacate(v->index);
+				i++;
+				continue;
+
+			case TRCOP_SLOT_RELEASE_FRONT:
+				if (input.permitted_slot_operations & TRPISP_RELEASE_FRONT) insn.slot->Vacate(v->index);
+				i++;
+				continue;
+
 			default:
 				NOT_REACHED();
 		}
+
+		/* conditions continue with their block when true, and jump to the next else/elif/orif/endif when false */
+		if (result != insn.invert) {
+			i++;
+		} else {
+			i = insn.target;
+		}
 	}
-	return TestBinaryConditionCommon(item, result);
 }
 
 /**
- * Test station condition
+ * Compile the instruction list into the pre-decoded form executed by Execute
+ * The program must have been validated.
+ *
+ * The condition stack is replaced by jumps: a condition which is false jumps to the next
+ * else/elif/orif/endif of its block. The end of the code of an if/elif is followed by a
+ * jump to the endif of its block when the next part of the block is an else/elif, or a
+ * jump over the condition when it is an orif, as an active block stays active at an orif.
+ * Code of inactive blocks is therefore never visited.
  */
-static bool TestStationCondition(StationID station, TraceRestrictItem item)
+void TraceRestrictProgram::Compile()
 {
-	bool result = (GetTraceRestrictAuxField(item) == TROCAF_STATION) && (station == GetTraceRestrictValue(item));
-	return TestBinaryConditionCommon(item, result);
-
-}
-
-/**
- * Execute program on train and store results in out
- * @p v may not be NULL
- * @p out should be zero-initialised
- */
-void TraceRestrictProgram::Execute(const Train* v, const TraceRestrictProgramInput &input, TraceRestrictProgramResult& out) const
-{
-	// static to avoid needing to re-alloc/resize on each execution
-	static std::vector<TraceRestrictCondStackFlags> condstack;
-	condstack.clear();
-
-	bool have_previous_signal = false;
-	TileIndex previous_signal_tile = INVALID_TILE;
+	/** Instructions of an if/endif block which need the location of the next part of the block, or of its end */
+	struct Block {
+		std::vector<size_t> to_next; ///< Conditions which jump to the next else/elif/orif/endif
+		std::vector<size_t> to_end;  ///< Jumps to the endif
+	};
+	std::vector<Block> blocks;
+
+	this->compiled.clear();
+
+	auto emit = [&](TraceRestrictCompiledOp op) -> TraceRestrictCompiledInstruction & {
+		TraceRestrictCompiledInstruction insn;
+		insn.op = op;
+		insn.condop = TRCO_IS;
+		insn.invert = false;
+		insn.aux = 0;
+		insn.value = 0;
+		insn.target = 0;
+		insn.slot = NULL;
+		this->compiled.push_back(insn);
+		return this->compiled.back();
+	};
+	auto resolve = [&](std::vector<size_t> &list) {
+		for (size_t index : list) this->compiled[index].target = (uint32)this->compiled.size();
+		list.clear();
+	};
 
 	size_t size = this->items.size();
 	for (size_t i = 0; i < size; i++) {
 		TraceRestrictItem item = this->items[i];
 		TraceRestrictItemType type = GetTraceRestrictType(item);
+		uint16 value = GetTraceRestrictValue(item);
+		uint8 aux = GetTraceRestrictAuxField(item);
 
 		if (IsTraceRestrictConditional(item)) {
 			TraceRestrictCondFlags condflags = GetTraceRestrictCondFlags(item);
 			TraceRestrictCondOp condop = GetTraceRestrictCondOp(item);
 
-			if (type == TRIT_COND_ENDIF) {
-				assert(!condstack.empty());
-				if (condflags & TRCF_ELSE) {
-					// else
-					assert(!(condstack.back() & TRCSF_SEEN_ELSE));
-					HandleCondition(condstack, condflags, true);
-					condstack.back() |= TRCSF_SEEN_ELSE;
+			if (type == TRIT_COND_ENDIF && !(condflags & TRCF_ELSE)) {
+				/* end if */
+				assert(!blocks.empty());
+				resolve(blocks.back().to_next);
+				resolve(blocks.back().to_end);
+				blocks.pop_back();
+				continue;
+			}
+
+			if (type != TRIT_COND_ENDIF && !(condflags & (TRCF_OR | TRCF_ELSE))) {
+				/* if */
+				blocks.emplace_back();
+			} else {
+				/* else, elif or orif */
+				assert(!blocks.empty());
+				Block &block = blocks.back();
+				size_t jump = this->compiled.size();
+				emit(TRCOP_JUMP);
+				if (type != TRIT_COND_ENDIF && (condflags & TRCF_OR)) {
+					this->compiled[jump].target = (uint32)jump + 2;
 				} else {
-					// end if
-					condstack.pop_back();
+					block.to_end.push_back(jump);
 				}
-			} else {
-				uint16 condvalue = GetTraceRestrictValue(item);
-				bool result = false;
-				switch(type) {
-					case TRIT_COND_UNDEFINED:
-						result = false;
-						break;
-
-					case TRIT_COND_TRAIN_LENGTH:
-						result = TestCondition(CeilDiv(v->gcache.cached_total_length, TILE_SIZE), condop, condvalue);
-						break;
+				resolve(block.to_next);
+				if (type == TRIT_COND_ENDIF) continue;
+			}
 
-					case TRIT_COND_MAX_SPEED:
-						result = TestCondition(v->GetDisplayMaxSpeed(), condop, condvalue);
-						break;
+			size_t index = this->compiled.size();
+			TraceRestrictCompiledInstruction &insn = emit(TRCOP_COND_CONST);
+			insn.condop = condop;
+			insn.invert = (condop == TRCO_ISNOT);
+			insn.value = value;
+			switch (type) {
+				case TRIT_COND_UNDEFINED:
+					insn.value = 0;
+					insn.invert = false;
+					break;
 
-					case TRIT_COND_CURRENT_ORDER:
-						result = TestOrderCondition(&(v->current_order), item);
-						break;
+				case TRIT_COND_TRAIN_LENGTH:
+					insn.op = TRCOP_COND_TRAIN_LENGTH;
+					break;
 
-					case TRIT_COND_NEXT_ORDER: {
-						if (v->orders.list == NULL) break;
-						if (v->orders.list->GetNumOrders() == 0) break;
+				case TRIT_COND_MAX_SPEED:
+					insn.op = TRCOP_COND_MAX_SPEED;
+					break;
 
-						const Order *current_order = v->GetOrder(v->cur_real_order_index);
-						for (const Order *order = v->orders.list->GetNext(current_order); order != current_order; order = v->orders.list->GetNext(order)) {
-							if (order->IsGotoOrder()) {
-								result = TestOrderCondition(order, item);
-								break;
-							}
-						}
-						break;
+				case TRIT_COND_CURRENT_ORDER:
+				case TRIT_COND_NEXT_ORDER:
+					switch (static_cast<TraceRestrictOrderCondAuxField>(aux)) {
+						case TROCAF_STATION:  insn.aux = OT_GOTO_STATION;  break;
+						case TROCAF_WAYPOINT: insn.aux = OT_GOTO_WAYPOINT; break;
+						case TROCAF_DEPOT:    insn.aux = OT_GOTO_DEPOT;    break;
+						default: NOT_REACHED();
 					}
+					insn.op = (type == TRIT_COND_CURRENT_ORDER) ? TRCOP_COND_CURRENT_ORDER : TRCOP_COND_NEXT_ORDER;
+					break;
 
-					case TRIT_COND_LAST_STATION:
-						result = TestStationCondition(v->last_station_visited, item);
-						break;
-
-					case TRIT_COND_CARGO: {
-						bool have_cargo = false;
-						for (const Vehicle *v_iter = v; v_iter != NULL; v_iter = v_iter->Next()) {
-							if (v_iter->cargo_type == GetTraceRestrictValue(item) && v_iter->cargo_cap > 0) {
-								have_cargo = true;
-								break;
-							}
-						}
-						result = TestBinaryConditionCommon(item, have_cargo);
-						break;
+				case TRIT_COND_LAST_STATION:
+					if (aux == TROCAF_STATION) {
+						insn.op = TRCOP_COND_LAST_STATION;
+					} else {
+						insn.value = 0;
 					}
+					break;
 
-					case TRIT_COND_ENTRY_DIRECTION: {
-						bool direction_match;
-						switch (GetTraceRestrictValue(item)) {
-							case TRNTSV_NE:
-							case TRNTSV_SE:
-							case TRNTSV_SW:
-							case TRNTSV_NW:
-								direction_match = (static_cast<DiagDirection>(GetTraceRestrictValue(item)) == TrackdirToExitdir(ReverseTrackdir(input.trackdir)));
-								break;
-
-							case TRDTSV_FRONT:
-								direction_match = IsTileType(input.tile, MP_RAILWAY) && HasSignalOnTrackdir(input.tile, input.trackdir);
-								break;
+				case TRIT_COND_CARGO:
+					insn.op = TRCOP_COND_CARGO;
+					break;
 
-							case TRDTSV_BACK:
-								direction_match = IsTileType(input.tile, MP_RAILWAY) && !HasSignalOnTrackdir(input.tile, input.trackdir);
-								break;
+				case TRIT_COND_ENTRY_DIRECTION:
+					switch (value) {
+						case TRNTSV_NE:
+						case TRNTSV_SE:
+						case TRNTSV_SW:
+						case TRNTSV_NW:
+							insn.op = TRCOP_COND_ENTRY_DIRECTION;
+							break;
 
-							default:
-								NOT_REACHED();
-								break;
-						}
-						result = TestBinaryConditionCommon(item, direction_match);
-						break;
-					}
+						case TRDTSV_FRONT:
+							insn.op = TRCOP_COND_ENTRY_FRONT;
+							break;
 
-					case TRIT_COND_PBS_ENTRY_SIGNAL: {
-						// TRVT_TILE_INDEX value type uses the next slot
-						i++;
-						uint32_t signal_tile = this->items[i];
-						if (!have_previous_signal) {
-							if (input.previous_signal_callback) {
-								previous_signal_tile = input.previous_signal_callback(v, input.previous_signal_ptr);
-							}
-							have_previous_signal = true;
-						}
-						bool match = (signal_tile != INVALID_TILE)
-								&& (previous_signal_tile == signal_tile);
-						result = TestBinaryConditionCommon(item, match);
-						break;
-					}
+						case TRDTSV_BACK:
+							insn.op = TRCOP_COND_ENTRY_BACK;
+							break;
 
-					case TRIT_COND_TRAIN_GROUP: {
-						result = TestBinaryConditionCommon(item, GroupIsInGroup(v->group_id, GetTraceRestrictValue(item)));
-						break;
+						default:
+							NOT_REACHED();
 					}
+					break;
 
-					case TRIT_COND_TRAIN_IN_SLOT: {
-						const TraceRestrictSlot *slot = TraceRestrictSlot::GetIfValid(GetTraceRestrictValue(item));
-						result = TestBinaryConditionCommon(item, slot != NULL && slot->IsOccupant(v->index));
-						break;
-					}
+				case TRIT_COND_PBS_ENTRY_SIGNAL:
+					/* TRVT_TILE_INDEX value type uses the next slot */
+					i++;
+					insn.op = TRCOP_COND_PBS_ENTRY_SIGNAL;
+					insn.value = this->items[i];
+					break;
 
-					case TRIT_COND_SLOT_OCCUPANCY: {
-						// TRIT_COND_SLOT_OCCUPANCY value type uses the next slot
-						i++;
-						uint32_t value = this->items[i];
-						const TraceRestrictSlot *slot = TraceRestrictSlot::GetIfValid(GetTraceRestrictValue(item));
-						switch (static_cast<TraceRestrictSlotOccupancyCondAuxField>(GetTraceRestrictAuxField(item))) {
-							case TRSOCAF_OCCUPANTS:
-								result = TestCondition(slot != NULL ? slot->occupants.size() : 0, condop, value);
-								break;
+				case TRIT_COND_TRAIN_GROUP:
+					insn.op = TRCOP_COND_TRAIN_GROUP;
+					break;
 
-							case TRSOCAF_REMAINING:
-								result = TestCondition(slot != NULL ? slot->max_occupancy - slot->occupants.size() : 0, condop, value);
-								break;
+				case TRIT_COND_TRAIN_IN_SLOT:
+					insn.op = TRCOP_COND_TRAIN_IN_SLOT;
+					insn.slot = TraceRestrictSlot::GetIfValid(value);
+					break;
 
-							default:
-								NOT_REACHED();
-								break;
-						}
-						break;
+				case TRIT_COND_SLOT_OCCUPANCY:
+					/* TRIT_COND_SLOT_OCCUPANCY value type uses the next slot */
+					i++;
+					switch (static_cast<TraceRestrictSlotOccupancyCondAuxField>(aux)) {
+						case TRSOCAF_OCCUPANTS: insn.op = TRCOP_COND_SLOT_OCCUPANTS; break;
+						case TRSOCAF_REMAINING: insn.op = TRCOP_COND_SLOT_REMAINING; break;
+						default: NOT_REACHED();
 					}
+					insn.slot = TraceRestrictSlot::GetIfValid(value);
+					insn.value = this->items[i];
+					insn.invert = false;
+					break;
 
-					case TRIT_COND_PHYS_PROP: {
-						switch (static_cast<TraceRestrictPhysPropCondAuxField>(GetTraceRestrictAuxField(item))) {
-							case TRPPCAF_WEIGHT:
-								result = TestCondition(v->gcache.cached_weight, condop, condvalue);
-								break;
-
-							case TRPPCAF_POWER:
-								result = TestCondition(v->gcache.cached_power, condop, condvalue);
-								break;
-
-							case TRPPCAF_MAX_TE:
-								result = TestCondition(v->gcache.cached_max_te / 1000, condop, condvalue);
-								break;
-
-							default:
-								NOT_REACHED();
-								break;
-						}
-						break;
+				case TRIT_COND_PHYS_PROP:
+					switch (static_cast<TraceRestrictPhysPropCondAuxField>(aux)) {
+						case TRPPCAF_WEIGHT: insn.op = TRCOP_COND_WEIGHT; break;
+						case TRPPCAF_POWER:  insn.op = TRCOP_COND_POWER;  break;
+						case TRPPCAF_MAX_TE: insn.op = TRCOP_COND_MAX_TE; break;
+						default: NOT_REACHED();
 					}
+					break;
 
-					case TRIT_COND_PHYS_RATIO: {
-						switch (static_cast<TraceRestrictPhysPropRatioCondAuxField>(GetTraceRestrictAuxField(item))) {
-							case TRPPRCAF_POWER_WEIGHT:
-								result = TestCondition(min<uint>(UINT16_MAX, (100 * v->gcache.cached_power) / max<uint>(1, v->gcache.cached_weight)), condop, condvalue);
-								break;
-
-							case TRPPRCAF_MAX_TE_WEIGHT:
-								result = TestCondition(min<uint>(UINT16_MAX, (v->gcache.cached_max_te / 10) / max<uint>(1, v->gcache.cached_weight)), condop, condvalue);
-								break;
-
-							default:
-								NOT_REACHED();
-								break;
-						}
-						break;
+				case TRIT_COND_PHYS_RATIO:
+					switch (static_cast<TraceRestrictPhysPropRatioCondAuxField>(aux)) {
+						case TRPPRCAF_POWER_WEIGHT:  insn.op = TRCOP_COND_POWER_WEIGHT;  break;
+						case TRPPRCAF_MAX_TE_WEIGHT: insn.op = TRCOP_COND_MAX_TE_WEIGHT; break;
+						default: NOT_REACHED();
 					}
+					break;
 
-					case TRIT_COND_TRAIN_OWNER: {
-						result = TestBinaryConditionCommon(item, v->owner == condvalue);
-						break;
-					}
+				case TRIT_COND_TRAIN_OWNER:
+					insn.op = TRCOP_COND_TRAIN_OWNER;
+					break;
 
-					default:
-						NOT_REACHED();
-				}
-				HandleCondition(condstack, condflags, result);
+				default:
+					NOT_REACHED();
 			}
-		} else {
-			if (condstack.empty() || condstack.back() & TRCSF_ACTIVE) {
-				switch(type) {
-					case TRIT_PF_DENY:
-						if (GetTraceRestrictValue(item)) {
-							out.flags &= ~TRPRF_DENY;
-						} else {
-							out.flags |= TRPRF_DENY;
-						}
-						break;
-
-					case TRIT_PF_PENALTY:
-						switch (static_cast<TraceRestrictPathfinderPenaltyAuxField>(GetTraceRestrictAuxField(item))) {
-							case TRPPAF_VALUE:
-								out.penalty += GetTraceRestrictValue(item);
-								break;
-
-							case TRPPAF_PRESET: {
-								uint16 index = GetTraceRestrictValue(item);
-								assert(index < TRPPPI_END);
-								out.penalty += _tracerestrict_pathfinder_penalty_preset_values[index];
-								break;
-							}
 
-							default:
-								NOT_REACHED();
-						}
-						break;
+			/* integer conditions use condop, and are not inverted */
+			switch (insn.op) {
+				case TRCOP_COND_TRAIN_LENGTH:
+				case TRCOP_COND_MAX_SPEED:
+				case TRCOP_COND_WEIGHT:
+				case TRCOP_COND_POWER:
+				case TRCOP_COND_MAX_TE:
+				case TRCOP_COND_POWER_WEIGHT:
+				case TRCOP_COND_MAX_TE_WEIGHT:
+					insn.invert = false;
+					break;
 
-					case TRIT_RESERVE_THROUGH:
-						if (GetTraceRestrictValue(item)) {
-							out.flags &= ~TRPRF_RESERVE_THROUGH;
-						} else {
-							out.flags |= TRPRF_RESERVE_THROUGH;
-						}
-						break;
+				default:
+					break;
+			}
+			blocks.back().to_next.push_back(index);
+		} else {
+			switch (type) {
+				case TRIT_PF_DENY:
+					emit(value ? TRCOP_CLEAR_FLAGS : TRCOP_SET_FLAGS).value = TRPRF_DENY;
+					break;
 
-					case TRIT_LONG_RESERVE:
-						if (GetTraceRestrictValue(item)) {
-							out.flags &= ~TRPRF_LONG_RESERVE;
-						} else {
-							out.flags |= TRPRF_LONG_RESERVE;
-						}
-						break;
+				case TRIT_PF_PENALTY:
+					switch (static_cast<TraceRestrictPathfinderPenaltyAuxField>(aux)) {
+						case TRPPAF_VALUE:
+							emit(TRCOP_PENALTY).value = value;
+							break;
 
-					case TRIT_WAIT_AT_PBS:
-						if (GetTraceRestrictValue(item)) {
-							out.flags &= ~TRPRF_WAIT_AT_PBS;
-						} else {
-							out.flags |= TRPRF_WAIT_AT_PBS;
-						}
-						break;
+						case TRPPAF_PRESET:
+							assert(value < TRPPPI_END);
+							emit(TRCOP_PENALTY).value = _tracerestrict_pathfinder_penalty_preset_values[value];
+							break;
 
-					case TRIT_SLOT: {
-						if (!input.permitted_slot_operations) break;
-						TraceRestrictSlot *slot = TraceRestrictSlot::GetIfValid(GetTraceRestrictValue(item));
-						if (slot == NULL) break;
-						switch (static_cast<TraceRestrictSlotCondOpField>(GetTraceRestrictCondOp(item))) {
-							case TRSCOF_ACQUIRE_WAIT:
-								if (input.permitted_slot_operations & TRPISP_ACQUIRE) {
-									if (!slot->Occupy(v->index)) out.flags |= TRPRF_WAIT_AT_PBS;
-								}
-								break;
+						default:
+							NOT_REACHED();
+					}
+					break;
 
-							case TRSCOF_ACQUIRE_TRY:
-								if (input.permitted_slot_operations & TRPISP_ACQUIRE) slot->Occupy(v->index);
-								break;
+				case TRIT_RESERVE_THROUGH:
+					emit(value ? TRCOP_CLEAR_FLAGS : TRCOP_SET_FLAGS).value = TRPRF_RESERVE_THROUGH;
+					break;
 
-							case TRSCOF_RELEASE_BACK:
-								if (input.permitted_slot_operations & TRPISP_RELEASE_BACK) slot->Vacate(v->index);
-								break;
+				case TRIT_LONG_RESERVE:
+					emit(value ? TRCOP_CLEAR_FLAGS : TRCOP_SET_FLAGS).value = TRPRF_LONG_RESERVE;
+					break;
 
-							case TRSCOF_RELEASE_FRONT:
-								if (input.permitted_slot_operations & TRPISP_RELEASE_FRONT) slot->Vacate(v->index);
-								break;
+				case TRIT_WAIT_AT_PBS:
+					emit(value ? TRCOP_CLEAR_FLAGS : TRCOP_SET_FLAGS).value = TRPRF_WAIT_AT_PBS;
+					break;
 
-							default:
-								NOT_REACHED();
-								break;
-						}
-						break;
+				case TRIT_SLOT: {
+					TraceRestrictSlot *slot = TraceRestrictSlot::GetIfValid(value);
+					if (slot == NULL) break;
+					TraceRestrictCompiledOp op;
+					switch (static_cast<TraceRestrictSlotCondOpField>(GetTraceRestrictCondOp(item))) {
+						case TRSCOF_ACQUIRE_WAIT:  op = TRCOP_SLOT_ACQUIRE_WAIT;  break;
+						case TRSCOF_ACQUIRE_TRY:   op = TRCOP_SLOT_ACQUIRE_TRY;   break;
+						case TRSCOF_RELEASE_BACK:  op = TRCOP_SLOT_RELEASE_BACK;  break;
+						case TRSCOF_RELEASE_FRONT: op = TRCOP_SLOT_RELEASE_FRONT; break;
+						default: NOT_REACHED();
 					}
-
-					default:
-						NOT_REACHED();
+					emit(op).slot = slot;
+					break;
 				}
+
+				default:
+					NOT_REACHED();
 			}
 		}
 	}
-	assert(condstack.empty());
+	assert(blocks.empty());
 }
 
 /**
@@ -1224,6 +1338,7 @@ CommandCost CmdProgramSignalTraceRestrict(TileIndex tile, DoCommandFlag flags, u
 		// move in modified program
 		prog->items.swap(items);
 		prog->actions_used_flags = actions_used_flags;
+		prog->Compile();
 
 		if (prog->items.size() == 0 && prog->refcount == 1) {
 			// program is empty, and this tile is the only reference to it
@@ -1389,6 +1504,7 @@ void TraceRestrictRemoveDestinationID(TraceRestrictOrderCondAuxField type, uint1
 	TraceRestrictProgram *prog;
 
 	FOR_ALL_TRACE_RESTRICT_PROGRAMS(prog) {
+		bool changed = false;
 		for (size_t i = 0; i < prog->items.size(); i++) {
 			TraceRestrictItem &item = prog->items[i]; // note this is a reference,
 			if (GetTraceRestrictType(item) == TRIT_COND_CURRENT_ORDER ||
@@ -1396,10 +1512,12 @@ void TraceRestrictRemoveDestinationID(TraceRestrictOrderCondAuxField type, uint1
 					GetTraceRestrictType(item) == TRIT_COND_LAST_STATION) {
 				if (GetTraceRestrictAuxField(item) == type && GetTraceRestrictValue(item) == index) {
 					SetTraceRestrictValueDefault(item, TRVT_ORDER); // this updates the instruction in-place
+					changed = true;
 				}
 			}
 			if (IsTraceRestrictDoubleItem(item)) i++;
 		}
+		if (changed) prog->Compile();
 	}
 
 	// update windows
@@ -1415,13 +1533,16 @@ void TraceRestrictRemoveGroupID(GroupID index)
 	TraceRestrictProgram *prog;
 
 	FOR_ALL_TRACE_RESTRICT_PROGRAMS(prog) {
+		bool changed = false;
 		for (size_t i = 0; i < prog->items.size(); i++) {
 			TraceRestrictItem &item = prog->items[i]; // note this is a reference,
 			if (GetTraceRestrictType(item) == TRIT_COND_TRAIN_GROUP && GetTraceRestrictValue(item) == index) {
 				SetTraceRestrictValueDefault(item, TRVT_GROUP_INDEX); // this updates the instruction in-place
+				changed = true;
 			}
 			if (IsTraceRestrictDoubleItem(item)) i++;
 		}
+		if (changed) prog->Compile();
 	}
 
 	// update windows
@@ -1437,15 +1558,18 @@ void TraceRestrictUpdateCompanyID(CompanyID old_company, CompanyID new_company)
 	TraceRestrictProgram *prog;
 
 	FOR_ALL_TRACE_RESTRICT_PROGRAMS(prog) {
+		bool changed = false;
 		for (size_t i = 0; i < prog->items.size(); i++) {
 			TraceRestrictItem &item = prog->items[i]; // note this is a reference,
 			if (GetTraceRestrictType(item) == TRIT_COND_TRAIN_OWNER) {
 				if (GetTraceRestrictValue(item) == old_company) {
 					SetTraceRestrictValue(item, new_company); // this updates the instruction in-place
+					changed = true;
 				}
 			}
 			if (IsTraceRestrictDoubleItem(item)) i++;
 		}
+		if (changed) prog->Compile();
 	}
 
 	// update windows
@@ -1578,22 +1702,87 @@ void TraceRestrictRemoveSlotID(TraceRestrictSlotID index)
 	TraceRestrictProgram *prog;
 
 	FOR_ALL_TRACE_RESTRICT_PROGRAMS(prog) {
+		bool changed = false;
 		for (size_t i = 0; i < prog->items.size(); i++) {
 			TraceRestrictItem &item = prog->items[i]; // note this is a reference,
 			if ((GetTraceRestrictType(item) == TRIT_SLOT || GetTraceRestrictType(item) == TRIT_COND_TRAIN_IN_SLOT) && GetTraceRestrictValue(item) == index) {
 				SetTraceRestrictValueDefault(item, TRVT_SLOT_INDEX); // this updates the instruction in-place
+				changed = true;
 			}
 			if ((GetTraceRestrictType(item) == TRIT_COND_SLOT_OCCUPANCY) && GetTraceRestrictValue(item) == index) {
 				SetTraceRestrictValueDefault(item, TRVT_SLOT_INDEX_INT); // this updates the instruction in-place
+				changed = true;
 			}
 			if (IsTraceRestrictDoubleItem(item)) i++;
 		}
+		if (changed) prog->Compile();
 	}
 
 	// update windows
 	InvalidateWindowClassesData(WC_TRACE_RESTRICT);
 }
 
+/**
+ * Recompile all programs, this is necessary when slots they refer to have been created or loaded
+ */
+void TraceRestrictCompileAllPrograms()
+{
+	TraceRestrictProgram *prog;
+
+	FOR_ALL_TRACE_RESTRICT_PROGRAMS(prog) {
+		prog->Compile();
+	}
+}
+
+/**
+ * Dump the programs which are executed most often, or which took the most time when profiling is enabled
+ * The counters are reset afterwards.
+ */
+void DumpTraceRestrictProgramStats(char *buffer, const char *last)
+{
+	std::vector<TraceRestrictProgram *> progs;
+	uint64 total_count = 0;
+	uint64 total_time = 0;
+
+	TraceRestrictProgram *prog;
+	FOR_ALL_TRACE_RESTRICT_PROGRAMS(prog) {
+		if (prog->eval_count == 0) continue;
+		progs.push_back(prog);
+		total_count += prog->eval_count;
+		total_time += prog->eval_time;
+	}
+
+	bool by_time = total_time > 0;
+	std::sort(progs.begin(), progs.end(), [by_time](const TraceRestrictProgram *a, const TraceRestrictProgram *b) {
+		if (by_time && a->eval_time != b->eval_time) return a->eval_time > b->eval_time;
+		return a->eval_count > b->eval_count;
+	});
+
+	buffer += seprintf(buffer, last, "%u programs executed " OTTD_PRINTF64U " times", (uint)progs.size(), total_count);
+	if (by_time) buffer += seprintf(buffer, last, ", %.3f ms", total_time / 1000.0);
+	buffer += seprintf(buffer, last, "%s\n", _tracerestrict_profile ? "" : " (profiling is off)");
+
+	for (size_t i = 0; i < progs.size() && i < 20; i++) {
+		prog = progs[i];
+		TileIndex tile = INVALID_TILE;
+		for (TraceRestrictMapping::iterator iter = _tracerestrictprogram_mapping.begin(); iter != _tracerestrictprogram_mapping.end(); ++iter) {
+			if (iter->second.program_id == prog->index) {
+				tile = GetTraceRestrictRefIdTileIndex(iter->first);
+				break;
+			}
+		}
+		buffer += seprintf(buffer, last, "  program %u: %u items, %u compiled, %u signals, " OTTD_PRINTF64U " times, %.3f ms",
+				prog->index, (uint)prog->items.size(), (uint)prog->compiled.size(), prog->refcount, prog->eval_count.load(), prog->eval_time.load() / 1000.0);
+		if (tile != INVALID_TILE) buffer += seprintf(buffer, last, ", signal at %u x %u", TileX(tile), TileY(tile));
+		buffer += seprintf(buffer, last, "\n");
+	}
+
+	FOR_ALL_TRACE_RESTRICT_PROGRAMS(prog) {
+		prog->eval_count = 0;
+		prog->eval_time = 0;
+	}
+}
+
 static bool IsUniqueSlotName(const char *name)
 {
 	const TraceRestrictSlot *slot;
@@ -1626,6 +1815,9 @@ CommandCost CmdCreateTraceRestrictSlot(TileIndex tile, DoCommandFlag flags, uint
 		TraceRestrictSlot *slot = new TraceRestrictSlot(_current_company);
 		slot->name = text;
 
+		/* programs may already refer to the new slot ID */
+		TraceRestrictCompileAllPrograms();
+
 		// update windows
 		InvalidateWindowClassesData(WC_TRACE_RESTRICT);
 		InvalidateWindowClassesData(WC_TRACE_RESTRICT_SLOTS);
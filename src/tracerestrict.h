@@ -24,6 +24,7 @@
 #include <map>
 #include <vector>
 #include <unordered_map>
+#include <atomic>
 
 struct Train;
 
@@ -317,6 +318,55 @@ struct TraceRestrictProgramResult {
 			: penalty(0), flags(static_cast<TraceRestrictProgramResultFlags>(0)) { }
 };
 
+/**
+ * Operations of compiled trace restrict instructions, see TraceRestrictProgram::Compile
+ * Conditions jump to TraceRestrictCompiledInstruction::target when they are false
+ */
+enum TraceRestrictCompiledOp {
+	TRCOP_JUMP,                   ///< Unconditional jump to target
+	TRCOP_COND_CONST,             ///< Constant condition: value
+	TRCOP_COND_TRAIN_LENGTH,      ///< Integer condition: train length in tiles
+	TRCOP_COND_MAX_SPEED,         ///< Integer condition: display max speed
+	TRCOP_COND_CURRENT_ORDER,     ///< Binary condition: current order is of type aux to destination value
+	TRCOP_COND_NEXT_ORDER,        ///< Binary condition: next goto order is of type aux to destination value
+	TRCOP_COND_LAST_STATION,      ///< Binary condition: last visited station is value
+	TRCOP_COND_CARGO,             ///< Binary condition: train can carry cargo value
+	TRCOP_COND_ENTRY_DIRECTION,   ///< Binary condition: entering from diagonal direction value
+	TRCOP_COND_ENTRY_FRONT,       ///< Binary condition: entering at the front of the signal
+	TRCOP_COND_ENTRY_BACK,        ///< Binary condition: entering at the back of the signal
+	TRCOP_COND_PBS_ENTRY_SIGNAL,  ///< Binary condition: the PBS entry signal is at tile value
+	TRCOP_COND_TRAIN_GROUP,       ///< Binary condition: train is in group value
+	TRCOP_COND_TRAIN_IN_SLOT,     ///< Binary condition: train is in slot
+	TRCOP_COND_SLOT_OCCUPANTS,    ///< Integer condition: number of occupants of slot
+	TRCOP_COND_SLOT_REMAINING,    ///< Integer condition: remaining capacity of slot
+	TRCOP_COND_WEIGHT,            ///< Integer condition: weight
+	TRCOP_COND_POWER,             ///< Integer condition: power
+	TRCOP_COND_MAX_TE,            ///< Integer condition: max tractive effort in kN
+	TRCOP_COND_POWER_WEIGHT,      ///< Integer condition: power to weight ratio
+	TRCOP_COND_MAX_TE_WEIGHT,     ///< Integer condition: max tractive effort to weight ratio
+	TRCOP_COND_TRAIN_OWNER,       ///< Binary condition: train is owned by company value
+	TRCOP_SET_FLAGS,              ///< Set result flags value
+	TRCOP_CLEAR_FLAGS,            ///< Clear result flags value
+	TRCOP_PENALTY,                ///< Add value to the pathfinder penalty
+	TRCOP_SLOT_ACQUIRE_WAIT,      ///< Acquire slot, or wait at PBS signal
+	TRCOP_SLOT_ACQUIRE_TRY,       ///< Try to acquire slot
+	TRCOP_SLOT_RELEASE_BACK,      ///< Release slot at the back of the signal
+	TRCOP_SLOT_RELEASE_FRONT,     ///< Release slot at the front of the signal
+};
+
+/**
+ * Pre-decoded instruction of a compiled trace restrict program
+ */
+struct TraceRestrictCompiledInstruction {
+	TraceRestrictCompiledOp op;   ///< Operation
+	TraceRestrictCondOp condop;   ///< Comparison of integer conditions
+	bool invert;                  ///< Whether the result of a binary condition is inverted
+	byte aux;                     ///< Order type of order conditions
+	uint32 value;                 ///< Operand
+	uint32 target;                ///< Instruction to jump to when a condition is false, or of a jump
+	TraceRestrictSlot *slot;      ///< Slot of slot conditions and actions, may be NULL
+};
+
 /**
  * Program type, this stores the instruction list
  * This is refcounted, see info at top of tracerestrict.cpp
@@ -325,12 +375,17 @@ struct TraceRestrictProgram : TraceRestrictProgramPool::PoolItem<&_tracerestrict
 	std::vector<TraceRestrictItem> items;
 	uint32 refcount;
 	TraceRestrictProgramActionsUsedFlags actions_used_flags;
+	std::vector<TraceRestrictCompiledInstruction> compiled; ///< Pre-decoded form of items, executed by Execute
+	mutable std::atomic<uint64> eval_count; ///< Number of times the program was executed, also by path predictions on worker threads
+	mutable std::atomic<uint64> eval_time;  ///< Time spent executing the program while profiling, see _tracerestrict_profile
 
 	TraceRestrictProgram()
-			: refcount(0), actions_used_flags(static_cast<TraceRestrictProgramActionsUsedFlags>(0)) { }
+			: refcount(0), actions_used_flags(static_cast<TraceRestrictProgramActionsUsedFlags>(0)), eval_count(0), eval_time(0) { }
 
 	void Execute(const Train *v, const TraceRestrictProgramInput &input, TraceRestrictProgramResult &out) const;
 
+	void Compile();
+
 	/**
 	 * Increment ref count, only use when creating a mapping
 	 */
@@ -380,11 +435,16 @@ struct TraceRestrictProgram : TraceRestrictProgramPool::PoolItem<&_tracerestrict
 		return items.begin() + TraceRestrictProgram::InstructionOffsetToArrayOffset(items, instruction_offset);
 	}
 
-	/** Call validation function on current program instruction list and set actions_used_flags */
+	/** Call validation function on current program instruction list and set actions_used_flags, and compile it when it is valid */
 	CommandCost Validate()
 	{
-		return TraceRestrictProgram::Validate(items, actions_used_flags);
+		CommandCost result = TraceRestrictProgram::Validate(items, actions_used_flags);
+		if (result.Succeeded()) this->Compile();
+		return result;
 	}
+
+private:
+	void ExecuteCompiled(const Train *v, const TraceRestrictProgramInput &input, TraceRestrictProgramResult &out) const;
 };
 
 /** Get TraceRestrictItem type field */
@@ -740,6 +800,10 @@ void TraceRestrictRemoveDestinationID(TraceRestrictOrderCondAuxField type, uint1
 void TraceRestrictRemoveGroupID(GroupID index);
 void TraceRestrictUpdateCompanyID(CompanyID old_company, CompanyID new_company);
 void TraceRestrictRemoveSlotID(TraceRestrictSlotID index);
+void TraceRestrictCompileAllPrograms();
+
+extern bool _tracerestrict_profile;
+void DumpTraceRestrictProgramStats(char *buffer, const char *last);
 
 void TraceRestrictRemoveVehicleFromAllSlots(VehicleID id);
 void TraceRestrictTransferVehicleOccupantInAllSlots(VehicleID from, VehicleID to);
@@ -73,6 +73,8 @@ void CheckTrainsLengths();
 
 void FreeTrainTrackReservation(const Train *v, TileIndex origin = INVALID_TILE, Trackdir orig_td = INVALID_TRACKDIR);
 bool TryPathReserve(Train *v, bool mark_as_stuck = false, bool first_tile_okay = false);
+void PredictTrainPaths();
+void FinishTrainPathPredictions();
 
 void DeleteVisibleTrain(Train *v);
 
@@ -42,6 +42,7 @@
 #include "engine_func.h"
 #include "bridge_signal_map.h"
 #include "scope_info.h"
+#include "framerate_type.h"
 
 #include "table/strings.h"
 #include "table/train_cmd.h"
@@ -3112,6 +3113,130 @@ bool TryPathReserve(Train *v, bool mark_as_stuck, bool first_tile_okay)
 	return true;
 }
 
+/**
+ * Find where the reservation of a train will end when it is extended up to the next track choice,
+ * like #ExtendTrainReservation does, without reserving anything.
+ * @param v The train.
+ * @param[in,out] origin The current end of the reservation, the end at the track choice on return.
+ * @return True if the extended reservation ends in front of a track choice, so the path finder is used.
+ */
+static bool PredictTrainReservationEnd(const Train *v, PBSTileInfo &origin)
+{
+	CFollowTrackRail ft(v);
+
+	TileIndex tile = origin.tile;
+	Trackdir  cur_td = origin.trackdir;
+	for (uint i = 0; i < 16 && ft.Follow(tile, cur_td); i++) {
+		if (KillFirstBit(ft.m_new_td_bits) == TRACKDIR_BIT_NONE) {
+			if (HasOnewaySignalBlockingTrackdir(ft.m_new_tile, FindFirstTrackdir(ft.m_new_td_bits))) return false;
+		}
+
+		if (_settings_game.pf.forbid_90_deg) {
+			ft.m_new_td_bits &= ~TrackdirCrossesTrackdirs(ft.m_old_td);
+			if (ft.m_new_td_bits == TRACKDIR_BIT_NONE) return false;
+		}
+
+		bool target_seen = ft.m_is_station || (IsTileType(ft.m_new_tile, MP_RAILWAY) && !IsPlainRail(ft.m_new_tile));
+		if (target_seen || KillFirstBit(ft.m_new_td_bits) != TRACKDIR_BIT_NONE) {
+			if (HasReservedTracks(ft.m_new_tile, TrackdirBitsToTrackBits(TrackdirReachesTrackdirs(ft.m_old_td)))) return false;
+			origin = PBSTileInfo(tile, cur_td, false);
+			return true;
+		}
+
+		tile = ft.m_new_tile;
+		cur_td = FindFirstTrackdir(ft.m_new_td_bits);
+
+		if (IsSafeWaitingPosition(v, tile, cur_td, true, _settings_game.pf.forbid_90_deg)) return false;
+		if (HasReservedTracks(tile, TrackToTrackBits(TrackdirToTrack(cur_td)))) return false;
+	}
+
+	return false;
+}
+
+/**
+ * Check whether the front of a train might enter the next tile during this tick.
+ * @param v The train.
+ * @return True if the distance to the next tile can be driven during this tick.
+ */
+static bool TrainMayEnterNextTile(Train *v)
+{
+	uint x = v->x_pos & 0xF;
+	uint y = v->y_pos & 0xF;
+	uint distance;
+	switch (TrainExitDir(v->direction, v->track)) {
+		case DIAGDIR_NE: distance = x; break;
+		case DIAGDIR_SE: distance = TILE_SIZE - 1 - y; break;
+		case DIAGDIR_SW: distance = TILE_SIZE - 1 - x; break;
+		case DIAGDIR_NW: distance = y; break;
+		default: NOT_REACHED();
+	}
+
+	/* The train moves twice per tick, allow it to accelerate a bit. */
+	uint speed = min<uint>(v->cur_speed + 8, v->vcache.cached_max_speed);
+	uint steps = (v->progress + 2 * v->GetAdvanceSpeed(speed)) / v->GetAdvanceDistance();
+	return distance < steps;
+}
+
+/**
+ * Search the paths of trains which are likely to choose a track during this tick, in advance and on worker threads.
+ * Trains are selected when they are stuck and will retry to reserve a path, or when they will enter the next tile
+ * and their reservation ends on their current tile, in front of a track choice or a path signal. The predicted paths
+ * are only used when the train really searches from the same origin with the same destination, and they are
+ * validated when they are reserved.
+ * Whether a train is selected depends on the state of the game only, so the results are deterministic.
+ */
+void PredictTrainPaths()
+{
+	if (!_settings_game.pf.yapf.rail_path_prediction || _settings_game.pf.pathfinder_for_trains != VPF_YAPF) return;
+
+	std::vector<YapfTrainPathRequest> requests;
+	Train *v;
+	FOR_ALL_TRAINS(v) {
+		if (!v->IsFrontEngine() || (v->vehstatus & (VS_CRASHED | VS_STOPPED)) != 0) continue;
+		if (v->track == TRACK_BIT_DEPOT || v->track == TRACK_BIT_WORMHOLE) continue;
+		if (v->current_order.IsType(OT_LOADING) || v->current_order.IsType(OT_NOTHING)) continue;
+
+		PBSTileInfo origin = FollowTrainReservation(v);
+		bool reserve;
+		if (HasBit(v->flags, VRF_TRAIN_STUCK)) {
+			/* Stuck trains retry to reserve a path every path_backoff_interval ticks, see TryPathReserve. */
+			if ((v->wait_counter + 1) % _settings_game.pf.path_backoff_interval != 0) continue;
+			if (origin.okay && origin.tile != v->tile) continue;
+			reserve = true;
+		} else {
+			/* A train chooses its track when entering a tile which is not reserved yet, see ChooseTrainTrack. */
+			if (origin.tile != v->tile || !TrainMayEnterNextTile(v)) continue;
+
+			CFollowTrackRail ft(v);
+			if (!ft.Follow(origin.tile, origin.trackdir)) continue;
+			if (_settings_game.pf.forbid_90_deg) ft.m_new_td_bits &= ~TrackdirCrossesTrackdirs(ft.m_old_td);
+			if (ft.m_new_td_bits == TRACKDIR_BIT_NONE || HasReservedTracks(ft.m_new_tile, TrackdirBitsToTrackBits(ft.m_new_td_bits))) continue;
+
+			if (KillFirstBit(ft.m_new_td_bits) == TRACKDIR_BIT_NONE) {
+				reserve = _settings_game.pf.reserve_paths || HasPbsSignalOnTrackdir(ft.m_new_tile, FindFirstTrackdir(ft.m_new_td_bits));
+				if (!reserve) continue;
+			} else {
+				reserve = _settings_game.pf.reserve_paths;
+			}
+		}
+
+		if (reserve && !PredictTrainReservationEnd(v, origin)) continue;
+
+		YapfTrainPathRequest request = { v, origin.tile, origin.trackdir };
+		requests.push_back(request);
+	}
+
+	if (!requests.empty()) YapfTrainPredictPaths(requests);
+}
+
+/**
+ * Drop the paths predicted by #PredictTrainPaths which were not used during the tick.
+ */
+void FinishTrainPathPredictions()
+{
+	YapfTrainFinishPredictions();
+}
+
 
 static bool CheckReverseTrain(const Train *v)
 {
@@ -4627,6 +4752,8 @@ bool Train::Tick()
 	this->tick_counter++;
 
 	if (this->IsFrontEngine()) {
+		PerformanceAccumulator framerate(PFE_GL_TRAINS);
+
 		if (!(this->vehstatus & VS_STOPPED) || this->cur_speed > 0) this->running_ticks++;
 
 		this->current_order_time++;
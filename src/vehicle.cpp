@@ -58,6 +58,8 @@
 #include "tbtr_template_vehicle_func.h"
 #include "string_func.h"
 #include "scope_info.h"
+#include "framerate_type.h"
+#include "newgrf_callback_cache.h"
 #include "3rdparty/cpp-btree/btree_set.h"
 
 #include "table/strings.h"
@@ -79,6 +81,21 @@ INSTANTIATE_POOL_METHODS(Vehicle)
 
 static btree::btree_set<Vehicle *> _vehicles_to_pay_repair;
 
+/** Work a vehicle has to do in #CallVehicleTicks. */
+enum VehicleTickKind : byte {
+	VTK_NONE,  ///< No vehicle, or a vehicle without any work (helicopter rotor).
+	VTK_FULL,  ///< Everything: the vehicle's own tick, cargo aging and running sounds.
+	VTK_PART,  ///< Only the tick counter and cargo aging (wagons and other parts of road vehicles).
+	VTK_CARGO, ///< Only cargo aging (aircraft shadow).
+};
+
+/**
+ * NOSAVE: Work of the vehicles in #CallVehicleTicks, by vehicle index. It is kept apart from the vehicles, so
+ * the ticks can skip the vehicles without any work and take a short cut for parts without touching the rest.
+ * A vehicle starts with #VTK_FULL, and gets its kind when it has been ticked; changes which add work call #Vehicle::ResetTickKind.
+ */
+static std::vector<VehicleTickKind> _vehicle_tick_kinds;
+
 /**
  * Determine shared bounds of all sprites.
  * @param [out] bounds Shared bounds.
@@ -386,6 +403,43 @@ Vehicle::Vehicle(VehicleType type)
 	this->last_station_visited = INVALID_STATION;
 	this->last_loading_station = INVALID_STATION;
 	this->cur_image_valid_dir  = INVALID_DIR;
+	this->ResetTickKind();
+}
+
+/**
+ * Do everything for the vehicle at the next tick, as it may have changed to a kind with more work in #CallVehicleTicks.
+ */
+void Vehicle::ResetTickKind()
+{
+	if (this->index >= _vehicle_tick_kinds.size()) _vehicle_tick_kinds.resize(this->index + 1, VTK_NONE);
+	_vehicle_tick_kinds[this->index] = VTK_FULL;
+}
+
+/**
+ * Get the work a vehicle has to do in #CallVehicleTicks.
+ * @param v The vehicle.
+ * @return The kind of work of the vehicle.
+ */
+static VehicleTickKind GetVehicleTickKind(const Vehicle *v)
+{
+	switch (v->type) {
+		case VEH_TRAIN: {
+			/* Train::Tick only increases the tick counter of parts, besides the first of a chain of free wagons; wagons play no sounds. */
+			const Train *t = Train::From(v);
+			return (t->IsFrontEngine() || t->IsFreeWagon() || !t->IsWagon()) ? VTK_FULL : VTK_PART;
+		}
+
+		case VEH_ROAD:
+			return RoadVehicle::From(v)->IsFrontEngine() ? VTK_FULL : VTK_PART;
+
+		case VEH_AIRCRAFT:
+			if (Aircraft::From(v)->IsNormalAircraft()) return VTK_FULL;
+			/* The rotor never carries cargo. */
+			return v->subtype == AIR_ROTOR ? VTK_NONE : VTK_CARGO;
+
+		default:
+			return VTK_FULL;
+	}
 }
 
 /**
@@ -397,25 +451,60 @@ byte VehicleRandomBits()
 	return GB(Random(), 0, 8);
 }
 
-/* Size of the hash, 6 = 64 x 64, 7 = 128 x 128. Larger sizes will (in theory) reduce hash
- * lookup times at the expense of memory usage. */
-const int HASH_BITS = 7;
-const int HASH_SIZE = 1 << HASH_BITS;
-const int HASH_MASK = HASH_SIZE - 1;
-const int TOTAL_HASH_SIZE = 1 << (HASH_BITS * 2);
-const int TOTAL_HASH_MASK = TOTAL_HASH_SIZE - 1;
+/* The tile hash has one bucket per tile, so that a lookup only visits the vehicles on that tile.
+ * On very large maps the number of buckets is limited to keep the memory usage reasonable;
+ * tiles which are a multiple of the hash size apart then share a bucket. */
+static const uint MAX_TILE_HASH_BITS = 20; ///< Maximum number of bits of the tile hash index, 20 = 1M buckets.
+
+static uint _tile_hash_bits_x;  ///< Number of bits of the x coordinate used by the tile hash.
+static uint _tile_hash_mask_x;  ///< Mask of the x coordinate in the tile hash.
+static uint _tile_hash_mask_y;  ///< Mask of the y coordinate in the tile hash.
+static uint _tile_hash_size;    ///< Number of buckets in the tile hash.
+static Vehicle **_vehicle_tile_hash = NULL;
+
+/**
+ * Get the bucket of the tile hash for a location on the map.
+ * @param x The X coordinate, in tiles.
+ * @param y The Y coordinate, in tiles.
+ * @return The index in #_vehicle_tile_hash.
+ */
+static inline uint GetTileHashIndex(uint x, uint y)
+{
+	return ((y & _tile_hash_mask_y) << _tile_hash_bits_x) | (x & _tile_hash_mask_x);
+}
+
+/**
+ * (Re)allocate the vehicle tile hash for the current map size.
+ * All vehicles are removed from the hash, they are added again by their next position update.
+ */
+void AllocateVehicleTileHash()
+{
+	uint bits_x = MapLogX();
+	uint bits_y = MapLogY();
+	while (bits_x + bits_y > MAX_TILE_HASH_BITS) {
+		if (bits_x >= bits_y) {
+			bits_x--;
+		} else {
+			bits_y--;
+		}
+	}
 
-/* Resolution of the hash, 0 = 1*1 tile, 1 = 2*2 tiles, 2 = 4*4 tiles, etc.
- * Profiling results show that 0 is fastest. */
-const int HASH_RES = 0;
+	_tile_hash_bits_x = bits_x;
+	_tile_hash_mask_x = (1 << bits_x) - 1;
+	_tile_hash_mask_y = (1 << bits_y) - 1;
+	_tile_hash_size = 1 << (bits_x + bits_y);
 
-static Vehicle *_vehicle_tile_hash[TOTAL_HASH_SIZE];
+	Vehicle *v;
+	FOR_ALL_VEHICLES(v) { v->hash_tile_current = NULL; }
+	free(_vehicle_tile_hash);
+	_vehicle_tile_hash = CallocT<Vehicle *>(_tile_hash_size);
+}
 
-static Vehicle *VehicleFromTileHash(int xl, int yl, int xu, int yu, void *data, VehicleFromPosProc *proc, bool find_first)
+static Vehicle *VehicleFromTileHash(uint xl, uint yl, uint xu, uint yu, void *data, VehicleFromPosProc *proc, bool find_first)
 {
-	for (int y = yl; ; y = (y + (1 << HASH_BITS)) & (HASH_MASK << HASH_BITS)) {
-		for (int x = xl; ; x = (x + 1) & HASH_MASK) {
-			Vehicle *v = _vehicle_tile_hash[(x + y) & TOTAL_HASH_MASK];
+	for (uint y = yl; ; y = (y + 1) & _tile_hash_mask_y) {
+		for (uint x = xl; ; x = (x + 1) & _tile_hash_mask_x) {
+			Vehicle *v = _vehicle_tile_hash[GetTileHashIndex(x, y)];
 			for (; v != NULL; v = v->hash_tile_next) {
 				Vehicle *a = proc(v, data);
 				if (find_first && a != NULL) return a;
@@ -445,10 +534,10 @@ static Vehicle *VehicleFromPosXY(int x, int y, void *data, VehicleFromPosProc *p
 	const int COLL_DIST = 6;
 
 	/* Hash area to scan is from xl,yl to xu,yu */
-	int xl = GB((x - COLL_DIST) / TILE_SIZE, HASH_RES, HASH_BITS);
-	int xu = GB((x + COLL_DIST) / TILE_SIZE, HASH_RES, HASH_BITS);
-	int yl = GB((y - COLL_DIST) / TILE_SIZE, HASH_RES, HASH_BITS) << HASH_BITS;
-	int yu = GB((y + COLL_DIST) / TILE_SIZE, HASH_RES, HASH_BITS) << HASH_BITS;
+	uint xl = ((x - COLL_DIST) / TILE_SIZE) & _tile_hash_mask_x;
+	uint xu = ((x + COLL_DIST) / TILE_SIZE) & _tile_hash_mask_x;
+	uint yl = ((y - COLL_DIST) / TILE_SIZE) & _tile_hash_mask_y;
+	uint yu = ((y + COLL_DIST) / TILE_SIZE) & _tile_hash_mask_y;
 
 	return VehicleFromTileHash(xl, yl, xu, yu, data, proc, find_first);
 }
@@ -500,10 +589,7 @@ bool HasVehicleOnPosXY(int x, int y, void *data, VehicleFromPosProc *proc)
  */
 static Vehicle *VehicleFromPos(TileIndex tile, void *data, VehicleFromPosProc *proc, bool find_first)
 {
-	int x = GB(TileX(tile), HASH_RES, HASH_BITS);
-	int y = GB(TileY(tile), HASH_RES, HASH_BITS) << HASH_BITS;
-
-	Vehicle *v = _vehicle_tile_hash[(x + y) & TOTAL_HASH_MASK];
+	Vehicle *v = _vehicle_tile_hash[GetTileHashIndex(TileX(tile), TileY(tile))];
 	for (; v != NULL; v = v->hash_tile_next) {
 		if (v->tile != tile) continue;
 
@@ -683,9 +769,7 @@ static void UpdateVehicleTileHash(Vehicle *v, bool remove)
 	if (remove) {
 		new_hash = NULL;
 	} else {
-		int x = GB(TileX(v->tile), HASH_RES, HASH_BITS);
-		int y = GB(TileY(v->tile), HASH_RES, HASH_BITS) << HASH_BITS;
-		new_hash = &_vehicle_tile_hash[(x + y) & TOTAL_HASH_MASK];
+		new_hash = &_vehicle_tile_hash[GetTileHashIndex(TileX(v->tile), TileY(v->tile))];
 	}
 
 	if (old_hash == new_hash) return;
@@ -741,7 +825,45 @@ void ResetVehicleHash()
 	Vehicle *v;
 	FOR_ALL_VEHICLES(v) { v->hash_tile_current = NULL; }
 	memset(_vehicle_viewport_hash, 0, sizeof(_vehicle_viewport_hash));
-	memset(_vehicle_tile_hash, 0, sizeof(_vehicle_tile_hash));
+	MemSetT(_vehicle_tile_hash, 0, _tile_hash_size);
+}
+
+/**
+ * Write statistics about the occupancy of the vehicle tile hash to a buffer.
+ * @param buffer Buffer to write to.
+ * @param last Last valid byte of the buffer.
+ */
+void DumpVehicleTileHashStats(char *buffer, const char *last)
+{
+	uint vehicles = 0;
+	uint used_buckets = 0;
+	uint max_chain = 0;
+	uint shared_buckets = 0;
+	uint64 chain_visits = 0;
+	for (uint i = 0; i < _tile_hash_size; i++) {
+		uint chain = 0;
+		bool shared = false;
+		for (const Vehicle *v = _vehicle_tile_hash[i]; v != NULL; v = v->hash_tile_next) {
+			if (v->tile != _vehicle_tile_hash[i]->tile) shared = true;
+			chain++;
+		}
+		if (chain == 0) continue;
+		vehicles += chain;
+		used_buckets++;
+		max_chain = max(max_chain, chain);
+		if (shared) shared_buckets++;
+		/* A lookup of a vehicle in this bucket walks the whole chain. */
+		chain_visits += (uint64)chain * chain;
+	}
+
+	buffer += seprintf(buffer, last, "Tile hash: %u x %u buckets, map: %u x %u tiles\n",
+			_tile_hash_mask_x + 1, _tile_hash_mask_y + 1, MapSizeX(), MapSizeY());
+	buffer += seprintf(buffer, last, "Vehicles in hash: %u, used buckets: %u, buckets with vehicles on different tiles: %u\n",
+			vehicles, used_buckets, shared_buckets);
+	if (used_buckets > 0) {
+		buffer += seprintf(buffer, last, "Average chain length: %.2f, longest chain: %u, average chain length per vehicle lookup: %.2f\n",
+				(double)vehicles / used_buckets, max_chain, (double)chain_visits / vehicles);
+	}
 }
 
 void ResetVehicleColourMap()
@@ -820,6 +942,16 @@ const Engine *Vehicle::GetEngine() const
 	return Engine::Get(this->engine_type);
 }
 
+/**
+ * Invalidates cached NewGRF variables and memoised callback results
+ * @see InvalidateNewGRFCacheOfChain
+ */
+void Vehicle::InvalidateNewGRFCache()
+{
+	this->grf_cache.cache_valid = 0;
+	InvalidateNewGRFCallbackCache();
+}
+
 /**
  * Retrieve the NewGRF the vehicle is tied to.
  * This is the GRF providing the Action 3 for the engine type.
@@ -882,7 +1014,7 @@ void Vehicle::PreDestructor()
 
 	if (Station::IsValidID(this->last_station_visited)) {
 		Station *st = Station::Get(this->last_station_visited);
-		st->loading_vehicles.erase(std::remove(st->loading_vehicles.begin(), st->loading_vehicles.end(), this), st->loading_vehicles.end());
+		st->RemoveLoadingVehicle(this);
 
 		HideFillingPercent(&this->fill_percent_te_id);
 		this->CancelReservation(INVALID_STATION, st);
@@ -957,6 +1089,8 @@ void Vehicle::PreDestructor()
 
 Vehicle::~Vehicle()
 {
+	_vehicle_tick_kinds[this->index] = VTK_NONE;
+
 	if (CleaningPool()) {
 		this->cargo.OnCleanPool();
 		return;
@@ -1062,97 +1196,159 @@ static void ShowAutoReplaceAdviceMessage(const CommandCost &res, const Vehicle *
 	AddVehicleAdviceNewsItem(message, v->index);
 }
 
-void CallVehicleTicks()
+/**
+ * Age the cargo of a vehicle when its cargo aging period has passed.
+ * @param v The vehicle.
+ */
+static inline void AgeVehicleCargo(Vehicle *v)
 {
-	_vehicles_to_autoreplace.Clear();
-	_vehicles_to_templatereplace.Clear();
-	_vehicles_to_pay_repair.clear();
+	if (v->vcache.cached_cargo_age_period != 0) {
+		v->cargo_age_counter = min(v->cargo_age_counter, v->vcache.cached_cargo_age_period);
+		if (--v->cargo_age_counter == 0) {
+			v->cargo.AgeCargo();
+			v->cargo_age_counter = v->vcache.cached_cargo_age_period;
+		}
+	}
+}
 
-	if (_tick_skip_counter == 0) RunVehicleDayProc();
+/**
+ * Do all the work of a vehicle in a tick.
+ * @param v The vehicle.
+ * @return True if the vehicle still exists.
+ */
+static bool TickVehicle(Vehicle *v)
+{
+	/* Vehicle could be deleted in this tick */
+	if (!v->Tick()) return false;
 
-	Station *st;
-	FOR_ALL_STATIONS(st) LoadUnloadStation(st);
+	switch (v->type) {
+		default: break;
 
-	Vehicle *v = NULL;
-	SCOPE_INFO_FMT([&v], "CallVehicleTicks: %s", scope_dumper().VehicleInfo(v));
-	FOR_ALL_VEHICLES(v) {
-		/* Vehicle could be deleted in this tick */
-		if (!v->Tick()) {
-			assert(Vehicle::Get(vehicle_index) == NULL);
-			continue;
-		}
+		case VEH_TRAIN:
+			if (HasBit(Train::From(v)->flags, VRF_TOO_HEAVY)) {
+				if (v->owner == _local_company) {
+					SetDParam(0, v->index);
+					SetDParam(1, STR_ERROR_TRAIN_TOO_HEAVY);
+					AddVehicleNewsItem(STR_ERROR_TRAIN_TOO_HEAVY, NT_ADVICE, v->index);
+				}
+				ClrBit(Train::From(v)->flags, VRF_TOO_HEAVY);
+			}
+			/* FALL THROUGH */
+		case VEH_ROAD:
+		case VEH_AIRCRAFT:
+		case VEH_SHIP: {
+			Vehicle *front = v->First();
 
-		assert(Vehicle::Get(vehicle_index) == v);
+			AgeVehicleCargo(v);
 
-		switch (v->type) {
-			default: break;
+			/* Do not play any sound when crashed */
+			if (front->vehstatus & VS_CRASHED) break;
 
-			case VEH_TRAIN:
-				if (HasBit(Train::From(v)->flags, VRF_TOO_HEAVY)) {
-					if (v->owner == _local_company) {
-						SetDParam(0, v->index);
-						SetDParam(1, STR_ERROR_TRAIN_TOO_HEAVY);
-						AddVehicleNewsItem(STR_ERROR_TRAIN_TOO_HEAVY, NT_ADVICE, v->index);
-					}
-					ClrBit(Train::From(v)->flags, VRF_TOO_HEAVY);
-				}
-				/* FALL THROUGH */
-			case VEH_ROAD:
-			case VEH_AIRCRAFT:
-			case VEH_SHIP: {
-				Vehicle *front = v->First();
-
-				if (v->vcache.cached_cargo_age_period != 0) {
-					v->cargo_age_counter = min(v->cargo_age_counter, v->vcache.cached_cargo_age_period);
-					if (--v->cargo_age_counter == 0) {
-						v->cargo.AgeCargo();
-						v->cargo_age_counter = v->vcache.cached_cargo_age_period;
-					}
-				}
+			/* Do not play any sound when in depot or tunnel */
+			if (v->vehstatus & VS_HIDDEN) break;
 
-				/* Do not play any sound when crashed */
-				if (front->vehstatus & VS_CRASHED) continue;
+			/* Do not play any sound when stopped */
+			if ((front->vehstatus & VS_STOPPED) && (front->type != VEH_TRAIN || front->cur_speed == 0)) break;
 
-				/* Do not play any sound when in depot or tunnel */
-				if (v->vehstatus & VS_HIDDEN) continue;
+			/* Check vehicle type specifics */
+			switch (v->type) {
+				case VEH_TRAIN:
+					if (Train::From(v)->IsWagon()) return true;
+					break;
 
-				/* Do not play any sound when stopped */
-				if ((front->vehstatus & VS_STOPPED) && (front->type != VEH_TRAIN || front->cur_speed == 0)) continue;
+				case VEH_ROAD:
+					if (!RoadVehicle::From(v)->IsFrontEngine()) return true;
+					break;
 
-				/* Check vehicle type specifics */
-				switch (v->type) {
-					case VEH_TRAIN:
-						if (Train::From(v)->IsWagon()) continue;
-						break;
+				case VEH_AIRCRAFT:
+					if (!Aircraft::From(v)->IsNormalAircraft()) return true;
+					break;
 
-					case VEH_ROAD:
-						if (!RoadVehicle::From(v)->IsFrontEngine()) continue;
-						break;
+				default:
+					break;
+			}
 
-					case VEH_AIRCRAFT:
-						if (!Aircraft::From(v)->IsNormalAircraft()) continue;
-						break;
+			v->motion_counter += front->cur_speed;
+			/* Play a running sound if the motion counter passes 256 (Do we not skip sounds?) */
+			if (GB(v->motion_counter, 0, 8) < front->cur_speed) PlayVehicleSound(v, VSE_RUNNING);
 
-					default:
-						break;
-				}
+			/* Play an alternating running sound every 16 ticks */
+			if (GB(v->tick_counter, 0, 4) == 0) {
+				/* Play running sound when speed > 0 and not braking */
+				bool running = (front->cur_speed > 0) && !(front->vehstatus & (VS_STOPPED | VS_TRAIN_SLOWING));
+				PlayVehicleSound(v, running ? VSE_RUNNING_16 : VSE_STOPPED_16);
+			}
 
-				v->motion_counter += front->cur_speed;
-				/* Play a running sound if the motion counter passes 256 (Do we not skip sounds?) */
-				if (GB(v->motion_counter, 0, 8) < front->cur_speed) PlayVehicleSound(v, VSE_RUNNING);
+			break;
+		}
+	}
 
-				/* Play an alternating running sound every 16 ticks */
-				if (GB(v->tick_counter, 0, 4) == 0) {
-					/* Play running sound when speed > 0 and not braking */
-					bool running = (front->cur_speed > 0) && !(front->vehstatus & (VS_STOPPED | VS_TRAIN_SLOWING));
-					PlayVehicleSound(v, running ? VSE_RUNNING_16 : VSE_STOPPED_16);
-				}
+	return true;
+}
 
-				break;
+void CallVehicleTicks()
+{
+	_vehicles_to_autoreplace.Clear();
+	_vehicles_to_templatereplace.Clear();
+	_vehicles_to_pay_repair.clear();
+
+	if (_tick_skip_counter == 0) RunVehicleDayProc();
+
+	PerformanceAccumulator::Reset(PFE_GL_TRAINS);
+	PerformanceAccumulator::Reset(PFE_GL_ROADVEHS);
+	PerformanceAccumulator::Reset(PFE_GL_SHIPS);
+	PerformanceAccumulator::Reset(PFE_GL_AIRCRAFT);
+
+	{
+		PerformanceMeasurer framerate(PFE_GL_ECONOMY);
+		/* Loading and unloading invalidate the memoised vehicle callbacks whenever the cargo of a vehicle changes. */
+		NewGRFCallbackCacheScope cb_cache(NEWGRF_CALLBACK_CACHE_VEHICLES);
+		LoadUnloadStations();
+	}
+
+	{
+		PerformanceAccumulator framerate(PFE_GL_TRAINS);
+		PredictTrainPaths();
+	}
+
+	Vehicle *v = NULL;
+	SCOPE_INFO_FMT([&v], "CallVehicleTicks: %s", scope_dumper().VehicleInfo(v));
+	{
+		/* Consist changes and commands invalidate the memoised vehicle callbacks; besides that, they are only kept during the tick of a single vehicle. */
+		NewGRFCallbackCacheScope cb_cache(NEWGRF_CALLBACK_CACHE_VEHICLES);
+		/* Vehicles are ticked in the order of the pool, including the vehicles created by the ticks. */
+		for (size_t index = 0; index < _vehicle_tick_kinds.size(); index++) {
+			switch (_vehicle_tick_kinds[index]) {
+				case VTK_NONE:
+					continue;
+
+				case VTK_PART:
+					v = Vehicle::Get(index);
+					v->tick_counter++;
+					AgeVehicleCargo(v);
+					continue;
+
+				case VTK_CARGO:
+					v = Vehicle::Get(index);
+					AgeVehicleCargo(v);
+					continue;
+
+				case VTK_FULL:
+					v = Vehicle::Get(index);
+					InvalidateNewGRFCallbackCache();
+					if (!TickVehicle(v)) {
+						assert(Vehicle::Get(index) == NULL);
+						continue;
+					}
+
+					assert(Vehicle::Get(index) == v);
+					_vehicle_tick_kinds[index] = GetVehicleTickKind(v);
+					break;
 			}
 		}
 	}
 	v = NULL;
+	FinishTrainPathPredictions();
 
 	/* do Template Replacement */
 	Backup<CompanyByte> tmpl_cur_company(_current_company, FILE_LINE);
@@ -2726,7 +2922,7 @@ void Vehicle::LeaveStation()
 	this->current_order.MakeLeaveStation();
 	Station *st = Station::Get(this->last_station_visited);
 	this->CancelReservation(INVALID_STATION, st);
-	st->loading_vehicles.erase(std::remove(st->loading_vehicles.begin(), st->loading_vehicles.end(), this), st->loading_vehicles.end());
+	st->RemoveLoadingVehicle(this);
 
 	HideFillingPercent(&this->fill_percent_te_id);
 	trip_occupancy = CalcPercentVehicleFilled(this, NULL);
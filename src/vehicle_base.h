@@ -349,6 +349,8 @@ public:
 	/** We want to 'destruct' the right class. */
 	virtual ~Vehicle();
 
+	void ResetTickKind();
+
 	uint32 GetLastLoadingStationValidCargoMask() const;
 
 	void BeginLoading();
@@ -459,14 +461,7 @@ public:
 	const GRFFile *GetGRF() const;
 	uint32 GetGRFID() const;
 
-	/**
-	 * Invalidates cached NewGRF variables
-	 * @see InvalidateNewGRFCacheOfChain
-	 */
-	inline void InvalidateNewGRFCache()
-	{
-		this->grf_cache.cache_valid = 0;
-	}
+	void InvalidateNewGRFCache();
 
 	/**
 	 * Invalidates cached NewGRF variables of all vehicles in the chain (after the current vehicle)
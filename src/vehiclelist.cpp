@@ -14,6 +14,9 @@
 #include "vehiclelist.h"
 #include "group.h"
 #include "tracerestrict.h"
+#include "order_func.h"
+
+#include <algorithm>
 
 #include "safeguards.h"
 
@@ -108,6 +111,27 @@ void BuildDepotVehicleList(VehicleType type, TileIndex tile, VehicleList *engine
 	if (wagons != NULL && wagons != engines) wagons->Compact();
 }
 
+/**
+ * Add the primary vehicles of a type which have an order to a destination to a list, in the order of their index.
+ * @param list List to add the vehicles to.
+ * @param vtype Type of the vehicles.
+ * @param destination The station, waypoint or depot.
+ * @param depot Whether to look for depot orders instead of station, waypoint and implicit orders.
+ */
+static void AddVehiclesWithDestination(VehicleList *list, VehicleType vtype, DestinationID destination, bool depot)
+{
+	std::vector<const OrderList *> lists;
+	GetOrderListsWithDestination(lists, destination, depot);
+
+	uint start = list->Length();
+	for (const OrderList *orderlist : lists) {
+		for (const Vehicle *v = orderlist->GetFirstSharedVehicle(); v != NULL; v = v->NextShared()) {
+			if (v->type == vtype && v->IsPrimaryVehicle()) *list->Append() = v;
+		}
+	}
+	std::sort(list->Begin() + start, list->End(), [](const Vehicle *a, const Vehicle *b) { return a->index < b->index; });
+}
+
 /**
  * Generate a list of vehicles based on window type.
  * @param list Pointer to list to add vehicles to
@@ -130,19 +154,7 @@ bool GenerateVehicleSortList(VehicleList *list, const VehicleListIdentifier &vli
 
 	switch (vli.type) {
 		case VL_STATION_LIST:
-			FOR_ALL_VEHICLES(v) {
-				if (v->type == vli.vtype && v->IsPrimaryVehicle()) {
-					const Order *order;
-
-					FOR_VEHICLE_ORDERS(v, order) {
-						if ((order->IsType(OT_GOTO_STATION) || order->IsType(OT_GOTO_WAYPOINT) || order->IsType(OT_IMPLICIT))
-								&& order->GetDestination() == vli.index) {
-							*list->Append() = v;
-							break;
-						}
-					}
-				}
-			}
+			AddVehiclesWithDestination(list, vli.vtype, vli.index, false);
 			break;
 
 		case VL_SHARED_ORDERS:
@@ -173,18 +185,7 @@ bool GenerateVehicleSortList(VehicleList *list, const VehicleListIdentifier &vli
 			break;
 
 		case VL_DEPOT_LIST:
-			FOR_ALL_VEHICLES(v) {
-				if (v->type == vli.vtype && v->IsPrimaryVehicle()) {
-					const Order *order;
-
-					FOR_VEHICLE_ORDERS(v, order) {
-						if (order->IsType(OT_GOTO_DEPOT) && !(order->GetDepotActionType() & ODATFB_NEAREST_DEPOT) && order->GetDestination() == vli.index) {
-							*list->Append() = v;
-							break;
-						}
-					}
-				}
-			}
+			AddVehiclesWithDestination(list, vli.vtype, vli.index, true);
 			break;
 
 		case VL_SLOT_LIST: {
@@ -12,6 +12,7 @@
 #include "../stdafx.h"
 #include "../gfx_func.h"
 #include "../blitter/factory.hpp"
+#include "../benchmark.h"
 #include "null_v.h"
 
 #include "../safeguards.h"
@@ -44,6 +45,11 @@ void VideoDriver_Null::MakeDirty(int left, int top, int width, int height) {}
 
 void VideoDriver_Null::MainLoop()
 {
+	if (_benchmark.ticks > 0) {
+		RunBenchmark();
+		return;
+	}
+
 	uint i;
 
 	for (i = 0; i < this->ticks; i++) {
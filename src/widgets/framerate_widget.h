@@ -0,0 +1,23 @@
+/* $Id$ */
+
+/*
+ * This file is part of OpenTTD.
+ * OpenTTD is free software; you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, version 2.
+ * OpenTTD is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details. You should have received a copy of the GNU General Public License along with OpenTTD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** @file framerate_widget.h Types related to the framerate windows widgets. */
+
+#ifndef WIDGETS_FRAMERATE_WIDGET_H
+#define WIDGETS_FRAMERATE_WIDGET_H
+
+/** Widgets of the #FramerateWindow class. */
+enum FramerateWidgets {
+	WID_FRW_CAPTION,        ///< Caption of the window.
+	WID_FRW_RATE_GAMELOOP,  ///< Simulation rate of the game loop.
+	WID_FRW_TIMES,          ///< Panel with the times of the game loop elements.
+	WID_FRW_SCROLLBAR,      ///< Scrollbar of the times panel.
+};
+
+#endif /* WIDGETS_FRAMERATE_WIDGET_H */
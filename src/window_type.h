@@ -743,6 +743,12 @@ enum WindowClass {
 	WC_BUILD_VIRTUAL_TRAIN,
 	WC_CREATE_TEMPLATE,
 
+	/**
+	 * Framerate window; %Window numbers:
+	 *   - 0 = #FramerateWidgets
+	 */
+	WC_FRAMERATE_DISPLAY,
+
 	WC_INVALID = 0xFFFF, ///< Invalid window.
 };
 